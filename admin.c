@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+#include "admin.h"
+#include "memacct.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// ms the admin thread waits in poll before checking if the server is still running
+#define POLL_MS 500
+// seconds an open admin connection may sit without sending a command before it is closed to free its slot
+#define IDLE_SECONDS 30
+// admin connections answered at once, one more is told there is no room
+#define ADMIN_CLIENTS 8
+// seconds writing an answer may block, a client that stops reading holds up the other connections at most this long
+#define SEND_SECONDS 2
+
+// one open admin connection and the part of a line it has sent so far
+typedef struct admin_client {
+    int fd;                // -1 for a free slot
+    size_t length;
+    char buffer[ADMIN_LINE_BYTES];
+    time_t last_active;    // CLOCK_MONOTONIC seconds of its last command
+} admin_client_t;
+
+admin_server_t admin_server = {-1};
+static volatile int* server_running = NULL;
+
+// adds a command the socket answers, before admin_start (returns 1 on success, 0 if there is no room)
+int admin_register(admin_server_t* server, const char* name, const char* help, admin_handler_fn handler) {
+    if (server->command_count == ADMIN_MAX_COMMANDS) {
+        return 0;
+    }
+    admin_command_t* command = &server->commands[server->command_count++];
+    command->name = name;
+    command->help = help;
+    command->handler = handler;
+    return 1;
+}
+
+void admin_snapshot_clear(admin_snapshot_t* snapshot) {
+    snapshot->count = 0;
+    snapshot->used = 0;
+    snapshot->failed = 0;
+}
+
+// copies a string into the arena (returns its offset, 0 for an empty string)
+static uint32_t copy_string(admin_snapshot_t* snapshot, const char* text, size_t max) {
+    size_t length = strnlen(text, max);
+    if (length == 0) {
+        return 0;
+    }
+    if (snapshot->used + length + 1 > snapshot->arena_capacity) {
+        size_t capacity = snapshot->arena_capacity ? snapshot->arena_capacity * 2 : 65536;
+        char* grown = memacct_realloc(MEMACCT_LOG, snapshot->arena, capacity);
+        if (grown == NULL) {
+            snapshot->failed = 1;
+            return 0;
+        }
+        snapshot->arena = grown;
+        snapshot->arena_capacity = capacity;
+    }
+    uint32_t offset = snapshot->used;
+    memcpy(snapshot->arena + offset, text, length);
+    snapshot->arena[offset + length] = '\0';
+    snapshot->used += length + 1;
+    return offset;
+}
+
+// copies one game into the snapshot, called with the game list locked so it does no I/O
+void admin_snapshot_add(admin_snapshot_t* snapshot, const admin_game_t* game, const char* x_name, const char* o_name, const char* variant, const char* board) {
+    if (snapshot->used == 0) {
+        // empty strings are offset 0, listed as -
+        copy_string(snapshot, "-", 1);
+    }
+    if (snapshot->count == snapshot->capacity) {
+        size_t capacity = snapshot->capacity ? snapshot->capacity * 2 : 1024;
+        admin_game_t* grown = memacct_realloc(MEMACCT_LOG, snapshot->games, capacity * sizeof(admin_game_t));
+        if (grown == NULL) {
+            snapshot->failed = 1;
+            return;
+        }
+        snapshot->games = grown;
+        snapshot->capacity = capacity;
+    }
+    admin_game_t* copy = &snapshot->games[snapshot->count++];
+    *copy = *game;
+    copy->x_name = copy_string(snapshot, x_name, 128);
+    copy->o_name = copy_string(snapshot, o_name, 128);
+    copy->variant = copy_string(snapshot, variant, 24);
+    copy->board = copy_string(snapshot, board, ADMIN_BOARD_BYTES);
+}
+
+// writes one line per game: id, state, turn, moves, X's fd and name, O's fd and name, variant and board
+void admin_snapshot_write(const admin_snapshot_t* snapshot, FILE* out) {
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const admin_game_t* game = &snapshot->games[i];
+        fprintf(out, "%llu %c %c %d %d %s %d %s %s %s\n", (unsigned long long) game->id, game->state, game->turn, game->moves,
+            game->xfd, snapshot->arena + game->x_name, game->ofd, snapshot->arena + game->o_name, snapshot->arena + game->variant, snapshot->arena + game->board);
+    }
+}
+
+void admin_snapshot_free(admin_snapshot_t* snapshot) {
+    memacct_free(MEMACCT_LOG, snapshot->games);
+    memacct_free(MEMACCT_LOG, snapshot->arena);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// runs one command line and writes its answer, an answer's last line starts with OK or ERR
+static void run_command(admin_server_t* server, char* line, FILE* out) {
+    char* name = line + strspn(line, " \t");
+    char* args = name + strcspn(name, " \t");
+    if (*args != '\0') {
+        *args++ = '\0';
+        args += strspn(args, " \t");
+    }
+    if (*name == '\0') {
+        return;
+    }
+    if (strcasecmp(name, "HELP") == 0) {
+        for (int i = 0; i < server->command_count; i++) {
+            fprintf(out, "%-10s %s\n", server->commands[i].name, server->commands[i].help);
+        }
+        fprintf(out, "OK %d commands\n", server->command_count);
+        return;
+    }
+    for (int i = 0; i < server->command_count; i++) {
+        if (strcasecmp(name, server->commands[i].name) == 0) {
+            if (!server->commands[i].handler(args, out)) {
+                fprintf(out, "ERR %s failed\n", server->commands[i].name);
+            }
+            return;
+        }
+    }
+    fprintf(out, "ERR unknown command %s, try HELP\n", name);
+}
+
+// writes all of a buffer (returns 1 on success, 0 if the connection is gone)
+static int write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t bytes_written = write(fd, data, length);
+        if (bytes_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_written <= 0) {
+            return 0;
+        }
+        data += bytes_written;
+        length -= bytes_written;
+    }
+    return 1;
+}
+
+static time_t monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+// reads what a connection poll found ready and answers every complete line, each answer is built in memory and written
+// once it is complete (returns 1 to keep the connection, 0 to close it)
+static int serve_client(admin_server_t* server, admin_client_t* client) {
+    ssize_t bytes_read = read(client->fd, client->buffer + client->length, sizeof(client->buffer) - 1 - client->length);
+    // a profiler tick, poll will say it is still ready
+    if (bytes_read < 0 && errno == EINTR) {
+        return 1;
+    }
+    if (bytes_read <= 0) {
+        return 0;
+    }
+    client->length += bytes_read;
+    client->buffer[client->length] = '\0';
+    client->last_active = monotonic_seconds();
+    char* newline;
+    while ((newline = strchr(client->buffer, '\n')) != NULL) {
+        *newline = '\0';
+        if (newline > client->buffer && newline[-1] == '\r') {
+            newline[-1] = '\0';
+        }
+        char* answer = NULL;
+        size_t answer_length = 0;
+        FILE* out = open_memstream(&answer, &answer_length);
+        if (out == NULL) {
+            perror("open_memstream");
+            return 0;
+        }
+        run_command(server, client->buffer, out);
+        fclose(out);
+        // the answer's buffer is only final once the stream is closed
+        memacct_track(MEMACCT_LOG, answer);
+        int written = write_all(client->fd, answer, answer_length);
+        memacct_free(MEMACCT_LOG, answer);
+        if (!written) {
+            return 0;
+        }
+        client->length -= newline + 1 - client->buffer;
+        memmove(client->buffer, newline + 1, client->length + 1);
+    }
+    if (client->length == sizeof(client->buffer) - 1) {
+        write_all(client->fd, "ERR line too long\n", 18);
+        return 0;
+    }
+    return 1;
+}
+
+// takes a new admin connection into a free slot, or tells it there is none
+static void accept_client(admin_server_t* server, admin_client_t* clients) {
+    int fd = accept(server->listener, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EINTR) {
+            perror("admin accept");
+        }
+        return;
+    }
+    struct timeval timeout = {SEND_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout));
+    for (int i = 0; i < ADMIN_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            clients[i].fd = fd;
+            clients[i].length = 0;
+            clients[i].buffer[0] = '\0';
+            clients[i].last_active = monotonic_seconds();
+            return;
+        }
+    }
+    write_all(fd, "ERR too many admin connections\n", 31);
+    close(fd);
+}
+
+// answers every open admin connection with one poll, so an operator who leaves a connection open holds up no one,
+// until the server stops
+static void* serve_admin(void* arg) {
+    admin_server_t* server = arg;
+    admin_client_t clients[ADMIN_CLIENTS];
+    for (int i = 0; i < ADMIN_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    while (*server_running) {
+        struct pollfd polled[ADMIN_CLIENTS + 1];
+        int slot_of[ADMIN_CLIENTS + 1];
+        int count = 0;
+        polled[count].fd = server->listener;
+        polled[count].events = POLLIN;
+        slot_of[count++] = -1;
+        for (int i = 0; i < ADMIN_CLIENTS; i++) {
+            if (clients[i].fd >= 0) {
+                polled[count].fd = clients[i].fd;
+                polled[count].events = POLLIN;
+                slot_of[count++] = i;
+            }
+        }
+        if (poll(polled, count, POLL_MS) > 0) {
+            for (int i = 1; i < count; i++) {
+                admin_client_t* client = &clients[slot_of[i]];
+                if ((polled[i].revents & (POLLIN | POLLHUP | POLLERR)) && !serve_client(server, client)) {
+                    close(client->fd);
+                    client->fd = -1;
+                }
+            }
+            if (polled[0].revents & POLLIN) {
+                accept_client(server, clients);
+            }
+        }
+        time_t now = monotonic_seconds();
+        for (int i = 0; i < ADMIN_CLIENTS; i++) {
+            if (clients[i].fd >= 0 && now - clients[i].last_active > IDLE_SECONDS) {
+                write_all(clients[i].fd, "ERR idle too long\n", 18);
+                close(clients[i].fd);
+                clients[i].fd = -1;
+            }
+        }
+    }
+    for (int i = 0; i < ADMIN_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            close(clients[i].fd);
+        }
+    }
+    close(server->listener);
+    server->listener = -1;
+    unlink(server->path);
+    return NULL;
+}
+
+// listens on the Unix socket at path (only its owner may connect) and starts the thread answering it,
+// the caller blocks the signals the thread must not get (returns 1 on success, 0 if error)
+int admin_start(admin_server_t* server, const char* path, volatile int* running) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "admin socket path %s is too long\n", path);
+        return 0;
+    }
+    strcpy(addr.sun_path, path);
+    strcpy(server->path, path);
+    // a socket left by a server that didn't shut down cleanly
+    unlink(path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    // the mode is set before listen, nobody can connect until then (a umask would be the whole process's, and the journal,
+    // history and trace threads may be creating files right now)
+    int bound = sock >= 0 && bind(sock, (struct sockaddr*) &addr, sizeof(addr)) == 0 && chmod(path, 0600) == 0;
+    if (!bound || listen(sock, 4) < 0) {
+        perror("admin socket");
+        if (sock >= 0) {
+            close(sock);
+        }
+        return 0;
+    }
+    server->listener = sock;
+    server_running = running;
+    int error = pthread_create(&server->tid, NULL, serve_admin, server);
+    if (error != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(error));
+        close(sock);
+        unlink(path);
+        server->listener = -1;
+        return 0;
+    }
+    pthread_detach(server->tid);
+    return 1;
+}
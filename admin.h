@@ -0,0 +1,71 @@
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Unix socket the server takes commands on (named after its port), one per line, answered with lines ending in a line starting with OK or ERR
+#define ADMIN_PATH_FORMAT "ttts-%s.admin"
+// characters of a game's board kept for listings, bigger m,n,k boards show their first cells
+#define ADMIN_BOARD_BYTES 128
+// most commands the server can register
+#define ADMIN_MAX_COMMANDS 16
+// longest command line
+#define ADMIN_LINE_BYTES 512
+
+// a game as a listing shows it, strings are offsets into the snapshot's arena
+typedef struct admin_game {
+    uint64_t id;
+    int xfd;
+    int ofd;
+    char state;            // W waiting for an opponent, R waiting for its players to resume it, P being played
+    char turn;             // X or O, - before the game starts
+    int moves;
+    uint32_t x_name;
+    uint32_t o_name;
+    uint32_t variant;
+    uint32_t board;
+} admin_game_t;
+
+// the games at one point in time, taken while the list is locked and printed after it is unlocked
+// the buffers are kept from one snapshot to the next so taking one allocates only when the list has grown
+typedef struct admin_snapshot {
+    admin_game_t* games;
+    size_t count;
+    size_t capacity;
+    char* arena;
+    size_t used;
+    size_t arena_capacity;
+    int failed;            // an allocation failed, the snapshot misses games
+} admin_snapshot_t;
+
+// runs a command with what followed its name on the line and writes the answer to out (returns 1 for OK, 0 for ERR)
+typedef int (*admin_handler_fn)(const char* args, FILE* out);
+
+typedef struct admin_command {
+    const char* name;
+    const char* help;
+    admin_handler_fn handler;
+} admin_command_t;
+
+// the socket and the thread answering it
+typedef struct admin_server {
+    int listener;          // -1 when the admin socket is off
+    pthread_t tid;
+    char path[108];
+    admin_command_t commands[ADMIN_MAX_COMMANDS];
+    int command_count;
+} admin_server_t;
+
+extern admin_server_t admin_server;
+
+int admin_register(admin_server_t* server, const char* name, const char* help, admin_handler_fn handler);
+int admin_start(admin_server_t* server, const char* path, volatile int* running);
+void admin_snapshot_clear(admin_snapshot_t* snapshot);
+void admin_snapshot_add(admin_snapshot_t* snapshot, const admin_game_t* game, const char* x_name, const char* o_name, const char* variant, const char* board);
+void admin_snapshot_write(const admin_snapshot_t* snapshot, FILE* out);
+void admin_snapshot_free(admin_snapshot_t* snapshot);
+
+#endif
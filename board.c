@@ -0,0 +1,88 @@
+#include "board.h"
+#include <string.h>
+
+const uint16_t board_win_masks[BOARD_LINES] = {
+    0x007, 0x038, 0x1C0, // rows
+    0x049, 0x092, 0x124, // columns
+    0x111, 0x054         // diagonals
+};
+
+// one bit per 9-bit mask (512 bits), set if the mask contains one of board_win_masks, so a win check is a single lookup
+static const uint8_t win_table[64] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0xFF,
+    0x80, 0xAA, 0xF0, 0xFA, 0x80, 0xAA, 0xF0, 0xFF,
+    0x80, 0x80, 0xCC, 0xCC, 0x80, 0x80, 0xCC, 0xFF,
+    0x80, 0xAA, 0xFC, 0xFE, 0x80, 0xAA, 0xFC, 0xFF,
+    0x80, 0x80, 0xAA, 0xAA, 0xF0, 0xF0, 0xFA, 0xFF,
+    0x80, 0xAA, 0xFA, 0xFA, 0xF0, 0xFA, 0xFA, 0xFF,
+    0x80, 0x80, 0xEE, 0xEE, 0xF0, 0xF0, 0xFE, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// gets the bit of a cell from its 1-based row and column (as they are sent in a MOVE message)
+static inline uint16_t cell_bit(int row, int col) {
+    return (uint16_t) (1u << ((row - 1) * 3 + (col - 1)));
+}
+
+// sets up an empty board
+void board_init(board_t* board) {
+    board->x = 0;
+    board->o = 0;
+    memset(board->str, '.', BOARD_CELLS);
+    board->str[BOARD_CELLS] = '\0';
+}
+
+// builds the masks from a board string like the one in a MOVD message (returns 1 on success, 0 if the string is malformed)
+int board_from_string(board_t* board, const char* board_str) {
+    board_init(board);
+    for (int i = 0; i < BOARD_CELLS; i++) {
+        if (board_str[i] == 'X') {
+            board->x |= (uint16_t) (1u << i);
+        }
+        else if (board_str[i] == 'O') {
+            board->o |= (uint16_t) (1u << i);
+        }
+        else if (board_str[i] != '.') {
+            return 0;
+        }
+        board->str[i] = board_str[i];
+    }
+    return 1;
+}
+
+// checks if a move is valid (1 if yes, else 0)
+int board_is_valid_move(const board_t* board, int row, int col) {
+    // check if the row and column are within the bounds of the board
+    if (row < 1 || row > 3 || col < 1 || col > 3) {
+        return 0;
+    }
+    // check if the spot on the board is already taken
+    return ((board->x | board->o) & cell_bit(row, col)) == 0;
+}
+
+// places role on a cell, the caller must have checked the move with board_is_valid_move
+void board_place(board_t* board, int row, int col, char role) {
+    if (role == 'X') {
+        board->x |= cell_bit(row, col);
+    }
+    else {
+        board->o |= cell_bit(row, col);
+    }
+    board->str[(row - 1) * 3 + (col - 1)] = role;
+}
+
+// checks if a mask of cells contains a full line (1 if yes, else 0)
+int board_mask_is_win(uint16_t mask) {
+    mask &= BOARD_FULL;
+    return (win_table[mask >> 3] >> (mask & 7)) & 1;
+}
+
+// checks if a player has won the game (1 if yes, else 0)
+int board_check_win(const board_t* board, char role) {
+    return board_mask_is_win(role == 'X' ? board->x : board->o);
+}
+
+// checks if there is a tie (1 if yes, else 0)
+int board_check_tie(const board_t* board) {
+    return __builtin_popcount(board->x | board->o) == BOARD_CELLS;
+}
@@ -0,0 +1,28 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+
+// a 3x3 board is stored as two 9-bit masks, cell (row, col) is bit ((row - 1) * 3 + (col - 1))
+#define BOARD_CELLS 9
+#define BOARD_FULL 0x1FF
+#define BOARD_LINES 8
+
+typedef struct board {
+    uint16_t x;                 // cells taken by X
+    uint16_t o;                 // cells taken by O
+    char str[BOARD_CELLS + 1];  // board string sent in MOVD, updated one cell per move
+} board_t;
+
+// the 8 winning lines (3 rows, 3 columns, 2 diagonals) as masks
+extern const uint16_t board_win_masks[BOARD_LINES];
+
+void board_init(board_t* board);
+int board_from_string(board_t* board, const char* board_str);
+int board_is_valid_move(const board_t* board, int row, int col);
+void board_place(board_t* board, int row, int col, char role);
+int board_check_win(const board_t* board, char role);
+int board_check_tie(const board_t* board);
+int board_mask_is_win(uint16_t mask);
+
+#endif
@@ -0,0 +1,419 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bot.h"
+#include "latency.h"
+#include "lockprof.h"
+#include "memacct.h"
+#include "metrics.h"
+#include "perfect.h"
+#include "poscache.h"
+#include "tablebase.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// one slot per core, each with an arena: a search borrows a slot for its tree and its game thread, and idle slots for more workers
+// the tree is thrown away after every move so a bot needs an arena only while it searches, and only the slot whose arena
+// holds the tree has one allocated (the first time it is borrowed, it is kept for the next search)
+static lockprof_mutex_t arena_lock = LOCKPROF_MUTEX_INITIALIZER("bot arena_lock");
+static pthread_cond_t arena_returned = PTHREAD_COND_INITIALIZER;
+static mcts_t arenas[BOT_MAX_ARENAS];
+static int arena_busy[BOT_MAX_ARENAS];
+static int arena_count = 0;
+
+// the slots one search holds, slots[0] is the one whose arena it searches in
+typedef struct borrowed {
+    int slots[MCTS_MAX_THREADS];
+    int count;
+    int budget_ms;    // what is left of the think time after waiting for the slots
+} borrowed_t;
+
+void bot_init(bot_t* bot, int strength, uint32_t seed) {
+    bot->strength = strength < 0 ? 0 : (strength > 100 ? 100 : strength);
+    bot->rng = seed != 0 ? seed : 1;
+    bot->last_search.playouts = 0;
+}
+
+static void return_arena(borrowed_t* borrowed) {
+    lockprof_lock(&arena_lock);
+    for (int i = 0; i < borrowed->count; i++) {
+        arena_busy[borrowed->slots[i]] = 0;
+    }
+    borrowed->count = 0;
+    // a search can give back several slots, everyone waiting may find one
+    pthread_cond_broadcast(&arena_returned);
+    lockprof_unlock(&arena_lock);
+}
+
+// borrows a free slot and its arena, waiting for one until budget_ms from now, and half the other idle slots as workers
+// half so the next bot to search still finds cores (returns 1 on success, 0 if none came free in time or it couldn't be allocated)
+static int borrow_arena(borrowed_t* borrowed, int budget_ms) {
+    uint64_t start_ns = latency_now();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += budget_ms / 1000;
+    deadline.tv_nsec += (budget_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    borrowed->count = 0;
+    lockprof_lock(&arena_lock);
+    if (arena_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        arena_count = cores < 1 ? 1 : (cores > BOT_MAX_ARENAS ? BOT_MAX_ARENAS : (int) cores);
+    }
+    while (borrowed->count == 0) {
+        int idle = 0;
+        int slot = -1;
+        for (int i = 0; i < arena_count; i++) {
+            if (!arena_busy[i]) {
+                idle++;
+                // an arena that is already allocated is taken before one that would have to be
+                if (slot < 0 || (arenas[slot].nodes == NULL && arenas[i].nodes != NULL)) {
+                    slot = i;
+                }
+            }
+        }
+        if (slot >= 0) {
+            arena_busy[slot] = 1;
+            borrowed->slots[borrowed->count++] = slot;
+            // workers go on slots without an arena first, so the allocated ones stay free for other searches' trees
+            int workers = (idle - 1) / 2;
+            for (int pass = 0; pass < 2; pass++) {
+                for (int i = 0; i < arena_count && workers > 0 && borrowed->count < MCTS_MAX_THREADS; i++) {
+                    if (!arena_busy[i] && (pass == 1 || arenas[i].nodes == NULL)) {
+                        arena_busy[i] = 1;
+                        borrowed->slots[borrowed->count++] = i;
+                        workers--;
+                    }
+                }
+            }
+        }
+        else if (lockprof_cond_timedwait(&arena_returned, &arena_lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    // allocated with the lock held, the first searches on a busy server would otherwise all allocate at once anyway
+    mcts_t* arena = borrowed->count > 0 ? &arenas[borrowed->slots[0]] : NULL;
+    if (arena != NULL && arena->nodes == NULL) {
+        if (mcts_init(arena, MCTS_DEFAULT_NODES)) {
+            memacct_track(MEMACCT_BOT, arena->nodes);
+        }
+        else {
+            for (int i = 0; i < borrowed->count; i++) {
+                arena_busy[borrowed->slots[i]] = 0;
+            }
+            borrowed->count = 0;
+            pthread_cond_broadcast(&arena_returned);
+        }
+    }
+    lockprof_unlock(&arena_lock);
+    // the wait comes out of the think time, a bot never takes longer than BOT_THINK_MS for a move
+    borrowed->budget_ms = budget_ms - (int) ((latency_now() - start_ns) / 1000000);
+    if (borrowed->count > 0 && borrowed->budget_ms < 1) {
+        return_arena(borrowed);
+    }
+    return borrowed->count > 0;
+}
+
+// xorshift, returns a number in [0, n)
+static uint32_t bot_random(bot_t* bot, uint32_t n) {
+    uint32_t r = bot->rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    bot->rng = r;
+    return r % n;
+}
+
+// rolls against the bot's strength (1 if the bot should play its best, else 0)
+static int plays_best(bot_t* bot) {
+    return (int) bot_random(bot, 100) < bot->strength;
+}
+
+// picks a random cell of a 9-bit mask (the mask must not be empty)
+static int random_cell(bot_t* bot, uint16_t mask) {
+    int pick = bot_random(bot, __builtin_popcount(mask));
+    for (int cell = 0; cell < BOARD_CELLS; cell++) {
+        if (mask & (1 << cell)) {
+            if (pick == 0) {
+                return cell;
+            }
+            pick--;
+        }
+    }
+    return -1;
+}
+
+// classic 3x3: a best move from the perfect play table, or a random one when the strength roll fails
+static int choose_classic(bot_t* bot, const board_t* board, int* row, int* col) {
+    uint16_t empty = ~(board->x | board->o) & BOARD_FULL;
+    if (empty == 0) {
+        return 0;
+    }
+    uint16_t best = perfect_best_moves(board);
+    int cell = random_cell(bot, (best != 0 && plays_best(bot)) ? best : empty);
+    *row = cell / 3 + 1;
+    *col = cell % 3 + 1;
+    return 1;
+}
+
+// ultimate: win the game if possible, else win a sub-board, else block the opponent's sub-board win (random when the strength roll fails)
+static int choose_ultimate(bot_t* bot, const ultimate_board_t* board, char role, int* row, int* col) {
+    uint16_t moves[BOARD_CELLS];
+    if (ultimate_legal_moves(board, moves) == 0) {
+        return 0;
+    }
+    const uint16_t* mine = (role == 'X') ? board->x : board->o;
+    const uint16_t* theirs = (role == 'X') ? board->o : board->x;
+    uint16_t won = (role == 'X') ? board->won_x : board->won_o;
+    int pick_sub = -1;
+    uint16_t pick = 0;
+    int rank = 0;
+    int best = plays_best(bot);
+    for (int sub = 0; sub < BOARD_CELLS && best; sub++) {
+        for (uint16_t left = moves[sub]; left != 0; left &= left - 1) {
+            uint16_t bit = left & -left;
+            int move_rank = 0;
+            if (board_mask_is_win(mine[sub] | bit)) {
+                move_rank = board_mask_is_win(won | (1 << sub)) ? 3 : 2;
+            }
+            else if (board_mask_is_win(theirs[sub] | bit)) {
+                move_rank = 1;
+            }
+            if (move_rank > rank) {
+                rank = move_rank;
+                pick_sub = sub;
+                pick = bit;
+            }
+        }
+    }
+    if (pick_sub < 0) {
+        int total = 0;
+        for (int sub = 0; sub < BOARD_CELLS; sub++) {
+            total += __builtin_popcount(moves[sub]);
+        }
+        int skip = bot_random(bot, total);
+        for (pick_sub = 0; skip >= __builtin_popcount(moves[pick_sub]); pick_sub++) {
+            skip -= __builtin_popcount(moves[pick_sub]);
+        }
+        pick = moves[pick_sub];
+        while (skip-- > 0) {
+            pick &= pick - 1;
+        }
+        pick &= -pick;
+    }
+    int cell = __builtin_ctz(pick);
+    *row = (pick_sub / 3) * 3 + cell / 3 + 1;
+    *col = (pick_sub % 3) * 3 + cell % 3 + 1;
+    return 1;
+}
+
+// gravity: win if possible, block the opponent's win, otherwise the free column nearest the middle (random when the strength roll fails)
+static int choose_gravity(bot_t* bot, const gravity_board_t* board, char role, int* row, int* col) {
+    char other = (role == 'X') ? 'O' : 'X';
+    int best = plays_best(bot);
+    int win_col = 0;
+    int block_col = 0;
+    int pick_col = 0;
+    int pick_score = -1;
+    int seen = 0;
+    for (int c = 1; c <= board->cols; c++) {
+        if (gravity_drop_row(board, c) == 0) {
+            continue;
+        }
+        if (win_col == 0 && gravity_would_win(board, c, role)) {
+            win_col = c;
+        }
+        if (block_col == 0 && gravity_would_win(board, c, other)) {
+            block_col = c;
+        }
+        // the middle columns are part of the most lines, a weak bot treats every column the same
+        int score = best ? board->cols - abs(2 * c - board->cols - 1) : 0;
+        if (score > pick_score) {
+            pick_score = score;
+            pick_col = c;
+            seen = 1;
+        }
+        else if (score == pick_score && bot_random(bot, ++seen) == 0) {
+            pick_col = c;
+        }
+    }
+    if (pick_col == 0) {
+        return 0;
+    }
+    if (win_col != 0) {
+        pick_col = win_col;
+    }
+    else if (block_col != 0 && best) {
+        pick_col = block_col;
+    }
+    *row = gravity_drop_row(board, pick_col);
+    *col = pick_col;
+    return 1;
+}
+
+// counts the stones around a cell, used to keep m,n,k moves near the action
+static int neighbours(const mnk_board_t* board, int row, int col) {
+    int count = 0;
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+            int r = row + dr;
+            int c = col + dc;
+            if ((dr != 0 || dc != 0) && r >= 1 && r <= board->rows && c >= 1 && c <= board->cols && board->str[(r - 1) * board->cols + (c - 1)] != '.') {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// looks up a move an earlier search picked for this position (or a mirror or rotation of it) in any game
+// cache values are the cell on the canonical board in the low 16 bits and the playouts behind it above
+static int cached_move(const game_board_t* game, int* row, int* col) {
+    const mnk_board_t* board = &game->mnk;
+    int sym = 0;
+    uint64_t value = 0;
+    if (position_cache.slots == NULL) {
+        return 0;
+    }
+    if (!poscache_get(&position_cache, canon_hash_key(&game->hash, &sym), &value)) {
+        metrics_add(METRIC_POSCACHE_MISSES, 1);
+        return 0;
+    }
+    metrics_add(METRIC_POSCACHE_HITS, 1);
+    int cell = canon_transform(canon_inverse(sym), board->rows, board->cols, value & 0xFFFF);
+    int r = cell / board->cols + 1;
+    int c = cell % board->cols + 1;
+    // a different position with the same 64 bit hash is very unlikely but must not make an illegal move
+    if (!mnk_is_valid_move(board, r, c)) {
+        return 0;
+    }
+    *row = r;
+    *col = c;
+    return 1;
+}
+
+// stores a searched move on the canonical board so games reaching any symmetric position can reuse it
+static void cache_move(const game_board_t* game, int row, int col, long playouts) {
+    if (position_cache.slots == NULL) {
+        return;
+    }
+    int sym = 0;
+    uint64_t key = canon_hash_key(&game->hash, &sym);
+    int cell = canon_transform(sym, game->mnk.rows, game->mnk.cols, (row - 1) * game->mnk.cols + (col - 1));
+    poscache_put(&position_cache, key, ((uint64_t) playouts << 16) | (uint64_t) cell);
+}
+
+// m,n,k boards: win if possible, block the opponent's win, otherwise search with MCTS (random when the strength roll fails)
+// playing next to the most stones is the fallback if the search can't run
+static int choose_mnk(bot_t* bot, const game_board_t* game, char role, int* row, int* col) {
+    const mnk_board_t* board = &game->mnk;
+    char other = (role == 'X') ? 'O' : 'X';
+    int best = plays_best(bot);
+    int block_row = 0;
+    int block_col = 0;
+    int pick_row = 0;
+    int pick_col = 0;
+    int pick_score = -1;
+    int seen = 0;
+    for (int r = 1; r <= board->rows; r++) {
+        for (int c = 1; c <= board->cols; c++) {
+            if (board->str[(r - 1) * board->cols + (c - 1)] != '.') {
+                continue;
+            }
+            if (mnk_would_win(board, r, c, role)) {
+                *row = r;
+                *col = c;
+                return 1;
+            }
+            if (block_row == 0 && mnk_would_win(board, r, c, other)) {
+                block_row = r;
+                block_col = c;
+            }
+            // a weak move is any empty cell, a strong one is the cell touching the most stones (ties broken at random)
+            int score = best ? neighbours(board, r, c) : 0;
+            if (score > pick_score) {
+                pick_score = score;
+                pick_row = r;
+                pick_col = c;
+                seen = 1;
+            }
+            else if (score == pick_score && bot_random(bot, ++seen) == 0) {
+                pick_row = r;
+                pick_col = c;
+            }
+        }
+    }
+    // 4x4 four in a row is solved, the tablebase has every best move
+    if (best && board->rows == 4 && board->cols == 4 && board->k == 4 && tablebase4.map != NULL) {
+        uint16_t x = 0;
+        uint16_t o = 0;
+        for (int cell = 0; cell < TABLEBASE_CELLS; cell++) {
+            x |= (board->str[cell] == 'X') << cell;
+            o |= (board->str[cell] == 'O') << cell;
+        }
+        uint16_t moves = tablebase_best_moves(&tablebase4, x, o);
+        if (moves != 0) {
+            int pick = bot_random(bot, __builtin_popcount(moves));
+            while (pick-- > 0) {
+                moves &= moves - 1;
+            }
+            int cell = __builtin_ctz(moves);
+            *row = cell / 4 + 1;
+            *col = cell % 4 + 1;
+            return 1;
+        }
+    }
+    if (block_row != 0 && best) {
+        *row = block_row;
+        *col = block_col;
+        return 1;
+    }
+    if (best && cached_move(game, row, col)) {
+        return 1;
+    }
+    // a search runs on the game thread and the idle cores it borrowed, more bot games than cores wait for a slot instead of
+    // crowding the cores, and a bot that waits its whole think time plays the fallback instead
+    borrowed_t borrowed;
+    if (best && borrow_arena(&borrowed, BOT_THINK_MS)) {
+        int searched = mcts_search(&arenas[borrowed.slots[0]], board, role, borrowed.budget_ms, borrowed.count, bot->rng, row, col, &bot->last_search);
+        return_arena(&borrowed);
+        if (searched) {
+            cache_move(game, *row, *col, bot->last_search.playouts);
+            return 1;
+        }
+    }
+    if (pick_row == 0) {
+        return 0;
+    }
+    *row = pick_row;
+    *col = pick_col;
+    return 1;
+}
+
+// picks the bot's next move as a 1-based row and col (returns 1 on success, 0 if there is no legal move)
+int bot_choose_move(bot_t* bot, const game_board_t* board, char role, int* row, int* col) {
+    bot->last_search.playouts = 0;
+    if (board->variant.type == VARIANT_CLASSIC) {
+        return choose_classic(bot, &board->classic, row, col);
+    }
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        return choose_ultimate(bot, &board->ultimate, role, row, col);
+    }
+    if (board->variant.type == VARIANT_GRAVITY) {
+        return choose_gravity(bot, &board->gravity, role, row, col);
+    }
+    return choose_mnk(bot, board, role, row, col);
+}
+
+// answers a draw suggested by the opponent on their turn (1 to accept, 0 to reject)
+// on the classic board the bot only rejects when it is winning with perfect play, elsewhere weaker bots accept more often
+int bot_accepts_draw(bot_t* bot, const game_board_t* board, char role) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        // the value is for the opponent since it is their turn
+        return perfect_value(&board->classic) != PERFECT_LOSS || !plays_best(bot);
+    }
+    return !plays_best(bot);
+}
@@ -0,0 +1,30 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stdint.h>
+#include "protocol.h"
+#include "variant.h"
+#include "mcts.h"
+
+// fd stored in a game for a bot player, bots run inside the game thread so they have no socket
+#define BOT_FD -2
+#define BOT_NAME "BOT"
+// time a bot may think about one move on an m,n,k board, a small slice of the turn timeout players get
+#define BOT_THINK_MS (TURN_TIMEOUT_SECONDS * 1000 / 20)
+// most search slots bots share, there is one per core up to this: a search borrows one for its tree and game thread and
+// half the idle ones for more workers, so however many bot games there are their searches use at most every core once
+// and an arena's memory per core
+#define BOT_MAX_ARENAS 64
+
+// an in-process opponent, strength is the chance in percent (0-100) that it plays a best move instead of a random one
+typedef struct bot {
+    int strength;
+    uint32_t rng;
+    mcts_stats_t last_search; // playouts of the last search (0 if the move didn't need one)
+} bot_t;
+
+void bot_init(bot_t* bot, int strength, uint32_t seed);
+int bot_choose_move(bot_t* bot, const game_board_t* board, char role, int* row, int* col);
+int bot_accepts_draw(bot_t* bot, const game_board_t* board, char role);
+
+#endif
@@ -0,0 +1,183 @@
+// NOTE: must use option -pthread when compiling!
+#include "canon.h"
+#include <pthread.h>
+
+// perm9[sym][mask] is a 3x3 cell mask with every cell moved by sym, so a board is transformed with two lookups
+static uint16_t perm9[CANON_SYMMETRIES][1 << BOARD_CELLS];
+// the same for 4x4 masks, split into the low and high byte so the tables stay small (mask = lo[mask & 0xFF] | hi[mask >> 8])
+static uint16_t perm16_lo[CANON_SYMMETRIES][256];
+static uint16_t perm16_hi[CANON_SYMMETRIES][256];
+// random keys for every role on every cell of the largest board, cells are numbered row * MNK_MAX_SIDE + col
+static uint64_t zobrist[2][MNK_MAX_SIDE * MNK_MAX_SIDE];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static const int inverses[CANON_SYMMETRIES] = {0, 3, 2, 1, 4, 5, 6, 7};
+
+// splitmix64, fixed seed so every process (and every run) uses the same keys
+static uint64_t next_key(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// moves a 0-based (row, col) by a symmetry
+static void transform_cell(int sym, int rows, int cols, int* row, int* col) {
+    int r = *row;
+    int c = *col;
+    switch (sym) {
+        case 1: *row = c; *col = rows - 1 - r; break;
+        case 2: *row = rows - 1 - r; *col = cols - 1 - c; break;
+        case 3: *row = cols - 1 - c; *col = r; break;
+        case 4: *col = cols - 1 - c; break;
+        case 5: *row = rows - 1 - r; break;
+        case 6: *row = c; *col = r; break;
+        case 7: *row = cols - 1 - c; *col = rows - 1 - r; break;
+    }
+}
+
+static void build_tables(void) {
+    for (int sym = 0; sym < CANON_SYMMETRIES; sym++) {
+        for (int mask = 0; mask < (1 << BOARD_CELLS); mask++) {
+            uint16_t moved = 0;
+            for (int cell = 0; cell < BOARD_CELLS; cell++) {
+                if (mask & (1 << cell)) {
+                    moved |= 1 << canon_transform(sym, 3, 3, cell);
+                }
+            }
+            perm9[sym][mask] = moved;
+        }
+        for (int byte = 0; byte < 256; byte++) {
+            uint16_t lo = 0;
+            uint16_t hi = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                if (byte & (1 << bit)) {
+                    lo |= 1 << canon_transform(sym, 4, 4, bit);
+                    hi |= 1 << canon_transform(sym, 4, 4, bit + 8);
+                }
+            }
+            perm16_lo[sym][byte] = lo;
+            perm16_hi[sym][byte] = hi;
+        }
+    }
+    uint64_t state = 0x5474547454745474ull;
+    for (int role = 0; role < 2; role++) {
+        for (int cell = 0; cell < MNK_MAX_SIDE * MNK_MAX_SIDE; cell++) {
+            zobrist[role][cell] = next_key(&state);
+        }
+    }
+}
+
+// builds the permutation and zobrist tables, safe to call from any thread any number of times
+void canon_init(void) {
+    pthread_once(&tables_once, build_tables);
+}
+
+// gets the symmetry that undoes sym
+int canon_inverse(int sym) {
+    return inverses[sym];
+}
+
+// moves a row-major cell index of a rows x cols board by a symmetry
+int canon_transform(int sym, int rows, int cols, int cell) {
+    int row = cell / cols;
+    int col = cell % cols;
+    transform_cell(sym, rows, cols, &row, &col);
+    return row * cols + col;
+}
+
+// moves every cell of a 3x3 mask by a symmetry
+uint16_t canon_classic_mask(int sym, uint16_t mask) {
+    canon_init();
+    return perm9[sym][mask & BOARD_FULL];
+}
+
+// gets the smallest packed key (x | o << 9) of a 3x3 board over all 8 symmetries and the symmetry that gives it
+uint32_t canon_classic_key(uint16_t x, uint16_t o, int* sym) {
+    canon_init();
+    uint32_t best = UINT32_MAX;
+    int best_sym = 0;
+    for (int s = 0; s < CANON_SYMMETRIES; s++) {
+        uint32_t key = perm9[s][x & BOARD_FULL] | ((uint32_t) perm9[s][o & BOARD_FULL] << BOARD_CELLS);
+        if (key < best) {
+            best = key;
+            best_sym = s;
+        }
+    }
+    if (sym != NULL) {
+        *sym = best_sym;
+    }
+    return best;
+}
+
+// moves every cell of a 4x4 mask (cell (row, col) is bit (row - 1) * 4 + (col - 1)) by a symmetry
+uint16_t canon_square4_mask(int sym, uint16_t mask) {
+    canon_init();
+    return perm16_lo[sym][mask & 0xFF] | perm16_hi[sym][mask >> 8];
+}
+
+// gets the smallest packed key (x | o << 16) of a 4x4 board over all 8 symmetries and the symmetry that gives it
+uint32_t canon_square4_key(uint16_t x, uint16_t o, int* sym) {
+    canon_init();
+    uint32_t best = UINT32_MAX;
+    int best_sym = 0;
+    for (int s = 0; s < CANON_SYMMETRIES; s++) {
+        uint32_t key = (perm16_lo[s][x & 0xFF] | perm16_hi[s][x >> 8]) | ((uint32_t) (perm16_lo[s][o & 0xFF] | perm16_hi[s][o >> 8]) << 16);
+        if (key < best) {
+            best = key;
+            best_sym = s;
+        }
+    }
+    if (sym != NULL) {
+        *sym = best_sym;
+    }
+    return best;
+}
+
+// starts the hashes of an empty board, the size and k are mixed in so different variants never share keys
+void canon_hash_init(canon_hash_t* hash, int rows, int cols, int k) {
+    canon_init();
+    uint64_t state = ((uint64_t) rows << 32) | ((uint64_t) cols << 16) | (uint64_t) k;
+    uint64_t salt = next_key(&state);
+    hash->rows = rows;
+    hash->cols = cols;
+    for (int s = 0; s < CANON_SYMMETRIES; s++) {
+        hash->h[s] = salt;
+    }
+}
+
+// adds a stone (1-based row and col like in a MOVE message) to every symmetric hash
+void canon_hash_place(canon_hash_t* hash, int row, int col, char role) {
+    int r0 = row - 1;
+    int c0 = col - 1;
+    const uint64_t* keys = zobrist[role == 'X' ? 0 : 1];
+    for (int s = 0; s < CANON_SYMMETRIES; s++) {
+        // rotations and transposes swap rows and cols, they only apply to square boards
+        if (hash->rows != hash->cols && (s == 1 || s == 3 || s == 6 || s == 7)) {
+            continue;
+        }
+        int r = r0;
+        int c = c0;
+        transform_cell(s, hash->rows, hash->cols, &r, &c);
+        hash->h[s] ^= keys[r * MNK_MAX_SIDE + c];
+    }
+}
+
+// gets the canonical hash of the board (the smallest over its symmetries) and the symmetry that gives it
+uint64_t canon_hash_key(const canon_hash_t* hash, int* sym) {
+    uint64_t best = hash->h[0];
+    int best_sym = 0;
+    for (int s = 1; s < CANON_SYMMETRIES; s++) {
+        if (hash->rows != hash->cols && (s == 1 || s == 3 || s == 6 || s == 7)) {
+            continue;
+        }
+        if (hash->h[s] < best) {
+            best = hash->h[s];
+            best_sym = s;
+        }
+    }
+    if (sym != NULL) {
+        *sym = best_sym;
+    }
+    return best;
+}
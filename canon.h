@@ -0,0 +1,32 @@
+#ifndef CANON_H
+#define CANON_H
+
+#include <stdint.h>
+#include "board.h"
+#include "mnk.h"
+
+// the 8 symmetries of a square board: 0 identity, 1-3 rotations by 90, 180 and 270 degrees clockwise,
+// 4 mirror left-right, 5 mirror top-bottom, 6 transpose, 7 anti-transpose (non-square boards only have 0, 2, 4 and 5)
+#define CANON_SYMMETRIES 8
+
+// zobrist hashes of an m,n,k board under every symmetry, updated with one xor each per move
+typedef struct canon_hash {
+    int rows;
+    int cols;
+    uint64_t h[CANON_SYMMETRIES];
+} canon_hash_t;
+
+void canon_init(void);
+int canon_inverse(int sym);
+int canon_transform(int sym, int rows, int cols, int cell);
+
+uint32_t canon_classic_key(uint16_t x, uint16_t o, int* sym);
+uint16_t canon_classic_mask(int sym, uint16_t mask);
+uint32_t canon_square4_key(uint16_t x, uint16_t o, int* sym);
+uint16_t canon_square4_mask(int sym, uint16_t mask);
+
+void canon_hash_init(canon_hash_t* hash, int rows, int cols, int k);
+void canon_hash_place(canon_hash_t* hash, int row, int col, char role);
+uint64_t canon_hash_key(const canon_hash_t* hash, int* sym);
+
+#endif
@@ -0,0 +1,393 @@
+#define _POSIX_C_SOURCE 200809L
+#include "columnar.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// hash table slots of a dictionary, twice the most strings a row group can have
+#define DICT_SLOTS (4 * COLUMNAR_ROW_GROUP)
+
+static uint32_t hash_string(const char* text) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) text; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static int dict_init(columnar_dict_t* dict) {
+    memset(dict, 0, sizeof(*dict));
+    dict->capacity = 1 << 20;
+    dict->arena = malloc(dict->capacity);
+    dict->offsets = malloc(2 * COLUMNAR_ROW_GROUP * sizeof(uint32_t));
+    dict->slots = calloc(DICT_SLOTS, sizeof(uint32_t));
+    dict->mask = DICT_SLOTS - 1;
+    return dict->arena != NULL && dict->offsets != NULL && dict->slots != NULL;
+}
+
+static void dict_free(columnar_dict_t* dict) {
+    free(dict->arena);
+    free(dict->offsets);
+    free(dict->slots);
+}
+
+static void dict_clear(columnar_dict_t* dict) {
+    dict->used = 0;
+    dict->count = 0;
+    memset(dict->slots, 0, DICT_SLOTS * sizeof(uint32_t));
+}
+
+// gets a string's index, adding it if the group hasn't had it yet (returns -1 if out of memory)
+static long dict_index(columnar_dict_t* dict, const char* text) {
+    for (uint32_t i = hash_string(text) & dict->mask;; i = (i + 1) & dict->mask) {
+        uint32_t slot = dict->slots[i];
+        if (slot == 0) {
+            size_t length = strlen(text) + 1;
+            if (dict->used + length > dict->capacity) {
+                char* grown = realloc(dict->arena, dict->capacity * 2);
+                if (grown == NULL) {
+                    return -1;
+                }
+                dict->arena = grown;
+                dict->capacity *= 2;
+            }
+            memcpy(dict->arena + dict->used, text, length);
+            dict->offsets[dict->count] = dict->used;
+            dict->used += length;
+            dict->slots[i] = ++dict->count;
+            return dict->count - 1;
+        }
+        if (strcmp(dict->arena + dict->offsets[slot - 1], text) == 0) {
+            return slot - 1;
+        }
+    }
+}
+
+// writes bytes at the end of the file (returns 1 on success, 0 if error)
+static int put(columnar_writer_t* writer, const void* data, size_t bytes) {
+    if (bytes > 0 && fwrite(data, 1, bytes, writer->file) != bytes) {
+        perror("columnar write");
+        return 0;
+    }
+    writer->offset += bytes;
+    return 1;
+}
+
+static int bits_needed(uint64_t value) {
+    int bits = 0;
+    while (value != 0) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// writes values as a packed chunk: the smallest value as a base and every value's difference from it in as few bits as the largest needs
+static int put_packed(columnar_writer_t* writer, const uint64_t* values, uint32_t count, columnar_chunk_t* chunk) {
+    uint64_t base = count ? values[0] : 0;
+    uint64_t top = base;
+    for (uint32_t i = 1; i < count; i++) {
+        base = values[i] < base ? values[i] : base;
+        top = values[i] > top ? values[i] : top;
+    }
+    uint32_t width = bits_needed(top - base);
+    size_t words = ((uint64_t) count * width + 63) / 64;
+    uint64_t* packed = calloc(words ? words : 1, sizeof(uint64_t));
+    if (packed == NULL) {
+        perror("calloc");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && width > 0; i++) {
+        uint64_t value = values[i] - base;
+        uint64_t bit = (uint64_t) i * width;
+        uint32_t shift = bit & 63;
+        packed[bit >> 6] |= value << shift;
+        if (shift + width > 64) {
+            packed[(bit >> 6) + 1] |= value >> (64 - shift);
+        }
+    }
+    chunk->encoding = COLUMNAR_PACKED;
+    chunk->offset = writer->offset;
+    int ok = put(writer, &base, sizeof(base)) && put(writer, &width, sizeof(width)) && put(writer, &count, sizeof(count)) && put(writer, packed, words * sizeof(uint64_t));
+    chunk->bytes = writer->offset - chunk->offset;
+    free(packed);
+    return ok;
+}
+
+static int put_strings(columnar_writer_t* writer, const columnar_dict_t* dict, columnar_chunk_t* chunk) {
+    chunk->encoding = COLUMNAR_STRINGS;
+    chunk->offset = writer->offset;
+    int ok = put(writer, &dict->count, sizeof(dict->count));
+    for (uint32_t i = 0; i < dict->count && ok; i++) {
+        const char* text = dict->arena + dict->offsets[i];
+        uint16_t length = strlen(text);
+        ok = put(writer, &length, sizeof(length)) && put(writer, text, length);
+    }
+    chunk->bytes = writer->offset - chunk->offset;
+    return ok;
+}
+
+// encodes and writes the buffered rows as one row group (returns 1 on success, 0 if error)
+static int flush_group(columnar_writer_t* writer) {
+    if (writer->rows == 0) {
+        return 1;
+    }
+    columnar_group_t group;
+    memset(&group, 0, sizeof(group));
+    group.magic = COLUMNAR_GROUP_MAGIC;
+    group.rows = writer->rows;
+    int ok = 1;
+    for (int column = 0; column < COLUMN_COUNT && ok; column++) {
+        if (column == COLUMN_PLAYERS) {
+            ok = put_strings(writer, &writer->players, &group.chunks[column]);
+        }
+        else if (column == COLUMN_VARIANTS) {
+            ok = put_strings(writer, &writer->variants, &group.chunks[column]);
+        }
+        else {
+            ok = put_packed(writer, writer->values[column], writer->rows, &group.chunks[column]);
+        }
+    }
+    if (ok && writer->groups == writer->group_capacity) {
+        uint32_t capacity = writer->group_capacity ? writer->group_capacity * 2 : 64;
+        uint64_t* grown = realloc(writer->group_offsets, capacity * sizeof(uint64_t));
+        ok = grown != NULL;
+        if (ok) {
+            writer->group_offsets = grown;
+            writer->group_capacity = capacity;
+        }
+    }
+    if (ok) {
+        writer->group_offsets[writer->groups++] = writer->offset;
+        ok = put(writer, &group, sizeof(group));
+    }
+    writer->total_rows += writer->rows;
+    writer->rows = 0;
+    dict_clear(&writer->players);
+    dict_clear(&writer->variants);
+    return ok;
+}
+
+// creates a file to write rows to (returns 1 on success, 0 if error)
+int columnar_writer_open(columnar_writer_t* writer, const char* path) {
+    memset(writer, 0, sizeof(*writer));
+    int ok = dict_init(&writer->players) && dict_init(&writer->variants);
+    for (int column = 0; column < COLUMN_COUNT && ok; column++) {
+        if (column != COLUMN_PLAYERS && column != COLUMN_VARIANTS) {
+            writer->values[column] = malloc(COLUMNAR_ROW_GROUP * sizeof(uint64_t));
+            ok = writer->values[column] != NULL;
+        }
+    }
+    if (!ok) {
+        perror("columnar writer");
+        columnar_writer_close(writer);
+        return 0;
+    }
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        perror("columnar open");
+        columnar_writer_close(writer);
+        return 0;
+    }
+    columnar_header_t header = {COLUMNAR_MAGIC, COLUMNAR_VERSION, 0};
+    return put(writer, &header, sizeof(header));
+}
+
+// buffers a row, writing the row group once it is full (returns 1 on success, 0 if error)
+int columnar_writer_add(columnar_writer_t* writer, const columnar_row_t* row) {
+    long x = dict_index(&writer->players, row->x_name);
+    long o = dict_index(&writer->players, row->o_name);
+    long variant = dict_index(&writer->variants, row->variant);
+    if (x < 0 || o < 0 || variant < 0) {
+        perror("columnar dictionary");
+        return 0;
+    }
+    uint32_t at = writer->rows++;
+    writer->values[COLUMN_GAME_ID][at] = row->game_id;
+    writer->values[COLUMN_STARTED][at] = row->started_ns;
+    writer->values[COLUMN_DURATION][at] = row->duration_ms;
+    writer->values[COLUMN_X][at] = x;
+    writer->values[COLUMN_O][at] = o;
+    writer->values[COLUMN_VARIANT][at] = variant;
+    writer->values[COLUMN_RESULT][at] = row->result;
+    writer->values[COLUMN_LENGTH][at] = row->length;
+    writer->values[COLUMN_FIRST_MOVE][at] = row->first_move;
+    if (writer->rows == COLUMNAR_ROW_GROUP) {
+        return flush_group(writer);
+    }
+    return 1;
+}
+
+// writes the last row group and the footer and closes the file (returns 1 on success, 0 if error)
+int columnar_writer_close(columnar_writer_t* writer) {
+    int ok = 1;
+    if (writer->file != NULL) {
+        ok = flush_group(writer);
+        columnar_trailer_t trailer = {writer->offset, writer->groups, COLUMNAR_MAGIC};
+        ok = ok && put(writer, writer->group_offsets, writer->groups * sizeof(uint64_t)) && put(writer, &trailer, sizeof(trailer));
+        if (fclose(writer->file) != 0) {
+            perror("columnar close");
+            ok = 0;
+        }
+        writer->file = NULL;
+    }
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        free(writer->values[column]);
+        writer->values[column] = NULL;
+    }
+    dict_free(&writer->players);
+    dict_free(&writer->variants);
+    free(writer->group_offsets);
+    writer->group_offsets = NULL;
+    return ok;
+}
+
+// opens a file and reads its footer and row group directories, no chunk is read yet (returns 1 on success, 0 if error)
+int columnar_open(columnar_file_t* file, const char* path) {
+    memset(file, 0, sizeof(*file));
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) {
+        perror("columnar open");
+        return 0;
+    }
+    struct stat st;
+    columnar_header_t header;
+    columnar_trailer_t trailer;
+    if (fstat(file->fd, &st) < 0 || (size_t) st.st_size < sizeof(header) + sizeof(trailer)
+        || pread(file->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.magic != COLUMNAR_MAGIC || header.version != COLUMNAR_VERSION
+        || pread(file->fd, &trailer, sizeof(trailer), st.st_size - sizeof(trailer)) != (ssize_t) sizeof(trailer) || trailer.magic != COLUMNAR_MAGIC
+        || trailer.footer_offset + trailer.groups * sizeof(uint64_t) + sizeof(trailer) != (uint64_t) st.st_size) {
+        fprintf(stderr, "%s is not a version %d columnar file\n", path, COLUMNAR_VERSION);
+        columnar_close(file);
+        return 0;
+    }
+    file->size = st.st_size;
+    file->groups = trailer.groups;
+    uint64_t* offsets = malloc((trailer.groups + 1) * sizeof(uint64_t));
+    file->group_info = malloc((trailer.groups + 1) * sizeof(columnar_group_t));
+    int ok = offsets != NULL && file->group_info != NULL
+        && pread(file->fd, offsets, trailer.groups * sizeof(uint64_t), trailer.footer_offset) == (ssize_t) (trailer.groups * sizeof(uint64_t));
+    for (uint32_t group = 0; group < trailer.groups && ok; group++) {
+        ok = pread(file->fd, &file->group_info[group], sizeof(columnar_group_t), offsets[group]) == (ssize_t) sizeof(columnar_group_t)
+            && file->group_info[group].magic == COLUMNAR_GROUP_MAGIC;
+    }
+    free(offsets);
+    if (!ok) {
+        fprintf(stderr, "%s has a broken footer\n", path);
+        columnar_close(file);
+        return 0;
+    }
+    return 1;
+}
+
+void columnar_close(columnar_file_t* file) {
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    free(file->group_info);
+    file->group_info = NULL;
+}
+
+// reads one chunk (returns it, the caller frees it, NULL if error)
+static char* read_chunk(columnar_file_t* file, uint32_t group, columnar_column_t column, columnar_encoding_t encoding) {
+    const columnar_chunk_t* chunk = (group < file->groups) ? &file->group_info[group].chunks[column] : NULL;
+    if (chunk == NULL || chunk->encoding != encoding || chunk->offset + chunk->bytes > file->size) {
+        fprintf(stderr, "columnar: column %d of group %u isn't there\n", column, group);
+        return NULL;
+    }
+    char* data = malloc(chunk->bytes + 1);
+    if (data == NULL || pread(file->fd, data, chunk->bytes, chunk->offset) != (ssize_t) chunk->bytes) {
+        perror("columnar read");
+        free(data);
+        return NULL;
+    }
+    file->bytes_read += chunk->bytes;
+    return data;
+}
+
+// decodes a packed column of a row group into values, which has room for the group's rows (returns 1 on success, 0 if error)
+int columnar_read_values(columnar_file_t* file, uint32_t group, columnar_column_t column, uint64_t* values) {
+    char* data = read_chunk(file, group, column, COLUMNAR_PACKED);
+    if (data == NULL) {
+        return 0;
+    }
+    uint64_t base;
+    uint32_t width;
+    uint32_t count;
+    memcpy(&base, data, sizeof(base));
+    memcpy(&width, data + 8, sizeof(width));
+    memcpy(&count, data + 12, sizeof(count));
+    const uint64_t* packed = (const uint64_t*) (data + 16);
+    uint64_t mask = (width >= 64) ? ~0ull : (1ull << width) - 1;
+    if (width > 64 || count != file->group_info[group].rows || 16 + ((uint64_t) count * width + 63) / 64 * 8 > file->group_info[group].chunks[column].bytes) {
+        fprintf(stderr, "columnar: column %d of group %u is broken\n", column, group);
+        free(data);
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t value = 0;
+        if (width > 0) {
+            uint64_t bit = (uint64_t) i * width;
+            uint32_t shift = bit & 63;
+            value = packed[bit >> 6] >> shift;
+            if (shift + width > 64) {
+                value |= packed[(bit >> 6) + 1] << (64 - shift);
+            }
+        }
+        values[i] = base + (value & mask);
+    }
+    free(data);
+    return 1;
+}
+
+// decodes a dictionary column of a row group (returns an array of count strings freed with one free(), NULL if error)
+char** columnar_read_strings(columnar_file_t* file, uint32_t group, columnar_column_t column, uint32_t* count) {
+    char* data = read_chunk(file, group, column, COLUMNAR_STRINGS);
+    if (data == NULL) {
+        return NULL;
+    }
+    uint64_t bytes = file->group_info[group].chunks[column].bytes;
+    memcpy(count, data, sizeof(*count));
+    // the pointers and the strings go in one allocation
+    char** strings = malloc(*count * sizeof(char*) + bytes + *count);
+    if (strings == NULL) {
+        perror("malloc");
+        free(data);
+        return NULL;
+    }
+    char* text = (char*) (strings + *count);
+    uint64_t at = sizeof(uint32_t);
+    for (uint32_t i = 0; i < *count; i++) {
+        uint16_t length = 0;
+        if (at + sizeof(length) > bytes || (memcpy(&length, data + at, sizeof(length)), at + sizeof(length) + length > bytes)) {
+            fprintf(stderr, "columnar: column %d of group %u is broken\n", column, group);
+            free(strings);
+            free(data);
+            return NULL;
+        }
+        at += sizeof(length);
+        memcpy(text, data + at, length);
+        text[length] = '\0';
+        strings[i] = text;
+        text += length + 1;
+        at += length;
+    }
+    free(data);
+    return strings;
+}
+
+// writes a first move the way a MOVE names it, "-" if there was none
+void columnar_format_move(uint32_t first_move, int gravity, char* position) {
+    if (first_move == 0) {
+        strcpy(position, "-");
+    }
+    else if (gravity) {
+        sprintf(position, "%u", first_move);
+    }
+    else {
+        sprintf(position, "%u,%u", first_move >> 8, first_move & 0xFF);
+    }
+}
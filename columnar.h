@@ -0,0 +1,122 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define COLUMNAR_MAGIC 0x43545454        // "TTTC"
+#define COLUMNAR_GROUP_MAGIC 0x50524754  // "TGRP"
+#define COLUMNAR_VERSION 1
+// rows buffered before a row group is encoded and written, the writer never holds more than one group
+#define COLUMNAR_ROW_GROUP 65536
+
+// the columns of a finished game, a scan reads only the chunks of the columns it asks for
+typedef enum columnar_column {
+    COLUMN_GAME_ID,      // journal game id
+    COLUMN_STARTED,      // CLOCK_REALTIME ns of the first BEGN
+    COLUMN_DURATION,     // ms from BEGN to OVER
+    COLUMN_PLAYERS,      // dictionary of the row group's player names
+    COLUMN_X,            // index of X's name in COLUMN_PLAYERS
+    COLUMN_O,            // index of O's name in COLUMN_PLAYERS
+    COLUMN_VARIANTS,     // dictionary of the row group's variants ("classic", "4,4,4", "gravity,6,7,4", ...)
+    COLUMN_VARIANT,      // index in COLUMN_VARIANTS
+    COLUMN_RESULT,       // 1 X won, 2 O won, 3 draw, the codes of replay.h
+    COLUMN_LENGTH,       // moves played
+    COLUMN_FIRST_MOVE,   // row << 8 | col (just col on gravity boards), 0 if no move was made
+    COLUMN_COUNT
+} columnar_column_t;
+
+// how a chunk is encoded
+typedef enum columnar_encoding {
+    // uint64 base, uint32 width, uint32 count, then count values - base packed width bits each into uint64 words
+    COLUMNAR_PACKED = 1,
+    // uint32 count, then count strings of a uint16 length and the bytes
+    COLUMNAR_STRINGS = 2
+} columnar_encoding_t;
+
+// where a column's chunk of a row group is in the file
+typedef struct columnar_chunk {
+    uint32_t encoding;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+} columnar_chunk_t;
+
+// written after the chunks of its row group
+typedef struct columnar_group {
+    uint32_t magic;
+    uint32_t rows;
+    columnar_chunk_t chunks[COLUMN_COUNT];
+} columnar_group_t;
+
+// a file is a 16 byte header, then the row groups, then the footer: the offset of every group's columnar_group_t
+// and a trailer of the footer's offset, the number of groups and the magic, so a reader finds the groups from the end
+typedef struct columnar_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+} columnar_header_t;
+
+typedef struct columnar_trailer {
+    uint64_t footer_offset;
+    uint32_t groups;
+    uint32_t magic;
+} columnar_trailer_t;
+
+// one finished game handed to the writer, the strings are copied
+typedef struct columnar_row {
+    uint64_t game_id;
+    uint64_t started_ns;
+    uint64_t duration_ms;
+    const char* x_name;
+    const char* o_name;
+    const char* variant;
+    int result;
+    int length;
+    uint32_t first_move;
+} columnar_row_t;
+
+// strings of a row group, each stored once
+typedef struct columnar_dict {
+    char* arena;
+    size_t used;
+    size_t capacity;
+    uint32_t* offsets;        // arena offset of each string
+    uint32_t count;
+    uint32_t* slots;          // open addressing table of index + 1, 0 when empty
+    uint32_t mask;
+} columnar_dict_t;
+
+// a file being written one row group at a time
+typedef struct columnar_writer {
+    FILE* file;
+    uint64_t offset;          // bytes written so far
+    uint32_t rows;            // rows buffered in the current group
+    uint64_t* values[COLUMN_COUNT];  // buffered values of the packed columns
+    columnar_dict_t players;
+    columnar_dict_t variants;
+    uint64_t* group_offsets;
+    uint32_t groups;
+    uint32_t group_capacity;
+    uint64_t total_rows;
+} columnar_writer_t;
+
+// a file open for reading columns
+typedef struct columnar_file {
+    int fd;
+    uint32_t groups;
+    columnar_group_t* group_info;
+    uint64_t size;
+    uint64_t bytes_read;      // bytes of chunks read, to show how little of the file a scan touches
+} columnar_file_t;
+
+int columnar_writer_open(columnar_writer_t* writer, const char* path);
+int columnar_writer_add(columnar_writer_t* writer, const columnar_row_t* row);
+int columnar_writer_close(columnar_writer_t* writer);
+int columnar_open(columnar_file_t* file, const char* path);
+void columnar_close(columnar_file_t* file);
+int columnar_read_values(columnar_file_t* file, uint32_t group, columnar_column_t column, uint64_t* values);
+char** columnar_read_strings(columnar_file_t* file, uint32_t group, columnar_column_t column, uint32_t* count);
+void columnar_format_move(uint32_t first_move, int gravity, char* position);
+
+#endif
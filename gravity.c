@@ -0,0 +1,82 @@
+#include "gravity.h"
+#include <string.h>
+
+// sets up an empty board (returns 1 on success, 0 if the size doesn't fit the masks)
+int gravity_init(gravity_board_t* board, int rows, int cols, int k) {
+    if (rows < 1 || cols < 1 || cols > GRAVITY_MAX_COLS || (rows + 1) * cols > GRAVITY_MAX_BITS || k < 1 || (k > rows && k > cols)) {
+        return 0;
+    }
+    board->rows = rows;
+    board->cols = cols;
+    board->k = k;
+    board->filled = 0;
+    board->x = 0;
+    board->o = 0;
+    memset(board->height, 0, sizeof(board->height));
+    memset(board->str, '.', rows * cols);
+    board->str[rows * cols] = '\0';
+    return 1;
+}
+
+// gets the 1-based row a piece dropped in col lands on (returns 0 if col is out of range or full)
+int gravity_drop_row(const gravity_board_t* board, int col) {
+    if (col < 1 || col > board->cols || board->height[col - 1] >= board->rows) {
+        return 0;
+    }
+    return board->rows - board->height[col - 1];
+}
+
+// checks if a move is valid (1 if yes, else 0), the row must be the one the piece falls to
+int gravity_is_valid_move(const gravity_board_t* board, int row, int col) {
+    return row != 0 && gravity_drop_row(board, col) == row;
+}
+
+// drops role into col, the caller must have checked the move with gravity_is_valid_move
+void gravity_place(gravity_board_t* board, int row, int col, char role) {
+    uint64_t bit = (uint64_t) 1 << ((col - 1) * (board->rows + 1) + board->height[col - 1]);
+    if (role == 'X') {
+        board->x |= bit;
+    }
+    else {
+        board->o |= bit;
+    }
+    board->height[col - 1]++;
+    board->filled++;
+    board->str[(row - 1) * board->cols + (col - 1)] = role;
+}
+
+// checks a mask for k in a row: shifting by the step of a direction and ANDing leaves a bit only where a line starts
+// the steps are 1 (up a column), rows + 1 (across a row) and rows + 2, rows (the diagonals)
+static int mask_has_line(uint64_t mask, int rows, int k) {
+    const int steps[4] = {1, rows + 1, rows + 2, rows};
+    for (int d = 0; d < 4; d++) {
+        uint64_t line = mask;
+        for (int i = 1; i < k && line != 0; i++) {
+            // a line longer than the mask can't fit (and shifting by 64 or more is undefined)
+            line = (i * steps[d] < GRAVITY_MAX_BITS) ? (line & (mask >> (i * steps[d]))) : 0;
+        }
+        if (line != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// checks if role has k in a row (1 if yes, else 0)
+int gravity_check_win(const gravity_board_t* board, char role) {
+    return mask_has_line(role == 'X' ? board->x : board->o, board->rows, board->k);
+}
+
+// checks if dropping role into col would win, without changing the board (1 if yes, else 0)
+int gravity_would_win(const gravity_board_t* board, int col, char role) {
+    if (gravity_drop_row(board, col) == 0) {
+        return 0;
+    }
+    uint64_t bit = (uint64_t) 1 << ((col - 1) * (board->rows + 1) + board->height[col - 1]);
+    return mask_has_line((role == 'X' ? board->x : board->o) | bit, board->rows, board->k);
+}
+
+// checks if every column is full (1 if yes, else 0)
+int gravity_check_tie(const gravity_board_t* board) {
+    return board->filled == board->rows * board->cols;
+}
@@ -0,0 +1,31 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include <stdint.h>
+
+// each column takes rows + 1 bits of a 64 bit mask (the extra bit keeps lines from wrapping into the next column)
+#define GRAVITY_MAX_BITS 64
+#define GRAVITY_MAX_COLS 16
+
+// a connect four style board, pieces are dropped into a column and land on the lowest free cell
+// cell (row, col) with row 1 at the top is bit (col - 1) * (rows + 1) + (rows - row) of the X or O mask
+typedef struct gravity_board {
+    int rows;
+    int cols;
+    int k;
+    int filled;                         // number of pieces dropped, so a tie check is one compare
+    uint64_t x;                         // cells taken by X
+    uint64_t o;                         // cells taken by O
+    uint8_t height[GRAVITY_MAX_COLS];   // pieces in each column
+    char str[GRAVITY_MAX_BITS + 1];     // board string sent in MOVD (rows of cols cells, top row first), updated one cell per move
+} gravity_board_t;
+
+int gravity_init(gravity_board_t* board, int rows, int cols, int k);
+int gravity_drop_row(const gravity_board_t* board, int col);
+int gravity_is_valid_move(const gravity_board_t* board, int row, int col);
+void gravity_place(gravity_board_t* board, int row, int col, char role);
+int gravity_check_win(const gravity_board_t* board, char role);
+int gravity_would_win(const gravity_board_t* board, int col, char role);
+int gravity_check_tie(const gravity_board_t* board);
+
+#endif
@@ -0,0 +1,617 @@
+// NOTE: must use option -pthread when compiling!
+#define _POSIX_C_SOURCE 200809L
+#include "history.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+history_t history = {"", -1};
+
+// a log or run file of the index, a log has lo == hi
+typedef struct history_file {
+    long lo;
+    long hi;
+    int is_run;
+    uint64_t count;       // entries in a run, from its size
+} history_file_t;
+
+// FNV-1a of a player's name
+uint64_t history_hash(const char* name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* p = (const unsigned char*) name; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// the order of a run: name hash, then newest first
+static int compare_entries(const void* a, const void* b) {
+    const history_entry_t* left = a;
+    const history_entry_t* right = b;
+    if (left->name_hash != right->name_hash) {
+        return left->name_hash < right->name_hash ? -1 : 1;
+    }
+    if (left->time_ns != right->time_ns) {
+        return left->time_ns > right->time_ns ? -1 : 1;
+    }
+    return (left->game_id < right->game_id) - (left->game_id > right->game_id);
+}
+
+// newest first whatever the name, for the answer of a query
+static int compare_newest(const void* a, const void* b) {
+    const history_entry_t* left = a;
+    const history_entry_t* right = b;
+    if (left->time_ns != right->time_ns) {
+        return left->time_ns > right->time_ns ? -1 : 1;
+    }
+    return (left->game_id < right->game_id) - (left->game_id > right->game_id);
+}
+
+static int compare_files(const void* a, const void* b) {
+    const history_file_t* left = a;
+    const history_file_t* right = b;
+    if (left->lo != right->lo) {
+        return left->lo < right->lo ? -1 : 1;
+    }
+    return (left->hi > right->hi) - (left->hi < right->hi);
+}
+
+// the version is in the file names, logs have no header and an older version's entries are another size
+// (version 1 kept 16 bits of the journal segment sequence), so files of another version are left alone instead of misread
+#define VERSION_STRING(version) #version
+#define FILE_PREFIX_OF(version) "history-v" VERSION_STRING(version) "-"
+#define FILE_PREFIX FILE_PREFIX_OF(HISTORY_VERSION)
+
+static void log_path(char* path, size_t size, const char* dir, long generation) {
+    snprintf(path, size, "%s/" FILE_PREFIX "%010ld.log", dir, generation);
+}
+
+static void run_path(char* path, size_t size, const char* dir, long lo, long hi) {
+    snprintf(path, size, "%s/" FILE_PREFIX "%010ld-%010ld.run", dir, lo, hi);
+}
+
+// makes a rename or unlink in dir durable
+static void sync_dir(const char* dir) {
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// lists the logs and runs in dir sorted by generation, leaving out runs another run covers
+// (a compaction that stopped between writing a merged run and removing its inputs leaves both)
+// with remove set, as only the compaction does, those runs and any half written run are removed
+// returns the number of files, -1 if the directory can't be read
+static int list_files(const char* dir, history_file_t* files, int max, int remove) {
+    DIR* dirp = opendir(dir);
+    if (dirp == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dirp)) != NULL && count < max) {
+        long lo = 0;
+        long hi = 0;
+        int end = 0;
+        if (sscanf(entry->d_name, FILE_PREFIX "%ld-%ld.run%n", &lo, &hi, &end) == 2 && entry->d_name[end] == '\0') {
+            char path[512];
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            if (stat(path, &st) < 0 || (size_t) st.st_size < sizeof(history_run_header_t)) {
+                continue;
+            }
+            files[count].count = (st.st_size - sizeof(history_run_header_t)) / sizeof(history_entry_t);
+            files[count].is_run = 1;
+        }
+        else if (sscanf(entry->d_name, FILE_PREFIX "%ld.log%n", &lo, &end) == 1 && entry->d_name[end] == '\0') {
+            hi = lo;
+            files[count].count = 0;
+            files[count].is_run = 0;
+        }
+        else {
+            size_t length = strlen(entry->d_name);
+            if (remove && strncmp(entry->d_name, "history-", 8) == 0 && length > 4 && strcmp(entry->d_name + length - 4, ".tmp") == 0) {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+                unlink(path);
+            }
+            continue;
+        }
+        files[count].lo = lo;
+        files[count].hi = hi;
+        count++;
+    }
+    closedir(dirp);
+    qsort(files, count, sizeof(history_file_t), compare_files);
+    // sorted by lo and then widest first, so a covered run comes after the run covering it
+    int kept = 0;
+    long covered_to = -1;
+    for (int i = 0; i < count; i++) {
+        if (files[i].is_run && files[i].hi <= covered_to) {
+            if (remove) {
+                char path[512];
+                run_path(path, sizeof(path), dir, files[i].lo, files[i].hi);
+                unlink(path);
+            }
+            continue;
+        }
+        if (files[i].is_run && files[i].hi > covered_to) {
+            covered_to = files[i].hi;
+        }
+        files[kept++] = files[i];
+    }
+    return kept;
+}
+
+// maps a run read only (returns its entries, NULL if it is missing or not a run)
+static const history_entry_t* map_run(const char* path, void** map, size_t* map_size, uint64_t* count) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(history_run_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("history mmap");
+        return NULL;
+    }
+    const history_run_header_t* header = data;
+    if (header->magic != HISTORY_MAGIC || header->version != HISTORY_VERSION
+        || header->count > (st.st_size - sizeof(history_run_header_t)) / sizeof(history_entry_t)) {
+        fprintf(stderr, "%s is not a version %d history run\n", path, HISTORY_VERSION);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    *map = data;
+    *map_size = st.st_size;
+    *count = header->count;
+    return (const history_entry_t*) (header + 1);
+}
+
+// reads a whole log (returns its entries, the caller frees them, NULL if it is missing or empty)
+// a crash can leave the last entry cut short, it is dropped
+static history_entry_t* read_log(const char* path, uint64_t* count) {
+    *count = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    history_entry_t* entries = NULL;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(history_entry_t)) {
+        size_t size = st.st_size - st.st_size % sizeof(history_entry_t);
+        entries = malloc(size);
+        if (entries != NULL) {
+            ssize_t got = pread(fd, entries, size, 0);
+            *count = got > 0 ? (size_t) got / sizeof(history_entry_t) : 0;
+        }
+    }
+    close(fd);
+    return entries;
+}
+
+// writes a run with the entries from next() beside its final name and renames it into place (returns 1 on success, 0 if error)
+// next fills one entry and returns 0 once there are none left
+static int write_run(const char* dir, long lo, long hi, int (*next)(void* arg, history_entry_t* entry), void* arg) {
+    char path[512];
+    char tmp_path[520];
+    run_path(path, sizeof(path), dir, lo, hi);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        perror("history run open");
+        return 0;
+    }
+    history_run_header_t header = {HISTORY_MAGIC, HISTORY_VERSION, 0};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    history_entry_t entry;
+    while (ok && next(arg, &entry)) {
+        ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+        header.count++;
+    }
+    // the count goes in last, the file only gets its name once it is complete
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !ok || rename(tmp_path, path) < 0) {
+        perror("history run write");
+        unlink(tmp_path);
+        return 0;
+    }
+    sync_dir(dir);
+    return 1;
+}
+
+// the entries of a sorted array, for write_run
+typedef struct array_source {
+    const history_entry_t* entries;
+    uint64_t count;
+    uint64_t at;
+} array_source_t;
+
+static int next_from_array(void* arg, history_entry_t* entry) {
+    array_source_t* source = arg;
+    if (source->at == source->count) {
+        return 0;
+    }
+    *entry = source->entries[source->at++];
+    return 1;
+}
+
+// two sorted runs merged into one, for write_run
+typedef struct merge_source {
+    const history_entry_t* older;
+    uint64_t older_count;
+    uint64_t older_at;
+    const history_entry_t* newer;
+    uint64_t newer_count;
+    uint64_t newer_at;
+    history_entry_t last;
+    int any;
+} merge_source_t;
+
+static int next_from_merge(void* arg, history_entry_t* entry) {
+    merge_source_t* source = arg;
+    for (;;) {
+        int has_older = source->older_at < source->older_count;
+        int has_newer = source->newer_at < source->newer_count;
+        if (!has_older && !has_newer) {
+            return 0;
+        }
+        if (has_older && (!has_newer || compare_entries(&source->older[source->older_at], &source->newer[source->newer_at]) <= 0)) {
+            *entry = source->older[source->older_at++];
+        }
+        else {
+            *entry = source->newer[source->newer_at++];
+        }
+        // the same entry twice means it was compacted twice, keep one
+        if (!source->any || compare_entries(entry, &source->last) != 0) {
+            source->last = *entry;
+            source->any = 1;
+            return 1;
+        }
+    }
+}
+
+// sorts a log into a run of its own and removes it (returns 1 on success, 0 if error)
+static int compact_log(const char* dir, long generation) {
+    char path[512];
+    log_path(path, sizeof(path), dir, generation);
+    uint64_t count = 0;
+    history_entry_t* entries = read_log(path, &count);
+    int ok = 1;
+    if (count > 0) {
+        qsort(entries, count, sizeof(history_entry_t), compare_entries);
+        array_source_t source = {entries, count, 0};
+        ok = write_run(dir, generation, generation, next_from_array, &source);
+    }
+    free(entries);
+    if (ok) {
+        unlink(path);
+        sync_dir(dir);
+    }
+    return ok;
+}
+
+// merges two runs next to each other into one and removes them (returns 1 on success, 0 if error)
+static int merge_runs(const char* dir, const history_file_t* older, const history_file_t* newer) {
+    char older_path[512];
+    char newer_path[512];
+    run_path(older_path, sizeof(older_path), dir, older->lo, older->hi);
+    run_path(newer_path, sizeof(newer_path), dir, newer->lo, newer->hi);
+    merge_source_t source;
+    memset(&source, 0, sizeof(source));
+    void* older_map = NULL;
+    void* newer_map = NULL;
+    size_t older_size = 0;
+    size_t newer_size = 0;
+    source.older = map_run(older_path, &older_map, &older_size, &source.older_count);
+    source.newer = map_run(newer_path, &newer_map, &newer_size, &source.newer_count);
+    int ok = source.older != NULL && source.newer != NULL;
+    if (ok) {
+        posix_madvise(older_map, older_size, POSIX_MADV_SEQUENTIAL);
+        posix_madvise(newer_map, newer_size, POSIX_MADV_SEQUENTIAL);
+        ok = write_run(dir, older->lo, newer->hi, next_from_merge, &source);
+    }
+    if (older_map != NULL) {
+        munmap(older_map, older_size);
+    }
+    if (newer_map != NULL) {
+        munmap(newer_map, newer_size);
+    }
+    // the inputs only go once the merged run is in place, a crash in between leaves runs the merged one covers
+    if (ok) {
+        unlink(older_path);
+        unlink(newer_path);
+        sync_dir(dir);
+    }
+    return ok;
+}
+
+// sorts every log of a generation below `below` into a run, then merges the newest runs while the newer one is at least half the size
+// of the one before it, so runs double in size going back and there are about log2 of the entries of them
+// returns the number of runs left, -1 if error
+int history_compact(const char* dir, long below) {
+    history_file_t files[HISTORY_MAX_FILES];
+    int count = list_files(dir, files, HISTORY_MAX_FILES, 1);
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!files[i].is_run && files[i].lo < below && !compact_log(dir, files[i].lo)) {
+            return -1;
+        }
+    }
+    for (;;) {
+        count = list_files(dir, files, HISTORY_MAX_FILES, 1);
+        if (count < 0) {
+            return -1;
+        }
+        // the runs are the files before the first log left
+        int runs = 0;
+        while (runs < count && files[runs].is_run) {
+            runs++;
+        }
+        if (runs < 2 || files[runs - 1].count * 2 < files[runs - 2].count) {
+            return runs;
+        }
+        if (!merge_runs(dir, &files[runs - 2], &files[runs - 1])) {
+            return -1;
+        }
+    }
+}
+
+// starts a new log, the caller holds index->lock (returns 1 on success, 0 if error)
+// done by the game thread whose entry filled the log, so no log outgrows HISTORY_COMPACT_ENTRIES however far behind the compaction is
+static int next_log(history_t* index) {
+    char path[512];
+    log_path(path, sizeof(path), index->dir, index->generation + 1);
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("history log open");
+        return 0;
+    }
+    close(index->log_fd);
+    index->log_fd = fd;
+    index->generation++;
+    index->logged = 0;
+    return 1;
+}
+
+// compacts the logs that are full, and a log that has waited long enough
+static void* compact_thread(void* arg) {
+    history_t* index = arg;
+    lockprof_lock(&index->lock);
+    long compacted = index->generation;
+    lockprof_unlock(&index->lock);
+    // what an earlier server left
+    history_compact(index->dir, compacted);
+    lockprof_lock(&index->lock);
+    while (index->running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += HISTORY_COMPACT_SECONDS;
+        while (index->running && index->generation == compacted) {
+            if (lockprof_cond_timedwait(&index->wake, &index->lock, &deadline) == ETIMEDOUT) {
+                if (index->logged > 0) {
+                    next_log(index);
+                }
+                break;
+            }
+        }
+        if (!index->running || index->generation == compacted) {
+            continue;
+        }
+        compacted = index->generation;
+        // game threads append to the new log while the old ones are compacted
+        lockprof_unlock(&index->lock);
+        if (history_compact(index->dir, compacted) < 0) {
+            fprintf(stderr, "[HISTORY] compaction failed, the logs are kept and compacted next time\n");
+        }
+        lockprof_lock(&index->lock);
+    }
+    lockprof_unlock(&index->lock);
+    return NULL;
+}
+
+// opens the index in dir with a new log and starts the compaction thread, which first compacts what an earlier run left
+// (returns 1 on success, 0 if error)
+int history_open(history_t* index, const char* dir) {
+    index->log_fd = -1;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("history mkdir");
+        return 0;
+    }
+    snprintf(index->dir, sizeof(index->dir), "%s", dir);
+    history_file_t files[HISTORY_MAX_FILES];
+    int count = list_files(dir, files, HISTORY_MAX_FILES, 0);
+    long generation = 0;
+    for (int i = 0; i < count; i++) {
+        generation = files[i].hi > generation ? files[i].hi : generation;
+    }
+    index->generation = generation + 1;
+    index->logged = 0;
+    char path[512];
+    log_path(path, sizeof(path), dir, index->generation);
+    index->log_fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (index->log_fd < 0) {
+        perror("history log open");
+        return 0;
+    }
+    lockprof_init(&index->lock, "history lock");
+    pthread_cond_init(&index->wake, NULL);
+    index->running = 1;
+    int error = pthread_create(&index->compact_tid, NULL, compact_thread, index);
+    if (error != 0) {
+        fprintf(stderr, "history compaction thread: %s\n", strerror(error));
+        index->running = 0;
+    }
+    return 1;
+}
+
+// stops the compaction thread, the log being appended to is compacted when the index is next opened
+void history_close(history_t* index) {
+    if (index->log_fd < 0) {
+        return;
+    }
+    lockprof_lock(&index->lock);
+    int was_running = index->running;
+    index->running = 0;
+    pthread_cond_signal(&index->wake);
+    lockprof_unlock(&index->lock);
+    if (was_running) {
+        pthread_join(index->compact_tid, NULL);
+    }
+    // game threads may still be ending games, they find the index off
+    lockprof_lock(&index->lock);
+    close(index->log_fd);
+    index->log_fd = -1;
+    lockprof_unlock(&index->lock);
+}
+
+// adds a finished game to both players' histories (returns 1 on success, 0 if the index is off, -1 if error)
+// both entries go in one O_APPEND write
+int history_add_game(history_t* index, uint64_t game_id, const char* x_name, const char* o_name, const journal_position_t* begun_at, const journal_position_t* over_at) {
+    if (__atomic_load_n(&index->log_fd, __ATOMIC_RELAXED) < 0) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    history_entry_t entries[2];
+    memset(entries, 0, sizeof(entries));
+    for (int i = 0; i < 2; i++) {
+        entries[i].name_hash = history_hash(i == 0 ? x_name : o_name);
+        entries[i].game_id = game_id;
+        entries[i].time_ns = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+        entries[i].begun_at = *begun_at;
+        entries[i].over_at = *over_at;
+    }
+    lockprof_lock(&index->lock);
+    if (index->log_fd < 0) {
+        lockprof_unlock(&index->lock);
+        return 0;
+    }
+    ssize_t written = write(index->log_fd, entries, sizeof(entries));
+    if (written == (ssize_t) sizeof(entries)) {
+        index->logged += 2;
+        if (index->logged >= HISTORY_COMPACT_ENTRIES && next_log(index)) {
+            pthread_cond_signal(&index->wake);
+        }
+    }
+    lockprof_unlock(&index->lock);
+    if (written != (ssize_t) sizeof(entries)) {
+        perror("history write");
+        return -1;
+    }
+    return 1;
+}
+
+// adds an entry to a growing array (returns 1 on success, 0 if out of memory)
+static int keep_entry(history_entry_t** found, int* count, int* capacity, const history_entry_t* entry) {
+    if (*count == *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 256;
+        history_entry_t* grown = realloc(*found, grown_capacity * sizeof(history_entry_t));
+        if (grown == NULL) {
+            perror("realloc");
+            return 0;
+        }
+        *found = grown;
+        *capacity = grown_capacity;
+    }
+    (*found)[(*count)++] = *entry;
+    return 1;
+}
+
+// collects the entries of hash from every file, newest limit of each run (returns 1 on success, 0 if a file went away under it)
+static int collect(const char* dir, uint64_t hash, int limit, history_entry_t** found, int* count, int* capacity) {
+    history_file_t files[HISTORY_MAX_FILES];
+    int files_count = list_files(dir, files, HISTORY_MAX_FILES, 0);
+    char path[512];
+    for (int i = 0; i < files_count; i++) {
+        if (files[i].is_run) {
+            run_path(path, sizeof(path), dir, files[i].lo, files[i].hi);
+            void* map = NULL;
+            size_t map_size = 0;
+            uint64_t entries_count = 0;
+            const history_entry_t* entries = map_run(path, &map, &map_size, &entries_count);
+            if (entries == NULL) {
+                return 0;
+            }
+            // binary search for the first entry of the hash, its newest game
+            uint64_t lo = 0;
+            uint64_t hi = entries_count;
+            while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+                if (entries[mid].name_hash < hash) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            for (uint64_t at = lo; at < entries_count && entries[at].name_hash == hash && at - lo < (uint64_t) limit; at++) {
+                keep_entry(found, count, capacity, &entries[at]);
+            }
+            munmap(map, map_size);
+        }
+        else {
+            log_path(path, sizeof(path), dir, files[i].lo);
+            uint64_t entries_count = 0;
+            errno = 0;
+            history_entry_t* entries = read_log(path, &entries_count);
+            // compacted since it was listed
+            if (entries == NULL && errno == ENOENT) {
+                return 0;
+            }
+            for (uint64_t at = 0; at < entries_count; at++) {
+                if (entries[at].name_hash == hash) {
+                    keep_entry(found, count, capacity, &entries[at]);
+                }
+            }
+            free(entries);
+        }
+    }
+    return files_count >= 0;
+}
+
+// gets the newest limit games of a player, newest first (returns how many were found, -1 if error)
+// each run gives only the range of the player's hash, so a query reads a few pages of each run and the small logs not yet compacted.
+// names that share a hash are told apart by the caller with the names in the BEGN
+int history_query(const char* dir, const char* name, history_entry_t* entries, int limit) {
+    uint64_t hash = history_hash(name);
+    history_entry_t* found = NULL;
+    int count = 0;
+    int capacity = 0;
+    // a compaction can remove a file between listing and opening it, the files it wrote have the same entries
+    int ok = 0;
+    for (int attempt = 0; attempt < 3 && !ok; attempt++) {
+        count = 0;
+        ok = collect(dir, hash, limit, &found, &count, &capacity);
+    }
+    if (!ok) {
+        free(found);
+        return -1;
+    }
+    qsort(found, count, sizeof(history_entry_t), compare_newest);
+    int kept = 0;
+    for (int i = 0; i < count && kept < limit; i++) {
+        // a log and the run it was compacted into can both be listed
+        if (kept > 0 && found[i].game_id == entries[kept - 1].game_id) {
+            continue;
+        }
+        entries[kept++] = found[i];
+    }
+    free(found);
+    return kept;
+}
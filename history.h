@@ -0,0 +1,62 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "journal.h"
+#include "lockprof.h"
+#include <pthread.h>
+#include <stdint.h>
+
+// the index lives beside the journal segments it points into
+#define HISTORY_DIR JOURNAL_DIR
+#define HISTORY_MAGIC 0x54534948  // "HIST"
+#define HISTORY_VERSION 2
+// entries a log takes before the next one is started and it is compacted, a query reads the logs whole so this bounds what it reads unsorted
+#define HISTORY_COMPACT_ENTRIES (1 << 16)
+// a log with fewer entries is still compacted after this long
+#define HISTORY_COMPACT_SECONDS 60
+// games a query returns unless asked for another number
+#define HISTORY_QUERY_GAMES 50
+// most logs and runs a query or compaction looks at, tiered merging keeps the runs near log2 of the entries
+#define HISTORY_MAX_FILES 256
+
+// one player's part in a finished game, every game adds one for X and one for O
+// runs are sorted by name hash and then newest first, so a player's games are one range found by binary search
+typedef struct history_entry {
+    uint64_t name_hash;
+    uint64_t game_id;
+    uint64_t time_ns;              // CLOCK_REALTIME when the game ended
+    journal_position_t begun_at;   // the game's BEGN (names and variant)
+    journal_position_t over_at;    // the game's OVER (winner and reason)
+} history_entry_t;
+
+// start of a run file, followed by count sorted entries
+typedef struct history_run_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+} history_run_header_t;
+
+// the index the server appends to
+// entries are appended to history-<generation>.log and a new log is started when one is full, the compaction thread
+// sorts the old one into a run history-<generation>-<generation>.run and merges runs of about the same size into one
+typedef struct history {
+    char dir[256];
+    int log_fd;                    // -1 when the index is off
+    long generation;               // of the log being appended to
+    uint64_t logged;               // entries in it
+    int running;
+    pthread_t compact_tid;
+    lockprof_mutex_t lock;         // held to append and to switch logs
+    pthread_cond_t wake;
+} history_t;
+
+extern history_t history;
+
+uint64_t history_hash(const char* name);
+int history_open(history_t* index, const char* dir);
+void history_close(history_t* index);
+int history_add_game(history_t* index, uint64_t game_id, const char* x_name, const char* o_name, const journal_position_t* begun_at, const journal_position_t* over_at);
+int history_compact(const char* dir, long below);
+int history_query(const char* dir, const char* name, history_entry_t* entries, int limit);
+
+#endif
@@ -0,0 +1,460 @@
+// NOTE: must use option -pthread when compiling!
+#define _POSIX_C_SOURCE 200809L
+#include "journal.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static journal_writer_t writers[JOURNAL_WRITERS];
+static char journal_dir[256];
+static JournalSync journal_sync = JOURNAL_SYNC_GROUP;
+static int journal_ready = 0;
+static int commit_running = 0;
+static pthread_t commit_tid;
+// segment names start with the server's start time so a restart never reuses a file
+static long journal_run = 0;
+static uint64_t next_game_id = 0;
+// claims that found every writer claimed and shared one
+static uint64_t shared_claims = 0;
+// where the calling thread's last append went, a shared writer's last record may be another game's
+static __thread journal_position_t last_appended;
+static size_t page_size = 4096;
+
+// creates, sizes and maps a new segment file for a writer (returns 1 on success, 0 if error)
+// the caller holds writer->map_lock
+static int open_segment(journal_writer_t* writer) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%010ld-%03d-%06ld.jnl", journal_dir, journal_run, writer->slot, writer->sequence);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        perror("journal open");
+        return 0;
+    }
+    // reserve the blocks now so a full disk fails here instead of with SIGBUS on a later append
+    int error = posix_fallocate(fd, 0, JOURNAL_SEGMENT_BYTES);
+    if (error != 0) {
+        fprintf(stderr, "journal fallocate: %s\n", strerror(error));
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(NULL, JOURNAL_SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("journal mmap");
+        return 0;
+    }
+    writer->map = map;
+    writer->used = 0;
+    writer->synced = 0;
+    return 1;
+}
+
+// syncs everything a writer appended since the last sync, the caller holds writer->map_lock
+static void sync_writer(journal_writer_t* writer) {
+    if (writer->map == NULL) {
+        return;
+    }
+    size_t used = __atomic_load_n(&writer->used, __ATOMIC_ACQUIRE);
+    if (used > writer->synced) {
+        // msync wants a page aligned start
+        size_t start = writer->synced & ~(page_size - 1);
+        if (msync(writer->map + start, used - start, MS_SYNC) < 0) {
+            perror("journal msync");
+        }
+        writer->synced = used;
+    }
+}
+
+// group commit: one pass syncs whatever every game wrote since the last pass
+static void* commit_thread(void* arg) {
+    struct timespec interval;
+    interval.tv_sec = JOURNAL_COMMIT_MS / 1000;
+    interval.tv_nsec = (JOURNAL_COMMIT_MS % 1000) * 1000000L;
+    while (__atomic_load_n(&commit_running, __ATOMIC_ACQUIRE)) {
+        nanosleep(&interval, NULL);
+        for (int slot = 0; slot < JOURNAL_WRITERS; slot++) {
+            lockprof_lock(&writers[slot].map_lock);
+            sync_writer(&writers[slot]);
+            lockprof_unlock(&writers[slot].map_lock);
+        }
+    }
+    return NULL;
+}
+
+// sets up the journal in dir and starts the commit thread for the group policy (returns 1 on success, 0 if error)
+int journal_init(const char* dir, JournalSync sync) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("journal mkdir");
+        return 0;
+    }
+    snprintf(journal_dir, sizeof(journal_dir), "%s", dir);
+    journal_sync = sync;
+    journal_run = (long) time(NULL);
+    // a restart within the second of the checkpoint would otherwise try to create the same files
+    long checkpoint = journal_read_checkpoint(dir);
+    if (journal_run <= checkpoint) {
+        journal_run = checkpoint + 1;
+    }
+    // ids are unique across restarts as long as fewer than 2^20 games start in one second
+    next_game_id = (uint64_t) journal_run << 20;
+    page_size = sysconf(_SC_PAGESIZE);
+    for (int slot = 0; slot < JOURNAL_WRITERS; slot++) {
+        writers[slot].slot = slot;
+        writers[slot].users = 0;
+        writers[slot].sequence = 0;
+        writers[slot].map = NULL;
+        writers[slot].used = 0;
+        writers[slot].synced = 0;
+        lockprof_init(&writers[slot].append_lock, "journal append_lock");
+        lockprof_init(&writers[slot].map_lock, "journal map_lock");
+    }
+    if (sync == JOURNAL_SYNC_GROUP) {
+        commit_running = 1;
+        int error = pthread_create(&commit_tid, NULL, commit_thread, NULL);
+        if (error != 0) {
+            fprintf(stderr, "journal commit thread: %s\n", strerror(error));
+            commit_running = 0;
+            return 0;
+        }
+    }
+    journal_ready = 1;
+    return 1;
+}
+
+// stops the commit thread and syncs every segment, segments stay mapped since game threads may still be appending
+void journal_shutdown(void) {
+    if (!journal_ready) {
+        return;
+    }
+    if (commit_running) {
+        __atomic_store_n(&commit_running, 0, __ATOMIC_RELEASE);
+        pthread_join(commit_tid, NULL);
+    }
+    journal_flush();
+}
+
+// syncs everything appended so far whatever the policy
+void journal_flush(void) {
+    if (!journal_ready) {
+        return;
+    }
+    for (int slot = 0; slot < JOURNAL_WRITERS; slot++) {
+        lockprof_lock(&writers[slot].map_lock);
+        sync_writer(&writers[slot]);
+        lockprof_unlock(&writers[slot].map_lock);
+    }
+}
+
+// gets the run this server's segments are named with
+long journal_current_run(void) {
+    return journal_run;
+}
+
+// gets an id for a new game, the id ties together the records of one game
+uint64_t journal_next_game_id(void) {
+    return __atomic_fetch_add(&next_game_id, 1, __ATOMIC_RELAXED);
+}
+
+// gets how many claims had to share a writer with another game
+uint64_t journal_shared_claims(void) {
+    return __atomic_load_n(&shared_claims, __ATOMIC_RELAXED);
+}
+
+// claims a writer for the calling game thread (returns NULL if the journal is off or a segment file can't be created)
+// a free writer if there is one, otherwise the one with the fewest games, so a game is journaled however many are live
+journal_writer_t* journal_claim(void) {
+    if (!journal_ready) {
+        return NULL;
+    }
+    journal_writer_t* writer = NULL;
+    for (int slot = 0; slot < JOURNAL_WRITERS && writer == NULL; slot++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&writers[slot].users, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            writer = &writers[slot];
+        }
+    }
+    if (writer == NULL) {
+        writer = &writers[0];
+        for (int slot = 1; slot < JOURNAL_WRITERS; slot++) {
+            if (__atomic_load_n(&writers[slot].users, __ATOMIC_RELAXED) < __atomic_load_n(&writer->users, __ATOMIC_RELAXED)) {
+                writer = &writers[slot];
+            }
+        }
+        __atomic_add_fetch(&writer->users, 1, __ATOMIC_ACQUIRE);
+        __atomic_add_fetch(&shared_claims, 1, __ATOMIC_RELAXED);
+    }
+    // a slot's first segment is only created when a game first needs it
+    lockprof_lock(&writer->append_lock);
+    int opened = 1;
+    if (writer->map == NULL) {
+        lockprof_lock(&writer->map_lock);
+        opened = open_segment(writer);
+        lockprof_unlock(&writer->map_lock);
+    }
+    lockprof_unlock(&writer->append_lock);
+    if (!opened) {
+        journal_release(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+// gives a writer back when its game is over, the next game to claim it keeps appending to the same segment
+void journal_release(journal_writer_t* writer) {
+    if (writer != NULL) {
+        __atomic_sub_fetch(&writer->users, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// appends one record and syncs it right away if sync_now is set (returns 1 on success, 0 if writer is NULL, -1 if error)
+// the payload and header are written before the length, so a record cut short by a crash reads as the end of the segment
+static int append_record(journal_writer_t* writer, int code, uint64_t game_id, const char* payload, size_t length, int sync_now) {
+    if (writer == NULL) {
+        return 0;
+    }
+    if (length > JOURNAL_MAX_PAYLOAD) {
+        length = JOURNAL_MAX_PAYLOAD;
+    }
+    size_t record_size = sizeof(journal_record_t) + ((length + 7) & ~(size_t) 7);
+    lockprof_lock(&writer->append_lock);
+    if (writer->map == NULL || writer->used + record_size > JOURNAL_SEGMENT_BYTES) {
+        // switch to a new file, the commit thread must not sync the old map while it is unmapped
+        lockprof_lock(&writer->map_lock);
+        if (writer->map != NULL) {
+            if (journal_sync != JOURNAL_SYNC_NONE) {
+                sync_writer(writer);
+            }
+            munmap(writer->map, JOURNAL_SEGMENT_BYTES);
+            writer->map = NULL;
+            writer->sequence++;
+        }
+        int opened = open_segment(writer);
+        lockprof_unlock(&writer->map_lock);
+        if (!opened) {
+            lockprof_unlock(&writer->append_lock);
+            return -1;
+        }
+    }
+
+    size_t start = writer->used;
+    journal_record_t* record = (journal_record_t*) (writer->map + start);
+    memcpy(record + 1, payload, length);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    record->code = code;
+    record->game_id = game_id;
+    record->time_ns = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+    __atomic_store_n(&record->length, (uint32_t) length, __ATOMIC_RELEASE);
+    __atomic_store_n(&writer->used, start + record_size, __ATOMIC_RELEASE);
+    last_appended.run = (uint32_t) journal_run;
+    last_appended.slot = (uint16_t) writer->slot;
+    last_appended.sequence = (uint32_t) writer->sequence;
+    last_appended.offset = (uint32_t) start;
+
+    int result = 1;
+    if (sync_now) {
+        size_t page_start = start & ~(page_size - 1);
+        if (msync(writer->map + page_start, start + record_size - page_start, MS_SYNC) < 0) {
+            perror("journal msync");
+            result = -1;
+        }
+    }
+    lockprof_unlock(&writer->append_lock);
+    return result;
+}
+
+// appends one record, with the always policy it is on disk when this returns (returns 1 on success, 0 if writer is NULL, -1 if error)
+int journal_append(journal_writer_t* writer, int code, uint64_t game_id, const char* payload, size_t length) {
+    return append_record(writer, code, game_id, payload, length, journal_sync == JOURNAL_SYNC_ALWAYS);
+}
+
+// appends one record without syncing it whatever the policy, for writing many records at once followed by journal_flush
+int journal_append_deferred(journal_writer_t* writer, int code, uint64_t game_id, const char* payload, size_t length) {
+    return append_record(writer, code, game_id, payload, length, 0);
+}
+
+// parses a sync policy name: none, group or always (returns 1 on success, 0 if unknown)
+int journal_parse_sync(const char* name, JournalSync* sync) {
+    if (strcmp(name, "none") == 0) {
+        *sync = JOURNAL_SYNC_NONE;
+    }
+    else if (strcmp(name, "group") == 0) {
+        *sync = JOURNAL_SYNC_GROUP;
+    }
+    else if (strcmp(name, "always") == 0) {
+        *sync = JOURNAL_SYNC_ALWAYS;
+    }
+    else {
+        return 0;
+    }
+    return 1;
+}
+
+// gets the run named in dir's checkpoint file (returns 0 if there is none, so every run is read)
+long journal_read_checkpoint(const char* dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, JOURNAL_CHECKPOINT);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    long run = 0;
+    if (fscanf(file, "%ld", &run) != 1) {
+        run = 0;
+    }
+    fclose(file);
+    return run;
+}
+
+// names run as the first one recovery reads (returns 1 on success, 0 if error)
+// the file is written beside the old one and renamed over it so a crash leaves one or the other
+int journal_write_checkpoint(const char* dir, long run) {
+    char path[512];
+    char tmp_path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, JOURNAL_CHECKPOINT);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/%s.tmp", dir, JOURNAL_CHECKPOINT);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("checkpoint open");
+        return 0;
+    }
+    char line[32];
+    int length = snprintf(line, sizeof(line), "%ld\n", run);
+    if (write(fd, line, length) != length || fsync(fd) < 0) {
+        perror("checkpoint write");
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    if (rename(tmp_path, path) < 0) {
+        perror("checkpoint rename");
+        return 0;
+    }
+    // the rename itself is only durable once the directory is synced
+    int dir_fd = open(dir, O_RDONLY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return 1;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+// calls visit for every record of the segments of runs from first_run on, in file name order (returns the number of records, -1 if error)
+// a game's records can be spread over several segments, so callers that need them in order sort by game and time themselves
+long journal_scan(const char* dir, long first_run, journal_visit_fn visit, void* arg) {
+    DIR* dirp = opendir(dir);
+    if (dirp == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    char** names = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dirp)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".jnl") != 0 || strtol(entry->d_name, NULL, 10) < first_run) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char** grown = realloc(names, capacity * sizeof(char*));
+            if (grown == NULL) {
+                perror("realloc");
+                break;
+            }
+            names = grown;
+        }
+        names[count++] = strdup(entry->d_name);
+    }
+    closedir(dirp);
+    // the names are zero padded so this is run, then writer, then sequence order
+    qsort(names, count, sizeof(char*), compare_names);
+
+    long records = 0;
+    char path[512];
+    for (size_t i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        free(names[i]);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror("journal scan open");
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+            close(fd);
+            continue;
+        }
+        const char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            perror("journal scan mmap");
+            continue;
+        }
+        posix_madvise((void*) map, st.st_size, POSIX_MADV_SEQUENTIAL);
+        size_t size = st.st_size;
+        size_t offset = 0;
+        while (offset + sizeof(journal_record_t) <= size) {
+            const journal_record_t* record = (const journal_record_t*) (map + offset);
+            // the first unwritten or torn record ends the segment
+            if (record->length == 0 || record->length > JOURNAL_MAX_PAYLOAD) {
+                break;
+            }
+            size_t record_size = sizeof(journal_record_t) + ((record->length + 7) & ~(size_t) 7);
+            if (offset + record_size > size) {
+                break;
+            }
+            visit(record, (const char*) (record + 1), arg);
+            records++;
+            offset += record_size;
+        }
+        munmap((void*) map, size);
+    }
+    free(names);
+    return records;
+}
+
+// gets where the record the calling thread appended last to writer is (returns 1 on success, 0 if it appended nothing there)
+int journal_last_position(const journal_writer_t* writer, journal_position_t* position) {
+    if (writer == NULL || last_appended.run == 0 || last_appended.slot != writer->slot) {
+        return 0;
+    }
+    *position = last_appended;
+    return 1;
+}
+
+// reads the record at a position into record and up to size bytes of its payload into payload, terminated
+// (returns the payload length, -1 if there is no complete record there)
+// two reads of a few hundred bytes, a lookup touches nothing but the record it wants
+int journal_read(const char* dir, const journal_position_t* position, uint64_t game_id, journal_record_t* record, char* payload, size_t size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%010ld-%03d-%06ld.jnl", dir, (long) position->run, (int) position->slot, (long) position->sequence);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int length = -1;
+    // a position that is off (a stale index entry, a reused file name) mostly lands on some other game's record, never return that
+    if (pread(fd, record, sizeof(*record), position->offset) == (ssize_t) sizeof(*record) && record->game_id == game_id
+        && record->length != 0 && record->length <= JOURNAL_MAX_PAYLOAD && size > 0) {
+        size_t wanted = record->length < size - 1 ? record->length : size - 1;
+        ssize_t got = pread(fd, payload, wanted, position->offset + sizeof(*record));
+        if (got == (ssize_t) wanted) {
+            payload[got] = '\0';
+            length = got;
+        }
+    }
+    close(fd);
+    return length;
+}
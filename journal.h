@@ -0,0 +1,79 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "lockprof.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// directory the segments are written to (created if missing), segment files are named <writer>-<sequence>.jnl
+#define JOURNAL_DIR "journal"
+// segment files written at once, a game claims a free writer for the whole game and once every one is claimed games share them
+#define JOURNAL_WRITERS 256
+// size a segment file is created with, a writer starts a new file when the current one is full
+#define JOURNAL_SEGMENT_BYTES (4 << 20)
+// how often the commit thread syncs everything written since its last pass with the group policy
+#define JOURNAL_COMMIT_MS 10
+// longest payload of one record
+#define JOURNAL_MAX_PAYLOAD 1024
+// file in the journal directory naming the first run recovery has to read, older runs hold no live games
+#define JOURNAL_CHECKPOINT "CHECKPOINT"
+
+// when written records reach the disk
+typedef enum {
+    JOURNAL_SYNC_NONE,   // 0 - left to the kernel, survives a server crash but not a power loss
+    JOURNAL_SYNC_GROUP,  // 1 - the commit thread syncs every segment every JOURNAL_COMMIT_MS, one sync covers all games
+    JOURNAL_SYNC_ALWAYS  // 2 - every record is synced before journal_append returns
+} JournalSync;
+
+// header of every record, followed by length bytes of payload and padding up to a multiple of 8
+// a header with length 0 marks the end of what has been written to a segment
+typedef struct journal_record {
+    uint32_t length;
+    uint8_t code;         // BEGN, MOVD or OVER from MessageCode
+    uint8_t reserved[3];
+    uint64_t game_id;
+    uint64_t time_ns;     // CLOCK_REALTIME when the record was appended
+} journal_record_t;
+
+// where a record is: the run, writer slot and sequence name its segment file and offset is where its header starts
+typedef struct journal_position {
+    uint32_t run;         // 0 for no position
+    uint16_t slot;
+    uint32_t sequence;
+    uint32_t offset;
+} journal_position_t;
+
+// a claimed segment, normally one game thread's alone so its append lock is never contended
+typedef struct journal_writer {
+    int slot;
+    int users;            // game threads that claimed it, more than 1 only once every writer is claimed
+    long sequence;        // number of the current segment file of this slot
+    char* map;            // the segment file mapped shared, NULL until the slot is first claimed
+    size_t used;          // bytes appended, published with a release store for the commit thread
+    size_t synced;        // bytes the commit thread has synced
+    lockprof_mutex_t append_lock; // held by whoever appends, so games sharing the writer never write over each other
+    lockprof_mutex_t map_lock; // held by the commit thread while syncing and by the writer while switching files
+} journal_writer_t;
+
+// called by journal_scan for every complete record in order, payload is length bytes and not terminated
+typedef void (*journal_visit_fn)(const journal_record_t* record, const char* payload, void* arg);
+
+int journal_init(const char* dir, JournalSync sync);
+void journal_shutdown(void);
+uint64_t journal_next_game_id(void);
+uint64_t journal_shared_claims(void);
+journal_writer_t* journal_claim(void);
+void journal_release(journal_writer_t* writer);
+int journal_append(journal_writer_t* writer, int code, uint64_t game_id, const char* payload, size_t length);
+int journal_append_deferred(journal_writer_t* writer, int code, uint64_t game_id, const char* payload, size_t length);
+int journal_parse_sync(const char* name, JournalSync* sync);
+long journal_current_run(void);
+void journal_flush(void);
+long journal_read_checkpoint(const char* dir);
+int journal_write_checkpoint(const char* dir, long run);
+long journal_scan(const char* dir, long first_run, journal_visit_fn visit, void* arg);
+int journal_last_position(const journal_writer_t* writer, journal_position_t* position);
+int journal_read(const char* dir, const journal_position_t* position, uint64_t game_id, journal_record_t* record, char* payload, size_t size);
+
+#endif
@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+// one recorder per thread that records, plus the shared one at the end
+// a recorder is never cleared, a thread that claims one freed by a finished game keeps adding to its counts
+static latency_recorder_t recorders[LATENCY_RECORDERS + 1];
+// recorders ever claimed, readers don't look past it so the untouched ones are never paged in
+static int recorders_used = 0;
+static __thread latency_recorder_t* thread_recorder = NULL;
+static pthread_key_t release_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+static const char* phase_names[LATENCY_PHASES] = {"handshake", "play_to_wait", "pairing", "begin", "move", "over", "send"};
+
+uint64_t latency_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// the same clock in seconds, what the tools and benches time whole runs with
+double now_seconds(void) {
+    return latency_now() / 1e9;
+}
+
+// gives a thread's recorder back when the thread exits, game threads are detached so this is the only place to do it
+static void release_recorder(void* recorder) {
+    __atomic_store_n(&((latency_recorder_t*) recorder)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_key(void) {
+    pthread_key_create(&release_key, release_recorder);
+    recorders[LATENCY_RECORDERS].shared = 1;
+    recorders[LATENCY_RECORDERS].in_use = 1;
+}
+
+// claims a free recorder for the calling thread the first time it records, or hands out the shared one if all are taken
+static latency_recorder_t* claim_recorder(void) {
+    pthread_once(&key_once, create_key);
+    for (int slot = 0; slot < LATENCY_RECORDERS; slot++) {
+        int expected = 0;
+        if (!__atomic_compare_exchange_n(&recorders[slot].in_use, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        int used = __atomic_load_n(&recorders_used, __ATOMIC_RELAXED);
+        while (used < slot + 1 && !__atomic_compare_exchange_n(&recorders_used, &used, slot + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+        pthread_setspecific(release_key, &recorders[slot]);
+        return &recorders[slot];
+    }
+    return &recorders[LATENCY_RECORDERS];
+}
+
+// bucket of a value: itself below 16, else the power of 2 it is in and the next 4 bits below its top bit
+static inline int bucket_of(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (int) ns;
+    }
+    if (ns >> LATENCY_MAX_BITS) {
+        return LATENCY_BUCKETS - 1;
+    }
+    int top = 63 - __builtin_clzll(ns);
+    return (top - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + (int) ((ns >> (top - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+// the highest value that lands in a bucket
+uint64_t latency_bucket_upper(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t lower = (uint64_t) (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+    return lower + (1ull << shift) - 1;
+}
+
+// adds to a counter only this thread writes: a relaxed load and store, no locked instruction and no retry
+static inline void add_owned(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+// adds a value to a histogram no other thread writes at the same time (a thread's own, or a lock's while it is held)
+void latency_histogram_add(latency_histogram_t* histogram, uint64_t ns) {
+    add_owned(&histogram->buckets[bucket_of(ns)], 1);
+    add_owned(&histogram->sum_ns, ns);
+    add_owned(&histogram->count, 1);
+    if (ns > histogram->max_ns) {
+        __atomic_store_n(&histogram->max_ns, ns, __ATOMIC_RELAXED);
+    }
+}
+
+// records one value of a phase, wait free: a thread's own recorder is never written by another thread
+void latency_record(latency_phase_t phase, uint64_t ns) {
+    latency_recorder_t* recorder = thread_recorder;
+    if (recorder == NULL) {
+        recorder = thread_recorder = claim_recorder();
+    }
+    latency_histogram_t* histogram = &recorder->phases[phase];
+    if (!recorder->shared) {
+        latency_histogram_add(histogram, ns);
+        return;
+    }
+    int bucket = bucket_of(ns);
+    __atomic_fetch_add(&histogram->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&histogram->max_ns, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// records the time from start_ns (a latency_now) to now
+void latency_since(latency_phase_t phase, uint64_t start_ns) {
+    uint64_t now = latency_now();
+    latency_record(phase, now > start_ns ? now - start_ns : 0);
+}
+
+// adds up a phase over every recorder into merged, while threads keep recording (a count may be ahead of its buckets by a value or two)
+void latency_merge(latency_phase_t phase, latency_histogram_t* merged) {
+    memset(merged, 0, sizeof(*merged));
+    int used = __atomic_load_n(&recorders_used, __ATOMIC_ACQUIRE);
+    for (int slot = 0; slot <= LATENCY_RECORDERS; slot++) {
+        if (slot == used) {
+            slot = LATENCY_RECORDERS;
+        }
+        const latency_histogram_t* histogram = &recorders[slot].phases[phase];
+        uint64_t count = 0;
+        for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            uint64_t value = __atomic_load_n(&histogram->buckets[bucket], __ATOMIC_RELAXED);
+            merged->buckets[bucket] += value;
+            count += value;
+        }
+        // the count is taken from the buckets read, so percentiles always add up
+        merged->count += count;
+        merged->sum_ns += __atomic_load_n(&histogram->sum_ns, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+        merged->max_ns = max > merged->max_ns ? max : merged->max_ns;
+    }
+}
+
+// the value percentile percent of the recorded values are at or below (within a bucket's width), 0 if nothing was recorded
+uint64_t latency_percentile(const latency_histogram_t* histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile / 100.0 * histogram->count + 0.5);
+    rank = rank < 1 ? 1 : (rank > histogram->count ? histogram->count : rank);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        // the last bucket has no top, everything past 2^36 ns is in it
+        if (seen >= rank && bucket < LATENCY_BUCKETS - 1) {
+            uint64_t upper = latency_bucket_upper(bucket);
+            return upper < histogram->max_ns ? upper : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+const char* latency_phase_name(latency_phase_t phase) {
+    return phase_names[phase];
+}
+
+// prints count, mean, p50, p90, p99, p99.9 and max of every phase in us
+void latency_report(FILE* out) {
+    latency_histogram_t merged;
+    fprintf(out, "Latency (us):      count      mean       p50       p90       p99     p99.9       max\n");
+    for (int phase = 0; phase < LATENCY_PHASES; phase++) {
+        latency_merge(phase, &merged);
+        fprintf(out, "    %-12s %9llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", phase_names[phase], (unsigned long long) merged.count,
+            merged.count ? merged.sum_ns / 1e3 / merged.count : 0.0, latency_percentile(&merged, 50) / 1e3, latency_percentile(&merged, 90) / 1e3,
+            latency_percentile(&merged, 99) / 1e3, latency_percentile(&merged, 99.9) / 1e3, merged.max_ns / 1e3);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// threads that can record at once with a recorder of their own (the accept loop plus one per game), the rest share one with atomic adds
+#define LATENCY_RECORDERS 256
+// buckets per power of 2, a value lands in a bucket at most 1/16 (6.25%) wider than itself
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+// values are ns and anything from 2^36 ns (about 69 s) up goes in the last bucket
+#define LATENCY_MAX_BITS 36
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+// the timed phases of a connection
+typedef enum latency_phase {
+    LATENCY_HANDSHAKE,   // accept to its first message (PLAY or RSUM) parsed
+    LATENCY_PLAY_WAIT,   // PLAY parsed to WAIT sent
+    LATENCY_PAIRING,     // X starting to wait to their game thread starting
+    LATENCY_BEGIN,       // game thread starting to BEGN sent to both players
+    LATENCY_MOVE,        // MOVE received to MOVD sent to both players
+    LATENCY_OVER,        // OVER decided to both sockets closed
+    LATENCY_SEND,        // one send_msg
+    LATENCY_PHASES
+} latency_phase_t;
+
+// one phase's counts, log linear like an HDR histogram: values below 16 ns get a bucket each, then every power of 2 is split in 16
+typedef struct latency_histogram {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+// a thread's histograms, only the thread holding it writes to them so recording is a few plain loads and stores
+// readers add up every recorder with relaxed loads and never stop a writer
+typedef struct latency_recorder {
+    int in_use;           // claimed by a thread (set with a compare and swap)
+    int shared;           // the recorder of threads that found no free one, updated with atomic adds
+    char padding[56];     // keeps the counts off the cache line other threads claim recorders on
+    latency_histogram_t phases[LATENCY_PHASES];
+} latency_recorder_t;
+
+uint64_t latency_now(void);
+double now_seconds(void);
+void latency_record(latency_phase_t phase, uint64_t ns);
+void latency_since(latency_phase_t phase, uint64_t start_ns);
+void latency_histogram_add(latency_histogram_t* histogram, uint64_t ns);
+void latency_merge(latency_phase_t phase, latency_histogram_t* merged);
+uint64_t latency_bucket_upper(int bucket);
+uint64_t latency_percentile(const latency_histogram_t* histogram, double percentile);
+const char* latency_phase_name(latency_phase_t phase);
+void latency_report(FILE* out);
+
+#endif
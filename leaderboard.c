@@ -0,0 +1,278 @@
+#define _POSIX_C_SOURCE 200809L
+#include "leaderboard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+leaderboard_t leaderboard = {NULL};
+
+// is (score, slot) placed before node, higher scores first and lower slots first on a tie
+static int comes_before(int64_t score, uint32_t slot, const leaderboard_node_t* node) {
+    return score > node->score || (score == node->score && slot < node->slot);
+}
+
+// picks a new node's level, each level up has a 1 in 4 chance
+static int random_level(leaderboard_t* board) {
+    int level = 1;
+    for (;;) {
+        board->random ^= board->random << 13;
+        board->random ^= board->random >> 17;
+        board->random ^= board->random << 5;
+        if ((board->random & 3) != 0 || level >= LEADERBOARD_MAX_LEVEL) {
+            return level;
+        }
+        level++;
+    }
+}
+
+static leaderboard_node_t* new_node(int level) {
+    leaderboard_node_t* node = calloc(1, sizeof(leaderboard_node_t) + level * sizeof(struct leaderboard_link));
+    if (node == NULL) {
+        perror("leaderboard calloc");
+        return NULL;
+    }
+    node->level = level;
+    return node;
+}
+
+// links a node in at its place, O(log n)
+static void list_insert(leaderboard_list_t* list, leaderboard_node_t* node) {
+    leaderboard_node_t* update[LEADERBOARD_MAX_LEVEL];
+    uint64_t rank[LEADERBOARD_MAX_LEVEL];
+    leaderboard_node_t* x = list->head;
+    // the node's level may be above the list's, those levels start at the head
+    int top = (node->level > list->level) ? node->level : list->level;
+    for (int i = top - 1; i >= 0; i--) {
+        rank[i] = (i == top - 1) ? 0 : rank[i + 1];
+        if (i >= list->level) {
+            // an unused level of the head skips the whole list
+            list->head->levels[i].span = list->length;
+        }
+        while (x->levels[i].next != NULL && comes_before(x->levels[i].next->score, x->levels[i].next->slot, node)) {
+            rank[i] += x->levels[i].span;
+            x = x->levels[i].next;
+        }
+        update[i] = x;
+    }
+    for (int i = 0; i < node->level; i++) {
+        node->levels[i].next = update[i]->levels[i].next;
+        update[i]->levels[i].next = node;
+        node->levels[i].span = update[i]->levels[i].span - (rank[0] - rank[i]);
+        update[i]->levels[i].span = rank[0] - rank[i] + 1;
+    }
+    // the links over the node on the levels it doesn't reach now skip one more place
+    for (int i = node->level; i < top; i++) {
+        update[i]->levels[i].span++;
+    }
+    if (node->level > list->level) {
+        list->level = node->level;
+    }
+    list->length++;
+}
+
+// unlinks a node, O(log n), the node is kept for its next place
+static void list_remove(leaderboard_list_t* list, leaderboard_node_t* node) {
+    leaderboard_node_t* x = list->head;
+    for (int i = list->level - 1; i >= 0; i--) {
+        while (x->levels[i].next != NULL && x->levels[i].next != node && comes_before(x->levels[i].next->score, x->levels[i].next->slot, node)) {
+            x = x->levels[i].next;
+        }
+        if (x->levels[i].next == node) {
+            x->levels[i].span += node->levels[i].span - 1;
+            x->levels[i].next = node->levels[i].next;
+        }
+        else {
+            x->levels[i].span--;
+        }
+    }
+    while (list->level > 1 && list->head->levels[list->level - 1].next == NULL) {
+        list->level--;
+    }
+    list->length--;
+}
+
+// moves a slot to its place for a new score, adding it if it isn't ranked yet (returns 1 on success, 0 if out of memory)
+static int list_set(leaderboard_t* board, leaderboard_list_t* list, uint32_t slot, int64_t score) {
+    leaderboard_node_t* node = list->nodes[slot];
+    if (node == NULL) {
+        node = new_node(random_level(board));
+        if (node == NULL) {
+            return 0;
+        }
+        node->slot = slot;
+        list->nodes[slot] = node;
+    }
+    else if (node->score == score) {
+        return 1;
+    }
+    else {
+        list_remove(list, node);
+    }
+    node->score = score;
+    list_insert(list, node);
+    return 1;
+}
+
+// gets the 1 based place of a ranked slot, O(log n)
+static uint64_t list_rank(const leaderboard_list_t* list, const leaderboard_node_t* node) {
+    uint64_t rank = 0;
+    const leaderboard_node_t* x = list->head;
+    for (int i = list->level - 1; i >= 0; i--) {
+        while (x->levels[i].next != NULL && (x->levels[i].next == node || comes_before(x->levels[i].next->score, x->levels[i].next->slot, node))) {
+            rank += x->levels[i].span;
+            x = x->levels[i].next;
+        }
+        if (x == node) {
+            return rank;
+        }
+    }
+    return 0;
+}
+
+// reads a slot's record and moves it on every board, players without a finished game aren't ranked
+static void apply(leaderboard_t* board, uint32_t slot) {
+    const player_record_t* record = &board->table->records[slot];
+    if (__atomic_load_n(&record->games, __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+    int64_t scores[LEADERBOARD_BOARDS];
+    scores[LEADERBOARD_RATING] = __atomic_load_n(&record->rating, __ATOMIC_RELAXED);
+    scores[LEADERBOARD_WINS] = __atomic_load_n(&record->wins, __ATOMIC_RELAXED);
+    for (int by = 0; by < LEADERBOARD_BOARDS; by++) {
+        if (!list_set(board, &board->lists[by], slot, scores[by])) {
+            fprintf(stderr, "[LEADERBOARD] could not rank %s\n", record->name);
+        }
+    }
+}
+
+static void apply_visit(players_t* table, uint64_t slot, void* arg) {
+    apply(arg, slot);
+}
+
+// applies every pushed slot, must hold the lock
+static void drain(leaderboard_t* board) {
+    uint32_t item = __atomic_exchange_n(&board->pending, 0, __ATOMIC_ACQUIRE);
+    while (item != 0) {
+        uint32_t slot = item - 1;
+        // the next slot is read before the slot can be pushed again and reuse its link
+        item = board->pending_next[slot];
+        // cleared before the record is read, so a game that ends after the read pushes the slot again
+        __atomic_store_n(&board->queued[slot], 0, __ATOMIC_SEQ_CST);
+        apply(board, slot);
+    }
+}
+
+// builds the boards from every player in the table (returns 1 on success, 0 if error)
+// this is the only full pass, after it every finished game moves its two players with O(log n) updates
+int leaderboard_init(leaderboard_t* board, players_t* table) {
+    memset(board, 0, sizeof(*board));
+    board->table = table;
+    board->random = 2463534242u;
+    lockprof_init(&board->lock, "leaderboard lock");
+    if (table->map == NULL) {
+        return 0;
+    }
+    uint64_t capacity = table->mask + 1;
+    board->pending_next = calloc(capacity, sizeof(uint32_t));
+    board->queued = calloc(capacity, sizeof(uint8_t));
+    int ok = board->pending_next != NULL && board->queued != NULL;
+    for (int by = 0; by < LEADERBOARD_BOARDS && ok; by++) {
+        board->lists[by].head = new_node(LEADERBOARD_MAX_LEVEL);
+        board->lists[by].level = 1;
+        board->lists[by].nodes = calloc(capacity, sizeof(leaderboard_node_t*));
+        ok = board->lists[by].head != NULL && board->lists[by].nodes != NULL;
+    }
+    if (!ok) {
+        perror("leaderboard init");
+        leaderboard_free(board);
+        return 0;
+    }
+    players_each(table, apply_visit, board);
+    return 1;
+}
+
+void leaderboard_free(leaderboard_t* board) {
+    for (int by = 0; by < LEADERBOARD_BOARDS; by++) {
+        leaderboard_list_t* list = &board->lists[by];
+        if (list->head != NULL) {
+            leaderboard_node_t* node = list->head->levels[0].next;
+            while (node != NULL) {
+                leaderboard_node_t* next = node->levels[0].next;
+                free(node);
+                node = next;
+            }
+            free(list->head);
+        }
+        free(list->nodes);
+        list->head = NULL;
+        list->nodes = NULL;
+    }
+    free(board->pending_next);
+    free(board->queued);
+    board->pending_next = NULL;
+    board->queued = NULL;
+    lockprof_destroy(&board->lock);
+}
+
+// notes that a player's record changed, called by a game thread after players_record_game
+// never waits: the slot is pushed with a compare and swap and applied now only if nobody else holds the lock
+void leaderboard_post(leaderboard_t* board, const char* name) {
+    if (board->queued == NULL) {
+        return;
+    }
+    player_record_t* record = players_get(board->table, name, 0);
+    if (record == NULL) {
+        return;
+    }
+    uint32_t slot = record - board->table->records;
+    // already on the stack, the drain that takes it off reads the record after this game's updates
+    if (__atomic_exchange_n(&board->queued[slot], 1, __ATOMIC_SEQ_CST) == 0) {
+        uint32_t top = __atomic_load_n(&board->pending, __ATOMIC_RELAXED);
+        do {
+            board->pending_next[slot] = top;
+        } while (!__atomic_compare_exchange_n(&board->pending, &top, slot + 1, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    if (lockprof_trylock(&board->lock)) {
+        drain(board);
+        lockprof_unlock(&board->lock);
+    }
+}
+
+// gets a player's place on a board and the number of ranked players (returns 1 if the player is ranked, else 0)
+int leaderboard_rank(leaderboard_t* board, leaderboard_by_t by, const char* name, uint64_t* rank, uint64_t* ranked) {
+    if (board->queued == NULL) {
+        return 0;
+    }
+    player_record_t* record = players_get(board->table, name, 0);
+    lockprof_lock(&board->lock);
+    drain(board);
+    leaderboard_list_t* list = &board->lists[by];
+    *ranked = list->length;
+    *rank = 0;
+    if (record != NULL && list->nodes[record - board->table->records] != NULL) {
+        *rank = list_rank(list, list->nodes[record - board->table->records]);
+    }
+    lockprof_unlock(&board->lock);
+    return *rank != 0;
+}
+
+// copies the first k places of a board into entries (returns how many were copied, fewer if fewer players are ranked)
+// every entry comes from the same state of the board, no game is half applied
+int leaderboard_top(leaderboard_t* board, leaderboard_by_t by, int k, leaderboard_entry_t* entries) {
+    if (board->queued == NULL) {
+        return 0;
+    }
+    int count = 0;
+    lockprof_lock(&board->lock);
+    drain(board);
+    for (const leaderboard_node_t* node = board->lists[by].head->levels[0].next; node != NULL && count < k; node = node->levels[0].next) {
+        // a record's name never changes once it is ready
+        memcpy(entries[count].name, board->table->records[node->slot].name, sizeof(entries[count].name));
+        entries[count].name[sizeof(entries[count].name) - 1] = '\0';
+        entries[count].score = node->score;
+        entries[count].rank = count + 1;
+        count++;
+    }
+    lockprof_unlock(&board->lock);
+    return count;
+}
@@ -0,0 +1,69 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "lockprof.h"
+#include "players.h"
+#include <pthread.h>
+#include <stdint.h>
+
+// enough levels for a skiplist of millions of players with a 1 in 4 chance of going up a level
+#define LEADERBOARD_MAX_LEVEL 16
+// players the server logs when it starts
+#define LEADERBOARD_TOP 10
+
+// what a board ranks players by, highest first
+typedef enum leaderboard_by {
+    LEADERBOARD_RATING,
+    LEADERBOARD_WINS,
+    LEADERBOARD_BOARDS
+} leaderboard_by_t;
+
+// a ranked player, slot is their index in the player table
+// levels[i].span is how many places the link on level i skips, so a rank is the sum of the spans walked to a node
+typedef struct leaderboard_node {
+    int64_t score;
+    uint32_t slot;
+    int level;
+    struct leaderboard_link {
+        struct leaderboard_node* next;
+        uint64_t span;
+    } levels[];
+} leaderboard_node_t;
+
+// an order statistics skiplist, ordered by score (highest first) and then slot so every player has one place
+typedef struct leaderboard_list {
+    leaderboard_node_t* head;
+    int level;
+    uint64_t length;
+    leaderboard_node_t** nodes;   // each slot's node, NULL if the player isn't ranked yet
+} leaderboard_list_t;
+
+// one place of a top K query
+typedef struct leaderboard_entry {
+    char name[136];
+    int64_t score;
+    uint64_t rank;
+} leaderboard_entry_t;
+
+// the boards of every player in a player table
+// game threads never wait for the lock: they push the players whose records changed onto a lock free stack,
+// which whoever next holds the lock (a query, or a game thread that got it with trylock) applies first
+typedef struct leaderboard {
+    players_t* table;
+    leaderboard_list_t lists[LEADERBOARD_BOARDS];
+    lockprof_mutex_t lock;
+    uint32_t pending;             // top of the stack, a slot + 1 (0 when it is empty)
+    uint32_t* pending_next;       // the slot under each pushed slot, + 1
+    uint8_t* queued;              // 1 while a slot is on the stack, so a player is pushed once however many games they finish
+    uint32_t random;              // level picks, only used with the lock held
+} leaderboard_t;
+
+extern leaderboard_t leaderboard;
+
+int leaderboard_init(leaderboard_t* board, players_t* table);
+void leaderboard_free(leaderboard_t* board);
+void leaderboard_post(leaderboard_t* board, const char* name);
+int leaderboard_rank(leaderboard_t* board, leaderboard_by_t by, const char* name, uint64_t* rank, uint64_t* ranked);
+int leaderboard_top(leaderboard_t* board, leaderboard_by_t by, int k, leaderboard_entry_t* entries);
+
+#endif
@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+#include "lockprof.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+// off until the admin LOCKS on command, locks taken meanwhile only check it
+int lockprof_enabled = 0;
+
+// every profiled lock's stats in the order they were first held, stats are never freed so a report can read them any time
+static lockprof_stats_t* registry[LOCKPROF_MAX_LOCKS];
+static int registered = 0;
+// bumped by a reset, stats from before it are left out of reports until their lock is held again and clears them
+static unsigned epoch = 0;
+
+// adds to a count only the lock's holder writes, readers may load it meanwhile
+static inline void add_owned(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+// (returns 1 on success, 0 if error)
+int lockprof_init(lockprof_mutex_t* lock, const char* name) {
+    lock->name = name;
+    lock->stats = NULL;
+    lock->held_ns = 0;
+    lock->where = NULL;
+    lock->func = NULL;
+    return pthread_mutex_init(&lock->mutex, NULL) == 0;
+}
+
+// the lock's stats stay in the registry, a report still shows them
+void lockprof_destroy(lockprof_mutex_t* lock) {
+    pthread_mutex_destroy(&lock->mutex);
+}
+
+// the stats of a lock the caller holds, allocated the first time and cleared if there was a reset since it was last held
+// (returns NULL if there is no room for them)
+static lockprof_stats_t* stats_of(lockprof_mutex_t* lock) {
+    lockprof_stats_t* stats = lock->stats;
+    unsigned current = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+    if (stats == NULL) {
+        if (__atomic_load_n(&registered, __ATOMIC_RELAXED) >= LOCKPROF_MAX_LOCKS) {
+            return NULL;
+        }
+        stats = calloc(1, sizeof(lockprof_stats_t));
+        if (stats == NULL) {
+            return NULL;
+        }
+        int slot = __atomic_fetch_add(&registered, 1, __ATOMIC_RELAXED);
+        if (slot >= LOCKPROF_MAX_LOCKS) {
+            free(stats);
+            return NULL;
+        }
+        stats->name = lock->name;
+        stats->epoch = current;
+        __atomic_store_n(&registry[slot], stats, __ATOMIC_RELEASE);
+        __atomic_store_n(&lock->stats, stats, __ATOMIC_RELEASE);
+    }
+    else if (stats->epoch != current) {
+        const char* name = stats->name;
+        memset(stats, 0, sizeof(lockprof_stats_t));
+        stats->name = name;
+        __atomic_store_n(&stats->epoch, current, __ATOMIC_RELEASE);
+    }
+    return stats;
+}
+
+// starts a hold of a lock just taken after waiting wait_ns for it
+static void start_hold(lockprof_mutex_t* lock, const char* where, const char* func, int contended, uint64_t wait_ns, uint64_t now) {
+    lockprof_stats_t* stats = stats_of(lock);
+    if (stats == NULL) {
+        lock->held_ns = 0;
+        return;
+    }
+    add_owned(&stats->acquired, 1);
+    if (contended) {
+        add_owned(&stats->contended, 1);
+    }
+    latency_histogram_add(&stats->wait, wait_ns);
+    lock->where = where;
+    lock->func = func;
+    // a clock at 0 would read as not profiled, it only is in the first ns after boot
+    lock->held_ns = now ? now : 1;
+}
+
+// ends the current hold, called with the lock still held
+static void end_hold(lockprof_mutex_t* lock) {
+    uint64_t now = latency_now();
+    uint64_t ns = now > lock->held_ns ? now - lock->held_ns : 0;
+    lock->held_ns = 0;
+    lockprof_stats_t* stats = lock->stats;
+    latency_histogram_add(&stats->hold, ns);
+    // sites are told apart by the address of their string, the same line always passes the same one
+    for (int i = 0; i < LOCKPROF_SITES; i++) {
+        lockprof_site_t* site = &stats->sites[i];
+        if (site->where == NULL) {
+            site->func = lock->func;
+            __atomic_store_n(&site->where, lock->where, __ATOMIC_RELEASE);
+        }
+        else if (site->where != lock->where) {
+            continue;
+        }
+        add_owned(&site->holds, 1);
+        add_owned(&site->hold_ns, ns);
+        if (ns > site->max_hold_ns) {
+            __atomic_store_n(&site->max_hold_ns, ns, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+}
+
+// takes the lock, timing the wait if another thread has it, a traced game's thread gets a span for the wait
+void lockprof_lock_at(lockprof_mutex_t* lock, const char* where, const char* func) {
+    int enabled = __atomic_load_n(&lockprof_enabled, __ATOMIC_RELAXED);
+    if (!enabled && trace_id == 0) {
+        pthread_mutex_lock(&lock->mutex);
+        lock->held_ns = 0;
+        return;
+    }
+    uint64_t start = latency_now();
+    int contended = pthread_mutex_trylock(&lock->mutex) != 0;
+    uint64_t now = start;
+    if (contended) {
+        pthread_mutex_lock(&lock->mutex);
+        now = latency_now();
+        trace_span("lock wait", lock->name, start, now);
+    }
+    if (!enabled) {
+        lock->held_ns = 0;
+        return;
+    }
+    start_hold(lock, where, func, contended, now - start, now);
+}
+
+// takes the lock if nobody has it (returns 1 if it was taken, 0 if it is held)
+int lockprof_trylock_at(lockprof_mutex_t* lock, const char* where, const char* func) {
+    int enabled = __atomic_load_n(&lockprof_enabled, __ATOMIC_RELAXED);
+    if (pthread_mutex_trylock(&lock->mutex) != 0) {
+        lockprof_stats_t* stats = enabled ? __atomic_load_n(&lock->stats, __ATOMIC_ACQUIRE) : NULL;
+        if (stats != NULL) {
+            __atomic_fetch_add(&stats->trylock_failed, 1, __ATOMIC_RELAXED);
+        }
+        return 0;
+    }
+    if (!enabled) {
+        lock->held_ns = 0;
+        return 1;
+    }
+    start_hold(lock, where, func, 0, 0, latency_now());
+    return 1;
+}
+
+void lockprof_unlock_at(lockprof_mutex_t* lock) {
+    if (lock->held_ns != 0) {
+        end_hold(lock);
+    }
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+// waits on a condition, the time asleep isn't counted as held, the hold after it goes to the same call site
+int lockprof_cond_timedwait_at(pthread_cond_t* cond, lockprof_mutex_t* lock, const struct timespec* deadline) {
+    int profiled = lock->held_ns != 0;
+    if (profiled) {
+        end_hold(lock);
+    }
+    int result = pthread_cond_timedwait(cond, &lock->mutex, deadline);
+    if (profiled && __atomic_load_n(&lockprof_enabled, __ATOMIC_RELAXED)) {
+        uint64_t now = latency_now();
+        lock->held_ns = now ? now : 1;
+    }
+    return result;
+}
+
+// turns profiling on or off, locks held at the time are profiled from the next time they are taken
+void lockprof_enable(int enabled) {
+    __atomic_store_n(&lockprof_enabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+// starts the counts over, each lock clears its own the next time it is held
+void lockprof_reset(void) {
+    __atomic_fetch_add(&epoch, 1, __ATOMIC_RELAXED);
+}
+
+// adds a histogram being written to into merged
+static void add_histogram(latency_histogram_t* merged, const latency_histogram_t* histogram) {
+    uint64_t count = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        uint64_t value = __atomic_load_n(&histogram->buckets[bucket], __ATOMIC_RELAXED);
+        merged->buckets[bucket] += value;
+        count += value;
+    }
+    merged->count += count;
+    merged->sum_ns += __atomic_load_n(&histogram->sum_ns, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+    merged->max_ns = max > merged->max_ns ? max : merged->max_ns;
+}
+
+// adds one lock's call sites into merged, a site is the same one in every lock with its file and line
+static void add_sites(lockprof_site_t* merged, const lockprof_site_t* sites) {
+    for (int i = 0; i < LOCKPROF_SITES; i++) {
+        const char* where = __atomic_load_n(&sites[i].where, __ATOMIC_ACQUIRE);
+        if (where == NULL) {
+            return;
+        }
+        int slot = 0;
+        while (slot < LOCKPROF_SITES && merged[slot].where != NULL && strcmp(merged[slot].where, where) != 0) {
+            slot++;
+        }
+        if (slot == LOCKPROF_SITES) {
+            continue;
+        }
+        merged[slot].where = where;
+        merged[slot].func = sites[i].func;
+        merged[slot].holds += __atomic_load_n(&sites[i].holds, __ATOMIC_RELAXED);
+        merged[slot].hold_ns += __atomic_load_n(&sites[i].hold_ns, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&sites[i].max_hold_ns, __ATOMIC_RELAXED);
+        merged[slot].max_hold_ns = max > merged[slot].max_hold_ns ? max : merged[slot].max_hold_ns;
+    }
+}
+
+static int longest_hold_first(const void* a, const void* b) {
+    // unused sites go last
+    if (((const lockprof_site_t*) a)->where == NULL || ((const lockprof_site_t*) b)->where == NULL) {
+        return (((const lockprof_site_t*) a)->where == NULL) - (((const lockprof_site_t*) b)->where == NULL);
+    }
+    uint64_t max_a = ((const lockprof_site_t*) a)->max_hold_ns;
+    uint64_t max_b = ((const lockprof_site_t*) b)->max_hold_ns;
+    return max_a < max_b ? 1 : (max_a > max_b ? -1 : 0);
+}
+
+// prints every lock held since profiling was turned on (or reset), locks of the same name (like the journal's segments) added up:
+// how often it was taken and had to wait, wait and hold percentiles in us, then the call sites that held it longest
+void lockprof_report(FILE* out) {
+    int count = __atomic_load_n(&registered, __ATOMIC_ACQUIRE);
+    count = count > LOCKPROF_MAX_LOCKS ? LOCKPROF_MAX_LOCKS : count;
+    unsigned current = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+    lockprof_stats_t* merged = malloc(sizeof(lockprof_stats_t));
+    char* done = calloc(count + 1, 1);
+    if (merged == NULL || done == NULL) {
+        perror("lockprof_report");
+        free(merged);
+        free(done);
+        return;
+    }
+    fprintf(out, "Locks (us, profiling %s):        acquired contended   wait p50   wait p99   wait max   hold p50   hold p99   hold max\n",
+        __atomic_load_n(&lockprof_enabled, __ATOMIC_RELAXED) ? "on" : "off");
+    for (int first = 0; first < count; first++) {
+        lockprof_stats_t* stats = __atomic_load_n(&registry[first], __ATOMIC_ACQUIRE);
+        if (done[first] || stats == NULL) {
+            continue;
+        }
+        memset(merged, 0, sizeof(lockprof_stats_t));
+        int locks = 0;
+        for (int other = first; other < count; other++) {
+            lockprof_stats_t* same = __atomic_load_n(&registry[other], __ATOMIC_ACQUIRE);
+            if (done[other] || same == NULL || strcmp(same->name, stats->name) != 0) {
+                continue;
+            }
+            done[other] = 1;
+            if (__atomic_load_n(&same->epoch, __ATOMIC_ACQUIRE) != current) {
+                continue;
+            }
+            locks++;
+            merged->acquired += __atomic_load_n(&same->acquired, __ATOMIC_RELAXED);
+            merged->contended += __atomic_load_n(&same->contended, __ATOMIC_RELAXED);
+            merged->trylock_failed += __atomic_load_n(&same->trylock_failed, __ATOMIC_RELAXED);
+            add_histogram(&merged->wait, &same->wait);
+            add_histogram(&merged->hold, &same->hold);
+            add_sites(merged->sites, same->sites);
+        }
+        if (locks == 0) {
+            continue;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), locks > 1 ? "%s (%d locks)" : "%s", stats->name, locks);
+        fprintf(out, "    %-32s %9llu %9llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, (unsigned long long) merged->acquired,
+            (unsigned long long) (merged->contended + merged->trylock_failed), latency_percentile(&merged->wait, 50) / 1e3,
+            latency_percentile(&merged->wait, 99) / 1e3, merged->wait.max_ns / 1e3, latency_percentile(&merged->hold, 50) / 1e3,
+            latency_percentile(&merged->hold, 99) / 1e3, merged->hold.max_ns / 1e3);
+        qsort(merged->sites, LOCKPROF_SITES, sizeof(lockprof_site_t), longest_hold_first);
+        for (int i = 0; i < LOCKPROF_REPORT_SITES && merged->sites[i].where != NULL; i++) {
+            lockprof_site_t* site = &merged->sites[i];
+            fprintf(out, "        held longest by %s %s: %llu holds, mean %.1f, max %.1f\n", site->where, site->func,
+                (unsigned long long) site->holds, site->holds ? site->hold_ns / 1e3 / site->holds : 0.0, site->max_hold_ns / 1e3);
+        }
+    }
+    free(merged);
+    free(done);
+}
@@ -0,0 +1,73 @@
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+#include "latency.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// most locks profiled at once (every journal segment has its own), locks past it are taken without being profiled
+#define LOCKPROF_MAX_LOCKS 1024
+// call sites kept per lock, holds from sites past it are only in the histograms
+#define LOCKPROF_SITES 16
+// call sites listed per lock in a report, longest hold first
+#define LOCKPROF_REPORT_SITES 3
+
+// where a lock was taken: "file.c:123" and the function
+typedef struct lockprof_site {
+    const char* where;
+    const char* func;
+    uint64_t holds;
+    uint64_t hold_ns;
+    uint64_t max_hold_ns;
+} lockprof_site_t;
+
+// the counts of one lock, only written with the lock held so they take no atomic adds (but for trylock_failed)
+// a report reads them with relaxed loads while they change, and they are kept after the lock is destroyed
+typedef struct lockprof_stats {
+    const char* name;
+    unsigned epoch;               // the reset they were last cleared at, cleared by the next holder when it is behind
+    uint64_t acquired;
+    uint64_t contended;           // a lock that had to wait because another thread held it
+    uint64_t trylock_failed;      // trylocks that found it held, counted without holding it
+    lockprof_site_t sites[LOCKPROF_SITES];
+    latency_histogram_t wait;
+    latency_histogram_t hold;
+} lockprof_stats_t;
+
+// a pthread mutex that records how it is used while profiling is on, and costs a branch more than the mutex while it is off
+typedef struct lockprof_mutex {
+    pthread_mutex_t mutex;
+    const char* name;
+    lockprof_stats_t* stats;      // allocated by the first holder after profiling is turned on
+    uint64_t held_ns;             // latency_now when the holder took it, 0 when it isn't being profiled
+    const char* where;
+    const char* func;
+} lockprof_mutex_t;
+
+#define LOCKPROF_MUTEX_INITIALIZER(name) {PTHREAD_MUTEX_INITIALIZER, (name), NULL, 0, NULL, NULL}
+
+#define LOCKPROF_STRING(x) #x
+#define LOCKPROF_LINE(x) LOCKPROF_STRING(x)
+#define LOCKPROF_WHERE __FILE__ ":" LOCKPROF_LINE(__LINE__)
+
+// use these rather than the _at functions so every hold knows where it was taken
+#define lockprof_lock(lock) lockprof_lock_at((lock), LOCKPROF_WHERE, __func__)
+#define lockprof_trylock(lock) lockprof_trylock_at((lock), LOCKPROF_WHERE, __func__)
+#define lockprof_unlock(lock) lockprof_unlock_at(lock)
+#define lockprof_cond_timedwait(cond, lock, deadline) lockprof_cond_timedwait_at((cond), (lock), (deadline))
+
+extern int lockprof_enabled;
+
+int lockprof_init(lockprof_mutex_t* lock, const char* name);
+void lockprof_destroy(lockprof_mutex_t* lock);
+void lockprof_lock_at(lockprof_mutex_t* lock, const char* where, const char* func);
+int lockprof_trylock_at(lockprof_mutex_t* lock, const char* where, const char* func);
+void lockprof_unlock_at(lockprof_mutex_t* lock);
+int lockprof_cond_timedwait_at(pthread_cond_t* cond, lockprof_mutex_t* lock, const struct timespec* deadline);
+void lockprof_enable(int enabled);
+void lockprof_reset(void);
+void lockprof_report(FILE* out);
+
+#endif
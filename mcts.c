@@ -0,0 +1,319 @@
+// NOTE: must use option -pthread when compiling!
+#define _POSIX_C_SOURCE 200809L
+#include "mcts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+// a leaf is expanded once it has been visited this many times, before that it only gets playouts
+#define EXPAND_AFTER 2
+// exploration constant of UCT, scores are scaled to 0..1
+#define EXPLORATION 1.0
+// candidate moves are the empty cells at most this far from a stone
+#define NEIGHBOURHOOD 2
+
+// data to be sent to worker threads
+typedef struct mcts_worker {
+    pthread_t tid;
+    mcts_t* mcts;
+    const mnk_board_t* root_board;
+    char root_role;
+    struct timespec deadline;
+    uint32_t rng;
+    long playouts;
+} mcts_worker_t;
+
+// sets up the arena (returns 1 on success, 0 if memory ran out)
+int mcts_init(mcts_t* mcts, int capacity) {
+    mcts->nodes = malloc(sizeof(mcts_node_t) * capacity);
+    if (mcts->nodes == NULL) {
+        return 0;
+    }
+    mcts->capacity = capacity;
+    mcts->used = 0;
+    return 1;
+}
+
+void mcts_free(mcts_t* mcts) {
+    free(mcts->nodes);
+    mcts->nodes = NULL;
+}
+
+// xorshift, returns a number in [0, n)
+static uint32_t worker_random(mcts_worker_t* worker, uint32_t n) {
+    uint32_t r = worker->rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    worker->rng = r;
+    return r % n;
+}
+
+static int deadline_passed(const struct timespec* deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+static void init_node(mcts_node_t* node, int move, int terminal) {
+    node->first_child = -1;
+    node->num_children = 0;
+    node->move = move;
+    node->visits = 0;
+    node->score = 0;
+    node->expanding = 0;
+    node->terminal = terminal;
+}
+
+// checks if a cell has a stone within NEIGHBOURHOOD (1 if yes, else 0)
+static int near_stone(const mnk_board_t* board, int row, int col) {
+    for (int r = row - NEIGHBOURHOOD; r <= row + NEIGHBOURHOOD; r++) {
+        for (int c = col - NEIGHBOURHOOD; c <= col + NEIGHBOURHOOD; c++) {
+            if (r >= 0 && r < board->rows && c >= 0 && c < board->cols && board->str[r * board->cols + c] != '.') {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// gives a node one child per candidate move, only one thread gets here per node (returns 1 on success, 0 if the arena is full)
+static int expand(mcts_t* mcts, int index, const mnk_board_t* board, char role) {
+    int total = board->rows * board->cols;
+    int16_t moves[MNK_MAX_SIDE * MNK_MAX_SIDE];
+    int count = 0;
+    for (int cell = 0; cell < total; cell++) {
+        if (board->str[cell] == '.' && (board->filled == 0 || near_stone(board, cell / board->cols, cell % board->cols))) {
+            moves[count++] = cell;
+        }
+    }
+    // an empty board has no stones to be near, start in the middle
+    if (board->filled == 0) {
+        count = 1;
+        moves[0] = (board->rows / 2) * board->cols + board->cols / 2;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    int first = __atomic_fetch_add(&mcts->used, count, __ATOMIC_RELAXED);
+    if (first + count > mcts->capacity) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        int row = moves[i] / board->cols + 1;
+        int col = moves[i] % board->cols + 1;
+        int terminal = 0;
+        if (mnk_would_win(board, row, col, role)) {
+            terminal = 2;
+        }
+        else if (board->filled + 1 == total) {
+            terminal = 1;
+        }
+        init_node(&mcts->nodes[first + i], moves[i], terminal);
+    }
+    mcts->nodes[index].num_children = count;
+    // publish the children last so other threads never see half of them
+    __atomic_store_n(&mcts->nodes[index].first_child, first, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// picks the child with the best UCT value, a child that wins on the spot is always taken
+static int select_child(mcts_t* mcts, mcts_node_t* node) {
+    int first = node->first_child;
+    double log_parent = log((double) __atomic_load_n(&node->visits, __ATOMIC_RELAXED) + 1);
+    int best = first;
+    double best_value = -1;
+    for (int i = first; i < first + node->num_children; i++) {
+        mcts_node_t* child = &mcts->nodes[i];
+        if (child->terminal == 2) {
+            return i;
+        }
+        int visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+        if (visits == 0) {
+            return i;
+        }
+        int score = __atomic_load_n(&child->score, __ATOMIC_RELAXED);
+        double value = score / (2.0 * visits) + EXPLORATION * sqrt(log_parent / visits);
+        if (value > best_value) {
+            best_value = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// plays random moves until the game ends, returns the winner's role or '.' for a draw
+static char playout(mcts_worker_t* worker, mnk_board_t* board, char role) {
+    int total = board->rows * board->cols;
+    int16_t empties[MNK_MAX_SIDE * MNK_MAX_SIDE];
+    int count = 0;
+    for (int cell = 0; cell < total; cell++) {
+        if (board->str[cell] == '.') {
+            empties[count++] = cell;
+        }
+    }
+    while (count > 0) {
+        int i = worker_random(worker, count);
+        int cell = empties[i];
+        empties[i] = empties[--count];
+        int row = cell / board->cols + 1;
+        int col = cell % board->cols + 1;
+        if (mnk_would_win(board, row, col, role)) {
+            return role;
+        }
+        mnk_place(board, row, col, role);
+        role = (role == 'X') ? 'O' : 'X';
+    }
+    return '.';
+}
+
+// one select, expand, playout and backup pass from the root
+static void iterate(mcts_worker_t* worker) {
+    mcts_t* mcts = worker->mcts;
+    char cells[MNK_MAX_SIDE * MNK_MAX_SIDE + 1];
+    mnk_board_t board = *worker->root_board;
+    memcpy(cells, worker->root_board->str, board.rows * board.cols + 1);
+    board.str = cells;
+
+    int path[MNK_MAX_SIDE * MNK_MAX_SIDE + 1];
+    int depth = 0;
+    int index = 0;
+    char role = worker->root_role;
+    path[depth++] = 0;
+    __atomic_fetch_add(&mcts->nodes[0].visits, 1, __ATOMIC_RELAXED);
+
+    // result for the player who made the move into the last node on the path (2 win, 1 draw, 0 loss)
+    int result;
+    while (1) {
+        mcts_node_t* node = &mcts->nodes[index];
+        if (node->terminal != 0) {
+            result = node->terminal == 2 ? 2 : 1;
+            break;
+        }
+        if (__atomic_load_n(&node->first_child, __ATOMIC_ACQUIRE) < 0) {
+            int expanded = 0;
+            if (__atomic_load_n(&node->visits, __ATOMIC_RELAXED) >= EXPAND_AFTER && __atomic_exchange_n(&node->expanding, 1, __ATOMIC_ACQ_REL) == 0) {
+                expanded = expand(mcts, index, &board, role);
+            }
+            if (!expanded) {
+                // the player who moved into this node is the one that is not to move
+                char winner = playout(worker, &board, role);
+                result = (winner == '.') ? 1 : (winner == role ? 0 : 2);
+                break;
+            }
+        }
+        index = select_child(mcts, node);
+        mcts_node_t* child = &mcts->nodes[index];
+        // counting the visit now is the virtual loss, other threads see a worse score until the result is added
+        __atomic_fetch_add(&child->visits, 1, __ATOMIC_RELAXED);
+        mnk_place(&board, child->move / board.cols + 1, child->move % board.cols + 1, role);
+        role = (role == 'X') ? 'O' : 'X';
+        path[depth++] = index;
+    }
+
+    // a pass that ends on a known result counts as a playout too, it is just a very short one
+    worker->playouts++;
+
+    // back up the result, flipping it at every level since the players alternate
+    for (int i = depth - 1; i >= 0; i--) {
+        __atomic_fetch_add(&mcts->nodes[path[i]].score, result, __ATOMIC_RELAXED);
+        result = 2 - result;
+    }
+}
+
+static void* run_worker(void* arg) {
+    mcts_worker_t* worker = arg;
+    long iterations = 0;
+    while (1) {
+        // checking the clock every few iterations is enough, one iteration is far shorter than the budget
+        if (iterations % 16 == 0 && deadline_passed(&worker->deadline)) {
+            break;
+        }
+        iterate(worker);
+        iterations++;
+    }
+    return NULL;
+}
+
+// searches for role's best move on board for budget_ms using threads workers that share one tree
+// (returns 1 and sets row and col on success, 0 if there is no move)
+int mcts_search(mcts_t* mcts, const mnk_board_t* board, char role, int budget_ms, int threads, uint32_t seed, int* row, int* col, mcts_stats_t* stats) {
+    if (board->filled == board->rows * board->cols) {
+        return 0;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > MCTS_MAX_THREADS) {
+        threads = MCTS_MAX_THREADS;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec deadline = start;
+    deadline.tv_sec += budget_ms / 1000;
+    deadline.tv_nsec += (budget_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // the tree is thrown away between moves, the arena is just reset
+    mcts->used = 1;
+    init_node(&mcts->nodes[0], -1, 0);
+    mcts->nodes[0].expanding = 1;
+    if (!expand(mcts, 0, board, role)) {
+        return 0;
+    }
+
+    mcts_worker_t workers[MCTS_MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        workers[i].mcts = mcts;
+        workers[i].root_board = board;
+        workers[i].root_role = role;
+        workers[i].deadline = deadline;
+        workers[i].rng = (seed ^ (uint32_t) (i * 0x9E3779B9u)) | 1;
+        workers[i].playouts = 0;
+    }
+    // the calling thread is worker 0, the others get their own threads for the length of the search
+    int started = 1;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i].tid, NULL, run_worker, &workers[i]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        started++;
+    }
+    run_worker(&workers[0]);
+    long playouts = workers[0].playouts;
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i].tid, NULL);
+        playouts += workers[i].playouts;
+    }
+
+    // play the most visited move, or a move that wins right away
+    mcts_node_t* root = &mcts->nodes[0];
+    int best = root->first_child;
+    for (int i = root->first_child; i < root->first_child + root->num_children; i++) {
+        if (mcts->nodes[i].terminal == 2) {
+            best = i;
+            break;
+        }
+        if (mcts->nodes[i].visits > mcts->nodes[best].visits) {
+            best = i;
+        }
+    }
+    *row = mcts->nodes[best].move / board->cols + 1;
+    *col = mcts->nodes[best].move % board->cols + 1;
+
+    if (stats != NULL) {
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stats->playouts = playouts;
+        stats->threads = started;
+        stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    }
+    return 1;
+}
@@ -0,0 +1,39 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <stdint.h>
+#include "mnk.h"
+
+// nodes in the arena of one engine, allocated once and reused for every move
+#define MCTS_DEFAULT_NODES (1 << 18)
+#define MCTS_MAX_THREADS 16
+
+// a tree node, children of a node are stored next to each other in the arena
+typedef struct mcts_node {
+    int32_t first_child;  // index of the first child, -1 until the node is expanded
+    int16_t num_children;
+    int16_t move;         // cell index of the move that led here
+    int32_t visits;       // bumped on the way down, which doubles as the virtual loss until the result comes back
+    int32_t score;        // 2 per win and 1 per draw for the player who made the move
+    int32_t expanding;    // set by the one thread allowed to expand the node
+    int32_t terminal;     // 2 if the move won, 1 if it filled the board, else 0
+} mcts_node_t;
+
+typedef struct mcts {
+    mcts_node_t* nodes;
+    int capacity;
+    int used;
+} mcts_t;
+
+// what a search did, for the bot's log line
+typedef struct mcts_stats {
+    long playouts;
+    int threads;
+    double seconds;
+} mcts_stats_t;
+
+int mcts_init(mcts_t* mcts, int capacity);
+void mcts_free(mcts_t* mcts);
+int mcts_search(mcts_t* mcts, const mnk_board_t* board, char role, int budget_ms, int threads, uint32_t seed, int* row, int* col, mcts_stats_t* stats);
+
+#endif
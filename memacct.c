@@ -0,0 +1,140 @@
+// _GNU_SOURCE for malloc_usable_size
+#define _GNU_SOURCE
+#include "memacct.h"
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the padding makes each subsystem a whole line, aligning the array makes them start on one
+static memacct_counts_t counts[MEMACCT_SUBSYSTEMS] __attribute__((aligned(64)));
+static memacct_sizes_t footprints[MEMACCT_FOOTPRINTS];
+
+static const char* subsystem_names[MEMACCT_SUBSYSTEMS] = {"connection", "game", "message", "name", "bot", "log"};
+static const char* footprint_names[MEMACCT_FOOTPRINTS] = {"waiting_player", "active_game"};
+
+// raises value to at least candidate, another thread raising it at the same time can't lower it
+static void raise_to(int64_t* value, int64_t candidate) {
+    int64_t current = __atomic_load_n(value, __ATOMIC_RELAXED);
+    while (candidate > current && !__atomic_compare_exchange_n(value, &current, candidate, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// the bytes an allocation holds, 0 for NULL
+size_t memacct_size(void* ptr) {
+    return ptr != NULL ? malloc_usable_size(ptr) : 0;
+}
+
+// counts an allocation made elsewhere (like a board's cells or a memstream's buffer) in subsystem, NULL counts nothing
+void memacct_track(memacct_subsystem_t subsystem, void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    memacct_counts_t* subsystem_counts = &counts[subsystem];
+    int64_t live = __atomic_add_fetch(&subsystem_counts->live_bytes, (int64_t) malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&subsystem_counts->live_objects, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&subsystem_counts->allocations, 1, __ATOMIC_RELAXED);
+    raise_to(&subsystem_counts->peak_bytes, live);
+}
+
+// stops counting an allocation about to be freed elsewhere, it must have been counted in the same subsystem
+void memacct_untrack(memacct_subsystem_t subsystem, void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    __atomic_sub_fetch(&counts[subsystem].live_bytes, (int64_t) malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counts[subsystem].live_objects, 1, __ATOMIC_RELAXED);
+}
+
+void* memacct_malloc(memacct_subsystem_t subsystem, size_t size) {
+    void* ptr = malloc(size);
+    memacct_track(subsystem, ptr);
+    return ptr;
+}
+
+void* memacct_calloc(memacct_subsystem_t subsystem, size_t count, size_t size) {
+    void* ptr = calloc(count, size);
+    memacct_track(subsystem, ptr);
+    return ptr;
+}
+
+// grows or shrinks an allocation counted in subsystem, it is still counted there (and unchanged) if realloc fails
+void* memacct_realloc(memacct_subsystem_t subsystem, void* ptr, size_t size) {
+    size_t old_bytes = memacct_size(ptr);
+    void* grown = realloc(ptr, size);
+    if (grown == NULL) {
+        return NULL;
+    }
+    if (ptr != NULL) {
+        __atomic_sub_fetch(&counts[subsystem].live_bytes, (int64_t) old_bytes, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&counts[subsystem].live_objects, 1, __ATOMIC_RELAXED);
+    }
+    memacct_track(subsystem, grown);
+    return grown;
+}
+
+char* memacct_strdup(memacct_subsystem_t subsystem, const char* string) {
+    char* copy = strdup(string);
+    memacct_track(subsystem, copy);
+    return copy;
+}
+
+void memacct_free(memacct_subsystem_t subsystem, void* ptr) {
+    memacct_untrack(subsystem, ptr);
+    free(ptr);
+}
+
+// reads a subsystem's counts while threads change them, each count is exact but they may be from moments apart
+void memacct_read(memacct_subsystem_t subsystem, memacct_counts_t* read) {
+    read->live_bytes = __atomic_load_n(&counts[subsystem].live_bytes, __ATOMIC_RELAXED);
+    read->live_objects = __atomic_load_n(&counts[subsystem].live_objects, __ATOMIC_RELAXED);
+    read->peak_bytes = __atomic_load_n(&counts[subsystem].peak_bytes, __ATOMIC_RELAXED);
+    read->allocations = __atomic_load_n(&counts[subsystem].allocations, __ATOMIC_RELAXED);
+}
+
+const char* memacct_name(memacct_subsystem_t subsystem) {
+    return subsystem_names[subsystem];
+}
+
+// adds what one waiting player or one game held to the sizes seen so far
+void memacct_record_footprint(memacct_footprint_t footprint, size_t bytes) {
+    __atomic_add_fetch(&footprints[footprint].count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&footprints[footprint].bytes, bytes, __ATOMIC_RELAXED);
+    raise_to((int64_t*) &footprints[footprint].max_bytes, (int64_t) bytes);
+}
+
+void memacct_read_footprint(memacct_footprint_t footprint, memacct_sizes_t* sizes) {
+    sizes->count = __atomic_load_n(&footprints[footprint].count, __ATOMIC_RELAXED);
+    sizes->bytes = __atomic_load_n(&footprints[footprint].bytes, __ATOMIC_RELAXED);
+    sizes->max_bytes = __atomic_load_n(&footprints[footprint].max_bytes, __ATOMIC_RELAXED);
+}
+
+const char* memacct_footprint_name(memacct_footprint_t footprint) {
+    return footprint_names[footprint];
+}
+
+// prints every subsystem's live and peak bytes and objects, then the mean and largest size of a waiting player and of a game
+// the peak of the total is the total of the peaks, the subsystems didn't all peak at once so the real one is lower
+void memacct_report(FILE* out) {
+    memacct_counts_t total;
+    memset(&total, 0, sizeof(total));
+    fprintf(out, "Memory (usable bytes of each allocation):\n");
+    fprintf(out, "    %-12s %12s %10s %12s %12s\n", "subsystem", "live bytes", "objects", "peak bytes", "allocations");
+    for (int subsystem = 0; subsystem < MEMACCT_SUBSYSTEMS; subsystem++) {
+        memacct_counts_t read;
+        memacct_read(subsystem, &read);
+        fprintf(out, "    %-12s %12lld %10lld %12lld %12llu\n", subsystem_names[subsystem], (long long) read.live_bytes, (long long) read.live_objects,
+            (long long) read.peak_bytes, (unsigned long long) read.allocations);
+        total.live_bytes += read.live_bytes;
+        total.live_objects += read.live_objects;
+        total.peak_bytes += read.peak_bytes;
+        total.allocations += read.allocations;
+    }
+    fprintf(out, "    %-12s %12lld %10lld %12lld %12llu\n", "total", (long long) total.live_bytes, (long long) total.live_objects,
+        (long long) total.peak_bytes, (unsigned long long) total.allocations);
+    for (int footprint = 0; footprint < MEMACCT_FOOTPRINTS; footprint++) {
+        memacct_sizes_t sizes;
+        memacct_read_footprint(footprint, &sizes);
+        fprintf(out, "    a %s: %.0f bytes on average, %llu at most, over %llu\n", footprint == MEMACCT_WAITING_PLAYER ? "waiting player" : "game",
+            sizes.count ? (double) sizes.bytes / sizes.count : 0.0, (unsigned long long) sizes.max_bytes, (unsigned long long) sizes.count);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef MEMACCT_H
+#define MEMACCT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// what the server's heap is spent on
+typedef enum {
+    MEMACCT_CONNECTION,     // a game's message buffers, one per player
+    MEMACCT_GAME,           // games_list nodes, the game threads' copies and their boards' cells
+    MEMACCT_MESSAGE,        // a game's parsed message structs, one per player
+    MEMACCT_NAME,           // names copied out of PLAY messages during a handshake
+    MEMACCT_BOT,            // the search arenas bots share, allocated when first borrowed and kept
+    MEMACCT_LOG,            // admin answers and snapshots, metrics scrape bodies
+    MEMACCT_SUBSYSTEMS
+} memacct_subsystem_t;
+
+// what one of the things the server holds costs, measured when it is at its biggest
+typedef enum {
+    MEMACCT_WAITING_PLAYER, // a player waiting for an opponent: their games_list node
+    MEMACCT_ACTIVE_GAME,    // a game being played: its node, the thread's copy, buffers, messages, board and bot tree
+    MEMACCT_FOOTPRINTS
+} memacct_footprint_t;
+
+// one subsystem's counts, on a cache line of its own since every thread allocates
+// bytes are what malloc_usable_size says an allocation holds, so they include malloc's rounding up but not its headers
+typedef struct memacct_counts {
+    int64_t live_bytes;
+    int64_t live_objects;
+    int64_t peak_bytes;           // the most live_bytes has been
+    uint64_t allocations;
+    char padding[32];
+} memacct_counts_t;
+
+typedef struct memacct_sizes {
+    uint64_t count;
+    uint64_t bytes;               // all of them added up, bytes / count is the mean
+    uint64_t max_bytes;
+} memacct_sizes_t;
+
+void* memacct_malloc(memacct_subsystem_t subsystem, size_t size);
+void* memacct_calloc(memacct_subsystem_t subsystem, size_t count, size_t size);
+void* memacct_realloc(memacct_subsystem_t subsystem, void* ptr, size_t size);
+char* memacct_strdup(memacct_subsystem_t subsystem, const char* string);
+void memacct_free(memacct_subsystem_t subsystem, void* ptr);
+void memacct_track(memacct_subsystem_t subsystem, void* ptr);
+void memacct_untrack(memacct_subsystem_t subsystem, void* ptr);
+size_t memacct_size(void* ptr);
+void memacct_read(memacct_subsystem_t subsystem, memacct_counts_t* counts);
+const char* memacct_name(memacct_subsystem_t subsystem);
+void memacct_record_footprint(memacct_footprint_t footprint, size_t bytes);
+void memacct_read_footprint(memacct_footprint_t footprint, memacct_sizes_t* sizes);
+const char* memacct_footprint_name(memacct_footprint_t footprint);
+void memacct_report(FILE* out);
+
+#endif
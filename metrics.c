@@ -0,0 +1,304 @@
+// sched_getcpu is a GNU extension
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "latency.h"
+#include "memacct.h"
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// bytes of a request read before answering, only the request line matters
+#define REQUEST_BYTES 2048
+// ms the scrape thread waits in poll before checking if the server is still running
+#define POLL_MS 500
+
+metrics_server_t metrics_server = {-1};
+
+// every CPU's row, a scrape adds up the rows and nothing else ever reads them
+static metrics_row_t rows[METRICS_CPUS] __attribute__((aligned(64)));
+static volatile int* server_running = NULL;
+
+static const char* invalid_reasons[INVALID_REASONS] = {
+    "malformed message or connection lost", "name is invalid", "variant is invalid", "name is in use", "invalid move",
+    "invalid role", "invalid field", "invalid command", "invalid message", "no game to resume", "server is draining", "other"
+};
+
+// adds to a counter in the calling CPU's row, a thread moved to another CPU between finding its row and the add is still counted once
+void metrics_add(metrics_counter_t counter, int64_t value) {
+    int cpu = sched_getcpu();
+    metrics_row_t* row = &rows[(cpu < 0 ? 0 : cpu) % METRICS_CPUS];
+    __atomic_fetch_add(&row->counters[counter], value, __ATOMIC_RELAXED);
+}
+
+// a counter over every CPU
+int64_t metrics_sum(metrics_counter_t counter) {
+    int64_t sum = 0;
+    for (int cpu = 0; cpu < METRICS_CPUS; cpu++) {
+        sum += __atomic_load_n(&rows[cpu].counters[counter], __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+// counts an INVL by the reason in its third field
+void metrics_invalid(const char* reason) {
+    int index = 0;
+    while (index < INVALID_OTHER && strcmp(invalid_reasons[index], reason) != 0) {
+        index++;
+    }
+    metrics_add(METRIC_INVALID + index, 1);
+}
+
+// adds an ended game's syscalls, bytes and moves
+void metrics_game_syscalls(const sysacct_t* account, int moves) {
+    for (int phase = 0; phase < SYSACCT_PHASES; phase++) {
+        for (int call = 0; call < SYSACCT_CALLS; call++) {
+            if (account->calls[phase][call] > 0) {
+                metrics_add(METRIC_GAME_SYSCALLS + phase * SYSACCT_CALLS + call, account->calls[phase][call]);
+            }
+        }
+        metrics_add(METRIC_GAME_BYTES_IN + phase, account->bytes_in[phase]);
+        metrics_add(METRIC_GAME_BYTES_OUT + phase, account->bytes_out[phase]);
+    }
+    metrics_add(METRIC_GAME_MOVES, moves);
+}
+
+// writes one counter or gauge with its help and type lines
+static void write_metric(FILE* out, const char* name, const char* type, const char* help, double value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n", name, help, name, type, name, value);
+}
+
+// writes the latency phases as one histogram labelled by phase, with a bucket at every power of 2 ns from 1 us
+static void write_phases(FILE* out) {
+    latency_histogram_t merged;
+    fprintf(out, "# HELP ttt_phase_seconds Time spent in each phase of a connection.\n# TYPE ttt_phase_seconds histogram\n");
+    for (int phase = 0; phase < LATENCY_PHASES; phase++) {
+        latency_merge(phase, &merged);
+        const char* name = latency_phase_name(phase);
+        uint64_t below = 0;
+        for (int bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++) {
+            below += merged.buckets[bucket];
+            // the last bucket of a power of 2 ends just below the next one
+            uint64_t upper = latency_bucket_upper(bucket) + 1;
+            if ((bucket + 1) % LATENCY_SUB_BUCKETS == 0 && upper >= 1024) {
+                fprintf(out, "ttt_phase_seconds_bucket{phase=\"%s\",le=\"%.6g\"} %llu\n", name, upper / 1e9, (unsigned long long) below);
+            }
+        }
+        fprintf(out, "ttt_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", name, (unsigned long long) merged.count);
+        fprintf(out, "ttt_phase_seconds_sum{phase=\"%s\"} %.9f\n", name, merged.sum_ns / 1e9);
+        fprintf(out, "ttt_phase_seconds_count{phase=\"%s\"} %llu\n", name, (unsigned long long) merged.count);
+    }
+}
+
+// writes the syscalls and bytes of ended games by phase, and the syscalls a move costs over all of them
+static void write_game_syscalls(FILE* out) {
+    int64_t total = 0;
+    fprintf(out, "# HELP ttt_game_syscalls_total Syscalls made for games that ended, by phase and call.\n# TYPE ttt_game_syscalls_total counter\n");
+    for (int phase = 0; phase < SYSACCT_PHASES; phase++) {
+        for (int call = 0; call < SYSACCT_CALLS; call++) {
+            int64_t calls = metrics_sum(METRIC_GAME_SYSCALLS + phase * SYSACCT_CALLS + call);
+            total += calls;
+            fprintf(out, "ttt_game_syscalls_total{phase=\"%s\",call=\"%s\"} %lld\n", sysacct_phase_name(phase), sysacct_call_name(call), (long long) calls);
+        }
+    }
+    fprintf(out, "# HELP ttt_game_bytes_total Bytes read and written for games that ended, by phase.\n# TYPE ttt_game_bytes_total counter\n");
+    for (int phase = 0; phase < SYSACCT_PHASES; phase++) {
+        fprintf(out, "ttt_game_bytes_total{phase=\"%s\",direction=\"in\"} %lld\n", sysacct_phase_name(phase), (long long) metrics_sum(METRIC_GAME_BYTES_IN + phase));
+        fprintf(out, "ttt_game_bytes_total{phase=\"%s\",direction=\"out\"} %lld\n", sysacct_phase_name(phase), (long long) metrics_sum(METRIC_GAME_BYTES_OUT + phase));
+    }
+    int64_t moves = metrics_sum(METRIC_GAME_MOVES);
+    write_metric(out, "ttt_game_moves_total", "counter", "Moves played in games that ended.", moves);
+    write_metric(out, "ttt_game_syscalls_per_move", "gauge", "Syscalls of ended games over their moves.", moves > 0 ? (double) total / moves : 0.0);
+}
+
+// writes the heap bytes and objects of every subsystem and what a waiting player and a game hold on average
+static void write_memory(FILE* out) {
+    memacct_counts_t counts[MEMACCT_SUBSYSTEMS];
+    for (int subsystem = 0; subsystem < MEMACCT_SUBSYSTEMS; subsystem++) {
+        memacct_read(subsystem, &counts[subsystem]);
+    }
+    fprintf(out, "# HELP ttt_memory_live_bytes Heap bytes held, by subsystem.\n# TYPE ttt_memory_live_bytes gauge\n");
+    for (int subsystem = 0; subsystem < MEMACCT_SUBSYSTEMS; subsystem++) {
+        fprintf(out, "ttt_memory_live_bytes{subsystem=\"%s\"} %lld\n", memacct_name(subsystem), (long long) counts[subsystem].live_bytes);
+    }
+    fprintf(out, "# HELP ttt_memory_live_objects Heap allocations held, by subsystem.\n# TYPE ttt_memory_live_objects gauge\n");
+    for (int subsystem = 0; subsystem < MEMACCT_SUBSYSTEMS; subsystem++) {
+        fprintf(out, "ttt_memory_live_objects{subsystem=\"%s\"} %lld\n", memacct_name(subsystem), (long long) counts[subsystem].live_objects);
+    }
+    fprintf(out, "# HELP ttt_memory_peak_bytes Most heap bytes held at once, by subsystem.\n# TYPE ttt_memory_peak_bytes gauge\n");
+    for (int subsystem = 0; subsystem < MEMACCT_SUBSYSTEMS; subsystem++) {
+        fprintf(out, "ttt_memory_peak_bytes{subsystem=\"%s\"} %lld\n", memacct_name(subsystem), (long long) counts[subsystem].peak_bytes);
+    }
+    fprintf(out, "# HELP ttt_memory_footprint_bytes Mean heap bytes a waiting player or a game holds.\n# TYPE ttt_memory_footprint_bytes gauge\n");
+    for (int footprint = 0; footprint < MEMACCT_FOOTPRINTS; footprint++) {
+        memacct_sizes_t sizes;
+        memacct_read_footprint(footprint, &sizes);
+        fprintf(out, "ttt_memory_footprint_bytes{of=\"%s\"} %.0f\n", memacct_footprint_name(footprint), sizes.count ? (double) sizes.bytes / sizes.count : 0.0);
+    }
+}
+
+// writes every metric in the Prometheus text format
+void metrics_write(FILE* out, double games_per_second) {
+    write_metric(out, "ttt_connections_active", "gauge", "Player connections open.", metrics_sum(METRIC_CONNECTIONS_OPENED) - metrics_sum(METRIC_CONNECTIONS_CLOSED));
+    write_metric(out, "ttt_connections_total", "counter", "Player connections accepted.", metrics_sum(METRIC_CONNECTIONS_OPENED));
+    write_metric(out, "ttt_waiting_players", "gauge", "Players waiting for an opponent.", metrics_sum(METRIC_WAITING));
+    write_metric(out, "ttt_games_active", "gauge", "Games being played.", metrics_sum(METRIC_GAMES_ACTIVE));
+    write_metric(out, "ttt_games_started_total", "counter", "Games started.", metrics_sum(METRIC_GAMES_STARTED));
+    write_metric(out, "ttt_games_finished_total", "counter", "Games won, lost or drawn.", metrics_sum(METRIC_GAMES_FINISHED));
+    write_metric(out, "ttt_games_scrapped_total", "counter", "Games scrapped before they ended.", metrics_sum(METRIC_GAMES_SCRAPPED));
+    write_metric(out, "ttt_games_per_second", "gauge", "Games finished per second since the last scrape.", games_per_second);
+    write_metric(out, "ttt_turn_timeouts_total", "counter", "Reads that timed out waiting for a player's turn.", metrics_sum(METRIC_TURN_TIMEOUTS));
+    write_metric(out, "ttt_wait_timeouts_total", "counter", "Waiting players paired with a bot.", metrics_sum(METRIC_WAIT_TIMEOUTS));
+    write_metric(out, "ttt_games_unjournaled_total", "counter", "Games started without a journal segment, they can't be recovered.", metrics_sum(METRIC_GAMES_UNJOURNALED));
+    write_metric(out, "ttt_position_cache_hits_total", "counter", "Bot moves found in the position cache instead of searched.", metrics_sum(METRIC_POSCACHE_HITS));
+    write_metric(out, "ttt_position_cache_misses_total", "counter", "Bot moves looked up in the position cache and not found.", metrics_sum(METRIC_POSCACHE_MISSES));
+    write_metric(out, "ttt_messages_received_total", "counter", "Messages parsed from players.", metrics_sum(METRIC_MESSAGES_IN));
+    write_metric(out, "ttt_messages_sent_total", "counter", "Messages sent to players.", metrics_sum(METRIC_MESSAGES_OUT));
+    write_metric(out, "ttt_received_bytes_total", "counter", "Bytes read from players.", metrics_sum(METRIC_BYTES_IN));
+    write_metric(out, "ttt_sent_bytes_total", "counter", "Bytes written to players.", metrics_sum(METRIC_BYTES_OUT));
+    fprintf(out, "# HELP ttt_invalid_messages_total INVL messages sent by reason.\n# TYPE ttt_invalid_messages_total counter\n");
+    for (int reason = 0; reason < INVALID_REASONS; reason++) {
+        fprintf(out, "ttt_invalid_messages_total{reason=\"%s\"} %lld\n", invalid_reasons[reason], (long long) metrics_sum(METRIC_INVALID + reason));
+    }
+    write_game_syscalls(out);
+    write_memory(out);
+    write_phases(out);
+}
+
+// answers one scrape and closes its connection, anything but a GET gets a 405 (returns 1 on success, 0 if error)
+static int answer(metrics_server_t* server, int fd) {
+    char request[REQUEST_BYTES];
+    size_t length = 0;
+    // a scraper that connects and sends nothing can't hold the thread up
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+    while (length < sizeof(request) - 1) {
+        ssize_t bytes_read = read(fd, request + length, sizeof(request) - 1 - length);
+        // the socket has a timeout, so a profiler tick isn't restarted by SA_RESTART
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            break;
+        }
+        length += bytes_read;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+            break;
+        }
+    }
+    request[length] = '\0';
+
+    char* body = NULL;
+    size_t body_length = 0;
+    FILE* out = open_memstream(&body, &body_length);
+    if (out == NULL) {
+        perror("open_memstream");
+        return 0;
+    }
+    const char* status = "200 OK";
+    if (strncmp(request, "GET ", 4) != 0) {
+        status = "405 Method Not Allowed";
+    }
+    else {
+        uint64_t now = latency_now();
+        uint64_t finished = metrics_sum(METRIC_GAMES_FINISHED);
+        double seconds = (now - server->last_ns) / 1e9;
+        metrics_write(out, seconds > 0 ? (finished - server->last_finished) / seconds : 0.0);
+        server->last_finished = finished;
+        server->last_ns = now;
+    }
+    fclose(out);
+    memacct_track(MEMACCT_LOG, body);
+
+    char header[256];
+    int header_length = snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", status, body_length);
+    int ok = 1;
+    const char* parts[2] = {header, body};
+    size_t lengths[2] = {header_length, body_length};
+    for (int part = 0; part < 2 && ok; part++) {
+        size_t written = 0;
+        while (written < lengths[part]) {
+            ssize_t bytes_written = write(fd, parts[part] + written, lengths[part] - written);
+            if (bytes_written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_written <= 0) {
+                ok = 0;
+                break;
+            }
+            written += bytes_written;
+        }
+    }
+    memacct_free(MEMACCT_LOG, body);
+    return ok;
+}
+
+// answers scrapes one at a time until the server stops, a scrape only reads counters so no game thread ever waits for it
+static void* serve_scrapes(void* arg) {
+    metrics_server_t* server = arg;
+    while (*server_running) {
+        struct pollfd listener_poll;
+        listener_poll.fd = server->listener;
+        listener_poll.events = POLLIN;
+        if (poll(&listener_poll, 1, POLL_MS) <= 0) {
+            continue;
+        }
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR) {
+                perror("metrics accept");
+            }
+            continue;
+        }
+        answer(server, fd);
+        close(fd);
+    }
+    close(server->listener);
+    server->listener = -1;
+    return NULL;
+}
+
+// listens on the loopback address and starts the thread answering scrapes, the caller blocks the signals the thread must not get
+// (returns 1 on success, 0 if error)
+int metrics_start(metrics_server_t* server, const char* port, volatile int* running) {
+    struct addrinfo hint, *info;
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_family = AF_INET;
+    hint.ai_socktype = SOCK_STREAM;
+    int error = getaddrinfo("127.0.0.1", port, &hint, &info);
+    if (error) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(error));
+        return 0;
+    }
+    int sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    int reuse = 1;
+    if (sock < 0 || setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0
+        || bind(sock, info->ai_addr, info->ai_addrlen) < 0 || listen(sock, 8) < 0) {
+        perror("metrics listener");
+        if (sock >= 0) {
+            close(sock);
+        }
+        freeaddrinfo(info);
+        return 0;
+    }
+    freeaddrinfo(info);
+    server->listener = sock;
+    server->last_finished = 0;
+    server->last_ns = latency_now();
+    server_running = running;
+    error = pthread_create(&server->tid, NULL, serve_scrapes, server);
+    if (error != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(error));
+        close(sock);
+        server->listener = -1;
+        return 0;
+    }
+    pthread_detach(server->tid);
+    return 1;
+}
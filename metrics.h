@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "sysacct.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// port the server answers scrapes on, on the loopback address only (set by the optional fifth argument, -1 turns it off)
+#define METRICS_PORT "15090"
+// counters are kept per CPU, CPUs past this share rows
+#define METRICS_CPUS 64
+
+// why an INVL was sent, the reasons the server gives in its third field
+typedef enum metrics_invalid {
+    INVALID_MALFORMED,     // malformed message or connection lost
+    INVALID_NAME,          // name is invalid
+    INVALID_VARIANT,       // variant is invalid
+    INVALID_NAME_IN_USE,   // name is in use
+    INVALID_MOVE,          // invalid move
+    INVALID_ROLE,          // invalid role
+    INVALID_FIELD,         // invalid field
+    INVALID_COMMAND,       // invalid command
+    INVALID_FIRST_MESSAGE, // invalid message
+    INVALID_NO_GAME,       // no game to resume
+    INVALID_DRAINING,      // server is draining
+    INVALID_OTHER,
+    INVALID_REASONS
+} metrics_invalid_t;
+
+// what is counted, gauges go up and down and only their sum over every CPU means anything
+typedef enum metrics_counter {
+    METRIC_CONNECTIONS_OPENED,
+    METRIC_CONNECTIONS_CLOSED,
+    METRIC_WAITING,            // gauge: players waiting for an opponent
+    METRIC_GAMES_ACTIVE,       // gauge: game threads running
+    METRIC_GAMES_STARTED,
+    METRIC_GAMES_FINISHED,     // won, lost or drawn
+    METRIC_GAMES_SCRAPPED,
+    METRIC_TURN_TIMEOUTS,      // reads that hit TURN_TIMEOUT_SECONDS
+    METRIC_WAIT_TIMEOUTS,      // players paired with a bot after waiting bot_wait_seconds
+    METRIC_GAMES_UNJOURNALED,  // games started without a journal segment (the journal is on but one couldn't be created)
+    METRIC_POSCACHE_HITS,      // bot moves found in the position cache instead of searched
+    METRIC_POSCACHE_MISSES,
+    METRIC_MESSAGES_IN,
+    METRIC_MESSAGES_OUT,
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_INVALID,            // first of INVALID_REASONS counters of INVL sent
+    METRIC_GAME_SYSCALLS = METRIC_INVALID + INVALID_REASONS,  // first of SYSACCT_PHASES * SYSACCT_CALLS counters of syscalls of ended games
+    METRIC_GAME_BYTES_IN = METRIC_GAME_SYSCALLS + SYSACCT_PHASES * SYSACCT_CALLS,  // first of SYSACCT_PHASES counters
+    METRIC_GAME_BYTES_OUT = METRIC_GAME_BYTES_IN + SYSACCT_PHASES,                 // first of SYSACCT_PHASES counters
+    METRIC_GAME_MOVES = METRIC_GAME_BYTES_OUT + SYSACCT_PHASES,                    // moves of ended games
+    METRIC_COUNT
+} metrics_counter_t;
+
+// one CPU's counters padded to whole cache lines, a thread adds to the row of the CPU it runs on so no two CPUs write a line
+#define METRICS_ROW_SLOTS ((METRIC_COUNT + 7) & ~7)
+typedef struct metrics_row {
+    int64_t counters[METRICS_ROW_SLOTS];
+} metrics_row_t;
+
+// the scrape listener
+typedef struct metrics_server {
+    int listener;              // -1 when metrics are off
+    pthread_t tid;
+    uint64_t last_finished;    // finished games and when at the last scrape, for games per second
+    uint64_t last_ns;
+} metrics_server_t;
+
+extern metrics_server_t metrics_server;
+
+void metrics_add(metrics_counter_t counter, int64_t value);
+int64_t metrics_sum(metrics_counter_t counter);
+void metrics_invalid(const char* reason);
+void metrics_game_syscalls(const sysacct_t* account, int moves);
+void metrics_write(FILE* out, double games_per_second);
+int metrics_start(metrics_server_t* server, const char* port, volatile int* running);
+
+#endif
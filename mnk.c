@@ -0,0 +1,87 @@
+#include "mnk.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the four line directions through a cell (row step, col step): horizontal, vertical and both diagonals
+static const int directions[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+
+// sets up an empty board (returns 1 on success, 0 if the size is not allowed or memory ran out)
+int mnk_init(mnk_board_t* board, int rows, int cols, int k) {
+    if (rows < 1 || rows > MNK_MAX_SIDE || cols < 1 || cols > MNK_MAX_SIDE || k < 1 || (k > rows && k > cols)) {
+        return 0;
+    }
+    board->str = malloc(rows * cols + 1);
+    if (board->str == NULL) {
+        return 0;
+    }
+    memset(board->str, '.', rows * cols);
+    board->str[rows * cols] = '\0';
+    board->rows = rows;
+    board->cols = cols;
+    board->k = k;
+    board->filled = 0;
+    return 1;
+}
+
+void mnk_free(mnk_board_t* board) {
+    free(board->str);
+    board->str = NULL;
+}
+
+// checks if a move is valid (1 if yes, else 0), row and col are 1-based like in a MOVE message
+int mnk_is_valid_move(const mnk_board_t* board, int row, int col) {
+    if (row < 1 || row > board->rows || col < 1 || col > board->cols) {
+        return 0;
+    }
+    return board->str[(row - 1) * board->cols + (col - 1)] == '.';
+}
+
+// places role on a cell, the caller must have checked the move with mnk_is_valid_move
+void mnk_place(mnk_board_t* board, int row, int col, char role) {
+    board->str[(row - 1) * board->cols + (col - 1)] = role;
+    board->filled++;
+}
+
+// counts how many of the same role follow (row, col) in one direction, stopping once k is reached
+static int count_run(const mnk_board_t* board, int row, int col, int drow, int dcol, char role, int limit) {
+    int count = 0;
+    row += drow;
+    col += dcol;
+    while (count < limit && row >= 0 && row < board->rows && col >= 0 && col < board->cols && board->str[row * board->cols + col] == role) {
+        count++;
+        row += drow;
+        col += dcol;
+    }
+    return count;
+}
+
+// checks if the move just made on (row, col) completed k in a row (1 if yes, else 0)
+// only the four lines through that cell are looked at, so the cost is O(k) no matter how big the board is
+int mnk_check_win_at(const mnk_board_t* board, int row, int col) {
+    char role = board->str[(row - 1) * board->cols + (col - 1)];
+    if (role == '.') {
+        return 0;
+    }
+    return mnk_would_win(board, row, col, role);
+}
+
+// checks if role playing on (row, col) would complete k in a row, without changing the board (1 if yes, else 0)
+int mnk_would_win(const mnk_board_t* board, int row, int col, char role) {
+    row--;
+    col--;
+    for (int i = 0; i < 4; i++) {
+        int run = 1 + count_run(board, row, col, directions[i][0], directions[i][1], role, board->k - 1);
+        if (run < board->k) {
+            run += count_run(board, row, col, -directions[i][0], -directions[i][1], role, board->k - run);
+        }
+        if (run >= board->k) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// checks if there is a tie (1 if yes, else 0)
+int mnk_check_tie(const mnk_board_t* board) {
+    return board->filled == board->rows * board->cols;
+}
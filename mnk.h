@@ -0,0 +1,24 @@
+#ifndef MNK_H
+#define MNK_H
+
+// largest number of rows or columns a m,n,k board can have (keeps coordinates to 2 digits)
+#define MNK_MAX_SIDE 32
+
+// a rows x cols board where k in a row wins, cells are stored row-major as '.', 'X' or 'O'
+typedef struct mnk_board {
+    int rows;
+    int cols;
+    int k;
+    int filled;   // number of cells taken, so a tie check doesn't have to scan the board
+    char* str;    // rows * cols cells plus '\0', doubles as the board string sent in MOVD
+} mnk_board_t;
+
+int mnk_init(mnk_board_t* board, int rows, int cols, int k);
+void mnk_free(mnk_board_t* board);
+int mnk_is_valid_move(const mnk_board_t* board, int row, int col);
+void mnk_place(mnk_board_t* board, int row, int col, char role);
+int mnk_check_win_at(const mnk_board_t* board, int row, int col);
+int mnk_would_win(const mnk_board_t* board, int row, int col, char role);
+int mnk_check_tie(const mnk_board_t* board);
+
+#endif
@@ -0,0 +1,32 @@
+#include "perfect.h"
+
+// gets the ternary index of a position (X is 1, O is 2 in digit i for cell i)
+int perfect_index(uint16_t x, uint16_t o) {
+    return perfect_ternary[x & BOARD_FULL] + 2 * perfect_ternary[o & BOARD_FULL];
+}
+
+// gets the table entry of a board
+uint16_t perfect_lookup(const board_t* board) {
+    return perfect_table[perfect_index(board->x, board->o)];
+}
+
+// gets the status of a board (PERFECT_PLAYING, PERFECT_X_WON, PERFECT_O_WON, PERFECT_TIE or PERFECT_UNREACHABLE)
+int perfect_status(const board_t* board) {
+    return (perfect_lookup(board) >> PERFECT_STATUS_SHIFT) & 7;
+}
+
+// gets the value of a board for the player to move with perfect play from both sides
+int perfect_value(const board_t* board) {
+    return (perfect_lookup(board) >> PERFECT_VALUE_SHIFT) & 3;
+}
+
+// gets a mask of every move that keeps the best value for the player to move (0 if the game is over)
+uint16_t perfect_best_moves(const board_t* board) {
+    return perfect_lookup(board) & PERFECT_MOVES_MASK;
+}
+
+// checks if the game can only end in a tie no matter what either player does (1 if yes, else 0)
+int perfect_is_dead_draw(const board_t* board) {
+    uint16_t entry = perfect_lookup(board);
+    return ((entry >> PERFECT_STATUS_SHIFT) & 7) == PERFECT_PLAYING && (entry & PERFECT_DEAD_BIT) != 0;
+}
@@ -0,0 +1,39 @@
+#ifndef PERFECT_H
+#define PERFECT_H
+
+#include <stdint.h>
+#include "board.h"
+
+// one entry per ternary board index (3^9), unreachable positions are 0
+#define PERFECT_POSITIONS 19683
+
+// game-theoretic value of a position for the player to move
+#define PERFECT_LOSS 0
+#define PERFECT_DRAW 1
+#define PERFECT_WIN 2
+
+// status of a position
+#define PERFECT_UNREACHABLE 0
+#define PERFECT_PLAYING 1
+#define PERFECT_X_WON 2
+#define PERFECT_O_WON 3
+#define PERFECT_TIE 4
+
+// layout of an entry: bits 0-8 best moves (cell mask), bits 9-10 value, bits 11-13 status, bit 14 set if nobody can ever complete a line
+#define PERFECT_MOVES_MASK 0x1FF
+#define PERFECT_VALUE_SHIFT 9
+#define PERFECT_STATUS_SHIFT 11
+#define PERFECT_DEAD_BIT (1 << 14)
+
+// generated by tttgen into perfect_table.c (make builds it before anything that links it)
+extern const uint16_t perfect_table[PERFECT_POSITIONS];
+extern const uint16_t perfect_ternary[1 << BOARD_CELLS];
+
+int perfect_index(uint16_t x, uint16_t o);
+uint16_t perfect_lookup(const board_t* board);
+int perfect_status(const board_t* board);
+int perfect_value(const board_t* board);
+uint16_t perfect_best_moves(const board_t* board);
+int perfect_is_dead_draw(const board_t* board);
+
+#endif
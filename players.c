@@ -0,0 +1,254 @@
+// SEEK_DATA and SEEK_HOLE are GNU extensions
+#define _GNU_SOURCE
+#include "players.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// times a reader waits for a claimed slot to get its name before treating it as a claim a crash cut short
+#define READY_SPINS 10000
+
+players_t players = {NULL, 0, NULL, NULL, 0, -1};
+
+// FNV-1a with the top bit set so a name never hashes to the empty marker
+static uint64_t hash_name(const char* name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* p = (const unsigned char*) name; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 1099511628211ull;
+    }
+    return hash | (1ull << 63);
+}
+
+// maps the table at path, creating it with capacity slots if it is new (returns 1 on success, 0 if error)
+int players_open(players_t* table, const char* path, uint64_t capacity) {
+    table->map = NULL;
+    table->fd = -1;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("players open");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("players fstat");
+        close(fd);
+        return 0;
+    }
+    int is_new = st.st_size == 0;
+    if (is_new) {
+        // capacity must be a power of 2 for the probe mask
+        uint64_t size = 64;
+        while (size < capacity) {
+            size *= 2;
+        }
+        capacity = size;
+        // a sparse file, untouched slots read as zero which is an empty slot
+        if (ftruncate(fd, PLAYERS_HEADER_BYTES + capacity * sizeof(player_record_t)) < 0) {
+            perror("players ftruncate");
+            close(fd);
+            return 0;
+        }
+    }
+    else {
+        players_header_t header;
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.magic != PLAYERS_MAGIC || header.version != PLAYERS_VERSION
+            || (uint64_t) st.st_size != PLAYERS_HEADER_BYTES + header.capacity * sizeof(player_record_t)) {
+            fprintf(stderr, "%s is not a version %d player table\n", path, PLAYERS_VERSION);
+            close(fd);
+            return 0;
+        }
+        capacity = header.capacity;
+    }
+    size_t map_size = PLAYERS_HEADER_BYTES + capacity * sizeof(player_record_t);
+    void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("players mmap");
+        close(fd);
+        return 0;
+    }
+    table->map = map;
+    table->fd = fd;
+    table->map_size = map_size;
+    table->header = map;
+    table->records = (player_record_t*) ((char*) map + PLAYERS_HEADER_BYTES);
+    table->mask = capacity - 1;
+    if (is_new) {
+        table->header->capacity = capacity;
+        table->header->count = 0;
+        table->header->version = PLAYERS_VERSION;
+        // the magic goes last so a crash while creating leaves a file that is rejected instead of half set up
+        __atomic_store_n(&table->header->magic, PLAYERS_MAGIC, __ATOMIC_RELEASE);
+    }
+    return 1;
+}
+
+// writes the table back to the file and unmaps it
+void players_close(players_t* table) {
+    if (table->map != NULL) {
+        msync(table->map, table->map_size, MS_SYNC);
+        munmap(table->map, table->map_size);
+        table->map = NULL;
+    }
+    if (table->fd >= 0) {
+        close(table->fd);
+        table->fd = -1;
+    }
+}
+
+// waits for a claimed slot's name (returns 1 once it is there, 0 if it never came)
+static int wait_ready(const player_record_t* record) {
+    for (int spin = 0; spin < READY_SPINS; spin++) {
+        if (__atomic_load_n(&record->ready, __ATOMIC_ACQUIRE)) {
+            return 1;
+        }
+        sched_yield();
+    }
+    return 0;
+}
+
+// gets the record of a player, adding it if create is set (returns NULL if the player is unknown or the table is full)
+// linear probing without a lock: a new player takes the first empty slot with a compare and swap of the hash,
+// so two threads adding the same name meet on one slot and the loser sees the winner's name there
+player_record_t* players_get(players_t* table, const char* name, int create) {
+    if (table->map == NULL) {
+        return NULL;
+    }
+    uint64_t hash = hash_name(name);
+    for (uint64_t i = hash & table->mask, probes = 0; probes <= table->mask; i = (i + 1) & table->mask, probes++) {
+        player_record_t* record = &table->records[i];
+        uint64_t seen = __atomic_load_n(&record->hash, __ATOMIC_ACQUIRE);
+        if (seen == 0) {
+            if (!create) {
+                return NULL;
+            }
+            // keep the table below its load limit so lookups of unknown names stay short
+            uint64_t count = __atomic_fetch_add(&table->header->count, 1, __ATOMIC_RELAXED);
+            if (count * 100 >= (table->mask + 1) * PLAYERS_MAX_LOAD) {
+                __atomic_fetch_sub(&table->header->count, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+            uint64_t expected = 0;
+            if (__atomic_compare_exchange_n(&record->hash, &expected, hash, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                snprintf(record->name, sizeof(record->name), "%s", name);
+                record->rating = PLAYERS_START_RATING;
+                __atomic_store_n(&record->ready, 1, __ATOMIC_RELEASE);
+                return record;
+            }
+            // another thread took the slot first, it may be for this name
+            __atomic_fetch_sub(&table->header->count, 1, __ATOMIC_RELAXED);
+            seen = expected;
+        }
+        if (seen == hash && wait_ready(record) && strcmp(record->name, name) == 0) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+// copies a record with atomic loads, each counter is exact though they may be from either side of a concurrent update
+void players_read(const player_record_t* record, player_stats_t* stats) {
+    memcpy(stats->name, record->name, sizeof(stats->name));
+    stats->name[sizeof(stats->name) - 1] = '\0';
+    stats->rating = __atomic_load_n(&record->rating, __ATOMIC_RELAXED) / 100.0;
+    stats->games = __atomic_load_n(&record->games, __ATOMIC_RELAXED);
+    stats->wins = __atomic_load_n(&record->wins, __ATOMIC_RELAXED);
+    stats->losses = __atomic_load_n(&record->losses, __ATOMIC_RELAXED);
+    stats->draws = __atomic_load_n(&record->draws, __ATOMIC_RELAXED);
+    stats->resigns = __atomic_load_n(&record->resigns, __ATOMIC_RELAXED);
+    stats->last_seen = __atomic_load_n(&record->last_seen, __ATOMIC_RELAXED);
+}
+
+// gets a copy of a player's record (returns 1 if the player is known, else 0)
+int players_lookup(players_t* table, const char* name, player_stats_t* stats) {
+    player_record_t* record = players_get(table, name, 0);
+    if (record == NULL) {
+        return 0;
+    }
+    players_read(record, stats);
+    return 1;
+}
+
+// notes that a player showed up, adding them if they are new (returns their record, NULL if the table is full)
+player_record_t* players_seen(players_t* table, const char* name, int64_t now) {
+    player_record_t* record = players_get(table, name, 1);
+    if (record != NULL) {
+        __atomic_store_n(&record->last_seen, now, __ATOMIC_RELAXED);
+    }
+    return record;
+}
+
+// adds a finished game to both players' records, winner is X, O or D and resigner the role that resigned or '\0' (returns 1 on success, 0 if the table is full)
+// the rating change is worked out from both ratings as they are now and added to one and taken from the other,
+// so games ending at the same time never lose an update even though they may see each other's ratings either way
+int players_record_game(players_t* table, const char* x_name, const char* o_name, char winner, char resigner, int64_t now) {
+    player_record_t* x = players_get(table, x_name, 1);
+    player_record_t* o = players_get(table, o_name, 1);
+    if (x == NULL || o == NULL) {
+        return 0;
+    }
+    double x_rating = __atomic_load_n(&x->rating, __ATOMIC_RELAXED) / 100.0;
+    double o_rating = __atomic_load_n(&o->rating, __ATOMIC_RELAXED) / 100.0;
+    double expected = 1.0 / (1.0 + pow(10.0, (o_rating - x_rating) / 400.0));
+    double score = (winner == 'X') ? 1.0 : (winner == 'O') ? 0.0 : 0.5;
+    int64_t change = (int64_t) lround(PLAYERS_K_FACTOR * (score - expected) * 100.0);
+    __atomic_fetch_add(&x->rating, change, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&o->rating, change, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&x->games, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&o->games, 1, __ATOMIC_RELAXED);
+    if (winner == 'X' || winner == 'O') {
+        __atomic_fetch_add(winner == 'X' ? &x->wins : &o->wins, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(winner == 'X' ? &o->losses : &x->losses, 1, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_fetch_add(&x->draws, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&o->draws, 1, __ATOMIC_RELAXED);
+    }
+    if (resigner == 'X' || resigner == 'O') {
+        __atomic_fetch_add(resigner == 'X' ? &x->resigns : &o->resigns, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&x->last_seen, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&o->last_seen, now, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// calls visit for every taken slot (returns how many there were)
+// only the extents of the file that hold data are read, reading the holes of a mostly empty table would fill memory with zero pages
+uint64_t players_each(players_t* table, players_visit_fn visit, void* arg) {
+    if (table->map == NULL) {
+        return 0;
+    }
+    uint64_t visited = 0;
+    off_t end = table->map_size;
+    off_t offset = PLAYERS_HEADER_BYTES;
+    while (offset < end) {
+        off_t data = lseek(table->fd, offset, SEEK_DATA);
+        off_t hole = (data < 0) ? end : lseek(table->fd, data, SEEK_HOLE);
+        if (data < 0) {
+            // no data left, or a file system that can't tell in which case every slot is read
+            if (errno == ENXIO) {
+                break;
+            }
+            data = offset;
+        }
+        if (hole < 0 || hole > end) {
+            hole = end;
+        }
+        uint64_t first = (data < PLAYERS_HEADER_BYTES) ? 0 : (data - PLAYERS_HEADER_BYTES) / sizeof(player_record_t);
+        uint64_t last = (hole - PLAYERS_HEADER_BYTES + sizeof(player_record_t) - 1) / sizeof(player_record_t);
+        for (uint64_t slot = first; slot < last && slot <= table->mask; slot++) {
+            if (__atomic_load_n(&table->records[slot].ready, __ATOMIC_ACQUIRE)) {
+                visit(table, slot, arg);
+                visited++;
+            }
+        }
+        offset = hole;
+    }
+    return visited;
+}
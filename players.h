@@ -0,0 +1,83 @@
+#ifndef PLAYERS_H
+#define PLAYERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// file the server keeps every player's record in
+#define PLAYERS_PATH "players.db"
+#define PLAYERS_MAGIC 0x59414C50  // "PLAY"
+#define PLAYERS_VERSION 1
+// slots in a new table, the file is sparse so only pages holding players take disk and memory
+#define PLAYERS_CAPACITY (1 << 20)
+// new players are refused once this many percent of the slots are taken, so probes stay short
+#define PLAYERS_MAX_LOAD 90
+// the records start on the second page
+#define PLAYERS_HEADER_BYTES 4096
+// Elo ratings are kept in hundredths of a point
+#define PLAYERS_START_RATING 150000
+#define PLAYERS_K_FACTOR 32
+
+// first page of the file
+typedef struct players_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;    // slots, a power of 2
+    uint64_t count;       // slots taken, updated atomically
+} players_header_t;
+
+// one player, 256 bytes so a record never straddles more cache lines than it has to
+// a slot is taken by swapping its hash in from 0, the name is written next and ready is set last
+// every counter is updated with atomic adds so game threads never lock a record
+typedef struct player_record {
+    uint64_t hash;        // hash of the name (never 0), 0 while the slot is empty
+    uint32_t ready;       // 1 once name is written
+    uint32_t reserved;
+    int64_t rating;       // Elo rating in hundredths
+    uint64_t games;
+    uint64_t wins;
+    uint64_t losses;
+    uint64_t draws;
+    uint64_t resigns;     // games this player resigned (also counted in losses)
+    int64_t last_seen;    // unix time of the last PLAY or game end
+    char name[136];       // names are at most 128 characters
+    char padding[48];
+} player_record_t;
+
+// a copy of a record read with atomic loads
+typedef struct player_stats {
+    char name[136];
+    double rating;
+    uint64_t games;
+    uint64_t wins;
+    uint64_t losses;
+    uint64_t draws;
+    uint64_t resigns;
+    int64_t last_seen;
+} player_stats_t;
+
+// the mapped table
+typedef struct players {
+    void* map;
+    size_t map_size;
+    players_header_t* header;
+    player_record_t* records;
+    uint64_t mask;
+    int fd;               // kept open to find the parts of the sparse file that hold records
+} players_t;
+
+// called for each player by players_each
+typedef void (*players_visit_fn)(players_t* table, uint64_t slot, void* arg);
+
+extern players_t players;
+
+int players_open(players_t* table, const char* path, uint64_t capacity);
+void players_close(players_t* table);
+player_record_t* players_get(players_t* table, const char* name, int create);
+int players_lookup(players_t* table, const char* name, player_stats_t* stats);
+player_record_t* players_seen(players_t* table, const char* name, int64_t now);
+int players_record_game(players_t* table, const char* x_name, const char* o_name, char winner, char resigner, int64_t now);
+void players_read(const player_record_t* record, player_stats_t* stats);
+uint64_t players_each(players_t* table, players_visit_fn visit, void* arg);
+
+#endif
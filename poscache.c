@@ -0,0 +1,64 @@
+#include "poscache.h"
+#include <stdlib.h>
+
+poscache_t position_cache = {NULL, 0};
+
+// sets up a cache with room for entries slots, rounded up to a power of two (returns 1 on success, 0 if memory ran out)
+int poscache_init(poscache_t* cache, size_t entries) {
+    size_t size = POSCACHE_WAYS;
+    while (size < entries) {
+        size *= 2;
+    }
+    cache->slots = calloc(size, sizeof(poscache_slot_t));
+    if (cache->slots == NULL) {
+        return 0;
+    }
+    cache->mask = size - 1;
+    return 1;
+}
+
+void poscache_free(poscache_t* cache) {
+    free(cache->slots);
+    cache->slots = NULL;
+}
+
+// spreads the key over the table, canonical keys are already random but 3x3 keys are small packed boards
+static size_t home_slot(const poscache_t* cache, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return (size_t) key & cache->mask;
+}
+
+// looks up a key (returns 1 and sets value if found, else 0)
+// the two words of a slot are written separately, a slot torn by a concurrent put fails the check and reads as a miss
+int poscache_get(poscache_t* cache, uint64_t key, uint64_t* value) {
+    size_t home = home_slot(cache, key);
+    for (int way = 0; way < POSCACHE_WAYS; way++) {
+        poscache_slot_t* slot = &cache->slots[(home + way) & cache->mask];
+        uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+        uint64_t data = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+        if ((check ^ data) == key && (check | data) != 0) {
+            *value = data;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// stores a value for a key, replacing the key's old value, an empty slot, or else the last slot of its ways
+void poscache_put(poscache_t* cache, uint64_t key, uint64_t value) {
+    size_t home = home_slot(cache, key);
+    poscache_slot_t* target = &cache->slots[(home + POSCACHE_WAYS - 1) & cache->mask];
+    for (int way = 0; way < POSCACHE_WAYS; way++) {
+        poscache_slot_t* slot = &cache->slots[(home + way) & cache->mask];
+        uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+        uint64_t data = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+        if ((check ^ data) == key || (check | data) == 0) {
+            target = slot;
+            break;
+        }
+    }
+    __atomic_store_n(&target->check, key ^ value, __ATOMIC_RELAXED);
+    __atomic_store_n(&target->value, value, __ATOMIC_RELAXED);
+}
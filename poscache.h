@@ -0,0 +1,31 @@
+#ifndef POSCACHE_H
+#define POSCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// entries looked at for one key, a key always lives in one of the POSCACHE_WAYS slots after its home slot
+#define POSCACHE_WAYS 4
+
+// one slot, check is key ^ value so a reader can tell if the two words came from different writes
+typedef struct poscache_slot {
+    uint64_t check;
+    uint64_t value;
+} poscache_slot_t;
+
+// lossy concurrent hash table from canonical position keys to evaluations, shared by every game thread without a lock
+// it keeps no counters, a shared hit count would be written by every lookup on every core (the bot counts them in metrics)
+typedef struct poscache {
+    poscache_slot_t* slots;
+    size_t mask;
+} poscache_t;
+
+// the process-wide cache (slots is NULL until poscache_init is called on it)
+extern poscache_t position_cache;
+
+int poscache_init(poscache_t* cache, size_t entries);
+void poscache_free(poscache_t* cache);
+int poscache_get(poscache_t* cache, uint64_t key, uint64_t* value);
+void poscache_put(poscache_t* cache, uint64_t key, uint64_t value);
+
+#endif
@@ -0,0 +1,240 @@
+// _GNU_SOURCE for the register names of ucontext_t
+#define _GNU_SOURCE
+#include "prof.h"
+#include "lockprof.h"
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+// allocated by the first profile and kept, so a SIGPROF never lands on memory being freed
+static prof_sample_t* samples = NULL;
+// samples the handler has claimed a slot for this profile, past PROF_MAX_SAMPLES they are the dropped ones
+static uint64_t taken = 0;
+static int running = 0;
+static int hz = 0;
+// no profile starts without the handler, SIGPROF's default action ends the process
+static int installed = 0;
+// starts, stops and writes come from the main thread (SIGUSR2) and the admin thread, never from the handler
+static lockprof_mutex_t control_mutex = LOCKPROF_MUTEX_INITIALIZER("prof control_mutex");
+
+// the instruction the signal interrupted, NULL where we don't know the register
+static void* interrupted_at(void* context) {
+#if defined(__x86_64__)
+    return (void*) ((ucontext_t*) context)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (void*) ((ucontext_t*) context)->uc_mcontext.gregs[REG_EIP];
+#elif defined(__aarch64__)
+    return (void*) ((ucontext_t*) context)->uc_mcontext.pc;
+#else
+    return NULL;
+#endif
+}
+
+// takes the stack of the thread that was on the CPU, only async signal safe calls: an atomic add and backtrace
+// (which prof_init has already called once, so it doesn't load libgcc here)
+static void prof_handler(int signum, siginfo_t* info, void* context) {
+    if (!__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+        // a tick that was on its way when the profile stopped
+        return;
+    }
+    int saved_errno = errno;
+    uint64_t slot = __atomic_fetch_add(&taken, 1, __ATOMIC_RELAXED);
+    if (slot < PROF_MAX_SAMPLES) {
+        prof_sample_t* sample = &samples[slot];
+        int depth = backtrace(sample->frames, PROF_MAX_DEPTH);
+        // the unwinder gives the interrupted frame its exact pc, everything above it is the handler and whatever called it
+        void* pc = interrupted_at(context);
+        sample->first = PROF_SKIP_FRAMES;
+        for (int frame = 0; frame < depth && pc != NULL; frame++) {
+            if (sample->frames[frame] == pc) {
+                sample->first = frame;
+                break;
+            }
+        }
+        __atomic_store_n(&sample->depth, depth, __ATOMIC_RELEASE);
+    }
+    errno = saved_errno;
+}
+
+// installs the SIGPROF handler for good, a tick that comes after a profile stops must not kill the server
+// SA_RESTART restarts most calls a tick interrupts, reads and writes on sockets with a timeout fail with EINTR and are retried
+// (returns 1 on success, 0 if error)
+int prof_init(void) {
+    void* frames[PROF_MAX_DEPTH];
+    backtrace(frames, PROF_MAX_DEPTH);
+    struct sigaction act;
+    act.sa_sigaction = prof_handler;
+    act.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGPROF, &act, NULL) == -1) {
+        perror("sigaction");
+        return 0;
+    }
+    installed = 1;
+    return 1;
+}
+
+// starts a new profile taking hz samples a second of CPU the process uses, on whichever thread uses it
+// (returns 1 on success, 0 if it is already running, prof_init wasn't called or error)
+int prof_start(int sample_hz) {
+    lockprof_lock(&control_mutex);
+    if (running || !installed) {
+        lockprof_unlock(&control_mutex);
+        return 0;
+    }
+    if (samples == NULL) {
+        samples = calloc(PROF_MAX_SAMPLES, sizeof(prof_sample_t));
+        if (samples == NULL) {
+            perror("calloc");
+            lockprof_unlock(&control_mutex);
+            return 0;
+        }
+    }
+    uint64_t last = taken < PROF_MAX_SAMPLES ? taken : PROF_MAX_SAMPLES;
+    for (uint64_t slot = 0; slot < last; slot++) {
+        samples[slot].depth = 0;
+    }
+    hz = sample_hz < 1 ? PROF_DEFAULT_HZ : (sample_hz > PROF_MAX_HZ ? PROF_MAX_HZ : sample_hz);
+    __atomic_store_n(&taken, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / hz;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) == -1) {
+        perror("setitimer");
+        __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+        lockprof_unlock(&control_mutex);
+        return 0;
+    }
+    lockprof_unlock(&control_mutex);
+    return 1;
+}
+
+// stops the profile, its samples stay until the next one starts (returns 1 if it was running, 0 if it wasn't)
+int prof_stop(void) {
+    lockprof_lock(&control_mutex);
+    int was_running = running;
+    if (running) {
+        struct itimerval timer;
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_PROF, &timer, NULL);
+        __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    }
+    lockprof_unlock(&control_mutex);
+    return was_running;
+}
+
+int prof_running(void) {
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+int prof_hz(void) {
+    return hz;
+}
+
+// samples taken by the current or last profile, the dropped ones included
+uint64_t prof_samples(void) {
+    return __atomic_load_n(&taken, __ATOMIC_RELAXED);
+}
+
+uint64_t prof_dropped(void) {
+    uint64_t count = prof_samples();
+    return count > PROF_MAX_SAMPLES ? count - PROF_MAX_SAMPLES : 0;
+}
+
+// appends a frame's name: the function from backtrace_symbols' "module(function+0x1a) [0x...]",
+// or "[module+0x...]" for a function that isn't exported (static ones, and any without -rdynamic), which addr2line -e resolves
+static void append_frame(char* line, size_t size, const char* symbol) {
+    const char* open = strchr(symbol, '(');
+    const char* plus = open != NULL ? strpbrk(open, "+)") : NULL;
+    size_t length = strlen(line);
+    if (open != NULL && plus != NULL && plus > open + 1) {
+        snprintf(line + length, size - length, "%.*s", (int) (plus - open - 1), open + 1);
+        return;
+    }
+    const char* close = open != NULL ? strchr(open, ')') : NULL;
+    const char* module = symbol;
+    for (const char* c = symbol; open != NULL && c < open; c++) {
+        if (*c == '/') {
+            module = c + 1;
+        }
+    }
+    if (open != NULL && close != NULL) {
+        snprintf(line + length, size - length, "[%.*s%.*s]", (int) (open - module), module, (int) (close - open - 1), open + 1);
+    }
+    else {
+        snprintf(line + length, size - length, "[%s]", symbol);
+    }
+}
+
+static int compare_lines(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+// writes the samples of the current or last profile to path as folded stacks, outermost frame first, for flamegraph.pl and speedscope
+// (returns the number of different stacks written, -1 if error)
+int prof_write(const char* path) {
+    lockprof_lock(&control_mutex);
+    uint64_t count = prof_samples();
+    count = count < PROF_MAX_SAMPLES ? count : PROF_MAX_SAMPLES;
+    char** lines = calloc(count + 1, sizeof(char*));
+    FILE* file = lines != NULL ? fopen(path, "w") : NULL;
+    if (file == NULL) {
+        perror("profile");
+        free(lines);
+        lockprof_unlock(&control_mutex);
+        return -1;
+    }
+    size_t line_count = 0;
+    for (uint64_t slot = 0; slot < count; slot++) {
+        int depth = __atomic_load_n(&samples[slot].depth, __ATOMIC_ACQUIRE);
+        int first = samples[slot].first;
+        if (depth <= first) {
+            continue;
+        }
+        char** symbols = backtrace_symbols(samples[slot].frames, depth);
+        if (symbols == NULL) {
+            continue;
+        }
+        char line[PROF_MAX_DEPTH * 64];
+        line[0] = '\0';
+        for (int frame = depth - 1; frame >= first; frame--) {
+            append_frame(line, sizeof(line), symbols[frame]);
+            if (frame > first && strlen(line) < sizeof(line) - 1) {
+                strcat(line, ";");
+            }
+        }
+        free(symbols);
+        lines[line_count] = strdup(line);
+        line_count += lines[line_count] != NULL;
+    }
+    // the same stack taken many times is one line with its count
+    qsort(lines, line_count, sizeof(char*), compare_lines);
+    int stacks = 0;
+    for (size_t i = 0; i < line_count; ) {
+        size_t same = i + 1;
+        while (same < line_count && strcmp(lines[same], lines[i]) == 0) {
+            same++;
+        }
+        fprintf(file, "%s %zu\n", lines[i], same - i);
+        stacks++;
+        i = same;
+    }
+    for (size_t i = 0; i < line_count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    int ok = fclose(file) == 0;
+    lockprof_unlock(&control_mutex);
+    if (!ok) {
+        perror("profile");
+        return -1;
+    }
+    return stacks;
+}
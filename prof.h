@@ -0,0 +1,36 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// file a profile's folded stacks are written to (named after the server's port), one stack and its samples a line
+#define PROF_PATH_FORMAT "ttts-%s.folded"
+// samples per second of CPU the server burns, not a round number so it doesn't tick in step with the server's own timers
+#define PROF_DEFAULT_HZ 99
+#define PROF_MAX_HZ 1000
+// samples kept per profile (about 165 s of one busy core at 99 Hz), samples past it are counted as dropped
+#define PROF_MAX_SAMPLES 16384
+// frames kept per sample, a deeper stack loses its outermost frames
+#define PROF_MAX_DEPTH 32
+// frames of the signal handler and the signal trampoline on top of a sample, skipped when the interrupted instruction isn't found in it
+// (a sanitizer's handler wrapper adds another, so a sample is normally cut at the interrupted instruction instead)
+#define PROF_SKIP_FRAMES 2
+
+// one stack, written by the SIGPROF handler of whichever thread was on the CPU
+typedef struct prof_sample {
+    int depth;                    // frames taken, 0 until the handler has written them
+    int first;                    // frames[first] is where the thread was interrupted, the frames before it are the handler's
+    void* frames[PROF_MAX_DEPTH];
+} prof_sample_t;
+
+int prof_init(void);
+int prof_start(int hz);
+int prof_stop(void);
+int prof_write(const char* path);
+int prof_running(void);
+int prof_hz(void);
+uint64_t prof_samples(void);
+uint64_t prof_dropped(void);
+
+#endif
@@ -1,4 +1,8 @@
 #include "protocol.h"
+#include "latency.h"
+#include "metrics.h"
+#include "sysacct.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -12,13 +16,15 @@
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 int is_socket_connected(int fd) {
     char buf;
     int retval = recv(fd, &buf, 1, MSG_PEEK | MSG_DONTWAIT);
+    sysacct_count(SYSACCT_PEEK, 0, 0);
 
-    if (retval == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-        // socket is still connected and there is no data available to read
+    if (retval == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        // socket is still connected and there is no data available to read (or a signal came before we could tell)
         return 1;
     }
 
@@ -51,6 +57,8 @@ char* get_message_code_string(MessageCode code) {
             return "INVL";
         case 8:
             return "OVER";
+        case 9:
+            return "RSUM";
     }
     return "";
 }
@@ -83,21 +91,65 @@ void set_message_fields(message_t* msg, int code, char* thirdField, char* fourth
     }
 }
 
+// checks if the fourth field of a MOVE message (from start up to the bar at end) is position,position or a single position (a gravity column)
+// where each position is 1 or 2 digits (1 if yes, else 0)
+static int is_position_field(const char* start, const char* end) {
+    const char* p = start;
+    for (int part = 0; part < 2; part++) {
+        int digits = 0;
+        while (p < end && isdigit((unsigned char) *p)) {
+            digits++;
+            p++;
+        }
+        if (digits < 1 || digits > 2) {
+            return 0;
+        }
+        if (part == 0) {
+            if (p == end) {
+                return 1;
+            }
+            if (*p != ',') {
+                return 0;
+            }
+            p++;
+        }
+    }
+    return p == end;
+}
+
 // returns 1 on success, -1 if error (invalid/malformed message, signal error, connection lost error, etc.)
-int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
+static int read_message(messageBuffer_t* msgBuffer, message_t* msg) {
     // clear out the message fields before reading.
     msg->code = 0;
     msg->secondField = 0;
     memset(msg->thirdField, '\0', sizeof(msg->thirdField));
     memset(msg->fourthField, '\0', sizeof(msg->fourthField));
 
+    int closed = 0;
     while (1) {
-        int bytes_read = read(msgBuffer->fd, msgBuffer->buffer + msgBuffer->buflen, BUFFER_SIZE - msgBuffer->buflen);
+        // we only come back here for more of a message, and the peer hung up (or the file ended) before sending it
+        if (closed) {
+            return -1;
+        }
+        // leave room for the '\0' written after the data
+        int bytes_read = read(msgBuffer->fd, msgBuffer->buffer + msgBuffer->buflen, BUFFER_SIZE - 1 - msgBuffer->buflen);
+        sysacct_count(SYSACCT_READ, bytes_read, 0);
+        // a profiler tick can interrupt the read, a socket with a timeout isn't restarted by SA_RESTART
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
         if (bytes_read < 0) {
+            // the read timeout set for a game ran out before the player's message came
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                metrics_add(METRIC_TURN_TIMEOUTS, 1);
+            }
             perror("Error reading from client");
             return -1;
         } 
         else {
+            metrics_add(METRIC_BYTES_IN, bytes_read);
+            // a message already in the buffer can still be read after the peer closes, only a partial one is lost
+            closed = bytes_read == 0;
             msgBuffer->buflen += bytes_read;
             msgBuffer->buffer[msgBuffer->buflen] = '\0';
             char* message_end = NULL;
@@ -126,6 +178,9 @@ int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
             } else if (strncmp(msgBuffer->buffer, "MOVE", 4) == 0) {
                 addl_bars = 2;
                 msgcode = MOVE;
+            } else if (strncmp(msgBuffer->buffer, "RSUM", 4) == 0) {
+                addl_bars = 2;
+                msgcode = RSUM;
             } else if (strncmp(msgBuffer->buffer, "RSGN", 4) == 0) {
                 addl_bars = 0;
                 msgcode = RSGN;
@@ -148,8 +203,8 @@ int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
             if (msgcode == DRAW && dataSize != 2) {
                 return -1;
             }
-            // check if the message is a move message, which would always have 6 in the second field (datasize field)
-            if (msgcode == MOVE && dataSize != 6) {
+            // check if the message is a move message, which has 4 to 8 in the second field (datasize field) since positions can be 1 or 2 digits and a gravity move is only a column
+            if (msgcode == MOVE && (dataSize < 4 || dataSize > 8)) {
                 return -1;
             }
             // check if the message was a RSGN msg, which would have a size of 0 otherwise this is a malformed RSGN msg.
@@ -175,6 +230,32 @@ int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
                         continue;
                     }
                 }
+                // a PLAY message may have a fourth field with the variant the player wants (e.g. PLAY|13|name|15,15,5|)
+                else if (msgcode == PLAY && (thirdfield_end - size_end) < dataSize) {
+                    char* fourthfield_end = strchr(thirdfield_end + 1, '|');
+                    if (fourthfield_end == NULL) {
+                        // check if the specified data size is <= actual size of the data after the second bar.
+                        if (((msgBuffer->buffer + msgBuffer->buflen - 1) - size_end) >= dataSize) {
+                            // we've read enough data after the second bar but we dont have a bar so this is malformed message.
+                            return -1;
+                        }
+                        else {
+                            // actual data read is smaller than specified size so we must read more.
+                            continue;
+                        }
+                    }
+                    // check if the specified data size is not the actual size of the data after the second bar.
+                    if ((fourthfield_end - size_end) != dataSize) {
+                        return -1;
+                    }
+                    // bars required are good and size is good so this is a complete message.
+                    message_end = fourthfield_end;
+                    // copy the contents of the third and fourth field into the message struct
+                    memcpy(msg->thirdField, size_end + 1, thirdfield_end - size_end - 1);
+                    msg->thirdField[thirdfield_end - size_end - 1] = '\0';
+                    memcpy(msg->fourthField, thirdfield_end + 1, message_end - thirdfield_end - 1);
+                    msg->fourthField[message_end - thirdfield_end - 1] = '\0';
+                }
                 else {
                     // check if the specified data size is not the actual size of the data after the second bar.
                     if ((thirdfield_end - size_end) != dataSize) {
@@ -210,11 +291,11 @@ int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
                 }
                 else {
                     // check if the MOVE message has only one char in the third field (player role)
-                    if ((thirdfield_end - size_end != 2)) {
+                    if (msgcode == MOVE && (thirdfield_end - size_end != 2)) {
                         return -1;
                     }
                     // check if the MOVE message doesn't have a valid third field character (must be X or O)
-                    if (strncmp(size_end + 1, "X", 1) != 0 && strncmp(size_end + 1, "O", 1) != 0) {
+                    if (msgcode == MOVE && strncmp(size_end + 1, "X", 1) != 0 && strncmp(size_end + 1, "O", 1) != 0) {
                         return -1;
                     }
                     char* fourthfield_end = strchr(thirdfield_end + 1, '|');
@@ -236,12 +317,8 @@ int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
                             return -1;
                         }
                         else {
-                            // check if the MOVE message has only 3 char in the fourth field (position,position)
-                            if ((fourthfield_end - thirdfield_end != 4)) {
-                                return -1;
-                            }
-                            // check if the fourth field is not formatted properly to be position,position
-                            if (!isdigit(*(thirdfield_end + 1)) || strncmp(thirdfield_end + 2, ",", 1) != 0 || !isdigit(*(thirdfield_end + 3))) {
+                            // check if the fourth field of a MOVE is not formatted properly to be position,position or position (a RSUM has the session token there)
+                            if (msgcode == MOVE && !is_position_field(thirdfield_end + 1, fourthfield_end)) {
                                 return -1;
                             }
                             // bars required are good and size is good so this is a complete message.
@@ -269,14 +346,24 @@ int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
                 memmove(msgBuffer->buffer, message_end + 1, leftover_length);
                 memset(msgBuffer->buffer + leftover_length, '\0', BUFFER_SIZE - leftover_length); // clear remaining bytes
                 msgBuffer->buflen = leftover_length;
+                metrics_add(METRIC_MESSAGES_IN, 1);
                 return 1;
             }
         }
     }
 }
 
+// reads the next message, a traced game's thread gets a span for the wait and the parse (returns 1 on success, -1 if error)
+int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg) {
+    uint64_t span = trace_begin();
+    int result = read_message(msgBuffer, msg);
+    trace_end("protocol", "recieve_msg", span);
+    return result;
+}
+
 // returns 1 on success, -1 if error
-int send_msg(int fd, message_t* msg, char* board_str) {
+int send_msg(int fd, message_t* msg, const char* board_str) {
+    uint64_t start_ns = latency_now();
     // handles connection lost error (we include this check in send_msg because we dont use it with files, whereas we use recieve_msg with a text file which is not a connected socket so we do the check before every recieve_msg in the server code.)
     if (!is_socket_connected(fd)) {
         // handle error caused by client socket not being connected anymore
@@ -284,9 +371,11 @@ int send_msg(int fd, message_t* msg, char* board_str) {
     }
     char buffer[BUFFER_SIZE];
     int len = 0;
-    // format message into a string
+    int board_len = 0;
+    // format message into a string, the board is not copied into it since m,n,k boards can be bigger than the buffer
     if (msg->thirdField[0] != '\0' && msg->fourthField[0] != '\0' && board_str != NULL) {
-        len = sprintf(buffer, "%s|%d|%s|%s|%s|", get_message_code_string(msg->code), (msg->secondField + 10), msg->thirdField, msg->fourthField, board_str);
+        board_len = strlen(board_str);
+        len = sprintf(buffer, "%s|%d|%s|%s|", get_message_code_string(msg->code), (msg->secondField + board_len + 1), msg->thirdField, msg->fourthField);
     }
     else if (msg->thirdField[0] != '\0' && msg->fourthField[0] != '\0') {
         len = sprintf(buffer, "%s|%d|%s|%s|", get_message_code_string(msg->code), msg->secondField, msg->thirdField, msg->fourthField);
@@ -297,22 +386,60 @@ int send_msg(int fd, message_t* msg, char* board_str) {
     else {
         len = sprintf(buffer, "%s|%d|", get_message_code_string(msg->code), msg->secondField);
     }
-    int total_written = 0;
-    // write message to socket
-    while (total_written < len) {
-        int bytes_written = write(fd, buffer + total_written, len - total_written);
+    // write message to socket, the header and the board (if any) go out in one writev
+    struct iovec iov[3];
+    int iovcnt = 1;
+    iov[0].iov_base = buffer;
+    iov[0].iov_len = len;
+    if (board_len > 0) {
+        iov[1].iov_base = (void*) board_str;
+        iov[1].iov_len = board_len;
+        iov[2].iov_base = "|";
+        iov[2].iov_len = 1;
+        iovcnt = 3;
+    }
+    struct iovec* curr_iov = iov;
+    while (iovcnt > 0) {
+        ssize_t bytes_written = writev(fd, curr_iov, iovcnt);
+        sysacct_count(SYSACCT_WRITE, 0, bytes_written);
+        if (bytes_written == -1 && errno == EINTR) {
+            continue;
+        }
         if (bytes_written == -1) {
             perror("write");
+            trace_span("protocol", "send_msg", start_ns, latency_now());
             return -1;
         }
-        total_written += bytes_written;
+        // skip past whatever was fully written and move the start of a partially written part
+        while (iovcnt > 0 && (size_t) bytes_written >= curr_iov->iov_len) {
+            bytes_written -= curr_iov->iov_len;
+            curr_iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            curr_iov->iov_base = (char*) curr_iov->iov_base + bytes_written;
+            curr_iov->iov_len -= bytes_written;
+        }
+    }
+    metrics_add(METRIC_MESSAGES_OUT, 1);
+    metrics_add(METRIC_BYTES_OUT, len + (board_len > 0 ? board_len + 1 : 0));
+    if (msg->code == INVL) {
+        metrics_invalid(msg->thirdField);
+    }
+    if (board_len > 0) {
+        printf("[SERVER SEND to %d]: %s%s|\n", fd, buffer, board_str);
+    }
+    else {
+        printf("[SERVER SEND to %d]: %s\n", fd, buffer);
     }
-    printf("[SERVER SEND to %d]: %s\n", fd, buffer);
     // clear out the message fields since the write was successful.
     msg->code = 0;
     msg->secondField = 0;
     memset(msg->thirdField, '\0', sizeof(msg->thirdField));
     memset(msg->fourthField, '\0', sizeof(msg->fourthField));
+    uint64_t end_ns = latency_now();
+    latency_record(LATENCY_SEND, end_ns - start_ns);
+    trace_span("protocol", "send_msg", start_ns, end_ns);
     return 1;
 }
 
@@ -2,6 +2,8 @@
 #define PROTOCOL_H
 
 #define BUFFER_SIZE 1028
+// seconds a player has to send their next message during a game before the read times out
+#define TURN_TIMEOUT_SECONDS 10
 
 typedef enum {
     PLAY, // 0
@@ -12,7 +14,8 @@ typedef enum {
     BEGN, // 5
     MOVD, // 6
     INVL, // 7
-    OVER  // 8
+    OVER, // 8
+    RSUM  // 9 - name and session token of a player getting back into their game after a server restart
 } MessageCode;
 
 
@@ -34,6 +37,6 @@ int is_socket_connected(int fd);
 char* get_message_code_string(MessageCode code);
 void set_message_fields(message_t* msg, int code, char* thirdField, char* fourthField);
 int recieve_msg(messageBuffer_t* msgBuffer, message_t* msg);
-int send_msg(int fd, message_t* msg, char* board_str);
+int send_msg(int fd, message_t* msg, const char* board_str);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,421 @@
+// NOTE: must use option -pthread when compiling!
+#define _POSIX_C_SOURCE 200809L
+#include "recovery.h"
+#include "lockprof.h"
+#include "protocol.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// one record read back from the journal, payloads are copied into one arena so each segment is unmapped once it is read
+typedef struct entry {
+    uint64_t game_id;
+    uint64_t time_ns;
+    uint64_t order;       // position in the scan, keeps records appended in the same nanosecond in order
+    size_t payload;       // offset of the payload in the arena
+    uint32_t length;
+    uint8_t code;
+} entry_t;
+
+typedef struct scan {
+    entry_t* entries;
+    size_t count;
+    size_t capacity;
+    char* arena;
+    size_t arena_used;
+    size_t arena_capacity;
+    int failed;
+} scan_t;
+
+// a reserved name, a removed name keeps its slot as a tombstone so lookups probe past it
+typedef struct slot {
+    const char* name;
+    recovered_game_t* game;
+} slot_t;
+
+static const char tombstone[] = "";
+static lockprof_mutex_t recovery_mutex = LOCKPROF_MUTEX_INITIALIZER("recovery_mutex");
+static slot_t* slots = NULL;
+static size_t slot_mask = 0;
+// every game recovery_load rebuilt, an entry is set to NULL when its game is finished or expired
+static recovered_game_t** recovered = NULL;
+static long recovered_count = 0;
+
+// makes a new session token of SESSION_TOKEN_LEN hex characters, token must have room for the terminator
+void session_token(char* token) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned char bytes[SESSION_TOKEN_LEN / 2];
+    ssize_t got = -1;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        got = read(fd, bytes, sizeof(bytes));
+        close(fd);
+    }
+    if (got != (ssize_t) sizeof(bytes)) {
+        // without urandom the clock still makes tokens nobody else is handed
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        uint64_t state = ((uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec) ^ (uint64_t) (uintptr_t) token;
+        for (size_t i = 0; i < sizeof(bytes); i++) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            bytes[i] = state >> 56;
+        }
+    }
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        token[2 * i] = hex[bytes[i] >> 4];
+        token[2 * i + 1] = hex[bytes[i] & 15];
+    }
+    token[SESSION_TOKEN_LEN] = '\0';
+}
+
+// keeps the records recovery needs, the payload of an OVER doesn't matter
+static void collect(const journal_record_t* record, const char* payload, void* arg) {
+    scan_t* scan = arg;
+    if ((record->code != BEGN && record->code != MOVD && record->code != OVER) || scan->failed) {
+        return;
+    }
+    uint32_t length = record->code == OVER ? 0 : record->length;
+    if (scan->count == scan->capacity) {
+        size_t capacity = scan->capacity ? scan->capacity * 2 : 4096;
+        entry_t* grown = realloc(scan->entries, capacity * sizeof(entry_t));
+        if (grown == NULL) {
+            scan->failed = 1;
+            return;
+        }
+        scan->entries = grown;
+        scan->capacity = capacity;
+    }
+    if (scan->arena_used + length > scan->arena_capacity) {
+        size_t capacity = scan->arena_capacity ? scan->arena_capacity * 2 : 65536;
+        while (scan->arena_used + length > capacity) {
+            capacity *= 2;
+        }
+        char* grown = realloc(scan->arena, capacity);
+        if (grown == NULL) {
+            scan->failed = 1;
+            return;
+        }
+        scan->arena = grown;
+        scan->arena_capacity = capacity;
+    }
+    entry_t* entry = &scan->entries[scan->count];
+    entry->game_id = record->game_id;
+    entry->time_ns = record->time_ns;
+    entry->order = scan->count;
+    entry->payload = scan->arena_used;
+    entry->length = length;
+    entry->code = record->code;
+    memcpy(scan->arena + scan->arena_used, payload, length);
+    scan->arena_used += length;
+    scan->count++;
+}
+
+// orders records by game, then by when they were appended
+static int compare_entries(const void* a, const void* b) {
+    const entry_t* x = a;
+    const entry_t* y = b;
+    if (x->game_id != y->game_id) {
+        return x->game_id < y->game_id ? -1 : 1;
+    }
+    if (x->time_ns != y->time_ns) {
+        return x->time_ns < y->time_ns ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+// fills a game from a BEGN payload: xName|oName|spec|xToken|oToken (returns 1 on success, 0 if it has no tokens to resume with)
+static int parse_begin(recovered_game_t* game, const char* payload, uint32_t length) {
+    char text[JOURNAL_MAX_PAYLOAD + 1];
+    memcpy(text, payload, length);
+    text[length] = '\0';
+    // strtok would skip the empty spec of a classic game, so split by hand
+    char* fields[5];
+    int count = 0;
+    char* start = text;
+    while (count < 5) {
+        fields[count++] = start;
+        char* bar = strchr(start, '|');
+        if (bar == NULL) {
+            break;
+        }
+        *bar = '\0';
+        start = bar + 1;
+    }
+    if (count != 5 || strlen(fields[0]) >= sizeof(game->xName) || strlen(fields[1]) >= sizeof(game->oName) || strlen(fields[2]) >= sizeof(game->spec) || strlen(fields[3]) > SESSION_TOKEN_LEN || strlen(fields[4]) > SESSION_TOKEN_LEN) {
+        return 0;
+    }
+    strcpy(game->xName, fields[0]);
+    strcpy(game->oName, fields[1]);
+    strcpy(game->spec, fields[2]);
+    strcpy(game->xToken, fields[3]);
+    strcpy(game->oToken, fields[4]);
+    game->moves = 0;
+    return 1;
+}
+
+// adds the position of a MOVD payload (role|position) to a game (returns 1 on success, 0 if memory ran out)
+static int add_move(recovered_game_t* game, const char* payload, uint32_t length) {
+    if (game->moves == game->capacity) {
+        int capacity = game->capacity ? game->capacity * 2 : 16;
+        char (*grown)[RECOVERY_POSITION_LEN] = realloc(game->positions, capacity * sizeof(*grown));
+        if (grown == NULL) {
+            return 0;
+        }
+        game->positions = grown;
+        game->capacity = capacity;
+    }
+    uint32_t position_length = length > 2 ? length - 2 : 0;
+    if (position_length >= RECOVERY_POSITION_LEN) {
+        position_length = RECOVERY_POSITION_LEN - 1;
+    }
+    memcpy(game->positions[game->moves], payload + 2, position_length);
+    game->positions[game->moves][position_length] = '\0';
+    game->moves++;
+    return 1;
+}
+
+static void free_game(recovered_game_t* game) {
+    if (game != NULL) {
+        free(game->positions);
+        free(game);
+    }
+}
+
+// FNV-1a
+static size_t hash_name(const char* name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* p = (const unsigned char*) name; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 1099511628211ull;
+    }
+    return (size_t) hash;
+}
+
+// gets the slot holding name or the empty slot that ends its probe, the caller holds recovery_mutex
+static slot_t* find_slot(const char* name) {
+    for (size_t i = hash_name(name) & slot_mask; ; i = (i + 1) & slot_mask) {
+        if (slots[i].name == NULL || (slots[i].name != tombstone && strcmp(slots[i].name, name) == 0)) {
+            return &slots[i];
+        }
+    }
+}
+
+// reserves a player's name for their recovered game, a bot's side has nothing to reserve
+static void reserve_name(const char* name, const char* token, recovered_game_t* game) {
+    if (strcmp(token, SESSION_TOKEN_NONE) == 0) {
+        return;
+    }
+    slot_t* slot = find_slot(name);
+    // two live games with one name can't both be resumed, the first one keeps it
+    if (slot->name == NULL) {
+        slot->name = name;
+        slot->game = game;
+    }
+}
+
+// rebuilds every game of the runs from first_run on that began but isn't over (returns how many, -1 if error)
+// the records of a game are sorted by time so it doesn't matter which segments its moves went to
+long recovery_load(const char* dir, long first_run) {
+    scan_t scan;
+    memset(&scan, 0, sizeof(scan));
+    long records = journal_scan(dir, first_run, collect, &scan);
+    if (records < 0 || scan.failed) {
+        fprintf(stderr, "recovery: could not read the journal in %s\n", dir);
+        free(scan.entries);
+        free(scan.arena);
+        return -1;
+    }
+    qsort(scan.entries, scan.count, sizeof(entry_t), compare_entries);
+
+    long capacity = 0;
+    recovered_count = 0;
+    for (size_t i = 0; i < scan.count; ) {
+        size_t end = i;
+        while (end < scan.count && scan.entries[end].game_id == scan.entries[i].game_id) {
+            end++;
+        }
+        // replay the game's records, a BEGN starts it over since recovery journals live games again from the start
+        recovered_game_t* game = NULL;
+        for (size_t j = i; j < end; j++) {
+            const entry_t* entry = &scan.entries[j];
+            const char* payload = scan.arena + entry->payload;
+            if (entry->code == BEGN) {
+                if (game == NULL) {
+                    game = calloc(1, sizeof(recovered_game_t));
+                    if (game == NULL) {
+                        break;
+                    }
+                }
+                game->id = entry->game_id;
+                // games journaled without session tokens can't be resumed by anyone
+                if (!parse_begin(game, payload, entry->length)) {
+                    free_game(game);
+                    game = NULL;
+                }
+            }
+            else if (entry->code == MOVD && game != NULL) {
+                if (!add_move(game, payload, entry->length)) {
+                    free_game(game);
+                    game = NULL;
+                    break;
+                }
+            }
+            else if (entry->code == OVER) {
+                free_game(game);
+                game = NULL;
+            }
+        }
+        if (game != NULL) {
+            if (recovered_count == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                recovered_game_t** grown = realloc(recovered, capacity * sizeof(recovered_game_t*));
+                if (grown == NULL) {
+                    perror("realloc");
+                    free_game(game);
+                    break;
+                }
+                recovered = grown;
+            }
+            game->index = recovered_count;
+            recovered[recovered_count++] = game;
+        }
+        i = end;
+    }
+    free(scan.entries);
+    free(scan.arena);
+
+    // two names per game and at most half the slots used keeps probes short
+    size_t size = 64;
+    while (size < 4 * (size_t) recovered_count) {
+        size *= 2;
+    }
+    lockprof_lock(&recovery_mutex);
+    free(slots);
+    slots = calloc(size, sizeof(slot_t));
+    if (slots == NULL) {
+        lockprof_unlock(&recovery_mutex);
+        perror("calloc");
+        return -1;
+    }
+    slot_mask = size - 1;
+    for (long i = 0; i < recovered_count; i++) {
+        reserve_name(recovered[i]->xName, recovered[i]->xToken, recovered[i]);
+        reserve_name(recovered[i]->oName, recovered[i]->oToken, recovered[i]);
+    }
+    lockprof_unlock(&recovery_mutex);
+    return recovered_count;
+}
+
+// journals every recovered game again from the start into this run, so the next recovery can begin at this run (returns how many, -1 if error)
+// the records aren't synced one by one, the caller flushes the journal once they are all written
+// with no writer (journal off) the games can still be resumed until the server stops
+long recovery_relog(journal_writer_t* writer) {
+    long relogged = 0;
+    char payload[JOURNAL_MAX_PAYLOAD];
+    for (long i = 0; i < recovered_count && writer != NULL; i++) {
+        recovered_game_t* game = recovered[i];
+        int length = snprintf(payload, sizeof(payload), "%s|%s|%s|%s|%s", game->xName, game->oName, game->spec, game->xToken, game->oToken);
+        if (journal_append_deferred(writer, BEGN, game->id, payload, length) == -1) {
+            relogged = -1;
+            break;
+        }
+        journal_last_position(writer, &game->begun_at);
+        for (int move = 0; move < game->moves; move++) {
+            length = snprintf(payload, sizeof(payload), "%c|%s", (move % 2 == 0) ? 'X' : 'O', game->positions[move]);
+            if (journal_append_deferred(writer, MOVD, game->id, payload, length) == -1) {
+                relogged = -1;
+                break;
+            }
+        }
+        if (relogged == -1) {
+            break;
+        }
+        relogged++;
+    }
+    return relogged;
+}
+
+// gets the recovered game of a player if token is theirs and sets role to their side (returns NULL if there is no such game)
+// a game whose thread was started is never handed out, only its thread frees it and only the caller of recovery_set_started starts it,
+// so the game stays allocated while the caller seats the player
+recovered_game_t* recovery_find(const char* name, const char* token, char* role) {
+    recovered_game_t* game = NULL;
+    lockprof_lock(&recovery_mutex);
+    if (slots != NULL) {
+        slot_t* slot = find_slot(name);
+        if (slot->name != NULL && !slot->game->started) {
+            int is_x = strcmp(slot->game->xName, name) == 0;
+            if (strcmp(is_x ? slot->game->xToken : slot->game->oToken, token) == 0) {
+                game = slot->game;
+                *role = is_x ? 'X' : 'O';
+            }
+        }
+    }
+    lockprof_unlock(&recovery_mutex);
+    return game;
+}
+
+// checks if a name belongs to a player of a recovered game that hasn't been resumed yet (1 if it does, else 0)
+int recovery_is_reserved(const char* name) {
+    int reserved = 0;
+    lockprof_lock(&recovery_mutex);
+    if (slots != NULL) {
+        reserved = find_slot(name)->name != NULL;
+    }
+    lockprof_unlock(&recovery_mutex);
+    return reserved;
+}
+
+// marks a game as started before its thread is created, or not started again if the thread couldn't be
+void recovery_set_started(recovered_game_t* game, int started) {
+    lockprof_lock(&recovery_mutex);
+    game->started = started;
+    lockprof_unlock(&recovery_mutex);
+}
+
+// frees the names of a game and takes it off the list, the caller holds recovery_mutex
+static void release_game(recovered_game_t* game) {
+    const char* names[2] = {game->xName, game->oName};
+    for (int i = 0; i < 2; i++) {
+        slot_t* slot = find_slot(names[i]);
+        if (slot->name != NULL && slot->game == game) {
+            slot->name = tombstone;
+            slot->game = NULL;
+        }
+    }
+    recovered[game->index] = NULL;
+}
+
+// releases the names of a game whose thread has rebuilt its board and frees it
+void recovery_finish(recovered_game_t* game) {
+    lockprof_lock(&recovery_mutex);
+    release_game(game);
+    lockprof_unlock(&recovery_mutex);
+    free_game(game);
+}
+
+// scraps every recovered game whose thread wasn't started: journals its OVER so no later restart brings it back,
+// releases its players' names and frees it (returns how many were scrapped)
+// the caller has scrapped the games_list nodes of the ones a player came back for
+long recovery_expire(journal_writer_t* writer) {
+    static const char over[] = "-|the game was not resumed in time.";
+    long expired = 0;
+    lockprof_lock(&recovery_mutex);
+    for (long i = 0; i < recovered_count; i++) {
+        recovered_game_t* game = recovered[i];
+        if (game == NULL || game->started) {
+            continue;
+        }
+        if (journal_append(writer, OVER, game->id, over, sizeof(over) - 1) == -1) {
+            fprintf(stderr, "[JOURNAL] could not journal the end of recovered game %llu\n", (unsigned long long) game->id);
+        }
+        release_game(game);
+        free_game(game);
+        expired++;
+    }
+    lockprof_unlock(&recovery_mutex);
+    return expired;
+}
@@ -0,0 +1,41 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include "journal.h"
+#include <stdint.h>
+
+// hex characters in a session token, a player presents their name and token to get back into a game after a restart
+#define SESSION_TOKEN_LEN 16
+// token journaled for a bot, bots are rebuilt with the game instead of reconnecting
+#define SESSION_TOKEN_NONE "-"
+// longest position field a recovered move keeps ("12,15" and a column alone fit)
+#define RECOVERY_POSITION_LEN 8
+// seconds the players of a recovered game have to come back after a restart, a game that isn't going again by then is scrapped
+#define RECOVERY_RESUME_SECONDS 120
+
+// a game that had begun but wasn't over when the server stopped, rebuilt from the journal
+typedef struct recovered_game {
+    uint64_t id;               // journal id, the resumed game keeps appending under it
+    char xName[128];
+    char oName[128];
+    char spec[24];             // variant as variant_format writes it
+    char xToken[SESSION_TOKEN_LEN + 1];
+    char oToken[SESSION_TOKEN_LEN + 1];
+    int moves;                 // moves played so far, X made the even ones
+    int capacity;
+    char (*positions)[RECOVERY_POSITION_LEN];  // position field of every move as it was journaled
+    journal_position_t begun_at;  // where recovery_relog journaled the game's BEGN again
+    long index;                // in the list of recovered games, which holds it until it is finished or expired
+    int started;               // its game thread was started, set with recovery_mutex held so recovery_find stops handing it out
+} recovered_game_t;
+
+void session_token(char* token);
+long recovery_load(const char* dir, long first_run);
+long recovery_relog(journal_writer_t* writer);
+recovered_game_t* recovery_find(const char* name, const char* token, char* role);
+int recovery_is_reserved(const char* name);
+void recovery_set_started(recovered_game_t* game, int started);
+void recovery_finish(recovered_game_t* game);
+long recovery_expire(journal_writer_t* writer);
+
+#endif
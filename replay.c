@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+#include "replay.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// gets the result code of an OVER's winner field: X, O or D (REPLAY_UNFINISHED for anything else)
+int replay_result_from_winner(char winner) {
+    if (winner == 'X') {
+        return REPLAY_X_WON;
+    }
+    if (winner == 'O') {
+        return REPLAY_O_WON;
+    }
+    if (winner == 'D') {
+        return REPLAY_DRAW;
+    }
+    return REPLAY_UNFINISHED;
+}
+
+// opens an archive for appending, creating it with a header if it is new (returns 1 on success, 0 if error)
+int replay_archive_open(replay_archive_t* archive, const char* path) {
+    archive->fd = -1;
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("replay archive open");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("replay archive fstat");
+        close(fd);
+        return 0;
+    }
+    if (st.st_size == 0) {
+        replay_header_t header = {REPLAY_MAGIC, REPLAY_VERSION, 0};
+        if (write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+            perror("replay archive write");
+            close(fd);
+            return 0;
+        }
+    }
+    else {
+        replay_header_t header;
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION) {
+            fprintf(stderr, "%s is not a version %d replay archive\n", path, REPLAY_VERSION);
+            close(fd);
+            return 0;
+        }
+        // a record cut short (a full disk) would shift every record after it, drop it
+        off_t torn = (st.st_size - sizeof(header)) % sizeof(replay_t);
+        if (torn != 0 && ftruncate(fd, st.st_size - torn) < 0) {
+            perror("replay archive ftruncate");
+            close(fd);
+            return 0;
+        }
+    }
+    archive->fd = fd;
+    return 1;
+}
+
+// appends one game (returns 1 on success, 0 if the archive isn't open, -1 if error)
+// O_APPEND makes every 8 byte write land at the end even with many game threads appending
+int replay_archive_append(replay_archive_t* archive, replay_t replay) {
+    if (archive->fd < 0) {
+        return 0;
+    }
+    if (write(archive->fd, &replay, sizeof(replay)) != (ssize_t) sizeof(replay)) {
+        perror("replay archive write");
+        return -1;
+    }
+    return 1;
+}
+
+void replay_archive_close(replay_archive_t* archive) {
+    if (archive->fd >= 0) {
+        close(archive->fd);
+        archive->fd = -1;
+    }
+}
+
+// maps an archive for reading (returns 1 on success, 0 if the file is missing or not an archive)
+int replay_map_open(replay_map_t* map, const char* path) {
+    map->map = NULL;
+    map->records = NULL;
+    map->count = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("replay archive open");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(replay_header_t)) {
+        fprintf(stderr, "%s is not a replay archive\n", path);
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+    const replay_header_t* header = data;
+    if (header->magic != REPLAY_MAGIC || header->version != REPLAY_VERSION) {
+        fprintf(stderr, "%s is not a version %d replay archive\n", path, REPLAY_VERSION);
+        munmap(data, st.st_size);
+        return 0;
+    }
+    map->map = data;
+    map->map_size = st.st_size;
+    map->records = (const replay_t*) (header + 1);
+    map->count = (st.st_size - sizeof(replay_header_t)) / sizeof(replay_t);
+    return 1;
+}
+
+void replay_map_close(replay_map_t* map) {
+    if (map->map != NULL) {
+        munmap(map->map, map->map_size);
+        map->map = NULL;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// archive finished classic games are appended to by the server
+#define REPLAY_PATH "replays.ttr"
+#define REPLAY_MAGIC 0x52545454  // "TTTR"
+#define REPLAY_VERSION 1
+// a 3x3 game has at most 9 moves, one nibble each
+#define REPLAY_MAX_MOVES 9
+// nibble of a move that wasn't played
+#define REPLAY_NO_MOVE 0xF
+#define REPLAY_LENGTH_SHIFT 36
+#define REPLAY_RESULT_SHIFT 40
+
+// result of an archived game, the same values sim.c uses so simulated games archive as they are
+#define REPLAY_UNFINISHED 0
+#define REPLAY_X_WON 1
+#define REPLAY_O_WON 2
+#define REPLAY_DRAW 3
+
+// a whole 3x3 game in 8 bytes:
+// bits 0-35 are the cells (0-8, (row - 1) * 3 + (col - 1)) of moves 1 to 9, REPLAY_NO_MOVE after the last one
+// bits 36-39 are the number of moves and bits 40-41 the result
+typedef uint64_t replay_t;
+
+// an archive file starts with this header and is followed by replay_t records, the number of records comes from the file size
+typedef struct replay_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;   // keeps the records 8 byte aligned in a mapped archive
+} replay_header_t;
+
+// an archive open for appending
+typedef struct replay_archive {
+    int fd;              // -1 if the archive couldn't be opened, appends are then dropped
+} replay_archive_t;
+
+// an archive mapped read only for scanning
+typedef struct replay_map {
+    void* map;
+    size_t map_size;
+    const replay_t* records;
+    size_t count;
+} replay_map_t;
+
+// a game with no moves yet
+static inline replay_t replay_empty(void) {
+    return 0xFFFFFFFFFull;
+}
+
+static inline int replay_length(replay_t replay) {
+    return (replay >> REPLAY_LENGTH_SHIFT) & 0xF;
+}
+
+static inline int replay_result(replay_t replay) {
+    return (replay >> REPLAY_RESULT_SHIFT) & 3;
+}
+
+// gets the cell of move i (0 based), REPLAY_NO_MOVE if the game was shorter
+static inline int replay_cell(replay_t replay, int i) {
+    return (replay >> (4 * i)) & 0xF;
+}
+
+// adds the next move, a full game is left as it is
+static inline replay_t replay_add_move(replay_t replay, int cell) {
+    int length = replay_length(replay);
+    if (length >= REPLAY_MAX_MOVES) {
+        return replay;
+    }
+    replay &= ~((replay_t) 0xF << (4 * length));
+    replay |= (replay_t) cell << (4 * length);
+    return replay + ((replay_t) 1 << REPLAY_LENGTH_SHIFT);
+}
+
+static inline replay_t replay_set_result(replay_t replay, int result) {
+    return (replay & ~((replay_t) 3 << REPLAY_RESULT_SHIFT)) | ((replay_t) result << REPLAY_RESULT_SHIFT);
+}
+
+int replay_result_from_winner(char winner);
+int replay_archive_open(replay_archive_t* archive, const char* path);
+int replay_archive_append(replay_archive_t* archive, replay_t replay);
+void replay_archive_close(replay_archive_t* archive);
+int replay_map_open(replay_map_t* map, const char* path);
+void replay_map_close(replay_map_t* map);
+
+#endif
@@ -0,0 +1,134 @@
+#include "sim.h"
+#include <string.h>
+
+// gives every lane its own xorshift state (the state must never be 0)
+void sim_batch_seed(sim_batch_t* batch, uint32_t seed) {
+    uint32_t s = seed * 2654435761u + 1;
+    for (int i = 0; i < SIM_BATCH; i++) {
+        // splitmix style scramble so neighbouring lanes don't start out correlated
+        s += 0x9E3779B9u;
+        uint32_t z = s;
+        z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+        z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+        z ^= z >> 16;
+        batch->rng[i] = z != 0 ? z : 1;
+    }
+}
+
+// plays one ply on every lane that is still playing
+// everything in the loop body is branchless so gcc can turn it into SIMD over the lanes
+static void play_ply(sim_batch_t* batch, int ply) {
+    const uint32_t empties = BOARD_CELLS - ply;
+    // all ones when X moves on this ply, 0 when O moves
+    const uint16_t x_moves = (ply % 2 == 0) ? 0xFFFF : 0;
+    const uint16_t won = (ply % 2 == 0) ? SIM_X_WON : SIM_O_WON;
+    const uint16_t not_won = (ply == BOARD_CELLS - 1) ? SIM_DRAW : SIM_PLAYING;
+    uint16_t* restrict xs = batch->x;
+    uint16_t* restrict os = batch->o;
+    uint16_t* restrict results = batch->result;
+    uint16_t* restrict lengths = batch->length;
+    uint8_t* restrict cells = batch->cells[ply];
+    uint32_t* restrict rngs = batch->rng;
+
+    for (int i = 0; i < SIM_BATCH; i++) {
+        uint32_t r = rngs[i];
+        r ^= r << 13;
+        r ^= r >> 17;
+        r ^= r << 5;
+        rngs[i] = r;
+
+        uint16_t x = xs[i];
+        uint16_t o = os[i];
+        uint16_t empty = (uint16_t) ~(x | o) & BOARD_FULL;
+        // every lane that is still playing has exactly `empties` free cells, pick one of them uniformly
+        uint16_t pick = (uint16_t) (((r >> 16) * empties) >> 16);
+
+        // find the pick-th free cell without branches
+        uint16_t seen = 0;
+        uint16_t bit = 0;
+        uint16_t cell = 0;
+        for (int c = 0; c < BOARD_CELLS; c++) {
+            uint16_t is_free = (empty >> c) & 1;
+            uint16_t hit = is_free & (seen == pick);
+            bit |= (uint16_t) (hit << c);
+            cell |= (uint16_t) (hit * c);
+            seen += is_free;
+        }
+
+        uint16_t playing = results[i] == SIM_PLAYING;
+        bit &= (uint16_t) -playing;
+        x |= bit & x_moves;
+        o |= bit & (uint16_t) ~x_moves;
+        uint16_t mover = (x & x_moves) | (o & (uint16_t) ~x_moves);
+
+        uint16_t win = 0;
+        for (int l = 0; l < BOARD_LINES; l++) {
+            win |= (mover & board_win_masks[l]) == board_win_masks[l];
+        }
+
+        uint16_t outcome = win ? won : not_won;
+        xs[i] = x;
+        os[i] = o;
+        results[i] = playing ? outcome : results[i];
+        lengths[i] += playing;
+        cells[i] = (uint8_t) cell;
+    }
+}
+
+// plays every game in the batch from an empty board to the end
+void sim_batch_play(sim_batch_t* batch) {
+    memset(batch->x, 0, sizeof(batch->x));
+    memset(batch->o, 0, sizeof(batch->o));
+    memset(batch->result, 0, sizeof(batch->result));
+    memset(batch->length, 0, sizeof(batch->length));
+    for (int ply = 0; ply < BOARD_CELLS; ply++) {
+        play_ply(batch, ply);
+    }
+}
+
+// adds the finished games of a batch to the totals
+void sim_batch_tally(const sim_batch_t* batch, sim_totals_t* totals) {
+    long counts[4] = {0, 0, 0, 0};
+    long moves = 0;
+    for (int i = 0; i < SIM_BATCH; i++) {
+        counts[batch->result[i] & 3]++;
+        moves += batch->length[i];
+    }
+    totals->games += SIM_BATCH;
+    totals->x_wins += counts[SIM_X_WON];
+    totals->o_wins += counts[SIM_O_WON];
+    totals->draws += counts[SIM_DRAW];
+    totals->moves += moves;
+}
+
+// replays every stride-th game of a batch with the server's rules from board.c and returns the number of games that disagree
+int sim_batch_verify(const sim_batch_t* batch, int stride) {
+    int mismatches = 0;
+    for (int i = 0; i < SIM_BATCH; i += stride) {
+        board_t board;
+        board_init(&board);
+        int result = SIM_PLAYING;
+        int length = 0;
+        for (int ply = 0; ply < BOARD_CELLS && result == SIM_PLAYING; ply++) {
+            char role = (ply % 2 == 0) ? 'X' : 'O';
+            int row = batch->cells[ply][i] / 3 + 1;
+            int col = batch->cells[ply][i] % 3 + 1;
+            if (!board_is_valid_move(&board, row, col)) {
+                result = -1;
+                break;
+            }
+            board_place(&board, row, col, role);
+            length++;
+            if (board_check_win(&board, role)) {
+                result = (role == 'X') ? SIM_X_WON : SIM_O_WON;
+            }
+            else if (board_check_tie(&board)) {
+                result = SIM_DRAW;
+            }
+        }
+        if (result != batch->result[i] || length != batch->length[i] || board.x != batch->x[i] || board.o != batch->o[i]) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
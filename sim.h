@@ -0,0 +1,40 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "board.h"
+
+// number of games advanced together, every array in sim_batch_t has one lane per game
+#define SIM_BATCH 4096
+
+// result of a simulated game (stored per lane in sim_batch_t.result)
+#define SIM_PLAYING 0
+#define SIM_X_WON 1
+#define SIM_O_WON 2
+#define SIM_DRAW 3
+
+// a batch of 3x3 games in structure-of-arrays layout so each step is a plain loop over lanes the compiler can vectorize
+typedef struct sim_batch {
+    uint16_t x[SIM_BATCH];                    // cells taken by X (same bit layout as board_t)
+    uint16_t o[SIM_BATCH];                    // cells taken by O
+    uint16_t result[SIM_BATCH];               // SIM_PLAYING until the game is over
+    uint16_t length[SIM_BATCH];               // number of moves played
+    uint8_t cells[BOARD_CELLS][SIM_BATCH];    // cell index (0-8) played on each ply, used to replay a game
+    uint32_t rng[SIM_BATCH];                  // xorshift state of each lane
+} sim_batch_t;
+
+// running totals of finished games
+typedef struct sim_totals {
+    long games;
+    long x_wins;
+    long o_wins;
+    long draws;
+    long moves;
+} sim_totals_t;
+
+void sim_batch_seed(sim_batch_t* batch, uint32_t seed);
+void sim_batch_play(sim_batch_t* batch);
+void sim_batch_tally(const sim_batch_t* batch, sim_totals_t* totals);
+int sim_batch_verify(const sim_batch_t* batch, int stride);
+
+#endif
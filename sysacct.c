@@ -0,0 +1,77 @@
+#include "sysacct.h"
+
+__thread sysacct_t* sysacct_current = NULL;
+__thread sysacct_phase_t sysacct_phase = SYSACCT_HANDSHAKE;
+
+static const char* call_names[SYSACCT_CALLS] = {"read", "write", "peek", "setsockopt", "close"};
+static const char* phase_names[SYSACCT_PHASES] = {"handshake", "begin", "play", "over"};
+
+// sends the calling thread's syscalls to account from phase on, NULL stops counting them
+void sysacct_attach(sysacct_t* account, sysacct_phase_t phase) {
+    sysacct_current = account;
+    sysacct_phase = phase;
+}
+
+void sysacct_set_phase(sysacct_phase_t phase) {
+    sysacct_phase = phase;
+}
+
+// adds an account into total, like the handshakes of both players into their game
+void sysacct_add(sysacct_t* total, const sysacct_t* account) {
+    for (int phase = 0; phase < SYSACCT_PHASES; phase++) {
+        for (int call = 0; call < SYSACCT_CALLS; call++) {
+            total->calls[phase][call] += account->calls[phase][call];
+        }
+        total->bytes_in[phase] += account->bytes_in[phase];
+        total->bytes_out[phase] += account->bytes_out[phase];
+    }
+}
+
+// one syscall over every phase
+uint64_t sysacct_calls(const sysacct_t* account, sysacct_call_t call) {
+    uint64_t calls = 0;
+    for (int phase = 0; phase < SYSACCT_PHASES; phase++) {
+        calls += account->calls[phase][call];
+    }
+    return calls;
+}
+
+// every syscall over every phase
+uint64_t sysacct_total(const sysacct_t* account) {
+    uint64_t total = 0;
+    for (int call = 0; call < SYSACCT_CALLS; call++) {
+        total += sysacct_calls(account, call);
+    }
+    return total;
+}
+
+const char* sysacct_call_name(sysacct_call_t call) {
+    return call_names[call];
+}
+
+const char* sysacct_phase_name(sysacct_phase_t phase) {
+    return phase_names[phase];
+}
+
+// prints one line: the syscalls by kind, by phase, the bytes each way and the syscalls per move
+void sysacct_print(FILE* out, const sysacct_t* account, int moves) {
+    uint64_t total = sysacct_total(account);
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    fprintf(out, "%llu syscalls (", (unsigned long long) total);
+    for (int call = 0; call < SYSACCT_CALLS; call++) {
+        fprintf(out, "%s%llu %s", call ? ", " : "", (unsigned long long) sysacct_calls(account, call), call_names[call]);
+    }
+    fprintf(out, "; ");
+    for (int phase = 0; phase < SYSACCT_PHASES; phase++) {
+        uint64_t calls = 0;
+        for (int call = 0; call < SYSACCT_CALLS; call++) {
+            calls += account->calls[phase][call];
+        }
+        bytes_in += account->bytes_in[phase];
+        bytes_out += account->bytes_out[phase];
+        fprintf(out, "%s%llu %s", phase ? ", " : "", (unsigned long long) calls, phase_names[phase]);
+    }
+    fprintf(out, "), %llu bytes in, %llu bytes out, %.1f syscalls per move", (unsigned long long) bytes_in, (unsigned long long) bytes_out,
+        moves > 0 ? (double) total / moves : 0.0);
+}
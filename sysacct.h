@@ -0,0 +1,61 @@
+#ifndef SYSACCT_H
+#define SYSACCT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// the syscalls a player's connection costs the server
+typedef enum sysacct_call {
+    SYSACCT_READ,        // read in recieve_msg
+    SYSACCT_WRITE,       // writev in send_msg
+    SYSACCT_PEEK,        // recv MSG_PEEK in is_socket_connected
+    SYSACCT_SETSOCKOPT,  // the turn timeout
+    SYSACCT_CLOSE,
+    SYSACCT_CALLS
+} sysacct_call_t;
+
+// the part of a game a syscall is made for
+typedef enum sysacct_phase {
+    SYSACCT_HANDSHAKE,   // accept to WAIT sent, on the main thread, both players' added up
+    SYSACCT_BEGIN,       // the game thread starting to the first move being read
+    SYSACCT_PLAY,        // the moves
+    SYSACCT_OVER,        // OVER decided (or the game scrapped) to both sockets closed
+    SYSACCT_PHASES
+} sysacct_phase_t;
+
+// one game's syscalls and bytes by phase
+typedef struct sysacct {
+    uint32_t calls[SYSACCT_PHASES][SYSACCT_CALLS];
+    uint64_t bytes_in[SYSACCT_PHASES];
+    uint64_t bytes_out[SYSACCT_PHASES];
+} sysacct_t;
+
+// the account the calling thread's syscalls go to, NULL on threads that serve no game right now
+extern __thread sysacct_t* sysacct_current;
+extern __thread sysacct_phase_t sysacct_phase;
+
+// counts a syscall and the bytes it moved, plain adds since an account is only written by the thread it is attached to
+static inline void sysacct_count(sysacct_call_t call, long bytes_in, long bytes_out) {
+    sysacct_t* account = sysacct_current;
+    if (account == NULL) {
+        return;
+    }
+    account->calls[sysacct_phase][call]++;
+    if (bytes_in > 0) {
+        account->bytes_in[sysacct_phase] += bytes_in;
+    }
+    if (bytes_out > 0) {
+        account->bytes_out[sysacct_phase] += bytes_out;
+    }
+}
+
+void sysacct_attach(sysacct_t* account, sysacct_phase_t phase);
+void sysacct_set_phase(sysacct_phase_t phase);
+void sysacct_add(sysacct_t* total, const sysacct_t* account);
+uint64_t sysacct_calls(const sysacct_t* account, sysacct_call_t call);
+uint64_t sysacct_total(const sysacct_t* account);
+const char* sysacct_call_name(sysacct_call_t call);
+const char* sysacct_phase_name(sysacct_phase_t phase);
+void sysacct_print(FILE* out, const sysacct_t* account, int moves);
+
+#endif
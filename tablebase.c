@@ -0,0 +1,148 @@
+// NOTE: must use option -pthread when compiling!
+#define _POSIX_C_SOURCE 200809L
+#include "tablebase.h"
+#include "canon.h"
+#include "perfect.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 4 rows, 4 columns and 2 diagonals
+const uint16_t tablebase_win_masks[TABLEBASE_LINES] = {0x000F, 0x00F0, 0x0F00, 0xF000, 0x1111, 0x2222, 0x4444, 0x8888, 0x8421, 0x1248};
+
+tablebase_t tablebase4 = {NULL, NULL, NULL, 0, NULL, 0};
+
+// ternary value of every byte of a mask (digit i is 1 when bit i is set), 3^8 = 6561 scales the high byte
+static const uint32_t byte_power = 6561;
+static uint16_t ternary8[256];
+static pthread_once_t ternary8_once = PTHREAD_ONCE_INIT;
+
+static void build_ternary8(void) {
+    for (int byte = 0; byte < 256; byte++) {
+        uint16_t value = 0;
+        uint16_t power = 1;
+        for (int bit = 0; bit < 8; bit++) {
+            if (byte & (1 << bit)) {
+                value += power;
+            }
+            power *= 3;
+        }
+        ternary8[byte] = value;
+    }
+}
+
+// checks if a mask holds one of the 10 lines (1 if yes, else 0)
+int tablebase_has_line(uint16_t mask) {
+    for (int line = 0; line < TABLEBASE_LINES; line++) {
+        if ((mask & tablebase_win_masks[line]) == tablebase_win_masks[line]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// gets the ternary index of a 4x4 board as it is (X is 1, O is 2 in digit i for cell i)
+uint32_t tablebase_ternary(uint16_t x, uint16_t o) {
+    pthread_once(&ternary8_once, build_ternary8);
+    uint32_t tx = ternary8[x & 0xFF] + byte_power * ternary8[x >> 8];
+    uint32_t to = ternary8[o & 0xFF] + byte_power * ternary8[o >> 8];
+    return tx + 2 * to;
+}
+
+// gets the position of an index among the stored positions (returns -1 if the index isn't stored)
+long tablebase_rank(const tablebase_t* tb, uint32_t index) {
+    uint32_t word = index / 64;
+    uint64_t bit = (uint64_t) 1 << (index % 64);
+    if (!(tb->reached[word] & bit)) {
+        return -1;
+    }
+    long rank = tb->ranks[word / TABLEBASE_RANK_WORDS];
+    for (uint32_t w = word - word % TABLEBASE_RANK_WORDS; w < word; w++) {
+        rank += __builtin_popcountll(tb->reached[w]);
+    }
+    return rank + __builtin_popcountll(tb->reached[word] & (bit - 1));
+}
+
+// maps a tablebase file written by tbgen (returns 1 on success, 0 if the file is missing or not a tablebase)
+int tablebase_open(tablebase_t* tb, const char* path) {
+    tb->map = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(tablebase_header_t)) {
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+    const tablebase_header_t* header = map;
+    size_t expected = sizeof(tablebase_header_t) + TABLEBASE_WORDS * sizeof(uint64_t) + TABLEBASE_RANKS * sizeof(uint32_t) + (header->positions + 3) / 4;
+    if (header->magic != TABLEBASE_MAGIC || header->version != TABLEBASE_VERSION || (size_t) st.st_size != expected) {
+        fprintf(stderr, "%s is not a version %d tablebase\n", path, TABLEBASE_VERSION);
+        munmap(map, st.st_size);
+        return 0;
+    }
+    tb->map = map;
+    tb->map_size = st.st_size;
+    tb->positions = header->positions;
+    tb->reached = (const uint64_t*) (header + 1);
+    tb->ranks = (const uint32_t*) (tb->reached + TABLEBASE_WORDS);
+    tb->values = (const uint8_t*) (tb->ranks + TABLEBASE_RANKS);
+    return 1;
+}
+
+void tablebase_close(tablebase_t* tb) {
+    if (tb->map != NULL) {
+        munmap(tb->map, tb->map_size);
+        tb->map = NULL;
+    }
+}
+
+// gets the value of a position for the player to move (PERFECT_LOSS, PERFECT_DRAW or PERFECT_WIN, -1 if it isn't reachable)
+int tablebase_value(const tablebase_t* tb, uint16_t x, uint16_t o) {
+    uint32_t key = canon_square4_key(x, o, NULL);
+    long rank = tablebase_rank(tb, tablebase_ternary(key & 0xFFFF, key >> 16));
+    if (rank < 0) {
+        return -1;
+    }
+    return (tb->values[rank / 4] >> (2 * (rank % 4))) & 3;
+}
+
+// gets a mask of every move that keeps the best value for the player to move (0 if the game is over or the position unknown)
+uint16_t tablebase_best_moves(const tablebase_t* tb, uint16_t x, uint16_t o) {
+    if (tablebase_has_line(x) || tablebase_has_line(o)) {
+        return 0;
+    }
+    int x_to_move = __builtin_popcount(x) == __builtin_popcount(o);
+    uint16_t empty = ~(x | o) & TABLEBASE_FULL;
+    // the best move leaves the opponent the worst value
+    int worst = PERFECT_WIN + 1;
+    uint16_t moves = 0;
+    for (int cell = 0; cell < TABLEBASE_CELLS; cell++) {
+        uint16_t bit = 1 << cell;
+        if (!(empty & bit)) {
+            continue;
+        }
+        int value = x_to_move ? tablebase_value(tb, x | bit, o) : tablebase_value(tb, x, o | bit);
+        if (value < 0) {
+            return 0;
+        }
+        if (value < worst) {
+            worst = value;
+            moves = bit;
+        }
+        else if (value == worst) {
+            moves |= bit;
+        }
+    }
+    return moves;
+}
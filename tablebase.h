@@ -0,0 +1,53 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the 4x4 four in a row tablebase, cell (row, col) is bit (row - 1) * 4 + (col - 1) of the X or O mask
+#define TABLEBASE_CELLS 16
+#define TABLEBASE_FULL 0xFFFF
+#define TABLEBASE_LINES 10
+// ternary board indexes (3^16), the reached bitmap has one bit per index
+#define TABLEBASE_INDEXES 43046721u
+#define TABLEBASE_WORDS ((TABLEBASE_INDEXES + 63) / 64)
+// one rank count per this many bitmap words, a rank adds the popcounts of at most this many words
+#define TABLEBASE_RANK_WORDS 8
+#define TABLEBASE_RANKS ((TABLEBASE_WORDS + TABLEBASE_RANK_WORDS - 1) / TABLEBASE_RANK_WORDS)
+#define TABLEBASE_MAGIC 0x34545454u   // "TTT4"
+#define TABLEBASE_VERSION 1
+// file written by tbgen and mapped by the server at start
+#define TABLEBASE_PATH "tablebase4.bin"
+
+// file layout: this header, the reached bitmap (TABLEBASE_WORDS uint64), the rank counts (TABLEBASE_RANKS uint32)
+// and the values (2 bits per reached position in index order, PERFECT_LOSS/DRAW/WIN for the player to move)
+typedef struct tablebase_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t positions;  // reached canonical positions
+    uint32_t reserved;
+} tablebase_header_t;
+
+// only positions that are reachable and the smallest of their 8 symmetric copies are stored
+typedef struct tablebase {
+    const uint64_t* reached;  // bit per ternary index, set for every stored position
+    const uint32_t* ranks;    // stored positions before every TABLEBASE_RANK_WORDS words of reached
+    const uint8_t* values;    // packed values, 4 per byte
+    uint32_t positions;
+    void* map;                // the mapped file (NULL when not loaded)
+    size_t map_size;
+} tablebase_t;
+
+extern const uint16_t tablebase_win_masks[TABLEBASE_LINES];
+// the tablebase the server loads at start, map is NULL if the file wasn't there
+extern tablebase_t tablebase4;
+
+int tablebase_has_line(uint16_t mask);
+uint32_t tablebase_ternary(uint16_t x, uint16_t o);
+long tablebase_rank(const tablebase_t* tb, uint32_t index);
+int tablebase_open(tablebase_t* tb, const char* path);
+void tablebase_close(tablebase_t* tb);
+int tablebase_value(const tablebase_t* tb, uint16_t x, uint16_t o);
+uint16_t tablebase_best_moves(const tablebase_t* tb, uint16_t x, uint16_t o);
+
+#endif
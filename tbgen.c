@@ -0,0 +1,230 @@
+// builds the 4x4 four in a row tablebase with parallel retrograde analysis and writes it for the server to map
+// usage: ./tbgen tablebase4.bin [threads]
+// NOTE: must use option -pthread when compiling!
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "tablebase.h"
+#include "canon.h"
+#include "perfect.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+// positions (canonical packed keys x | o << 16) with the same number of stones, every move goes from one layer to the next
+typedef struct layer {
+    uint32_t* keys;
+    size_t count;
+} layer_t;
+
+// one worker's share of a layer
+typedef struct job {
+    const layer_t* layer;
+    size_t start;
+    size_t end;
+    layer_t found;     // forward pass: positions this worker reached first
+    size_t capacity;
+} job_t;
+
+layer_t layers[TABLEBASE_CELLS + 1];
+uint64_t* reached;
+uint32_t* ranks;
+uint8_t* values;      // one byte per stored position while building, packed when written
+tablebase_t tb;
+int threads;
+
+// forward pass: marks every child of the job's positions and keeps the ones no other worker marked first
+void* expand_worker(void* arg) {
+    job_t* job = arg;
+    for (size_t i = job->start; i < job->end; i++) {
+        uint32_t key = job->layer->keys[i];
+        uint16_t x = key & 0xFFFF;
+        uint16_t o = key >> 16;
+        // the game is over, nothing follows
+        if (tablebase_has_line(x) || tablebase_has_line(o)) {
+            continue;
+        }
+        int x_to_move = __builtin_popcount(x) == __builtin_popcount(o);
+        uint16_t empty = ~(x | o) & TABLEBASE_FULL;
+        for (uint16_t left = empty; left != 0; left &= left - 1) {
+            uint16_t bit = left & -left;
+            uint32_t child = x_to_move ? canon_square4_key(x | bit, o, NULL) : canon_square4_key(x, o | bit, NULL);
+            uint32_t index = tablebase_ternary(child & 0xFFFF, child >> 16);
+            uint64_t mask = (uint64_t) 1 << (index % 64);
+            if (__atomic_fetch_or(&reached[index / 64], mask, __ATOMIC_RELAXED) & mask) {
+                continue;
+            }
+            if (job->found.count == job->capacity) {
+                job->capacity = job->capacity ? job->capacity * 2 : 4096;
+                job->found.keys = realloc(job->found.keys, job->capacity * sizeof(uint32_t));
+                if (job->found.keys == NULL) {
+                    perror("realloc");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            job->found.keys[job->found.count++] = child;
+        }
+    }
+    return NULL;
+}
+
+// backward pass: solves the job's positions from the values of the next layer, which is already solved
+void* solve_worker(void* arg) {
+    job_t* job = arg;
+    for (size_t i = job->start; i < job->end; i++) {
+        uint32_t key = job->layer->keys[i];
+        uint16_t x = key & 0xFFFF;
+        uint16_t o = key >> 16;
+        long rank = tablebase_rank(&tb, tablebase_ternary(x, o));
+        // only the player who just moved can have a line, so the player to move has lost
+        if (tablebase_has_line(x) || tablebase_has_line(o)) {
+            values[rank] = PERFECT_LOSS;
+            continue;
+        }
+        if ((x | o) == TABLEBASE_FULL) {
+            values[rank] = PERFECT_DRAW;
+            continue;
+        }
+        int x_to_move = __builtin_popcount(x) == __builtin_popcount(o);
+        uint16_t empty = ~(x | o) & TABLEBASE_FULL;
+        int best = PERFECT_LOSS;
+        for (uint16_t left = empty; left != 0 && best != PERFECT_WIN; left &= left - 1) {
+            uint16_t bit = left & -left;
+            uint32_t child = x_to_move ? canon_square4_key(x | bit, o, NULL) : canon_square4_key(x, o | bit, NULL);
+            // the child's value is for the opponent so flip it
+            int value = 2 - values[tablebase_rank(&tb, tablebase_ternary(child & 0xFFFF, child >> 16))];
+            if (value > best) {
+                best = value;
+            }
+        }
+        values[rank] = best;
+    }
+    return NULL;
+}
+
+// splits a layer over the workers and waits for them
+void run_layer(const layer_t* layer, job_t* jobs, void* (*worker)(void*)) {
+    pthread_t tids[MAX_THREADS];
+    size_t share = (layer->count + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        jobs[t].layer = layer;
+        jobs[t].start = t * share < layer->count ? t * share : layer->count;
+        jobs[t].end = (t + 1) * share < layer->count ? (t + 1) * share : layer->count;
+        jobs[t].found.keys = NULL;
+        jobs[t].found.count = 0;
+        jobs[t].capacity = 0;
+        if (pthread_create(&tids[t], NULL, worker, &jobs[t]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+}
+
+int write_tablebase(const char* path, uint32_t positions) {
+    FILE* out = fopen(path, "wb");
+    if (out == NULL) {
+        perror("fopen");
+        return 0;
+    }
+    size_t packed_size = (positions + 3) / 4;
+    uint8_t* packed = calloc(packed_size, 1);
+    if (packed == NULL) {
+        perror("calloc");
+        fclose(out);
+        return 0;
+    }
+    for (uint32_t rank = 0; rank < positions; rank++) {
+        packed[rank / 4] |= values[rank] << (2 * (rank % 4));
+    }
+    tablebase_header_t header = {TABLEBASE_MAGIC, TABLEBASE_VERSION, positions, 0};
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1
+        && fwrite(reached, sizeof(uint64_t), TABLEBASE_WORDS, out) == TABLEBASE_WORDS
+        && fwrite(ranks, sizeof(uint32_t), TABLEBASE_RANKS, out) == TABLEBASE_RANKS
+        && fwrite(packed, 1, packed_size, out) == packed_size;
+    free(packed);
+    if (fclose(out) != 0 || !ok) {
+        perror("write");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: ./tbgen <output file> [threads]\n");
+        return EXIT_FAILURE;
+    }
+    threads = argc >= 3 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    job_t jobs[MAX_THREADS];
+    double start = now_seconds();
+
+    reached = calloc(TABLEBASE_WORDS, sizeof(uint64_t));
+    ranks = malloc(TABLEBASE_RANKS * sizeof(uint32_t));
+    if (reached == NULL || ranks == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    // forward: every reachable canonical position, one layer per number of stones
+    layers[0].keys = malloc(sizeof(uint32_t));
+    layers[0].keys[0] = 0;
+    layers[0].count = 1;
+    reached[0] = 1;
+    for (int n = 0; n < TABLEBASE_CELLS; n++) {
+        run_layer(&layers[n], jobs, expand_worker);
+        size_t count = 0;
+        for (int t = 0; t < threads; t++) {
+            count += jobs[t].found.count;
+        }
+        layers[n + 1].keys = malloc((count ? count : 1) * sizeof(uint32_t));
+        layers[n + 1].count = 0;
+        for (int t = 0; t < threads; t++) {
+            memcpy(layers[n + 1].keys + layers[n + 1].count, jobs[t].found.keys, jobs[t].found.count * sizeof(uint32_t));
+            layers[n + 1].count += jobs[t].found.count;
+            free(jobs[t].found.keys);
+        }
+    }
+
+    // rank counts so a position's value is found from its bit in reached
+    uint32_t positions = 0;
+    for (uint32_t w = 0; w < TABLEBASE_WORDS; w++) {
+        if (w % TABLEBASE_RANK_WORDS == 0) {
+            ranks[w / TABLEBASE_RANK_WORDS] = positions;
+        }
+        positions += __builtin_popcountll(reached[w]);
+    }
+    tb.reached = reached;
+    tb.ranks = ranks;
+    tb.positions = positions;
+    values = malloc(positions);
+    if (values == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    double forward = now_seconds() - start;
+
+    // backward: full boards first, every layer only needs the values of the one after it
+    for (int n = TABLEBASE_CELLS; n >= 0; n--) {
+        run_layer(&layers[n], jobs, solve_worker);
+    }
+    double seconds = now_seconds() - start;
+
+    if (!write_tablebase(argv[1], positions)) {
+        return EXIT_FAILURE;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const char* names[] = {"loss", "draw", "win"};
+    printf("tbgen: %u positions up to symmetry in %.2f s (%.2f s forward) on %d threads, %.0f positions/s, peak memory %ld MB\n", positions, seconds, forward, threads, positions / seconds, usage.ru_maxrss / 1024);
+    printf("tbgen: the empty board is a %s for X, wrote %s\n", names[values[tablebase_rank(&tb, 0)]], argv[1]);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+// measures an admin GAMES listing: a linked list of games like games_list copied into a snapshot with its mutex held,
+// then printed with it released, and how long a thread wanting the mutex meanwhile (like accept) waits for it
+// usage: ./adminbench [games]
+#define _POSIX_C_SOURCE 200809L
+#include "admin.h"
+#include "latency.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// the fields of a server game node a listing reads, about as big as one
+typedef struct bench_game {
+    char xName[128];
+    int xfd;
+    char oName[128];
+    int ofd;
+    uint64_t id;
+    unsigned published;
+    char turn;
+    int moves;
+    char board[ADMIN_BOARD_BYTES + 1];
+    struct bench_game* next;
+} bench_game_t;
+
+pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+bench_game_t* list = NULL;
+
+// copies the list the way the server's GAMES command does (returns the seconds the mutex was held)
+double take_snapshot(admin_snapshot_t* snapshot) {
+    admin_snapshot_clear(snapshot);
+    pthread_mutex_lock(&list_mutex);
+    double start = now_seconds();
+    for (bench_game_t* game_p = list; game_p != NULL; game_p = game_p->next) {
+        admin_game_t game;
+        char board[ADMIN_BOARD_BYTES + 1];
+        game.xfd = game_p->xfd;
+        game.ofd = game_p->ofd;
+        unsigned published;
+        do {
+            published = __atomic_load_n(&game_p->published, __ATOMIC_ACQUIRE);
+            game.id = game_p->id;
+            game.turn = game_p->turn;
+            game.moves = game_p->moves;
+            memcpy(board, game_p->board, sizeof(board));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while ((published & 1) || published != __atomic_load_n(&game_p->published, __ATOMIC_RELAXED));
+        game.state = published ? 'P' : 'W';
+        admin_snapshot_add(snapshot, &game, game_p->xName, game_p->oName, "classic", board);
+    }
+    double held = now_seconds() - start;
+    pthread_mutex_unlock(&list_mutex);
+    return held;
+}
+
+int main(int argc, char **argv) {
+    long games = argc >= 2 ? atol(argv[1]) : 100000;
+    // nodes are allocated one at a time like the server does, so the walk chases pointers around the heap
+    for (long i = 0; i < games; i++) {
+        bench_game_t* game = calloc(1, sizeof(bench_game_t));
+        if (game == NULL) {
+            perror("calloc");
+            return EXIT_FAILURE;
+        }
+        snprintf(game->xName, sizeof(game->xName), "player%ld", 2 * i);
+        game->xfd = 10 + 2 * i;
+        if (i % 10 != 0) {
+            snprintf(game->oName, sizeof(game->oName), "player%ld", 2 * i + 1);
+            game->ofd = 11 + 2 * i;
+            game->id = i + 1;
+            game->published = 2;
+            game->turn = (i % 2) ? 'X' : 'O';
+            game->moves = i % 9;
+            snprintf(game->board, sizeof(game->board), "XO..X..O.");
+        }
+        else {
+            game->ofd = -1;
+        }
+        game->next = list;
+        list = game;
+    }
+    admin_snapshot_t snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    // the first listing grows the buffers, later ones reuse them
+    double first = take_snapshot(&snapshot);
+    double best = 1e9;
+    for (int i = 0; i < 10; i++) {
+        double held = take_snapshot(&snapshot);
+        best = held < best ? held : best;
+    }
+    FILE* out = fopen("/dev/null", "w");
+    if (out == NULL) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    double start = now_seconds();
+    admin_snapshot_write(&snapshot, out);
+    double printed = now_seconds() - start;
+    fclose(out);
+    printf("adminbench: %zu games listed, mutex held %.2f ms for the first snapshot and %.2f ms after, printed in %.2f ms without it\n",
+        snapshot.count, first * 1e3, best * 1e3, printed * 1e3);
+    int ok = snapshot.count == (size_t) games && !snapshot.failed;
+    admin_snapshot_free(&snapshot);
+    while (list != NULL) {
+        bench_game_t* next = list->next;
+        free(list);
+        list = next;
+    }
+    printf("adminbench: %s\n", ok ? "OK" : "FAILED, games are missing from the snapshot");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
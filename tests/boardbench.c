@@ -0,0 +1,146 @@
+// microbenchmark comparing the old char[3][3] board helpers against the bitboard game core in board.c
+#define _POSIX_C_SOURCE 200809L
+#include "board.h"
+#include "latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GAMES 2000000
+#define SEQUENCES 4096
+
+// the board helpers the server used before board.c, kept here so both versions run the same games
+int old_check_if_valid_move(char board[3][3], int row, int col) {
+    if (row < 1 || row > 3 || col < 1 || col > 3) {
+        return 0;
+    }
+    if (board[row - 1][col - 1] != '.') {
+        return 0;
+    }
+    return 1;
+}
+
+int old_check_win(char board[3][3], char player_role) {
+    for (int i = 0; i < 3; i++) {
+        if (board[i][0] == player_role && board[i][1] == player_role && board[i][2] == player_role) {
+            return 1;
+        }
+        if (board[0][i] == player_role && board[1][i] == player_role && board[2][i] == player_role) {
+            return 1;
+        }
+    }
+    if (board[0][0] == player_role && board[1][1] == player_role && board[2][2] == player_role) {
+        return 1;
+    }
+    if (board[0][2] == player_role && board[1][1] == player_role && board[2][0] == player_role) {
+        return 1;
+    }
+    return 0;
+}
+
+int old_check_tie(char board[3][3]) {
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (board[i][j] == '.')
+                return 0;
+        }
+    }
+    return 1;
+}
+
+void old_format_board(char board[3][3], char* board_str) {
+    int index = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            board_str[index++] = board[i][j];
+        }
+    }
+    board_str[index] = '\0';
+}
+
+int main(int argc, char **argv) {
+    // random move orders (cell indexes 0-8) shared by both runs
+    static unsigned char sequences[SEQUENCES][BOARD_CELLS];
+    srand(42);
+    for (int s = 0; s < SEQUENCES; s++) {
+        for (int i = 0; i < BOARD_CELLS; i++) {
+            sequences[s][i] = i;
+        }
+        for (int i = BOARD_CELLS - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            unsigned char tmp = sequences[s][i];
+            sequences[s][i] = sequences[s][j];
+            sequences[s][j] = tmp;
+        }
+    }
+
+    // every move is validated, placed, formatted and checked for a win and a tie, just like make_move does
+    long old_moves = 0;
+    long old_wins = 0;
+    double start = now_seconds();
+    for (int g = 0; g < GAMES; g++) {
+        unsigned char* seq = sequences[g % SEQUENCES];
+        char board[3][3];
+        char board_str[10];
+        memset(board, '.', sizeof(board));
+        for (int i = 0; i < BOARD_CELLS; i++) {
+            char role = (i % 2 == 0) ? 'X' : 'O';
+            int row = seq[i] / 3 + 1;
+            int col = seq[i] % 3 + 1;
+            if (!old_check_if_valid_move(board, row, col)) {
+                break;
+            }
+            board[row - 1][col - 1] = role;
+            old_format_board(board, board_str);
+            old_moves++;
+            if (old_check_win(board, role)) {
+                old_wins++;
+                break;
+            }
+            if (old_check_tie(board)) {
+                break;
+            }
+        }
+    }
+    double old_time = now_seconds() - start;
+
+    long new_moves = 0;
+    long new_wins = 0;
+    start = now_seconds();
+    for (int g = 0; g < GAMES; g++) {
+        unsigned char* seq = sequences[g % SEQUENCES];
+        board_t board;
+        board_init(&board);
+        for (int i = 0; i < BOARD_CELLS; i++) {
+            char role = (i % 2 == 0) ? 'X' : 'O';
+            int row = seq[i] / 3 + 1;
+            int col = seq[i] % 3 + 1;
+            if (!board_is_valid_move(&board, row, col)) {
+                break;
+            }
+            board_place(&board, row, col, role);
+            new_moves++;
+            if (board_check_win(&board, role)) {
+                new_wins++;
+                break;
+            }
+            if (board_check_tie(&board)) {
+                break;
+            }
+        }
+    }
+    double new_time = now_seconds() - start;
+
+    // both versions must agree on every game or the comparison means nothing
+    if (old_moves != new_moves || old_wins != new_wins) {
+        fprintf(stderr, "MISMATCH: char board %ld moves %ld wins, bitboard %ld moves %ld wins\n", old_moves, old_wins, new_moves, new_wins);
+        return EXIT_FAILURE;
+    }
+
+    printf("games: %d moves: %ld wins: %ld\n", GAMES, new_moves, new_wins);
+    printf("char board: %.2f ns/move\n", old_time * 1e9 / old_moves);
+    printf("bitboard:   %.2f ns/move\n", new_time * 1e9 / new_moves);
+    printf("speedup:    %.2fx\n", old_time / new_time);
+    return EXIT_SUCCESS;
+}
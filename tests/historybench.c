@@ -0,0 +1,140 @@
+// measures the history index: game threads adding finished games while it compacts, then last 50 games queries
+// every queried player's count is checked against what was posted
+// usage: ./historybench [threads] [games per thread] [players]
+#define _POSIX_C_SOURCE 200809L
+#include "history.h"
+#include "latency.h"
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DIR "/tmp/ttt-history-bench"
+#define MAX_THREADS 64
+#define QUERIES 10000
+
+typedef struct worker {
+    pthread_t tid;
+    int id;
+    long games;
+} worker_t;
+
+long player_count = 1000000;
+uint32_t* games_of;   // games posted for each player
+
+// removes the index files a previous run left
+void clear_dir() {
+    DIR* dirp = opendir(BENCH_DIR);
+    if (dirp == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    char path[512];
+    while ((entry = readdir(dirp)) != NULL) {
+        if (strncmp(entry->d_name, "history-", 8) == 0) {
+            snprintf(path, sizeof(path), "%s/%s", BENCH_DIR, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dirp);
+}
+
+void* add_games(void* arg) {
+    worker_t* worker = arg;
+    uint32_t state = worker->id * 2654435761u + 1;
+    char x_name[32];
+    char o_name[32];
+    journal_position_t begun_at = {1, (uint16_t) worker->id, 0, 0};
+    journal_position_t over_at = begun_at;
+    for (long game = 0; game < worker->games; game++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        long x = state % player_count;
+        long o = (x + 1 + (state >> 8) % (player_count - 1)) % player_count;
+        snprintf(x_name, sizeof(x_name), "player%ld", x);
+        snprintf(o_name, sizeof(o_name), "player%ld", o);
+        over_at.offset = begun_at.offset = game;
+        if (history_add_game(&history, ((uint64_t) worker->id << 32) | game, x_name, o_name, &begun_at, &over_at) == 1) {
+            __atomic_fetch_add(&games_of[x], 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&games_of[o], 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+// queries random players, checking the count, the hash and the order of what comes back (returns us per query, -1 if a check failed)
+double time_queries() {
+    history_entry_t entries[HISTORY_QUERY_GAMES];
+    char name[32];
+    double start = now_seconds();
+    for (long i = 0; i < QUERIES; i++) {
+        long player = (i * 7919) % player_count;
+        snprintf(name, sizeof(name), "player%ld", player);
+        int found = history_query(BENCH_DIR, name, entries, HISTORY_QUERY_GAMES);
+        int expected = games_of[player] < HISTORY_QUERY_GAMES ? (int) games_of[player] : HISTORY_QUERY_GAMES;
+        if (found != expected) {
+            fprintf(stderr, "%s has %d games in the index, %u were posted\n", name, found, games_of[player]);
+            return -1;
+        }
+        for (int j = 0; j < found; j++) {
+            if (entries[j].name_hash != history_hash(name) || (j > 0 && entries[j].time_ns > entries[j - 1].time_ns)) {
+                fprintf(stderr, "%s got a game that isn't theirs or out of order\n", name);
+                return -1;
+            }
+        }
+    }
+    return (now_seconds() - start) * 1e6 / QUERIES;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long games = argc >= 3 ? atol(argv[2]) : 250000;
+    player_count = argc >= 4 ? atol(argv[3]) : 1000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    mkdir(BENCH_DIR, 0755);
+    clear_dir();
+    games_of = calloc(player_count, sizeof(uint32_t));
+    if (games_of == NULL || !history_open(&history, BENCH_DIR)) {
+        return EXIT_FAILURE;
+    }
+
+    worker_t workers[MAX_THREADS];
+    double start = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        workers[t].id = t + 1;
+        workers[t].games = games;
+        if (pthread_create(&workers[t].tid, NULL, add_games, &workers[t]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].tid, NULL);
+    }
+    double add_seconds = now_seconds() - start;
+    long posted = threads * games;
+    // the log being appended to is left as it is, queries read it alongside the runs
+    history_close(&history);
+
+    double tail_us = time_queries();
+    start = now_seconds();
+    int runs = history_compact(BENCH_DIR, LONG_MAX);
+    double compact_seconds = now_seconds() - start;
+    double query_us = time_queries();
+    if (tail_us < 0 || query_us < 0 || runs < 0) {
+        return EXIT_FAILURE;
+    }
+
+    printf("history: %ld games (%ld entries) indexed by %d threads for %ld players in %.3f s, %.0f ns a game\n", posted, 2 * posted, threads, player_count, add_seconds, add_seconds * 1e9 / posted);
+    printf("history: last %d games query %.1f us with the log uncompacted, %.1f us over %d runs after compacting it in %.3f s, every count matches\n", HISTORY_QUERY_GAMES, tail_us, query_us, runs, compact_seconds);
+    clear_dir();
+    rmdir(BENCH_DIR);
+    free(games_of);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+// measures what journaling adds to a move: the cost of a MOVD journal append next to the two send_msg calls make_move does
+// then checks two games sharing a writer, as they do once every writer is claimed, append every record whole
+// usage: ./journalbench [none, group or always] [records]
+#define _POSIX_C_SOURCE 200809L
+#include "journal.h"
+#include "latency.h"
+#include "protocol.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DIR "/tmp/ttt-journal-bench"
+#define SHARED_RECORDS 100000
+
+// one of two games appending to the same writer, each with its own game id
+typedef struct sharer {
+    pthread_t tid;
+    journal_writer_t* writer;
+    uint64_t game_id;
+    long failed;
+} sharer_t;
+
+void* append_shared(void* arg) {
+    sharer_t* sharer = arg;
+    for (long i = 0; i < SHARED_RECORDS; i++) {
+        sharer->failed += journal_append_deferred(sharer->writer, MOVD, sharer->game_id, "O|3,3", 5) != 1;
+    }
+    return NULL;
+}
+
+// counts the shared writers' records by game, a record written over by the other game would have a wrong id or payload
+void count_shared(const journal_record_t* record, const char* payload, void* arg) {
+    long* counts = arg;
+    if (record->game_id >= 2 && record->game_id <= 3 && record->length == 5 && memcmp(payload, "O|3,3", 5) == 0) {
+        counts[record->game_id - 2]++;
+    }
+    else if (record->game_id != 1) {
+        counts[2]++;
+    }
+}
+
+// removes the segments this run wrote
+void remove_segments(void) {
+    DIR* dir = opendir(BENCH_DIR);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    char path[512];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strstr(entry->d_name, ".jnl") != NULL) {
+            snprintf(path, sizeof(path), "%s/%s", BENCH_DIR, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+int main(int argc, char **argv) {
+    JournalSync sync = JOURNAL_SYNC_GROUP;
+    if (argc >= 2 && !journal_parse_sync(argv[1], &sync)) {
+        fprintf(stderr, "unknown policy %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    long records = argc >= 3 ? atol(argv[2]) : (sync == JOURNAL_SYNC_ALWAYS ? 2000 : 1000000);
+
+    if (!journal_init(BENCH_DIR, sync)) {
+        return EXIT_FAILURE;
+    }
+    journal_writer_t* writer = journal_claim();
+    if (writer == NULL) {
+        fprintf(stderr, "no journal writer\n");
+        return EXIT_FAILURE;
+    }
+    double start = now_seconds();
+    for (long i = 0; i < records; i++) {
+        if (journal_append(writer, MOVD, 1, "X|12,15", 7) != 1) {
+            fprintf(stderr, "append failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+    double append_ns = (now_seconds() - start) * 1e9 / records;
+    journal_position_t last;
+    int have_last = journal_last_position(writer, &last);
+
+    // a second game shares the writer
+    sharer_t sharers[2];
+    for (int i = 0; i < 2; i++) {
+        sharers[i].writer = writer;
+        sharers[i].game_id = 2 + i;
+        sharers[i].failed = 0;
+        pthread_create(&sharers[i].tid, NULL, append_shared, &sharers[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(sharers[i].tid, NULL);
+    }
+    journal_release(writer);
+    journal_shutdown();
+    long counts[3] = {0, 0, 0};
+    journal_scan(BENCH_DIR, 0, count_shared, counts);
+    int shared_ok = sharers[0].failed == 0 && sharers[1].failed == 0 && counts[0] == SHARED_RECORDS && counts[1] == SHARED_RECORDS && counts[2] == 0;
+    // the history index reads a game's records by position, asking for the right record as another game's must fail
+    journal_record_t record;
+    char payload[JOURNAL_MAX_PAYLOAD + 1];
+    int read_ok = have_last && journal_read(BENCH_DIR, &last, 1, &record, payload, sizeof(payload)) == 7 && strcmp(payload, "X|12,15") == 0
+        && journal_read(BENCH_DIR, &last, 2, &record, payload, sizeof(payload)) == -1;
+    remove_segments();
+
+    // the same MOVD a 15x15 game sends, written to a socket pair and read back so the buffer never fills
+    // send_msg logs every message like the server does, that goes to /dev/null here
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        return EXIT_FAILURE;
+    }
+    char board[15 * 15 + 1];
+    memset(board, '.', sizeof(board) - 1);
+    board[sizeof(board) - 1] = '\0';
+    message_t msg;
+    char drain[BUFFER_SIZE];
+    long sends = 100000;
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    freopen("/dev/null", "w", stdout);
+    start = now_seconds();
+    for (long i = 0; i < sends; i++) {
+        set_message_fields(&msg, 6, "X", "12,15");
+        if (send_msg(fds[0], &msg, board) == -1 || read(fds[1], drain, sizeof(drain)) <= 0) {
+            perror("send");
+            return EXIT_FAILURE;
+        }
+    }
+    double send_ns = (now_seconds() - start) * 1e9 / sends;
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    printf("journal append (%s): %.1f ns/record over %ld records\n", argc >= 2 ? argv[1] : "group", append_ns, records);
+    printf("send_msg MOVD:          %.1f ns/message\n", send_ns);
+    printf("a move sends 2 MOVD and appends 1 record: journaling adds %.2f%%\n", 100.0 * append_ns / (2 * send_ns));
+    printf("2 games sharing a writer: %ld and %ld of %d records each read back, %ld torn\n", counts[0], counts[1], SHARED_RECORDS, counts[2]);
+    printf("last record read back by position: %s\n", read_ok ? "its own game's, refused for another game" : "wrong");
+    printf("journalbench: %s\n", shared_ok && read_ok ? "OK" : (shared_ok ? "FAILED, a record read by position" : "FAILED, games sharing a writer lost or tore records"));
+    return shared_ok && read_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,110 @@
+// measures the latency histograms: threads recording at once like game threads do, then merging them like a report does
+// checks every count made it and that the merged percentiles are within a bucket of the exact ones
+// usage: ./latencybench [threads] [values per thread]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+typedef struct worker {
+    pthread_t tid;
+    int id;
+    long values;
+    uint64_t* recorded;
+} worker_t;
+
+// the threads start recording together once their values are made
+pthread_barrier_t ready;
+
+// values spread from ns to 2 seconds like the phases are, then recorded in a tight loop
+void* record_values(void* arg) {
+    worker_t* worker = arg;
+    uint32_t state = worker->id * 2654435761u + 1;
+    for (long i = 0; i < worker->values; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        worker->recorded[i] = (uint64_t) (state & 0xFFFF) << (state >> 28);
+    }
+    pthread_barrier_wait(&ready);
+    for (long i = 0; i < worker->values; i++) {
+        latency_record(LATENCY_MOVE, worker->recorded[i]);
+    }
+    return NULL;
+}
+
+int compare_values(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*) a;
+    uint64_t right = *(const uint64_t*) b;
+    return (left > right) - (left < right);
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long values = argc >= 3 ? atol(argv[2]) : 10000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    worker_t workers[MAX_THREADS];
+    uint64_t* all = malloc(threads * values * sizeof(uint64_t));
+    if (all == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    pthread_barrier_init(&ready, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        workers[i].values = values;
+        workers[i].recorded = all + i * values;
+        pthread_create(&workers[i].tid, NULL, record_values, &workers[i]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+    }
+    // the time a core spends on a record, the threads share the cores when there are more of them
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double core_seconds = (now_seconds() - start) * (threads < cores ? threads : cores);
+    printf("latencybench: %ld values from %d threads, %.2f ns per record\n", threads * values, threads, core_seconds * 1e9 / (threads * values));
+
+    // a clock read and a record, what each hook in the server costs
+    start = now_seconds();
+    for (long i = 0; i < values; i++) {
+        latency_since(LATENCY_SEND, latency_now());
+    }
+    printf("latencybench: %.2f ns per latency_since with its two clock reads\n", (now_seconds() - start) * 1e9 / values);
+
+    latency_histogram_t merged;
+    start = now_seconds();
+    latency_merge(LATENCY_MOVE, &merged);
+    printf("latencybench: merged %d recorders in %.1f us\n", threads + 1, (now_seconds() - start) * 1e6);
+    if (merged.count != (uint64_t) (threads * values)) {
+        printf("latencybench: FAILED, %llu values merged of %ld recorded\n", (unsigned long long) merged.count, threads * values);
+        return EXIT_FAILURE;
+    }
+    qsort(all, threads * values, sizeof(uint64_t), compare_values);
+    double percentiles[] = {50, 90, 99, 99.9, 100};
+    int failed = 0;
+    for (int i = 0; i < 5; i++) {
+        long rank = (long) (percentiles[i] / 100.0 * threads * values + 0.5);
+        uint64_t exact = all[(rank < 1 ? 1 : rank) - 1];
+        uint64_t found = latency_percentile(&merged, percentiles[i]);
+        // the bucket's top is at most 1/16 above its bottom, the last bucket holds everything past 2^36
+        int within = (found >= exact && found - exact <= exact / 16 + 1) || (exact >> LATENCY_MAX_BITS && found == merged.max_ns);
+        printf("    p%-5g exact %15llu ns, histogram %15llu ns%s\n", percentiles[i], (unsigned long long) exact, (unsigned long long) found, within ? "" : "  WRONG");
+        failed += !within;
+    }
+    free(all);
+    latency_report(stdout);
+    if (failed) {
+        printf("latencybench: FAILED, %d percentiles off by more than a bucket\n", failed);
+        return EXIT_FAILURE;
+    }
+    printf("latencybench: OK\n");
+    return EXIT_SUCCESS;
+}
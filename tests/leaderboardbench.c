@@ -0,0 +1,149 @@
+// measures the leaderboard: game threads posting results while it is kept up to date, then rank and top K queries
+// every player's rank is checked against a full sort of the player table at the end
+// usage: ./leaderboardbench [threads] [games per thread] [players]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "leaderboard.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_PATH "/tmp/ttt-leaderboard-bench.db"
+#define MAX_THREADS 64
+
+typedef struct worker {
+    pthread_t tid;
+    int id;
+    long games;
+} worker_t;
+
+long player_count = 100000;
+int64_t* sort_scores;
+
+void* post_results(void* arg) {
+    worker_t* worker = arg;
+    uint32_t state = worker->id * 2654435761u + 1;
+    char x_name[32];
+    char o_name[32];
+    for (long game = 0; game < worker->games; game++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        long x = state % player_count;
+        long o = (x + 1 + (state >> 8) % (player_count - 1)) % player_count;
+        snprintf(x_name, sizeof(x_name), "player%ld", x);
+        snprintf(o_name, sizeof(o_name), "player%ld", o);
+        // low numbered players win more so the ratings spread out
+        char winner = (x < o) ? "XXD"[(state >> 4) % 3] : "OOD"[(state >> 4) % 3];
+        if (players_record_game(&players, x_name, o_name, winner, '\0', game)) {
+            leaderboard_post(&leaderboard, x_name);
+            leaderboard_post(&leaderboard, o_name);
+        }
+    }
+    return NULL;
+}
+
+// the order of the boards: higher score first, lower slot first on a tie
+int compare_slots(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*) a;
+    uint64_t right = *(const uint64_t*) b;
+    if (sort_scores[left] != sort_scores[right]) {
+        return sort_scores[left] > sort_scores[right] ? -1 : 1;
+    }
+    return (left > right) - (left < right);
+}
+
+// checks every player's rank on a board against a sort of the table (returns 1 if they all match)
+int check_board(leaderboard_by_t by) {
+    uint64_t capacity = players.mask + 1;
+    uint64_t* order = malloc(capacity * sizeof(uint64_t));
+    sort_scores = malloc(capacity * sizeof(int64_t));
+    uint64_t ranked = 0;
+    for (uint64_t slot = 0; slot < capacity; slot++) {
+        const player_record_t* record = &players.records[slot];
+        if (record->hash != 0 && record->games > 0) {
+            sort_scores[slot] = (by == LEADERBOARD_RATING) ? record->rating : (int64_t) record->wins;
+            order[ranked++] = slot;
+        }
+    }
+    qsort(order, ranked, sizeof(uint64_t), compare_slots);
+    int ok = 1;
+    for (uint64_t i = 0; i < ranked && ok; i++) {
+        uint64_t rank = 0;
+        uint64_t total = 0;
+        ok = leaderboard_rank(&leaderboard, by, players.records[order[i]].name, &rank, &total) && rank == i + 1 && total == ranked;
+        if (!ok) {
+            fprintf(stderr, "%s is ranked %llu of %llu, a sort puts them %llu of %llu\n", players.records[order[i]].name, (unsigned long long) rank, (unsigned long long) total, (unsigned long long) i + 1, (unsigned long long) ranked);
+        }
+    }
+    free(order);
+    free(sort_scores);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long games = argc >= 3 ? atol(argv[2]) : 500000;
+    player_count = argc >= 4 ? atol(argv[3]) : 100000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    unlink(BENCH_PATH);
+    if (!players_open(&players, BENCH_PATH, PLAYERS_CAPACITY) || !leaderboard_init(&leaderboard, &players)) {
+        return EXIT_FAILURE;
+    }
+
+    worker_t workers[MAX_THREADS];
+    double start = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        workers[t].id = t + 1;
+        workers[t].games = games;
+        if (pthread_create(&workers[t].tid, NULL, post_results, &workers[t]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].tid, NULL);
+    }
+    double post_seconds = now_seconds() - start;
+    long posted = threads * games;
+
+    if (!check_board(LEADERBOARD_RATING) || !check_board(LEADERBOARD_WINS)) {
+        return EXIT_FAILURE;
+    }
+
+    long queries = 1000000;
+    char name[32];
+    uint64_t rank = 0;
+    uint64_t ranked = 0;
+    start = now_seconds();
+    for (long i = 0; i < queries; i++) {
+        snprintf(name, sizeof(name), "player%ld", (i * 7919) % player_count);
+        leaderboard_rank(&leaderboard, LEADERBOARD_RATING, name, &rank, &ranked);
+    }
+    double rank_ns = (now_seconds() - start) * 1e9 / queries;
+
+    leaderboard_entry_t top[LEADERBOARD_TOP];
+    int count = 0;
+    start = now_seconds();
+    for (long i = 0; i < queries; i++) {
+        count = leaderboard_top(&leaderboard, LEADERBOARD_RATING, LEADERBOARD_TOP, top);
+    }
+    double top_ns = (now_seconds() - start) * 1e9 / queries;
+
+    // a restarted server builds the boards from the table once
+    leaderboard_free(&leaderboard);
+    start = now_seconds();
+    leaderboard_init(&leaderboard, &players);
+    double init_seconds = now_seconds() - start;
+
+    printf("leaderboard: %ld games posted by %d threads for %ld players in %.3f s, %.0f games/s, every rank matches a full sort\n", posted, threads, player_count, post_seconds, posted / post_seconds);
+    printf("leaderboard: rank %.1f ns, top %d %.1f ns, rebuilt from the table in %.3f s\n", rank_ns, count, top_ns, init_seconds);
+    printf("leaderboard: first is %s at %.2f\n", top[0].name, top[0].score / 100.0);
+    leaderboard_free(&leaderboard);
+    players_close(&players);
+    unlink(BENCH_PATH);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+// measures what the lock profiler costs: threads taking one lock for a short critical section like games_list_mutex,
+// with a plain pthread mutex, a profiled one while profiling is off and while it is on
+// checks every acquisition was counted and prints the report
+// usage: ./lockbench [threads] [locks per thread]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "lockprof.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+typedef struct worker {
+    pthread_t tid;
+    long locks;
+    int plain;
+} worker_t;
+
+// the threads start together
+pthread_barrier_t ready;
+pthread_mutex_t plain_lock = PTHREAD_MUTEX_INITIALIZER;
+lockprof_mutex_t profiled_lock = LOCKPROF_MUTEX_INITIALIZER("bench lock");
+// what the critical section touches, like the games it walks
+volatile long shared[8];
+
+void critical_section(long i) {
+    for (int j = 0; j < 8; j++) {
+        shared[j] += i;
+    }
+}
+
+void* take_locks(void* arg) {
+    worker_t* worker = arg;
+    pthread_barrier_wait(&ready);
+    for (long i = 0; i < worker->locks; i++) {
+        if (worker->plain) {
+            pthread_mutex_lock(&plain_lock);
+            critical_section(i);
+            pthread_mutex_unlock(&plain_lock);
+        }
+        // every 16th hold comes from another site, like the rarer callers of a lock
+        else if (i % 16 == 0) {
+            lockprof_lock(&profiled_lock);
+            critical_section(i);
+            lockprof_unlock(&profiled_lock);
+        }
+        else {
+            lockprof_lock(&profiled_lock);
+            critical_section(i);
+            lockprof_unlock(&profiled_lock);
+        }
+    }
+    return NULL;
+}
+
+// runs the threads and returns the ns a core spends on a lock and unlock
+double run(int threads, long locks, int plain) {
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&ready, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].locks = locks;
+        workers[i].plain = plain;
+        pthread_create(&workers[i].tid, NULL, take_locks, &workers[i]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+    }
+    // the threads share the cores when there are more of them
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double core_seconds = (now_seconds() - start) * (threads < cores ? threads : cores);
+    pthread_barrier_destroy(&ready);
+    return core_seconds * 1e9 / (threads * locks);
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long locks = argc >= 3 ? atol(argv[2]) : 2000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    double plain = run(threads, locks, 1);
+    double off = run(threads, locks, 0);
+    lockprof_enable(1);
+    double on = run(threads, locks, 0);
+    lockprof_enable(0);
+    printf("lockbench: %ld locks from %d threads, %.1f ns per lock with a pthread mutex, %.1f ns profiled while off, %.1f ns while on\n",
+        threads * locks, threads, plain, off, on);
+    lockprof_report(stdout);
+
+    // the counts are read the way a report does, straight from the lock's stats
+    uint64_t acquired = profiled_lock.stats != NULL ? profiled_lock.stats->acquired : 0;
+    uint64_t site_holds = 0;
+    for (int i = 0; profiled_lock.stats != NULL && i < LOCKPROF_SITES; i++) {
+        site_holds += profiled_lock.stats->sites[i].holds;
+    }
+    if (acquired != (uint64_t) (threads * locks) || site_holds != acquired || profiled_lock.stats->hold.count != acquired) {
+        printf("lockbench: FAILED, %llu acquisitions and %llu holds counted of %ld\n", (unsigned long long) acquired, (unsigned long long) site_holds, threads * locks);
+        return EXIT_FAILURE;
+    }
+    printf("lockbench: OK\n");
+    return EXIT_SUCCESS;
+}
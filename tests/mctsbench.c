@@ -0,0 +1,41 @@
+// runs MCTS searches on a 15x15 five in a row board and reports playouts per second per core
+// usage: ./mctsbench [budget ms] [threads]
+#define _POSIX_C_SOURCE 200809L
+#include "mcts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    int budget_ms = argc >= 2 ? atoi(argv[1]) : 1000;
+    int threads = argc >= 3 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    mcts_t mcts;
+    if (!mcts_init(&mcts, MCTS_DEFAULT_NODES)) {
+        perror("mcts_init");
+        return EXIT_FAILURE;
+    }
+    mnk_board_t board;
+    mnk_init(&board, 15, 15, 5);
+
+    // X has an open three on row 8, so O should block it at 8,6 or 8,10
+    mnk_place(&board, 8, 7, 'X');
+    mnk_place(&board, 8, 8, 'X');
+    mnk_place(&board, 8, 9, 'X');
+    mnk_place(&board, 7, 7, 'O');
+    mnk_place(&board, 9, 9, 'O');
+
+    int row = 0;
+    int col = 0;
+    mcts_stats_t stats;
+    if (!mcts_search(&mcts, &board, 'O', budget_ms, threads, 12345, &row, &col, &stats)) {
+        fprintf(stderr, "search found no move\n");
+        return EXIT_FAILURE;
+    }
+    printf("15x15 k=5, O to move: played %d,%d\n", row, col);
+    printf("%ld playouts in %.3f s on %d threads: %.0f playouts/s, %.0f playouts/s per core\n", stats.playouts, stats.seconds, stats.threads, stats.playouts / stats.seconds, stats.playouts / stats.seconds / stats.threads);
+
+    mnk_free(&board);
+    mcts_free(&mcts);
+    return EXIT_SUCCESS;
+}
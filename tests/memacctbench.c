@@ -0,0 +1,120 @@
+// allocates and frees like the server does, from several threads into every subsystem at once
+// checks every subsystem is back to 0 live bytes and objects with every allocation counted, and that the peaks are where they must be,
+// then times an allocation and free through memacct against plain malloc and free
+// usage: ./memacctbench [threads] [allocations per thread]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "memacct.h"
+#include "protocol.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+// allocations a thread holds at once, like the buffers and messages of a game between its start and end
+#define HELD 16
+
+typedef struct worker {
+    pthread_t tid;
+    long allocations;
+    int counted;
+} worker_t;
+
+// the threads start together
+pthread_barrier_t ready;
+
+// the sizes the server allocates most: connection buffers, messages and names
+static size_t size_of(long i) {
+    switch (i % 3) {
+    case 0:
+        return sizeof(messageBuffer_t);
+    case 1:
+        return sizeof(message_t);
+    default:
+        return 1 + i % 64;
+    }
+}
+
+static memacct_subsystem_t subsystem_of(long i) {
+    return i % 3 == 0 ? MEMACCT_CONNECTION : (i % 3 == 1 ? MEMACCT_MESSAGE : MEMACCT_NAME);
+}
+
+// frees the allocation made at iteration i
+static void release(worker_t* worker, long i, void* ptr) {
+    if (worker->counted) {
+        memacct_free(subsystem_of(i), ptr);
+    }
+    else {
+        free(ptr);
+    }
+}
+
+// keeps HELD allocations, each new one replacing the one made HELD iterations before
+void* allocate(void* arg) {
+    worker_t* worker = arg;
+    void* held[HELD] = {NULL};
+    pthread_barrier_wait(&ready);
+    for (long i = 0; i < worker->allocations; i++) {
+        int slot = i % HELD;
+        if (held[slot] != NULL) {
+            release(worker, i - HELD, held[slot]);
+        }
+        held[slot] = worker->counted ? memacct_malloc(subsystem_of(i), size_of(i)) : malloc(size_of(i));
+    }
+    for (long i = worker->allocations - HELD; i < worker->allocations; i++) {
+        if (i >= 0) {
+            release(worker, i, held[i % HELD]);
+        }
+    }
+    return NULL;
+}
+
+// runs the threads and returns the ns a core spends on an allocation and its free
+double run(int threads, long allocations, int counted) {
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&ready, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].allocations = allocations;
+        workers[i].counted = counted;
+        pthread_create(&workers[i].tid, NULL, allocate, &workers[i]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+    }
+    // the threads share the cores when there are more of them
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double core_seconds = (now_seconds() - start) * (threads < cores ? threads : cores);
+    pthread_barrier_destroy(&ready);
+    return core_seconds * 1e9 / (threads * allocations);
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long allocations = argc >= 3 ? atol(argv[2]) : 1000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    // every subsystem gets the same number of allocations
+    allocations -= allocations % 3;
+    double plain = run(threads, allocations, 0);
+    double counted = run(threads, allocations, 1);
+    printf("memacctbench: %d threads, %ld allocations each, %.1f ns an allocation and free with malloc and %.1f ns through memacct\n",
+        threads, allocations, plain, counted);
+    memacct_report(stdout);
+
+    // a thread holds at most HELD / 3 + 1 of a subsystem's allocations at once, each at most 32 bytes bigger than asked for
+    int ok = 1;
+    memacct_subsystem_t used[3] = {MEMACCT_CONNECTION, MEMACCT_MESSAGE, MEMACCT_NAME};
+    for (int i = 0; i < 3; i++) {
+        memacct_counts_t counts;
+        memacct_read(used[i], &counts);
+        size_t largest = used[i] == MEMACCT_CONNECTION ? sizeof(messageBuffer_t) : (used[i] == MEMACCT_MESSAGE ? sizeof(message_t) : 64);
+        ok = ok && counts.live_bytes == 0 && counts.live_objects == 0 && counts.allocations == (uint64_t) (threads * allocations / 3)
+            && counts.peak_bytes > 0 && (size_t) counts.peak_bytes <= threads * (HELD / 3 + 1) * (largest + 32);
+    }
+    printf("memacctbench: %s\n", ok ? "OK" : "FAILED, a subsystem's counts don't match the allocations made");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
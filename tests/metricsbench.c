@@ -0,0 +1,78 @@
+// measures the metrics counters: threads counting at once like game threads do, then a scrape adding them up
+// checks no count was lost
+// usage: ./metricsbench [threads] [adds per thread]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "metrics.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+typedef struct worker {
+    pthread_t tid;
+    long adds;
+} worker_t;
+
+// the threads start counting together
+pthread_barrier_t ready;
+
+// what a move costs the counters: a message in, a message out and their bytes
+void* count_messages(void* arg) {
+    worker_t* worker = arg;
+    pthread_barrier_wait(&ready);
+    for (long i = 0; i < worker->adds; i += 4) {
+        metrics_add(METRIC_MESSAGES_IN, 1);
+        metrics_add(METRIC_BYTES_IN, 12);
+        metrics_add(METRIC_MESSAGES_OUT, 1);
+        metrics_add(METRIC_BYTES_OUT, 26);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long adds = argc >= 3 ? atol(argv[2]) : 10000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    adds -= adds % 4;
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&ready, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].adds = adds;
+        pthread_create(&workers[i].tid, NULL, count_messages, &workers[i]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+    }
+    // the time a core spends on an add, the threads share the cores when there are more of them
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double core_seconds = (now_seconds() - start) * (threads < cores ? threads : cores);
+    printf("metricsbench: %ld adds from %d threads, %.2f ns per add\n", threads * adds, threads, core_seconds * 1e9 / (threads * adds));
+
+    FILE* out = fopen("/dev/null", "w");
+    if (out == NULL) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    int scrapes = 1000;
+    start = now_seconds();
+    for (int i = 0; i < scrapes; i++) {
+        metrics_write(out, 0.0);
+    }
+    printf("metricsbench: %.1f us per scrape\n", (now_seconds() - start) * 1e6 / scrapes);
+    fclose(out);
+
+    long messages = threads * adds / 4;
+    if (metrics_sum(METRIC_MESSAGES_IN) != messages || metrics_sum(METRIC_MESSAGES_OUT) != messages
+        || metrics_sum(METRIC_BYTES_IN) != messages * 12 || metrics_sum(METRIC_BYTES_OUT) != messages * 26) {
+        printf("metricsbench: FAILED, %lld messages counted of %ld\n", (long long) metrics_sum(METRIC_MESSAGES_IN), messages);
+        return EXIT_FAILURE;
+    }
+    printf("metricsbench: OK\n");
+    return EXIT_SUCCESS;
+}
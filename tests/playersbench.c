@@ -0,0 +1,110 @@
+// measures the player table: game threads posting results to random players at once, then lookups like PLAY does
+// usage: ./playersbench [threads] [games per thread] [players]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "players.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_PATH "/tmp/ttt-players-bench.db"
+#define MAX_THREADS 64
+
+typedef struct worker {
+    pthread_t tid;
+    int id;
+    long games;
+    long failed;
+} worker_t;
+
+long player_count = 100000;
+
+// every thread plays games between random players from the same pool, so records are added and updated concurrently
+void* post_results(void* arg) {
+    worker_t* worker = arg;
+    uint32_t state = worker->id * 2654435761u + 1;
+    char x_name[32];
+    char o_name[32];
+    for (long game = 0; game < worker->games; game++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        long x = state % player_count;
+        long o = (x + 1 + (state >> 8) % (player_count - 1)) % player_count;
+        snprintf(x_name, sizeof(x_name), "player%ld", x);
+        snprintf(o_name, sizeof(o_name), "player%ld", o);
+        char winner = "XOD"[(state >> 4) % 3];
+        if (!players_record_game(&players, x_name, o_name, winner, (state & 16) ? 'X' : '\0', game)) {
+            worker->failed++;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long games = argc >= 3 ? atol(argv[2]) : 1000000;
+    player_count = argc >= 4 ? atol(argv[3]) : 100000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    unlink(BENCH_PATH);
+    if (!players_open(&players, BENCH_PATH, PLAYERS_CAPACITY)) {
+        return EXIT_FAILURE;
+    }
+
+    worker_t workers[MAX_THREADS];
+    double start = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        workers[t].id = t + 1;
+        workers[t].games = games;
+        workers[t].failed = 0;
+        if (pthread_create(&workers[t].tid, NULL, post_results, &workers[t]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    long failed = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].tid, NULL);
+        failed += workers[t].failed;
+    }
+    double post_seconds = now_seconds() - start;
+
+    // no update may be lost: every game adds 2 to the games, a win to one side for each loss, and the ratings only move between players
+    uint64_t known = 0, total_games = 0, wins = 0, losses = 0;
+    int64_t rating = 0;
+    for (uint64_t i = 0; i <= players.mask; i++) {
+        player_record_t* record = &players.records[i];
+        if (record->hash != 0) {
+            known++;
+            total_games += record->games;
+            wins += record->wins;
+            losses += record->losses;
+            rating += record->rating;
+        }
+    }
+    long posted = threads * games;
+    if (failed != 0 || total_games != 2 * (uint64_t) posted || wins != losses || rating != (int64_t) known * PLAYERS_START_RATING || known != (uint64_t) player_count) {
+        fprintf(stderr, "player table lost updates: %llu players, %llu games for %ld posted, %llu wins, %llu losses, %ld failed\n", (unsigned long long) known, (unsigned long long) total_games, posted, (unsigned long long) wins, (unsigned long long) losses, failed);
+        return EXIT_FAILURE;
+    }
+
+    long lookups = 1000000;
+    char name[32];
+    player_stats_t stats;
+    long found = 0;
+    start = now_seconds();
+    for (long i = 0; i < lookups; i++) {
+        snprintf(name, sizeof(name), "player%ld", (i * 7919) % player_count);
+        found += players_lookup(&players, name, &stats);
+    }
+    double lookup_ns = (now_seconds() - start) * 1e9 / lookups;
+    players_close(&players);
+    unlink(BENCH_PATH);
+
+    printf("players: %ld games posted by %d threads for %ld players in %.3f s, %.0f games/s, no update lost\n", posted, threads, player_count, post_seconds, posted / post_seconds);
+    printf("players: lookup %.1f ns (%ld of %ld found)\n", lookup_ns, found, lookups);
+    return EXIT_SUCCESS;
+}
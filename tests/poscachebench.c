@@ -0,0 +1,212 @@
+// checks the position cache the way the bot uses it: a move stored for a position is found again, mapped back, for
+// every rotation and mirror of it and is the move a fresh search of that copy would have stored
+// then threads put and get values made from their keys at once, a get must never return a value made from another key
+// usage: ./poscachebench [threads] [operations per thread]
+#define _POSIX_C_SOURCE 200809L
+#include "canon.h"
+#include "latency.h"
+#include "poscache.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_THREADS 64
+// random positions checked per board size
+#define POSITIONS 20000
+
+typedef struct worker {
+    pthread_t tid;
+    long operations;
+    uint32_t rng;
+    long hits;
+    long wrong;
+} worker_t;
+
+// the threads start together
+pthread_barrier_t ready;
+poscache_t cache;
+
+uint32_t next_random(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// the value a key's entry holds in the concurrent part, never 0 so it can't look like an empty slot
+uint64_t value_of(uint64_t key) {
+    return (key * 0x9E3779B97F4A7C15ull) | 1;
+}
+
+// the symmetries a board has, rotations and transposes only apply to square boards
+int applies(int sym, int rows, int cols) {
+    return rows == cols || sym == 0 || sym == 2 || sym == 4 || sym == 5;
+}
+
+// a board moved by a symmetry, the stones are placed in the hash one at a time like moves
+void move_board(int sym, int rows, int cols, const char* cells, char* moved, canon_hash_t* hash, int k) {
+    canon_hash_init(hash, rows, cols, k);
+    memset(moved, '.', rows * cols);
+    for (int cell = 0; cell < rows * cols; cell++) {
+        if (cells[cell] != '.') {
+            int to = canon_transform(sym, rows, cols, cell);
+            moved[to] = cells[cell];
+            canon_hash_place(hash, to / cols + 1, to % cols + 1, cells[cell]);
+        }
+    }
+}
+
+// stores a move like the bot's cache_move: the cell on the canonical board, the playouts above it
+void store_move(const canon_hash_t* hash, int rows, int cols, int cell, long playouts) {
+    int sym = 0;
+    uint64_t key = canon_hash_key(hash, &sym);
+    poscache_put(&cache, key, ((uint64_t) playouts << 16) | (uint64_t) canon_transform(sym, rows, cols, cell));
+}
+
+// looks a move up like the bot's cached_move (returns the cell on this board, -1 if it isn't there)
+int find_move(const canon_hash_t* hash, int rows, int cols, long* playouts) {
+    int sym = 0;
+    uint64_t value = 0;
+    if (!poscache_get(&cache, canon_hash_key(hash, &sym), &value)) {
+        return -1;
+    }
+    *playouts = (long) (value >> 16);
+    return canon_transform(canon_inverse(sym), rows, cols, value & 0xFFFF);
+}
+
+// a board that is its own mirror (or rotation) has more than one right answer, any cell the mirror takes the move to is the same move
+int same_move(int rows, int cols, const char* cells, int found, int expected) {
+    for (int sym = 0; sym < CANON_SYMMETRIES; sym++) {
+        if (!applies(sym, rows, cols)) {
+            continue;
+        }
+        int fixed = 1;
+        for (int cell = 0; cell < rows * cols && fixed; cell++) {
+            fixed = cells[canon_transform(sym, rows, cols, cell)] == cells[cell];
+        }
+        if (fixed && canon_transform(sym, rows, cols, found) == expected) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// stores a move for random positions of one board size and looks every symmetric copy up (returns the failures)
+long check_symmetries(int rows, int cols, int k, uint32_t* rng) {
+    char cells[MNK_MAX_SIDE * MNK_MAX_SIDE];
+    char moved[MNK_MAX_SIDE * MNK_MAX_SIDE];
+    canon_hash_t hash;
+    canon_hash_t moved_hash;
+    long failures = 0;
+    for (int position = 0; position < POSITIONS; position++) {
+        // a few stones up to half the board, and one empty cell as the searched move
+        int stones = 1 + next_random(rng) % (rows * cols / 2);
+        memset(cells, '.', rows * cols);
+        for (int i = 0; i < stones; i++) {
+            cells[next_random(rng) % (rows * cols)] = (i % 2 == 0) ? 'X' : 'O';
+        }
+        int move = next_random(rng) % (rows * cols);
+        while (cells[move] != '.') {
+            move = (move + 1) % (rows * cols);
+        }
+        long playouts = position + 1;
+        move_board(0, rows, cols, cells, moved, &hash, k);
+        store_move(&hash, rows, cols, move, playouts);
+
+        for (int sym = 0; sym < CANON_SYMMETRIES; sym++) {
+            if (!applies(sym, rows, cols)) {
+                continue;
+            }
+            move_board(sym, rows, cols, cells, moved, &moved_hash, k);
+            int expected = canon_transform(sym, rows, cols, move);
+            long found_playouts = 0;
+            int found = find_move(&moved_hash, rows, cols, &found_playouts);
+            if (found < 0 || found_playouts != playouts || moved[found] != '.' || !same_move(rows, cols, moved, found, expected)) {
+                if (failures < 5) {
+                    printf("poscachebench: %dx%d position %d under symmetry %d found cell %d with %ld playouts, expected %d with %ld\n",
+                        rows, cols, position, sym, found, found_playouts, expected, playouts);
+                }
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+void* hammer(void* arg) {
+    worker_t* worker = arg;
+    pthread_barrier_wait(&ready);
+    for (long i = 0; i < worker->operations; i++) {
+        // a small key space so threads keep writing the slots others read
+        uint64_t key = 1 + next_random(&worker->rng) % 4096;
+        key *= 0xD6E8FEB86659FD93ull;
+        uint64_t value = 0;
+        if (i % 4 == 0) {
+            poscache_put(&cache, key, value_of(key));
+        }
+        else if (poscache_get(&cache, key, &value)) {
+            worker->hits++;
+            worker->wrong += value != value_of(key);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long operations = argc >= 3 ? atol(argv[2]) : 4000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    canon_init();
+
+    // big enough that no entry is pushed out before its copies are looked up
+    if (!poscache_init(&cache, 1 << 20)) {
+        perror("poscache_init");
+        return EXIT_FAILURE;
+    }
+    uint32_t rng = 0x2545F491;
+    const int sizes[][3] = {{3, 3, 3}, {7, 7, 4}, {15, 15, 5}, {6, 9, 4}, {32, 32, 5}};
+    long failures = 0;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        failures += check_symmetries(sizes[i][0], sizes[i][1], sizes[i][2], &rng);
+    }
+    printf("poscachebench: %d positions on each of %d board sizes, every symmetric copy looked up, %ld wrong\n", POSITIONS, (int) (sizeof(sizes) / sizeof(sizes[0])), failures);
+    poscache_free(&cache);
+
+    // a small table so the ways of a key fill up and get overwritten while they are read
+    if (!poscache_init(&cache, 1024)) {
+        perror("poscache_init");
+        return EXIT_FAILURE;
+    }
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&ready, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].operations = operations;
+        workers[i].rng = 0x9E3779B9u * (i + 1);
+        workers[i].hits = 0;
+        workers[i].wrong = 0;
+        pthread_create(&workers[i].tid, NULL, hammer, &workers[i]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_seconds();
+    long hits = 0;
+    long wrong = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        hits += workers[i].hits;
+        wrong += workers[i].wrong;
+    }
+    double seconds = now_seconds() - start;
+    pthread_barrier_destroy(&ready);
+    poscache_free(&cache);
+    printf("poscachebench: %ld operations from %d threads, %.1f ns each, %ld hits, %ld with another key's value\n",
+        threads * operations, threads, seconds * 1e9 * threads / (threads * operations), hits, wrong);
+
+    if (failures != 0 || wrong != 0) {
+        printf("poscachebench: FAILED\n");
+        return EXIT_FAILURE;
+    }
+    printf("poscachebench: OK\n");
+    return EXIT_SUCCESS;
+}
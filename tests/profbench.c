@@ -0,0 +1,128 @@
+// profiles threads burning CPU in two known functions, one formatting with snprintf and one summing, then reads the folded stacks back
+// checks about the expected number of samples were taken, that both functions are in them in about the share of time they got,
+// and times the work with and without the profiler running
+// usage: ./profbench [threads] [seconds]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "prof.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_THREADS 64
+#define BENCH_PATH "/tmp/ttt-prof-bench.folded"
+
+volatile uint64_t sink = 0;
+
+// what send_msg spends formatting a message, not static and not inlined so the profile can name it
+__attribute__((noinline)) void bench_format(long rounds) {
+    char line[64];
+    for (long i = 0; i < rounds; i++) {
+        snprintf(line, sizeof(line), "MOVD|%ld|X|%ld,%ld|X........|", i, i % 3, i % 7);
+        sink += line[5];
+    }
+}
+
+__attribute__((noinline)) void bench_sum(long rounds) {
+    uint64_t sum = 0;
+    for (long i = 0; i < rounds; i++) {
+        sum += i * i ^ (sum >> 3);
+    }
+    sink += sum;
+}
+
+// alternates the two for the time it is given
+void* burn(void* arg) {
+    double until = now_seconds() + *(double*) arg;
+    while (now_seconds() < until) {
+        bench_format(2000);
+        bench_sum(200000);
+    }
+    return NULL;
+}
+
+// runs the threads for seconds and returns the CPU seconds they used
+double run(int threads, double seconds) {
+    pthread_t tids[MAX_THREADS];
+    struct timespec start, end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, burn, &seconds);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// a fixed amount of work on this thread (returns the seconds it took)
+double time_work() {
+    double start = now_seconds();
+    for (int i = 0; i < 200; i++) {
+        bench_format(2000);
+        bench_sum(200000);
+    }
+    return now_seconds() - start;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 2;
+    double seconds = argc >= 3 ? atof(argv[2]) : 2;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    if (!prof_init()) {
+        return EXIT_FAILURE;
+    }
+    double unprofiled = time_work();
+    prof_start(PROF_MAX_HZ);
+    double profiled = time_work();
+    prof_stop();
+
+    if (!prof_start(PROF_DEFAULT_HZ)) {
+        return EXIT_FAILURE;
+    }
+    double cpu_seconds = run(threads, seconds);
+    prof_stop();
+    int stacks = prof_write(BENCH_PATH);
+    if (stacks < 0) {
+        return EXIT_FAILURE;
+    }
+
+    // every line is "outermost;...;leaf count", a sample is in a function if the function is anywhere in its stack
+    FILE* file = fopen(BENCH_PATH, "r");
+    if (file == NULL) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    char line[4096];
+    uint64_t total = 0, in_burn = 0, in_format = 0, in_sum = 0, in_snprintf = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* count_start = strrchr(line, ' ');
+        if (count_start == NULL) {
+            continue;
+        }
+        uint64_t count = strtoull(count_start + 1, NULL, 10);
+        *count_start = '\0';
+        total += count;
+        in_burn += strstr(line, "burn;") != NULL ? count : 0;
+        in_format += strstr(line, "bench_format") != NULL ? count : 0;
+        in_sum += strstr(line, "bench_sum") != NULL ? count : 0;
+        in_snprintf += strstr(line, "bench_format;") != NULL && strstr(line, "printf") != NULL ? count : 0;
+    }
+    fclose(file);
+    remove(BENCH_PATH);
+
+    double expected = cpu_seconds * PROF_DEFAULT_HZ;
+    printf("profbench: %d threads used %.2f s of CPU, %llu samples (%.0f expected at %d Hz) in %d stacks, %.1f%% in bench_format (%.1f%% in its printf) and %.1f%% in bench_sum\n",
+        threads, cpu_seconds, (unsigned long long) total, expected, PROF_DEFAULT_HZ, stacks, total ? 100.0 * in_format / total : 0,
+        total ? 100.0 * in_snprintf / total : 0, total ? 100.0 * in_sum / total : 0);
+    printf("profbench: the work took %.1f ms without the profiler and %.1f ms with it at %d Hz (%+.1f%%)\n",
+        unprofiled * 1e3, profiled * 1e3, PROF_MAX_HZ, 100.0 * (profiled - unprofiled) / unprofiled);
+    // the count follows the CPU used within a tick or so a thread, and nearly every sample is in the burning threads
+    int ok = total > 0 && total + prof_dropped() >= expected * 0.7 && total <= expected * 1.3 + threads
+        && in_burn >= total * 0.9 && in_format > 0 && in_sum > 0 && in_format + in_sum >= total * 0.9;
+    printf("profbench: %s\n", ok ? "OK" : "FAILED, the samples don't match the work done");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,6 @@
 // imported for opening txt files for testing
 #include "protocol.h"
+#include "variant.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -15,24 +16,184 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+// reads one server message the way a client does, the header and then exactly the length it gives (returns 1 on success, -1 if error)
+int read_reply(int fd, char* buffer, int size) {
+    int length = 0;
+    int bars = 0;
+    while (bars < 2) {
+        if (length == size - 1 || read(fd, buffer + length, 1) != 1) {
+            return -1;
+        }
+        bars += buffer[length++] == '|';
+    }
+    int data_size = atoi(buffer + 5);
+    if (data_size < 0 || length + data_size > size - 1) {
+        return -1;
+    }
+    for (int end = length + data_size; length < end; ) {
+        ssize_t bytes_read = read(fd, buffer + length, end - length);
+        if (bytes_read <= 0) {
+            return -1;
+        }
+        length += bytes_read;
+    }
+    buffer[length] = '\0';
+    return 1;
+}
+
+// plays "<variant> <move> <move> ..." over a socketpair, X and O taking turns: the client side sends PLAY and every MOVE
+// with send_msg, the server side reads them with recieve_msg, plays them on the game core and answers with send_msg
+// like ttts does (returns 1 if every MOVD came back with the board and the last move, and only it, ended the game with OVER)
+int play_game(char* text) {
+    char* spec = strtok(text, " ");
+    variant_t variant;
+    game_board_t board;
+    if (spec == NULL || !variant_parse(spec, &variant) || !game_board_init(&board, &variant)) {
+        printf("    bad variant\n");
+        return 0;
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        perror("Error creating socketpair");
+        game_board_free(&board);
+        return 0;
+    }
+    messageBuffer_t server;
+    server.fd = fds[1];
+    server.buflen = 0;
+    memset(server.buffer, '\0', BUFFER_SIZE);
+    message_t sent;
+    message_t got;
+    message_t answer;
+    char reply[BUFFER_SIZE];
+    int passed = 0;
+
+    set_message_fields(&sent, PLAY, "protocoltest", spec);
+    if (send_msg(fds[0], &sent, NULL) == -1 || recieve_msg(&server, &got) == -1 || got.code != PLAY || strcmp(got.fourthField, spec) != 0) {
+        printf("    PLAY didn't come through\n");
+        goto done;
+    }
+    char role[2] = "X";
+    int moves = 0;
+    int over = 0;
+    for (char* position = strtok(NULL, " "); position != NULL; position = strtok(NULL, " ")) {
+        if (over) {
+            printf("    %s was played after the game ended\n", position);
+            goto done;
+        }
+        set_message_fields(&sent, MOVE, role, position);
+        int row = 0;
+        int col = 0;
+        if (send_msg(fds[0], &sent, NULL) == -1 || recieve_msg(&server, &got) == -1 || got.code != MOVE || strcmp(got.thirdField, role) != 0 ||
+            !game_board_parse_move(&board, got.fourthField, &row, &col) || !game_board_is_valid_move(&board, row, col)) {
+            printf("    MOVE %s %s didn't come through or isn't a valid move\n", role, position);
+            goto done;
+        }
+        game_board_place(&board, row, col, role[0]);
+        moves++;
+        set_message_fields(&answer, MOVD, role, got.fourthField);
+        char expected[BUFFER_SIZE];
+        snprintf(expected, sizeof(expected), "MOVD|%zu|%s|%s|%s|", strlen(role) + strlen(position) + strlen(game_board_str(&board)) + 3, role, position, game_board_str(&board));
+        if (send_msg(fds[1], &answer, game_board_str(&board)) == -1 || read_reply(fds[0], reply, sizeof(reply)) == -1 || strcmp(reply, expected) != 0) {
+            printf("    MOVD for %s %s didn't come back whole\n", role, position);
+            goto done;
+        }
+        if (game_board_check_win(&board, row, col, role[0])) {
+            set_message_fields(&answer, OVER, "W", "you have won.");
+            over = 1;
+        }
+        else if (game_board_check_tie(&board)) {
+            set_message_fields(&answer, OVER, "D", "the grid is full.");
+            over = 1;
+        }
+        if (over && (send_msg(fds[1], &answer, NULL) == -1 || read_reply(fds[0], reply, sizeof(reply)) == -1 || strncmp(reply, "OVER|", 5) != 0)) {
+            printf("    OVER didn't come back\n");
+            goto done;
+        }
+        role[0] = role[0] == 'X' ? 'O' : 'X';
+    }
+    passed = over;
+    printf("    %d moves, %s\n", moves, over ? reply : "the game never ended");
+done:
+    close(fds[0]);
+    close(fds[1]);
+    game_board_free(&board);
+    return passed;
+}
+
+// every line of the input file is one case, "accept " or "reject " and then the message (lines starting with # are comments)
+// an accepted message has to be read whole, a rejected one has to make recieve_msg return -1
+// "game " and then a variant and moves plays a whole game through the framing, it has to end with OVER on the last move
 int main(int argc, char **argv) {
-    message_t myMessage;
-    messageBuffer_t myMessageBuffer;
-    int fd = open("input.txt", O_RDONLY);
-    myMessageBuffer.fd = fd;
-    myMessageBuffer.buflen = 0;
-    memset(myMessageBuffer.buffer, '\0', BUFFER_SIZE);
-    
-    int res = recieve_msg(&myMessageBuffer, &myMessage);
-    if (res > -1) {
-        printf("FIRSTFIELD:%s\nSECONDFIELD:%d\nTHIRDFIELD:%s\nFOURTHFIELD:%s\n", get_message_code_string(myMessage.code), myMessage.secondField, myMessage.thirdField, myMessage.fourthField);
-    }
-    while (myMessageBuffer.buflen != 0) {
-        res = recieve_msg(&myMessageBuffer, &myMessage);
-        printf("RESULT: %d\n\n", res);
+    const char* path = argc > 1 ? argv[1] : "input.txt";
+    FILE* input = fopen(path, "r");
+    if (input == NULL) {
+        perror("Error opening the input file");
+        return 1;
+    }
+    canon_init();
+    char line[BUFFER_SIZE + 16];
+    int cases = 0;
+    int failed = 0;
+    while (fgets(line, sizeof(line), input) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        int accept;
+        if (strncmp(line, "game ", 5) == 0) {
+            printf("game %s\n", line + 5);
+            int passed = play_game(line + 5);
+            printf("%s game\n", passed ? "PASS" : "FAIL");
+            cases++;
+            failed += !passed;
+            continue;
+        }
+        if (strncmp(line, "accept ", 7) == 0) {
+            accept = 1;
+        }
+        else if (strncmp(line, "reject ", 7) == 0) {
+            accept = 0;
+        }
+        else {
+            fprintf(stderr, "protocoltest: a case starts with accept or reject: %s\n", line);
+            failed++;
+            continue;
+        }
+        const char* text = line + 7;
+
+        // the message comes through a pipe that is closed after it, like a client that sends it and hangs up
+        int fds[2];
+        if (pipe(fds) == -1) {
+            perror("Error creating pipe");
+            return 1;
+        }
+        if (write(fds[1], text, strlen(text)) != (ssize_t) strlen(text)) {
+            perror("Error writing to pipe");
+            return 1;
+        }
+        close(fds[1]);
+
+        message_t myMessage;
+        messageBuffer_t myMessageBuffer;
+        myMessageBuffer.fd = fds[0];
+        myMessageBuffer.buflen = 0;
+        memset(myMessageBuffer.buffer, '\0', BUFFER_SIZE);
+        int res = recieve_msg(&myMessageBuffer, &myMessage);
+        close(fds[0]);
+
+        int passed = accept ? (res == 1 && myMessageBuffer.buflen == 0) : res == -1;
+        printf("%s %s %s\n", passed ? "PASS" : "FAIL", accept ? "accept" : "reject", text);
         if (res > -1) {
-            printf("FIRSTFIELD:%s\nSECONDFIELD:%d\nTHIRDFIELD:%s\nFOURTHFIELD:%s\n", get_message_code_string(myMessage.code), myMessage.secondField, myMessage.thirdField, myMessage.fourthField);
+            printf("    FIRSTFIELD:%s SECONDFIELD:%d THIRDFIELD:%s FOURTHFIELD:%s\n", get_message_code_string(myMessage.code), myMessage.secondField, myMessage.thirdField, myMessage.fourthField);
         }
+        cases++;
+        failed += !passed;
+    }
+    fclose(input);
+    printf("protocoltest: %d cases, %d failed\n", cases, failed);
+    if (failed == 0) {
+        printf("protocoltest: OK\n");
     }
-    return 0;    
-}
\ No newline at end of file
+    return failed != 0;
+}
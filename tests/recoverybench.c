@@ -0,0 +1,127 @@
+// measures crash recovery: journals in-flight games the way the server does, then times rebuilding them and journaling them again
+// then checks the games nobody came back for expire: their OVER is journaled and their names are free, a started game is left alone
+// usage: ./recoverybench [live games]
+#define _POSIX_C_SOURCE 200809L
+#include "journal.h"
+#include "latency.h"
+#include "protocol.h"
+#include "recovery.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DIR "/tmp/ttt-recovery-bench"
+// the server spreads games over its writers, so a game's records are spread over segments
+#define BENCH_WRITERS 64
+
+// removes the segments and checkpoint this run wrote
+void remove_journal(void) {
+    DIR* dir = opendir(BENCH_DIR);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    char path[512];
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", BENCH_DIR, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+int main(int argc, char **argv) {
+    long live = argc >= 2 ? atol(argv[1]) : 100000;
+    // as many games again finished before the crash, recovery has to read past them
+    long total = 2 * live;
+    remove_journal();
+    if (!journal_init(BENCH_DIR, JOURNAL_SYNC_NONE)) {
+        return EXIT_FAILURE;
+    }
+    journal_writer_t* writers[BENCH_WRITERS];
+    for (int w = 0; w < BENCH_WRITERS; w++) {
+        writers[w] = journal_claim();
+    }
+
+    // 15,15,5 games of up to 20 moves, every other one ends with an OVER
+    srand(1);
+    char payload[JOURNAL_MAX_PAYLOAD];
+    char xToken[SESSION_TOKEN_LEN + 1];
+    char oToken[SESSION_TOKEN_LEN + 1];
+    char first_token[SESSION_TOKEN_LEN + 1];
+    long records = 0;
+    for (long game = 0; game < total; game++) {
+        journal_writer_t* writer = writers[game % BENCH_WRITERS];
+        uint64_t id = journal_next_game_id();
+        session_token(xToken);
+        session_token(oToken);
+        if (game == 0) {
+            strcpy(first_token, xToken);
+        }
+        int length = snprintf(payload, sizeof(payload), "x%ld|o%ld|15,15,5|%s|%s", game, game, xToken, oToken);
+        journal_append(writer, BEGN, id, payload, length);
+        int moves = rand() % 21;
+        for (int move = 0; move < moves; move++) {
+            length = snprintf(payload, sizeof(payload), "%c|%d,%d", (move % 2 == 0) ? 'X' : 'O', move / 15 + 1, move % 15 + 1);
+            journal_append(writer, MOVD, id, payload, length);
+        }
+        records += moves + 1;
+        if (game % 2 == 1) {
+            journal_append(writer, OVER, id, "D|the grid is full.", 19);
+            records++;
+        }
+    }
+    for (int w = 0; w < BENCH_WRITERS; w++) {
+        journal_release(writers[w]);
+    }
+    journal_flush();
+
+    double start = now_seconds();
+    long recovered = recovery_load(BENCH_DIR, 0);
+    double load_seconds = now_seconds() - start;
+    if (recovered != live) {
+        fprintf(stderr, "recovered %ld games, expected %ld\n", recovered, live);
+        return EXIT_FAILURE;
+    }
+    // the first game is live and only its own token gets its player back, the second one is over
+    char role = 0;
+    recovered_game_t* first = recovery_find("x0", first_token, &role);
+    if (first == NULL || role != 'X' || recovery_find("x0", "not a token", &role) != NULL || recovery_is_reserved("o1") || !recovery_is_reserved("o0")) {
+        fprintf(stderr, "names of recovered games are wrong\n");
+        return EXIT_FAILURE;
+    }
+
+    start = now_seconds();
+    journal_writer_t* writer = journal_claim();
+    long relogged = recovery_relog(writer);
+    journal_release(writer);
+    journal_flush();
+    double relog_seconds = now_seconds() - start;
+    if (relogged != live) {
+        fprintf(stderr, "journaled %ld games again, expected %ld\n", relogged, live);
+        return EXIT_FAILURE;
+    }
+
+    // the first game's players came back and its thread is running, nobody came back for the others
+    recovery_set_started(first, 1);
+    writer = journal_claim();
+    long expired = recovery_expire(writer);
+    journal_release(writer);
+    journal_flush();
+    int expired_ok = expired == live - 1 && recovery_find("x0", first_token, &role) == NULL && recovery_is_reserved("x0") && !recovery_is_reserved("x2");
+    // only the running game is still live for the next restart
+    long still_live = recovery_load(BENCH_DIR, 0);
+    journal_shutdown();
+    remove_journal();
+    if (!expired_ok || still_live != 1) {
+        fprintf(stderr, "expired %ld games and %ld are still live, expected %ld and 1\n", expired, still_live, live - 1);
+        return EXIT_FAILURE;
+    }
+
+    printf("recovery: %ld live games out of %ld (%ld records) rebuilt in %.3f s, journaled again in %.3f s\n", recovered, total, records, load_seconds, relog_seconds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+// counts the syscalls of moves played like make_move plays them: the mover's socket checked and its MOVE read,
+// then MOVD sent to both players, over socket pairs standing in for the players
+// checks the account against what those calls must cost and times a move with and without counting
+// usage: ./sysacctbench [moves]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "protocol.h"
+#include "sysacct.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// plays moves alternating between the players (returns the seconds it took, -1 if a call failed)
+// x[0] and o[0] are the server's ends, the bench writes the MOVEs to and reads the MOVDs from the other ends
+double play_moves(int x[2], int o[2], long moves) {
+    static const char* move = "MOVE|6|X|2,2|";
+    char board[10] = "X........";
+    char drain[BUFFER_SIZE];
+    messageBuffer_t x_buffer = {x[0], {0}, 0};
+    messageBuffer_t o_buffer = {o[0], {0}, 0};
+    message_t msg;
+    double start = now_seconds();
+    for (long i = 0; i < moves; i++) {
+        messageBuffer_t* mover = (i % 2 == 0) ? &x_buffer : &o_buffer;
+        int client = (i % 2 == 0) ? x[1] : o[1];
+        if (write(client, move, strlen(move)) < 0 || !is_socket_connected(mover->fd) || recieve_msg(mover, &msg) == -1) {
+            return -1;
+        }
+        set_message_fields(&msg, 6, "X", "2,2");
+        if (send_msg(x[0], &msg, board) == -1) {
+            return -1;
+        }
+        set_message_fields(&msg, 6, "X", "2,2");
+        if (send_msg(o[0], &msg, board) == -1 || read(x[1], drain, sizeof(drain)) <= 0 || read(o[1], drain, sizeof(drain)) <= 0) {
+            return -1;
+        }
+    }
+    return now_seconds() - start;
+}
+
+int main(int argc, char **argv) {
+    long moves = argc >= 2 ? atol(argv[1]) : 100000;
+    int x[2];
+    int o[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, x) < 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, o) < 0) {
+        perror("socketpair");
+        return EXIT_FAILURE;
+    }
+    // send_msg logs every message like the server does, that goes to /dev/null here
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        perror("freopen");
+        return EXIT_FAILURE;
+    }
+    double uncounted = play_moves(x, o, moves);
+    sysacct_t account;
+    memset(&account, 0, sizeof(account));
+    sysacct_attach(&account, SYSACCT_PLAY);
+    double counted = play_moves(x, o, moves);
+    sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    if (uncounted < 0 || counted < 0) {
+        printf("sysacctbench: FAILED, a move's syscall failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("sysacctbench: %ld moves, %.0f ns a move without counting and %.0f ns with it\n", moves, uncounted * 1e9 / moves, counted * 1e9 / moves);
+    printf("sysacctbench: ");
+    sysacct_print(stdout, &account, moves);
+    printf("\n");
+    // a move is a peek and a read of the mover, then a peek and a writev per MOVD
+    // each MOVD is "MOVD|16|X|2,2|" and the board "X........|"
+    int ok = sysacct_calls(&account, SYSACCT_PEEK) == (uint64_t) (3 * moves) && sysacct_calls(&account, SYSACCT_READ) == (uint64_t) moves
+        && sysacct_calls(&account, SYSACCT_WRITE) == (uint64_t) (2 * moves) && account.bytes_in[SYSACCT_PLAY] == (uint64_t) (13 * moves)
+        && account.bytes_out[SYSACCT_PLAY] == (uint64_t) (2 * 24 * moves);
+    printf("sysacctbench: %s\n", ok ? "OK" : "FAILED, the account doesn't match the calls made");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,94 @@
+// measures the tracer: what a span costs a thread that isn't traced and one that is, while the flush thread writes the spans out
+// checks every span was either written or counted as dropped, and that the file has one event per span written
+// usage: ./tracebench [threads] [spans per thread]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+#define BENCH_PATH "/tmp/ttt-trace-bench.json"
+
+typedef struct worker {
+    pthread_t tid;
+    long spans;
+    uint64_t trace;        // 0 for an untraced thread
+} worker_t;
+
+// the threads start together
+pthread_barrier_t ready;
+volatile int running = 1;
+
+// what a send_msg costs the tracer
+void* add_spans(void* arg) {
+    worker_t* worker = arg;
+    trace_set(worker->trace);
+    pthread_barrier_wait(&ready);
+    for (long i = 0; i < worker->spans; i++) {
+        uint64_t span = trace_begin();
+        trace_end("protocol", "send_msg", span);
+    }
+    trace_set(0);
+    return NULL;
+}
+
+// runs the threads and returns the ns a core spends on a span
+double run(int threads, long spans, int traced) {
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&ready, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].spans = spans;
+        workers[i].trace = traced ? i + 1 : 0;
+        pthread_create(&workers[i].tid, NULL, add_spans, &workers[i]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+    }
+    // the threads share the cores when there are more of them
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double core_seconds = (now_seconds() - start) * (threads < cores ? threads : cores);
+    pthread_barrier_destroy(&ready);
+    return core_seconds * 1e9 / (threads * spans);
+}
+
+int main(int argc, char **argv) {
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    long spans = argc >= 3 ? atol(argv[2]) : 1000000;
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+    if (!trace_start(BENCH_PATH, &running)) {
+        return EXIT_FAILURE;
+    }
+    double untraced = run(threads, spans, 0);
+    double traced = run(threads, spans, 1);
+    running = 0;
+    trace_stop();
+    printf("tracebench: %ld spans from %d threads, %.1f ns a span untraced and %.1f ns traced, %llu written and %llu dropped while the rings were full\n",
+        threads * spans, threads, untraced, traced, (unsigned long long) trace_written(), (unsigned long long) trace_dropped());
+
+    // one event a line between the [ and ]
+    FILE* file = fopen(BENCH_PATH, "r");
+    if (file == NULL) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    char line[512];
+    uint64_t events = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        events += strncmp(line, "{\"name\"", 7) == 0;
+    }
+    fclose(file);
+    unlink(BENCH_PATH);
+    if (trace_written() + trace_dropped() != (uint64_t) (threads * spans) || events != trace_written()) {
+        printf("tracebench: FAILED, %llu events in the file, %llu spans written of %ld\n", (unsigned long long) events, (unsigned long long) trace_written(), threads * spans);
+        return EXIT_FAILURE;
+    }
+    printf("tracebench: OK\n");
+    return EXIT_SUCCESS;
+}
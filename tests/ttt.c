@@ -10,43 +10,8 @@
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
-
-
-#define BOARD_SIZE 3
-#define BUFFER_SIZE 256
-
-// checks if a player has won the game (1 if yes, else 0)
-int check_win(char board[3][3], char player_role) {
-    for (int i = 0; i < 3; i++) {
-        // check rows
-        if (board[i][0] == player_role && board[i][1] == player_role && board[i][2] == player_role) {
-            return 1;
-        }
-        // check columns
-        if (board[0][i] == player_role && board[1][i] == player_role && board[2][i] == player_role) {
-            return 1;
-        }
-    }
-    // check diagonals
-    if (board[0][0] == player_role && board[1][1] == player_role && board[2][2] == player_role) {
-        return 1;
-    }
-    if (board[0][2] == player_role && board[1][1] == player_role && board[2][0] == player_role) {
-        return 1;
-    }
-    return 0;
-}
-
-// checks if there is a tie (1 if yes, else 0)
-int check_tie(char board[3][3]) {
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            if (board[i][j] == '.')
-                return 0;
-        }
-    }
-    return 1;
-}
+#include "protocol.h"
+#include "variant.h"
 
 void send_resign(int sockfd) {
     char message[BUFFER_SIZE];
@@ -81,20 +46,41 @@ void send_move(int sockfd, char role, const char *user_input) {
 
 }
 
-void display_board(char board[BOARD_SIZE][BOARD_SIZE]) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            printf("%c ", board[i][j]);
-            if (j < BOARD_SIZE - 1)
-            {
-                printf("| ");
-            }
+// prints the board string of a MOVD one row per line, any variant's board is rows * cols cells
+void display_board(const variant_t* variant, const char* board_str) {
+    for (int i = 0; i < variant->rows; i++) {
+        for (int j = 0; j < variant->cols; j++) {
+            printf("%c ", board_str[i * variant->cols + j]);
         }
         printf("\n");
-        if (i < BOARD_SIZE - 1) {
-            printf("---------\n");
+    }
+}
+
+// reads one whole server message into buffer, the header first and then exactly the length it gives, so a long MOVD
+// split over reads or a MOVD and OVER in one read are both handled (returns 1 on success, -1 if error)
+int read_server_msg(int sockfd, char* buffer, int size) {
+    int length = 0;
+    int bars = 0;
+    // CODE|length| is read a byte at a time, it is never more than 10 bytes
+    while (bars < 2) {
+        if (length == size - 1 || read(sockfd, buffer + length, 1) != 1) {
+            return -1;
         }
+        bars += buffer[length++] == '|';
     }
+    int data_size = atoi(buffer + 5);
+    if (data_size < 0 || length + data_size > size - 1) {
+        return -1;
+    }
+    for (int end = length + data_size; length < end; ) {
+        ssize_t bytes_read = read(sockfd, buffer + length, end - length);
+        if (bytes_read <= 0) {
+            return -1;
+        }
+        length += bytes_read;
+    }
+    buffer[length] = '\0';
+    return 1;
 }
 
 void print_prompt(char role) {
@@ -102,6 +88,34 @@ void print_prompt(char role) {
     printf("1. MOVE|row,col\n");
     printf("2. RSGN\n");
     printf("3. DRAW S\n");
+    printf("4. HINT\n");
+}
+
+// reads the user's choice, answering HINT with the best moves from the perfect play table until something else is typed
+// (the table only knows the classic board, other variants get no hints)
+void read_user_input(char role, const game_board_t* game, char* user_input, int size) {
+    while (1) {
+        print_prompt(role);
+        fgets(user_input, size, stdin);
+        user_input[strcspn(user_input, "\n")] = 0;
+        if (strcmp(user_input, "HINT") != 0) {
+            return;
+        }
+        if (game->variant.type != VARIANT_CLASSIC) {
+            printf("Hints are only given on the classic 3x3 board\n");
+            continue;
+        }
+        const board_t* core = &game->classic;
+        static const char* values[] = {"you lose with perfect play", "draw with perfect play", "you win with perfect play"};
+        uint16_t moves = perfect_best_moves(core);
+        printf("Hint (%s), best moves:", values[perfect_value(core)]);
+        for (int cell = 0; cell < BOARD_CELLS; cell++) {
+            if (moves & (1 << cell)) {
+                printf(" %d,%d", cell / 3 + 1, cell % 3 + 1);
+            }
+        }
+        printf("\n");
+    }
 }
 
 int connect_inet(char *host, char *service) {
@@ -142,11 +156,18 @@ int connect_inet(char *host, char *service) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
+    if (argc != 3 && argc != 4) {
         printf("Provide Domain Name and Port Number.");
-        printf("Usage: ./ttt <domain name> <port number>\n");
+        printf("Usage: ./ttt <domain name> <port number> [variant, e.g. 15,15,5, ultimate or gravity]\n");
         return EXIT_FAILURE;
     }
+    const char* spec = argc == 4 ? argv[3] : "";
+    variant_t variant;
+    if (!variant_parse(spec, &variant)) {
+        printf("Unknown variant: %s\n", spec);
+        return EXIT_FAILURE;
+    }
+    canon_init();
 
     // Get the domain name and port number of the desired service.
     char *domainName = argv[1];
@@ -171,12 +192,20 @@ int main(int argc, char *argv[]) {
     name[strcspn(name, "\n")] = 0; // Remove newline character
     name[128] = '\0';
     char name_msg[BUFFER_SIZE];
-    snprintf(name_msg, sizeof(name_msg), "PLAY|%zu|%s|", strlen(name) + 1, name);
+    if (spec[0] != '\0') {
+        snprintf(name_msg, sizeof(name_msg), "PLAY|%zu|%s|%s|", strlen(name) + strlen(spec) + 2, name, spec);
+    }
+    else {
+        snprintf(name_msg, sizeof(name_msg), "PLAY|%zu|%s|", strlen(name) + 1, name);
+    }
     write(sockfd, name_msg, strlen(name_msg));
 
     // Wait for server's response
     char buffer[BUFFER_SIZE];
-    read(sockfd, buffer, sizeof(buffer));
+    if (read_server_msg(sockfd, buffer, sizeof(buffer)) == -1) {
+        printf("Connection lost\n");
+        return EXIT_FAILURE;
+    }
     printf("MESSAGE RECIEVED: %s\n", buffer);
     fflush(stdout);
     if (strstr(buffer, "INVL") != NULL) {
@@ -197,37 +226,41 @@ int main(int argc, char *argv[]) {
         memset(buffer, '\0', sizeof(buffer));
     }
     // Wait for the BEGN message and read from server
-    read(sockfd, buffer, sizeof(buffer));
-    if (strstr(buffer, "BEGN") == NULL) {
+    if (read_server_msg(sockfd, buffer, sizeof(buffer)) == -1 || strstr(buffer, "BEGN") == NULL) {
         return 0;
     }
     printf("MESSAGE RECIEVED: %s\n", buffer);
     fflush(stdout);
     // Extract role and opponent's name
     int size;
-    char role, opponent_name[128];
-    sscanf(buffer, "BEGN|%d|%c|%[^|]|", &size, &role, opponent_name);
+    char role, opponent_name[128], session_token[32] = "";
+    sscanf(buffer, "BEGN|%d|%c|%[^|]|%31[^|]|", &size, &role, opponent_name, session_token);
     printf("Your role: %c\nOpponent's Name: %s\n", role, opponent_name);
+    printf("Session token (send RSUM|len|name|token| to resume after a server restart): %s\n", session_token);
     
     // Game loop
-    char board[BOARD_SIZE][BOARD_SIZE] = {{'.', '.', '.'}, {'.', '.', '.'}, {'.', '.', '.'}};
+    // the board in the shared game core, every MOVD's move is played on it for the end of game checks and hints
+    game_board_t game;
+    if (!game_board_init(&game, &variant)) {
+        perror("game_board_init");
+        return EXIT_FAILURE;
+    }
     int gameover = 0;
     int is_client_turn = 0;
     int draw_sent = 0;
     if (role == 'X') {
         is_client_turn = 1;
         
-        print_prompt(role);
         char user_input[10];
-        fgets(user_input, sizeof(user_input), stdin);
-        user_input[strcspn(user_input, "\n")] = 0;
+        read_user_input(role, &game, user_input, sizeof(user_input));
 
         if (strcmp(user_input, "RSGN") == 0)
         {
             send_resign(sockfd);
             gameover = 1;
-            read(sockfd, buffer, sizeof(buffer));
-            printf("MESSAGE RECIEVED: %s\n", buffer);
+            if (read_server_msg(sockfd, buffer, sizeof(buffer)) == 1) {
+                printf("MESSAGE RECIEVED: %s\n", buffer);
+            }
         }
         else if (strncmp(user_input, "DRAW", 4) == 0)
         {
@@ -243,8 +276,10 @@ int main(int argc, char *argv[]) {
     
     while (!gameover) {
         // Receive game state from the server
-        bzero(buffer, sizeof(buffer));
-        read(sockfd, buffer, sizeof(buffer));
+        if (read_server_msg(sockfd, buffer, sizeof(buffer)) == -1) {
+            printf("Connection lost\n");
+            break;
+        }
         printf("Server: %s\n", buffer);
 
         // Handle the server's message
@@ -252,20 +287,21 @@ int main(int argc, char *argv[]) {
         sscanf(buffer, "%4s", code);
 
         if (strcmp(code, "MOVD") == 0) {
-            // Update the board
-            char* board_str;
+            // MOVD|length|role|position|board|, the position is 1 to 5 bytes and the board is the rest
             char finished_role;
-            finished_role = *(buffer + 8);
-            board_str = buffer + 14;
-            int k = 0;
-            for (int i = 0; i < BOARD_SIZE; i++) {
-                for (int j = 0; j < BOARD_SIZE; j++) {
-                    board[i][j] = board_str[k];
-                    k++;
-                }
+            char position[8];
+            int board_start = 0;
+            int row = 0;
+            int col = 0;
+            if (sscanf(buffer, "MOVD|%*d|%c|%7[^|]|%n", &finished_role, position, &board_start) != 2 || board_start == 0 ||
+                !game_board_parse_move(&game, position, &row, &col) || !game_board_is_valid_move(&game, row, col)) {
+                printf("Malformed MOVD\n");
+                break;
             }
-            display_board(board);
-            if (finished_role == role || check_tie(board) || check_win(board, finished_role)) {
+            display_board(&variant, buffer + board_start);
+            // let the shared game core decide if the move ended the game
+            game_board_place(&game, row, col, finished_role);
+            if (finished_role == role || game_board_check_tie(&game) || game_board_check_win(&game, row, col, finished_role) || game_board_is_dead_draw(&game)) {
                 is_client_turn = 0;
             } else {
                 is_client_turn = 1;
@@ -304,17 +340,16 @@ int main(int argc, char *argv[]) {
             if (draw_sent) {
                 draw_sent = 0;
             }
-            print_prompt(role);
             char user_input[10];
-            fgets(user_input, sizeof(user_input), stdin);
-            user_input[strcspn(user_input, "\n")] = 0;
+            read_user_input(role, &game, user_input, sizeof(user_input));
 
             if (strcmp(user_input, "RSGN") == 0)
             {
                 send_resign(sockfd);
                 gameover = 1;
-                read(sockfd, buffer, sizeof(buffer));
-                printf("Server: %s\n", buffer);
+                if (read_server_msg(sockfd, buffer, sizeof(buffer)) == 1) {
+                    printf("Server: %s\n", buffer);
+                }
             }
             else if (strncmp(user_input, "DRAW", 4) == 0)
             {
@@ -329,6 +364,7 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    game_board_free(&game);
     close(sockfd);
 
     return 0;
@@ -10,52 +10,11 @@
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
+#include "board.h"
 
 #define BOARD_SIZE 3
 #define BUFFER_SIZE 256
 
-// checks if a player has won the game (1 if yes, else 0)
-int check_win(char board[3][3], char player_role)
-{
-    for (int i = 0; i < 3; i++)
-    {
-        // check rows
-        if (board[i][0] == player_role && board[i][1] == player_role && board[i][2] == player_role)
-        {
-            return 1;
-        }
-        // check columns
-        if (board[0][i] == player_role && board[1][i] == player_role && board[2][i] == player_role)
-        {
-            return 1;
-        }
-    }
-    // check diagonals
-    if (board[0][0] == player_role && board[1][1] == player_role && board[2][2] == player_role)
-    {
-        return 1;
-    }
-    if (board[0][2] == player_role && board[1][1] == player_role && board[2][0] == player_role)
-    {
-        return 1;
-    }
-    return 0;
-}
-
-// checks if there is a tie (1 if yes, else 0)
-int check_tie(char board[3][3])
-{
-    for (int i = 0; i < 3; i++)
-    {
-        for (int j = 0; j < 3; j++)
-        {
-            if (board[i][j] == '.')
-                return 0;
-        }
-    }
-    return 1;
-}
-
 void send_resign(int sockfd)
 {
     char message[BUFFER_SIZE];
@@ -315,7 +274,10 @@ int main(int argc, char *argv[])
                 }
             }
             display_board(board);
-            if (finished_role == role || check_tie(board) || check_win(board, finished_role))
+            // let the shared game core decide if the move ended the game
+            board_t core;
+            board_from_string(&core, board_str);
+            if (finished_role == role || board_check_tie(&core) || board_check_win(&core, finished_role))
             {
                 is_client_turn = 0;
             }
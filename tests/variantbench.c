@@ -0,0 +1,158 @@
+// replays recorded random games of every variant through the game_board functions make_move uses and reports moves per second
+// the classic games are also replayed straight on board.c to show what the variant dispatch costs
+// usage: ./variantbench [replays]
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "variant.h"
+#include "perfect.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define GAMES 1024
+#define MAX_MOVES (MNK_MAX_SIDE * MNK_MAX_SIDE)
+
+typedef struct recording {
+    variant_t variant;
+    int lengths[GAMES];
+    unsigned char (*moves)[MAX_MOVES][2];   // row and col of every move of every game
+    long total_moves;
+} recording_t;
+
+// plays GAMES random games of a variant and keeps their moves, picking moves at random is not part of the timing
+int record_games(recording_t* rec, const char* spec) {
+    if (!variant_parse(spec, &rec->variant)) {
+        fprintf(stderr, "bad variant %s\n", spec);
+        return 0;
+    }
+    rec->moves = malloc(sizeof(*rec->moves) * GAMES);
+    if (rec->moves == NULL) {
+        perror("malloc");
+        return 0;
+    }
+    rec->total_moves = 0;
+    for (int g = 0; g < GAMES; g++) {
+        game_board_t board;
+        if (!game_board_init(&board, &rec->variant)) {
+            perror("game_board_init");
+            return 0;
+        }
+        int n = 0;
+        for (;;) {
+            char role = (n % 2 == 0) ? 'X' : 'O';
+            int row = rand() % rec->variant.rows + 1;
+            int col = rand() % rec->variant.cols + 1;
+            if (rec->variant.type == VARIANT_GRAVITY) {
+                char position[16];
+                sprintf(position, "%d", col);
+                game_board_parse_move(&board, position, &row, &col);
+            }
+            if (!game_board_is_valid_move(&board, row, col)) {
+                continue;
+            }
+            game_board_place(&board, row, col, role);
+            rec->moves[g][n][0] = row;
+            rec->moves[g][n][1] = col;
+            n++;
+            if (game_board_check_win(&board, row, col, role) || game_board_check_tie(&board) || game_board_is_dead_draw(&board)) {
+                break;
+            }
+        }
+        rec->lengths[g] = n;
+        rec->total_moves += n;
+        game_board_free(&board);
+    }
+    return 1;
+}
+
+// replays the games with the same checks finish_if_over does after every move (returns the number of wins as a checksum)
+long replay(const recording_t* rec, int replays) {
+    long wins = 0;
+    for (int r = 0; r < replays; r++) {
+        for (int g = 0; g < GAMES; g++) {
+            game_board_t board;
+            game_board_init(&board, &rec->variant);
+            for (int i = 0; i < rec->lengths[g]; i++) {
+                char role = (i % 2 == 0) ? 'X' : 'O';
+                int row = rec->moves[g][i][0];
+                int col = rec->moves[g][i][1];
+                if (!game_board_is_valid_move(&board, row, col)) {
+                    break;
+                }
+                game_board_place(&board, row, col, role);
+                if (game_board_check_win(&board, row, col, role)) {
+                    wins++;
+                    break;
+                }
+                if (game_board_check_tie(&board) || game_board_is_dead_draw(&board)) {
+                    break;
+                }
+            }
+            game_board_free(&board);
+        }
+    }
+    return wins;
+}
+
+// the classic games again on board.c directly, without the variant dispatch
+long replay_classic(const recording_t* rec, int replays) {
+    long wins = 0;
+    for (int r = 0; r < replays; r++) {
+        for (int g = 0; g < GAMES; g++) {
+            board_t board;
+            board_init(&board);
+            for (int i = 0; i < rec->lengths[g]; i++) {
+                char role = (i % 2 == 0) ? 'X' : 'O';
+                int row = rec->moves[g][i][0];
+                int col = rec->moves[g][i][1];
+                if (!board_is_valid_move(&board, row, col)) {
+                    break;
+                }
+                board_place(&board, row, col, role);
+                if (board_check_win(&board, role)) {
+                    wins++;
+                    break;
+                }
+                if (board_check_tie(&board) || perfect_is_dead_draw(&board)) {
+                    break;
+                }
+            }
+        }
+    }
+    return wins;
+}
+
+int main(int argc, char **argv) {
+    int replays = argc >= 2 ? atoi(argv[1]) : 200;
+    const char* specs[] = {"", "ultimate", "gravity", "15,15,5"};
+    const char* names[] = {"classic 3x3", "ultimate", "gravity 6x7", "15,15,5"};
+    int count = sizeof(specs) / sizeof(specs[0]);
+    srand(42);
+
+    recording_t classic;
+    for (int v = 0; v < count; v++) {
+        recording_t rec;
+        if (!record_games(&rec, specs[v])) {
+            return EXIT_FAILURE;
+        }
+        double start = now_seconds();
+        long wins = replay(&rec, replays);
+        double seconds = now_seconds() - start;
+        long moves = rec.total_moves * replays;
+        printf("%-12s %8.1f moves/game %6.1f%% won  %7.2f ns/move  %7.1f M moves/s\n", names[v], (double) rec.total_moves / GAMES, 100.0 * wins / ((long) GAMES * replays), seconds * 1e9 / moves, moves / seconds / 1e6);
+        if (v == 0) {
+            classic = rec;
+        }
+        else {
+            free(rec.moves);
+        }
+    }
+
+    double start = now_seconds();
+    replay_classic(&classic, replays);
+    double seconds = now_seconds() - start;
+    long moves = classic.total_moves * replays;
+    printf("%-12s %8.1f moves/game         %7.2f ns/move  %7.1f M moves/s\n", "board.c 3x3", (double) classic.total_moves / GAMES, seconds * 1e9 / moves, moves / seconds / 1e6);
+    free(classic.moves);
+    return EXIT_SUCCESS;
+}
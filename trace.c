@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+__thread uint64_t trace_id = 0;
+
+// buffers are allocated the first time a thread claims them and kept, a thread that claims one freed by a finished game adds after its spans
+static trace_buffer_t* buffers[TRACE_BUFFERS];
+static __thread trace_buffer_t* thread_buffer = NULL;
+static pthread_key_t release_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+// a plain mutex, not a lockprof one: lockprof records its waits as trace spans, so a lockprof mutex here would trace into itself
+static pthread_mutex_t claim_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 1 in sample_every games is traced, 0 traces none
+static int sample_every = 0;
+static uint64_t sampled = 0;
+static uint64_t next_trace_id = 0;
+static uint64_t written = 0;
+static uint64_t dropped = 0;
+
+static char trace_path[256];
+static FILE* trace_file = NULL;
+static uint64_t epoch_ns = 0;
+static pthread_t flush_tid;
+static int flushing = 0;
+static volatile int* server_running = NULL;
+
+// gives a thread's buffer back when the thread exits, its spans are still flushed
+static void release_buffer(void* buffer) {
+    __atomic_store_n(&((trace_buffer_t*) buffer)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_key(void) {
+    pthread_key_create(&release_key, release_buffer);
+}
+
+// claims a free buffer for the calling thread the first time it traces (returns NULL if every buffer is in use)
+// only traced threads get here, so the mutex is taken about once per sampled game
+static trace_buffer_t* claim_buffer(void) {
+    pthread_once(&key_once, create_key);
+    trace_buffer_t* claimed = NULL;
+    pthread_mutex_lock(&claim_mutex);
+    for (int slot = 0; slot < TRACE_BUFFERS && claimed == NULL; slot++) {
+        if (buffers[slot] == NULL) {
+            trace_buffer_t* buffer = calloc(1, sizeof(trace_buffer_t));
+            if (buffer == NULL) {
+                break;
+            }
+            buffer->tid = slot + 1;
+            buffer->in_use = 1;
+            __atomic_store_n(&buffers[slot], buffer, __ATOMIC_RELEASE);
+            claimed = buffer;
+        }
+        else if (!__atomic_load_n(&buffers[slot]->in_use, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&buffers[slot]->in_use, 1, __ATOMIC_RELAXED);
+            claimed = buffers[slot];
+        }
+    }
+    pthread_mutex_unlock(&claim_mutex);
+    if (claimed != NULL) {
+        pthread_setspecific(release_key, claimed);
+    }
+    return claimed;
+}
+
+// adds a finished span of the calling thread's game, nothing if the thread isn't traced
+void trace_span(const char* category, const char* name, uint64_t start_ns, uint64_t end_ns) {
+    if (trace_id == 0) {
+        return;
+    }
+    trace_buffer_t* buffer = thread_buffer;
+    if (buffer == NULL) {
+        buffer = thread_buffer = claim_buffer();
+        if (buffer == NULL) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    uint64_t head = buffer->head;
+    if (head - __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_EVENTS) {
+        // counted in the thread's own buffer, a thread dropping spans doesn't fight the others over a counter
+        __atomic_store_n(&buffer->dropped, buffer->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    trace_event_t* event = &buffer->events[head % TRACE_RING_EVENTS];
+    event->category = category;
+    event->name = name;
+    event->trace_id = trace_id;
+    event->start_ns = start_ns;
+    event->end_ns = end_ns > start_ns ? end_ns : start_ns;
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// the calling thread works for the game with this trace id from now on, 0 when it is done or the game isn't traced
+void trace_set(uint64_t id) {
+    trace_id = id;
+}
+
+// decides if a new game is traced (returns its trace id, 0 if it isn't)
+uint64_t trace_sample(void) {
+    int every = __atomic_load_n(&sample_every, __ATOMIC_RELAXED);
+    if (every <= 0 || __atomic_fetch_add(&sampled, 1, __ATOMIC_RELAXED) % every != 0) {
+        return 0;
+    }
+    return __atomic_add_fetch(&next_trace_id, 1, __ATOMIC_RELAXED);
+}
+
+// traces 1 in every new games from now on, 0 stops tracing new ones
+void trace_sample_every(int every) {
+    __atomic_store_n(&sample_every, every < 0 ? 0 : every, __ATOMIC_RELAXED);
+}
+
+int trace_sampling(void) {
+    return __atomic_load_n(&sample_every, __ATOMIC_RELAXED);
+}
+
+uint64_t trace_written(void) {
+    return __atomic_load_n(&written, __ATOMIC_RELAXED);
+}
+
+// spans lost to full rings, to every buffer being in use or to the file not opening
+uint64_t trace_dropped(void) {
+    uint64_t total = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    for (int slot = 0; slot < TRACE_BUFFERS; slot++) {
+        trace_buffer_t* buffer = __atomic_load_n(&buffers[slot], __ATOMIC_ACQUIRE);
+        if (buffer == NULL) {
+            break;
+        }
+        total += __atomic_load_n(&buffer->dropped, __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+// writes every span the threads have added since the last flush, the file is only created once there is something to write
+// a span's ts and dur are in us from when tracing started
+static void flush_buffers(void) {
+    for (int slot = 0; slot < TRACE_BUFFERS; slot++) {
+        trace_buffer_t* buffer = __atomic_load_n(&buffers[slot], __ATOMIC_ACQUIRE);
+        if (buffer == NULL) {
+            break;
+        }
+        uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = buffer->tail;
+        if (tail == head) {
+            continue;
+        }
+        if (trace_file == NULL) {
+            trace_file = fopen(trace_path, "w");
+            if (trace_file == NULL) {
+                perror("trace fopen");
+                __atomic_fetch_add(&dropped, head - tail, __ATOMIC_RELAXED);
+                __atomic_store_n(&buffer->tail, head, __ATOMIC_RELEASE);
+                continue;
+            }
+            fprintf(trace_file, "[\n");
+        }
+        for (; tail < head; tail++) {
+            const trace_event_t* event = &buffer->events[tail % TRACE_RING_EVENTS];
+            fprintf(trace_file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"trace\":%llu}}",
+                __atomic_load_n(&written, __ATOMIC_RELAXED) ? ",\n" : "", event->name, event->category, (event->start_ns - epoch_ns) / 1e3,
+                (event->end_ns - event->start_ns) / 1e3, buffer->tid, (unsigned long long) event->trace_id);
+            __atomic_fetch_add(&written, 1, __ATOMIC_RELAXED);
+        }
+        // the slots are only given back once their spans are written
+        __atomic_store_n(&buffer->tail, head, __ATOMIC_RELEASE);
+    }
+    if (trace_file != NULL) {
+        fflush(trace_file);
+    }
+}
+
+// flushes every TRACE_FLUSH_MS until the server stops, then once more and ends the file
+static void* flush_thread(void* arg) {
+    struct timespec interval;
+    interval.tv_sec = TRACE_FLUSH_MS / 1000;
+    interval.tv_nsec = (TRACE_FLUSH_MS % 1000) * 1000000L;
+    while (*server_running) {
+        nanosleep(&interval, NULL);
+        flush_buffers();
+    }
+    flush_buffers();
+    if (trace_file != NULL) {
+        fprintf(trace_file, "\n]\n");
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+    return NULL;
+}
+
+// starts the thread writing the traced games' spans to path, the caller blocks the signals the thread must not get
+// (returns 1 on success, 0 if error)
+int trace_start(const char* path, volatile int* running) {
+    snprintf(trace_path, sizeof(trace_path), "%s", path);
+    epoch_ns = latency_now();
+    server_running = running;
+    int error = pthread_create(&flush_tid, NULL, flush_thread, NULL);
+    if (error != 0) {
+        fprintf(stderr, "trace flush thread: %s\n", strerror(error));
+        return 0;
+    }
+    flushing = 1;
+    return 1;
+}
+
+// waits for the flush thread to write the last spans and end the file, once the server has stopped running
+void trace_stop(void) {
+    if (flushing) {
+        pthread_join(flush_tid, NULL);
+        flushing = 0;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "latency.h"
+#include <pthread.h>
+#include <stdint.h>
+
+// file the sampled games' spans are written to (named after the server's port), in the Chrome trace event format
+#define TRACE_PATH_FORMAT "ttts-%s.trace.json"
+// threads that can trace at once, a traced thread past it loses its spans
+#define TRACE_BUFFERS 256
+// spans a thread can have waiting for the flush thread, spans past it are dropped
+#define TRACE_RING_EVENTS 1024
+// ms between flushes
+#define TRACE_FLUSH_MS 100
+
+// one finished span, a complete event ("ph":"X") in the trace
+typedef struct trace_event {
+    const char* category;
+    const char* name;
+    uint64_t trace_id;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} trace_event_t;
+
+// a ring of one thread's spans: the thread adds at head and the flush thread takes from tail, neither ever waits for the other
+typedef struct trace_buffer {
+    int in_use;            // claimed by a thread (set under the claim mutex, cleared when the thread exits)
+    int tid;               // the thread id shown in the trace
+    char padding[56];      // keeps head off the line threads claim buffers on
+    uint64_t head;         // spans added, only written by the thread holding the buffer
+    uint64_t dropped;      // spans the ring was full for, also only written by that thread
+    char padding2[48];
+    uint64_t tail;         // spans flushed, only written by the flush thread
+    char padding3[56];
+    trace_event_t events[TRACE_RING_EVENTS];
+} trace_buffer_t;
+
+// the trace id of the game the calling thread is working for, 0 when it isn't being traced
+extern __thread uint64_t trace_id;
+
+void trace_span(const char* category, const char* name, uint64_t start_ns, uint64_t end_ns);
+
+// when a span starts, 0 if the thread isn't traced so the matching trace_end does nothing
+static inline uint64_t trace_begin(void) {
+    return trace_id ? latency_now() : 0;
+}
+
+static inline void trace_end(const char* category, const char* name, uint64_t start_ns) {
+    if (start_ns != 0) {
+        trace_span(category, name, start_ns, latency_now());
+    }
+}
+
+void trace_set(uint64_t id);
+uint64_t trace_sample(void);
+void trace_sample_every(int every);
+int trace_sampling(void);
+uint64_t trace_written(void);
+uint64_t trace_dropped(void);
+int trace_start(const char* path, volatile int* running);
+void trace_stop(void);
+
+#endif
@@ -0,0 +1,377 @@
+// NOTE: must use option -pthread when compiling!
+// exports the finished games in the journal to a columnar file for analytics, and aggregates one reading only the columns it needs
+// usage: ./tttexport [-d journal directory] <file>   exports every finished game in the journal
+//        ./tttexport -q <file>                       results, length, duration and most common first move by variant
+//        ./tttexport -g <games> <file>               writes random self-play classic games from sim.c instead
+// the export only reads the journal's segment files, the server doesn't know it runs
+#define _POSIX_C_SOURCE 200809L
+#include "columnar.h"
+#include "journal.h"
+#include "latency.h"
+#include "mnk.h"
+#include "protocol.h"
+#include "replay.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// most variants a query keeps totals for
+#define MAX_VARIANTS 64
+// first moves a query counts per variant, a move is row << 8 | col (gravity's is the col alone) and no side is longer than MNK_MAX_SIDE
+#define MOVE_SLOTS ((MNK_MAX_SIDE << 8) + MNK_MAX_SIDE + 1)
+
+// the parts of a journal record the export needs, sorted by game and time like recovery sorts them
+typedef struct record {
+    uint64_t game_id;
+    uint64_t time_ns;
+    uint64_t order;           // scan order, keeps records with the same time in the order they were written
+    uint32_t code;
+    uint32_t begun;           // offset of a BEGN's payload in the arena
+    char field[8];            // a MOVD's position, an OVER's winner
+} record_t;
+
+typedef struct scan {
+    record_t* records;
+    size_t count;
+    size_t capacity;
+    char* arena;              // BEGN payloads, terminated
+    size_t used;
+    size_t arena_capacity;
+    int failed;
+} scan_t;
+
+// totals of one variant in a query
+typedef struct variant_totals {
+    char name[32];
+    uint64_t games;
+    uint64_t results[4];
+    uint64_t moves;
+    uint64_t duration_ms;
+    uint32_t first_moves[MOVE_SLOTS];
+} variant_totals_t;
+
+void collect(const journal_record_t* journal_record, const char* payload, void* arg) {
+    scan_t* scan = arg;
+    int code = journal_record->code;
+    if ((code != BEGN && code != MOVD && code != OVER) || scan->failed) {
+        return;
+    }
+    if (scan->count == scan->capacity) {
+        size_t capacity = scan->capacity ? scan->capacity * 2 : 65536;
+        record_t* grown = realloc(scan->records, capacity * sizeof(record_t));
+        if (grown == NULL) {
+            perror("realloc");
+            scan->failed = 1;
+            return;
+        }
+        scan->records = grown;
+        scan->capacity = capacity;
+    }
+    record_t* record = &scan->records[scan->count];
+    memset(record, 0, sizeof(*record));
+    record->game_id = journal_record->game_id;
+    record->time_ns = journal_record->time_ns;
+    record->order = scan->count;
+    record->code = code;
+    if (code == BEGN) {
+        if (scan->used + journal_record->length + 1 > scan->arena_capacity) {
+            size_t capacity = scan->arena_capacity ? scan->arena_capacity * 2 : (1 << 20);
+            while (scan->used + journal_record->length + 1 > capacity) {
+                capacity *= 2;
+            }
+            char* grown = realloc(scan->arena, capacity);
+            if (grown == NULL) {
+                perror("realloc");
+                scan->failed = 1;
+                return;
+            }
+            scan->arena = grown;
+            scan->arena_capacity = capacity;
+        }
+        record->begun = scan->used;
+        memcpy(scan->arena + scan->used, payload, journal_record->length);
+        scan->arena[scan->used + journal_record->length] = '\0';
+        scan->used += journal_record->length + 1;
+    }
+    else {
+        // a MOVD is role|pos and an OVER winner|reason
+        size_t start = (code == MOVD) ? 2 : 0;
+        if (journal_record->length > start) {
+            size_t length = (code == MOVD) ? journal_record->length - start : 1;
+            memcpy(record->field, payload + start, length < sizeof(record->field) ? length : sizeof(record->field) - 1);
+        }
+    }
+    scan->count++;
+}
+
+int compare_records(const void* a, const void* b) {
+    const record_t* left = a;
+    const record_t* right = b;
+    if (left->game_id != right->game_id) {
+        return left->game_id < right->game_id ? -1 : 1;
+    }
+    if (left->time_ns != right->time_ns) {
+        return left->time_ns < right->time_ns ? -1 : 1;
+    }
+    return (left->order > right->order) - (left->order < right->order);
+}
+
+// packs a move's position: row << 8 | col, or the col alone on a gravity board (0 if it doesn't parse)
+uint32_t pack_move(const char* position) {
+    unsigned row = 0;
+    unsigned col = 0;
+    if (sscanf(position, "%u,%u", &row, &col) == 2) {
+        return (row << 8) | (col & 0xFF);
+    }
+    return sscanf(position, "%u", &col) == 1 ? col : 0;
+}
+
+// writes the finished games of the records of one game to the file (returns 1 on success, 0 if error)
+// a BEGN starts the game again (recovery journals a resumed game's BEGN and moves again), the first BEGN's time is when it started
+int export_game(columnar_writer_t* writer, const scan_t* scan, const record_t* records, size_t count, uint64_t* exported) {
+    const char* begun = NULL;
+    uint64_t started = 0;
+    uint64_t ended = 0;
+    int moves = 0;
+    uint32_t first_move = 0;
+    char winner = '\0';
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].code == BEGN) {
+            begun = scan->arena + records[i].begun;
+            started = started ? started : records[i].time_ns;
+            moves = 0;
+            first_move = 0;
+        }
+        else if (records[i].code == MOVD) {
+            moves++;
+            if (moves == 1) {
+                first_move = pack_move(records[i].field);
+            }
+        }
+        else {
+            winner = records[i].field[0];
+            ended = records[i].time_ns;
+        }
+    }
+    // scrapped and unfinished games have no result
+    int result = replay_result_from_winner(winner);
+    if (begun == NULL || result == REPLAY_UNFINISHED) {
+        return 1;
+    }
+    // BEGN is x|o|spec|xToken|oToken
+    char payload[JOURNAL_MAX_PAYLOAD + 1];
+    snprintf(payload, sizeof(payload), "%s", begun);
+    char* x_name = payload;
+    char* o_name = strchr(x_name, '|');
+    char* spec = o_name ? strchr(o_name + 1, '|') : NULL;
+    if (spec == NULL) {
+        return 1;
+    }
+    *o_name++ = '\0';
+    *spec++ = '\0';
+    char* bar = strchr(spec, '|');
+    if (bar != NULL) {
+        *bar = '\0';
+    }
+    columnar_row_t row;
+    row.game_id = records[0].game_id;
+    row.started_ns = started;
+    row.duration_ms = ended > started ? (ended - started) / 1000000 : 0;
+    row.x_name = x_name;
+    row.o_name = o_name;
+    row.variant = spec[0] != '\0' ? spec : "classic";
+    row.result = result;
+    row.length = moves;
+    row.first_move = first_move;
+    (*exported)++;
+    return columnar_writer_add(writer, &row);
+}
+
+// reads every run of the journal and writes its finished games (returns 1 on success, 0 if error)
+int export_journal(const char* dir, const char* path) {
+    double start = now_seconds();
+    scan_t scan;
+    memset(&scan, 0, sizeof(scan));
+    long records = journal_scan(dir, 0, collect, &scan);
+    if (records < 0 || scan.failed) {
+        fprintf(stderr, "could not read the journal in %s\n", dir);
+        return 0;
+    }
+    qsort(scan.records, scan.count, sizeof(record_t), compare_records);
+    columnar_writer_t writer;
+    if (!columnar_writer_open(&writer, path)) {
+        return 0;
+    }
+    uint64_t exported = 0;
+    int ok = 1;
+    for (size_t first = 0, last = 0; first < scan.count && ok; first = last) {
+        while (last < scan.count && scan.records[last].game_id == scan.records[first].game_id) {
+            last++;
+        }
+        ok = export_game(&writer, &scan, &scan.records[first], last - first, &exported);
+    }
+    uint64_t bytes = writer.offset;
+    ok = columnar_writer_close(&writer) && ok;
+    free(scan.records);
+    free(scan.arena);
+    if (ok) {
+        printf("tttexport: %llu finished games from %ld journal records written to %s (%.1f KB) in %.3f s\n", (unsigned long long) exported, records, path, bytes / 1e3, now_seconds() - start);
+    }
+    return ok;
+}
+
+// writes random self-play classic games with made up players, to measure a scan of a big file (returns 1 on success, 0 if error)
+int generate(const char* path, long games) {
+    columnar_writer_t writer;
+    sim_batch_t* batch = malloc(sizeof(sim_batch_t));
+    if (batch == NULL || !columnar_writer_open(&writer, path)) {
+        free(batch);
+        return 0;
+    }
+    sim_batch_seed(batch, 1);
+    uint64_t started = (uint64_t) time(NULL) * 1000000000ull;
+    uint32_t state = 2463534242u;
+    char x_name[32];
+    char o_name[32];
+    int ok = 1;
+    for (long done = 0; done < games && ok; done += SIM_BATCH) {
+        sim_batch_play(batch);
+        int lanes = (games - done < SIM_BATCH) ? games - done : SIM_BATCH;
+        for (int i = 0; i < lanes && ok; i++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            snprintf(x_name, sizeof(x_name), "player%u", state % 100000);
+            snprintf(o_name, sizeof(o_name), "player%u", (state >> 7) % 100000);
+            int first = batch->cells[0][i];
+            columnar_row_t row = {done + i + 1, started, 2000 + state % 30000, x_name, o_name, "classic", batch->result[i], batch->length[i], ((first / 3 + 1) << 8) | (first % 3 + 1)};
+            started += state % 1000000;
+            ok = columnar_writer_add(&writer, &row);
+        }
+    }
+    free(batch);
+    return columnar_writer_close(&writer) && ok;
+}
+
+// aggregates a file by variant reading only the variant, result, length, duration and first move columns (returns 1 on success, 0 if error)
+int query(const char* path) {
+    columnar_file_t file;
+    if (!columnar_open(&file, path)) {
+        return 0;
+    }
+    double start = now_seconds();
+    variant_totals_t* totals = calloc(MAX_VARIANTS, sizeof(variant_totals_t));
+    uint64_t* columns[COLUMN_COUNT] = {NULL};
+    const columnar_column_t wanted[] = {COLUMN_VARIANT, COLUMN_RESULT, COLUMN_LENGTH, COLUMN_DURATION, COLUMN_FIRST_MOVE};
+    int ok = totals != NULL;
+    for (size_t i = 0; i < sizeof(wanted) / sizeof(wanted[0]) && ok; i++) {
+        columns[wanted[i]] = malloc(COLUMNAR_ROW_GROUP * sizeof(uint64_t));
+        ok = columns[wanted[i]] != NULL;
+    }
+    int variants = 0;
+    uint64_t rows = 0;
+    for (uint32_t group = 0; group < file.groups && ok; group++) {
+        uint32_t names_count = 0;
+        char** names = columnar_read_strings(&file, group, COLUMN_VARIANTS, &names_count);
+        ok = names != NULL;
+        for (size_t i = 0; i < sizeof(wanted) / sizeof(wanted[0]) && ok; i++) {
+            ok = columnar_read_values(&file, group, wanted[i], columns[wanted[i]]);
+        }
+        // the group's variant indexes mapped to the query's totals
+        int slot_of[MAX_VARIANTS];
+        for (uint32_t i = 0; i < names_count && i < MAX_VARIANTS && ok; i++) {
+            slot_of[i] = -1;
+            for (int v = 0; v < variants && slot_of[i] < 0; v++) {
+                slot_of[i] = (strcmp(totals[v].name, names[i]) == 0) ? v : -1;
+            }
+            if (slot_of[i] < 0 && variants < MAX_VARIANTS) {
+                snprintf(totals[variants].name, sizeof(totals[variants].name), "%s", names[i]);
+                slot_of[i] = variants++;
+            }
+        }
+        uint32_t group_rows = file.group_info[group].rows;
+        for (uint32_t row = 0; row < group_rows && ok; row++) {
+            uint64_t variant = columns[COLUMN_VARIANT][row];
+            if (variant >= names_count || variant >= MAX_VARIANTS || slot_of[variant] < 0) {
+                continue;
+            }
+            variant_totals_t* total = &totals[slot_of[variant]];
+            total->games++;
+            total->results[columns[COLUMN_RESULT][row] & 3]++;
+            total->moves += columns[COLUMN_LENGTH][row];
+            total->duration_ms += columns[COLUMN_DURATION][row];
+            uint64_t first_move = columns[COLUMN_FIRST_MOVE][row];
+            // a move off every board would only come from a damaged file, it is left out of the counts instead of landing on another move
+            if (first_move < MOVE_SLOTS) {
+                total->first_moves[first_move]++;
+            }
+        }
+        rows += group_rows;
+        free(names);
+    }
+    double seconds = now_seconds() - start;
+    if (ok) {
+        printf("tttexport: %llu games in %u row groups, read %.1f KB of %.1f KB (%.1f%%) in %.3f s\n", (unsigned long long) rows, file.groups, file.bytes_read / 1e3, file.size / 1e3, 100.0 * file.bytes_read / file.size, seconds);
+        for (int v = 0; v < variants; v++) {
+            variant_totals_t* total = &totals[v];
+            uint64_t games = total->games ? total->games : 1;
+            int common = 0;
+            for (int move = 1; move < MOVE_SLOTS; move++) {
+                common = total->first_moves[move] > total->first_moves[common] ? move : common;
+            }
+            char position[16];
+            columnar_format_move(common, strncmp(total->name, "gravity", 7) == 0, position);
+            printf("    %-16s %llu games, X %.2f%%, O %.2f%%, draw %.2f%%, %.2f moves, %.1f s, most common first move %s\n", total->name, (unsigned long long) total->games,
+                100.0 * total->results[REPLAY_X_WON] / games, 100.0 * total->results[REPLAY_O_WON] / games, 100.0 * total->results[REPLAY_DRAW] / games,
+                (double) total->moves / games, total->duration_ms / 1000.0 / games, position);
+        }
+    }
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        free(columns[column]);
+    }
+    free(totals);
+    columnar_close(&file);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char* dir = JOURNAL_DIR;
+    long generate_games = -1;
+    int is_query = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:g:q")) != -1) {
+        if (opt == 'd') {
+            dir = optarg;
+        }
+        else if (opt == 'g') {
+            generate_games = atol(optarg);
+        }
+        else if (opt == 'q') {
+            is_query = 1;
+        }
+        else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1) {
+        printf("Usage: ./tttexport [-d journal directory] <file>\n       ./tttexport -q <file>\n       ./tttexport -g <games> <file>\n");
+        return EXIT_FAILURE;
+    }
+    const char* path = argv[optind];
+    if (is_query) {
+        return query(path) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (generate_games >= 0) {
+        double start = now_seconds();
+        if (!generate(path, generate_games)) {
+            return EXIT_FAILURE;
+        }
+        printf("tttexport: wrote %ld games to %s in %.2f s\n", generate_games, path, now_seconds() - start);
+        return EXIT_SUCCESS;
+    }
+    return export_journal(dir, path) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
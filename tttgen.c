@@ -0,0 +1,123 @@
+// build step that solves every reachable 3x3 position with minimax and writes the table as C source
+// usage: ./tttgen perfect_table.c
+#include "board.h"
+#include "perfect.h"
+#include "canon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// table being built, indexed the same way as perfect_table
+uint16_t table[PERFECT_POSITIONS];
+uint16_t ternary[1 << BOARD_CELLS];
+// 1 once a position has been solved
+unsigned char solved[PERFECT_POSITIONS];
+// 1 if some continuation of the position completes a line for either player
+unsigned char can_win[PERFECT_POSITIONS];
+int reachable = 0;
+// reachable positions that are the smallest of their 8 symmetric copies
+int canonical = 0;
+
+int index_of(uint16_t x, uint16_t o) {
+    return ternary[x] + 2 * ternary[o];
+}
+
+// solves a position and every position reachable from it, returns its value for the player to move
+int solve(uint16_t x, uint16_t o) {
+    int index = index_of(x, o);
+    if (solved[index]) {
+        return (table[index] >> PERFECT_VALUE_SHIFT) & 3;
+    }
+    solved[index] = 1;
+    reachable++;
+    if (canon_classic_key(x, o, NULL) == (x | ((uint32_t) o << BOARD_CELLS))) {
+        canonical++;
+    }
+
+    // terminal positions, the player who just moved is the only one that can have a line
+    if (board_mask_is_win(x) || board_mask_is_win(o)) {
+        int status = board_mask_is_win(x) ? PERFECT_X_WON : PERFECT_O_WON;
+        table[index] = (PERFECT_LOSS << PERFECT_VALUE_SHIFT) | (status << PERFECT_STATUS_SHIFT);
+        can_win[index] = 1;
+        return PERFECT_LOSS;
+    }
+    if ((x | o) == BOARD_FULL) {
+        table[index] = (PERFECT_DRAW << PERFECT_VALUE_SHIFT) | (PERFECT_TIE << PERFECT_STATUS_SHIFT) | PERFECT_DEAD_BIT;
+        can_win[index] = 0;
+        return PERFECT_DRAW;
+    }
+
+    int x_to_move = __builtin_popcount(x) == __builtin_popcount(o);
+    int best = -1;
+    uint16_t best_moves = 0;
+    int any_win = 0;
+    for (int cell = 0; cell < BOARD_CELLS; cell++) {
+        uint16_t bit = 1 << cell;
+        if ((x | o) & bit) {
+            continue;
+        }
+        uint16_t nx = x_to_move ? (x | bit) : x;
+        uint16_t no = x_to_move ? o : (o | bit);
+        // the child's value is for the opponent so flip it
+        int value = 2 - solve(nx, no);
+        any_win |= can_win[index_of(nx, no)];
+        if (value > best) {
+            best = value;
+            best_moves = bit;
+        }
+        else if (value == best) {
+            best_moves |= bit;
+        }
+    }
+    can_win[index] = any_win;
+    table[index] = best_moves | (best << PERFECT_VALUE_SHIFT) | (PERFECT_PLAYING << PERFECT_STATUS_SHIFT) | (any_win ? 0 : PERFECT_DEAD_BIT);
+    return best;
+}
+
+// writes an array as C source, 8 values per line
+void write_array(FILE* out, const char* name, const uint16_t* values, int count) {
+    fprintf(out, "const uint16_t %s[%d] = {\n", name, count);
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s0x%04X%s", (i % 8 == 0) ? "    " : "", values[i], (i == count - 1) ? "\n" : ((i % 8 == 7) ? ",\n" : ", "));
+    }
+    fprintf(out, "};\n\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        printf("Usage: ./tttgen <output file>\n");
+        return EXIT_FAILURE;
+    }
+
+    // ternary value of every cell mask (digit i is 1 when bit i is set)
+    for (int mask = 0; mask < (1 << BOARD_CELLS); mask++) {
+        int value = 0;
+        int power = 1;
+        for (int cell = 0; cell < BOARD_CELLS; cell++) {
+            if (mask & (1 << cell)) {
+                value += power;
+            }
+            power *= 3;
+        }
+        ternary[mask] = value;
+    }
+
+    solve(0, 0);
+
+    FILE* out = fopen(argv[1], "w");
+    if (out == NULL) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "// generated by tttgen, do not edit\n");
+    fprintf(out, "// %d reachable positions, %d up to symmetry\n", reachable, canonical);
+    fprintf(out, "#include \"perfect.h\"\n\n");
+    write_array(out, "perfect_ternary", ternary, 1 << BOARD_CELLS);
+    write_array(out, "perfect_table", table, PERFECT_POSITIONS);
+    if (fclose(out) != 0) {
+        perror("fclose");
+        return EXIT_FAILURE;
+    }
+    printf("tttgen: wrote %d reachable positions (%d up to symmetry) to %s\n", reachable, canonical, argv[1]);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+// NOTE: must use option -pthread when compiling!
+// prints the last games of a player from the history index and the journal records it points at
+// usage: ./ttthist [-n games] [-d journal directory] <name>
+#define _POSIX_C_SOURCE 200809L
+#include "history.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// splits a journal payload in place at its bars (returns the number of fields)
+int split_fields(char* payload, char** fields, int max) {
+    int count = 0;
+    char* field = payload;
+    while (count < max) {
+        fields[count++] = field;
+        char* bar = strchr(field, '|');
+        if (bar == NULL) {
+            break;
+        }
+        *bar = '\0';
+        field = bar + 1;
+    }
+    return count;
+}
+
+// prints one game as the player saw it (returns 1 if it was the player's game, 0 if the name only shared their hash or the journal is gone)
+int print_game(const char* dir, const char* name, const history_entry_t* entry) {
+    journal_record_t record;
+    char begun[JOURNAL_MAX_PAYLOAD + 1];
+    char over[JOURNAL_MAX_PAYLOAD + 1];
+    if (journal_read(dir, &entry->begun_at, entry->game_id, &record, begun, sizeof(begun)) < 0 || record.code != BEGN
+        || journal_read(dir, &entry->over_at, entry->game_id, &record, over, sizeof(over)) < 0 || record.code != OVER) {
+        return 0;
+    }
+    // BEGN is x|o|spec|xToken|oToken and OVER is winner|reason
+    char* begun_fields[5];
+    char* over_fields[2];
+    if (split_fields(begun, begun_fields, 5) < 3 || split_fields(over, over_fields, 2) < 2) {
+        return 0;
+    }
+    char role;
+    const char* opponent;
+    if (strcmp(begun_fields[0], name) == 0) {
+        role = 'X';
+        opponent = begun_fields[1];
+    }
+    else if (strcmp(begun_fields[1], name) == 0) {
+        role = 'O';
+        opponent = begun_fields[0];
+    }
+    else {
+        return 0;
+    }
+    char winner = over_fields[0][0];
+    const char* result = (winner == 'D') ? "drew" : (winner == role) ? "won " : "lost";
+
+    time_t seconds = entry->time_ns / 1000000000ull;
+    struct tm local;
+    char when[32];
+    localtime_r(&seconds, &local);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &local);
+    // a classic game's variant is journaled empty
+    const char* spec = begun_fields[2][0] != '\0' ? begun_fields[2] : "classic";
+    printf("%s  %s  %c vs %-20s %-16s %s\n", when, result, role, opponent, spec, over_fields[1]);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int limit = HISTORY_QUERY_GAMES;
+    const char* dir = HISTORY_DIR;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+        if (opt == 'n') {
+            limit = atoi(optarg);
+        }
+        else if (opt == 'd') {
+            dir = optarg;
+        }
+        else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1 || limit < 1) {
+        printf("Usage: ./ttthist [-n games] [-d journal directory] <name>\n");
+        return EXIT_FAILURE;
+    }
+    const char* name = argv[optind];
+
+    // a few more than asked for, in case some belong to another name with the same hash
+    int wanted = limit + 8;
+    history_entry_t* entries = malloc(wanted * sizeof(history_entry_t));
+    if (entries == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int found = history_query(dir, name, entries, wanted);
+    if (found < 0) {
+        fprintf(stderr, "could not read the history index in %s\n", dir);
+        free(entries);
+        return EXIT_FAILURE;
+    }
+    int printed = 0;
+    for (int i = 0; i < found && printed < limit; i++) {
+        printed += print_game(dir, name, &entries[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ttthist: %d games of %s in %.3f ms\n", printed, name, ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e6);
+    free(entries);
+    return EXIT_SUCCESS;
+}
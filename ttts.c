@@ -1,10 +1,29 @@
 // NOTE: must use option -pthread when compiling!
 #define _POSIX_C_SOURCE 200809L
 #include "protocol.h"
+#include "variant.h"
+#include "bot.h"
+#include "poscache.h"
+#include "tablebase.h"
+#include "journal.h"
+#include "recovery.h"
+#include "replay.h"
+#include "players.h"
+#include "leaderboard.h"
+#include "history.h"
+#include "latency.h"
+#include "metrics.h"
+#include "admin.h"
+#include "lockprof.h"
+#include "sysacct.h"
+#include "trace.h"
+#include "prof.h"
+#include "memacct.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -13,17 +32,53 @@
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <stdarg.h>
 
 #define QUEUE_SIZE 8
 #define HOSTSIZE 100
 #define PORTSIZE 10
+// slots in the position cache bots share across games (16 bytes each)
+#define POSITION_CACHE_ENTRIES (1 << 20)
 
 volatile int active = 1;
 
+// seconds a player waits for an opponent before being paired with a bot (negative turns bots off) and the strength of that bot (0-100)
+int bot_wait_seconds = 30;
+int bot_strength = 50;
+// when journal records reach the disk, set by the optional fourth argument (none, group or always)
+JournalSync journal_sync = JOURNAL_SYNC_GROUP;
+// set once the journal is set up, a game that can't claim a writer after that is one recovery won't know about
+int journal_on = 0;
+// recovered games wait for their players until resume_deadline, resumes_pending is cleared once they have expired
+struct timespec resume_deadline;
+int resumes_pending = 0;
+// finished classic games are appended here packed into 8 bytes each
+replay_archive_t replay_archive = {-1};
+// set by the admin DRAIN command: new players are turned away while the games being played finish
+volatile int draining = 0;
+// where the spans of the games sampled by the admin TRACE command go
+char trace_path[64];
+// set by SIGUSR1, the main thread prints the lock report when it next wakes up
+volatile sig_atomic_t lock_report_wanted = 0;
+// where the CPU profile's folded stacks go
+char prof_path[64];
+// set by SIGUSR2, the main thread starts the CPU profiler or stops it and writes the profile when it next wakes up
+volatile sig_atomic_t profile_toggle_wanted = 0;
+
 void handler(int signum) {
     active = 0;
 }
 
+void lock_report_handler(int signum) {
+    lock_report_wanted = 1;
+}
+
+void profile_toggle_handler(int signum) {
+    profile_toggle_wanted = 1;
+}
+
 // set up signal handlers for primary thread
 // return a mask blocking those signals for worker threads
 void install_handlers(sigset_t *mask) {
@@ -43,13 +98,31 @@ void install_handlers(sigset_t *mask) {
         perror("sigaction");
         exit(EXIT_FAILURE);
     }
+
+    // Set up signal handler for SIGUSR1, which asks for the lock report without stopping anything
+    act.sa_handler = lock_report_handler;
+    act.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &act, NULL) == -1) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
+
+    // Set up signal handler for SIGUSR2, which starts and stops the CPU profiler
+    act.sa_handler = profile_toggle_handler;
+    if (sigaction(SIGUSR2, &act, NULL) == -1) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
     
+    // SIGPROF isn't in the mask: the profiler's samples must reach every thread
     sigemptyset(mask);
     sigaddset(mask, SIGINT);
     sigaddset(mask, SIGTERM);
+    sigaddset(mask, SIGUSR1);
+    sigaddset(mask, SIGUSR2);
 }
 
-// data to be sent to worker threads
+// a connection being accepted, on the main thread's stack
 typedef struct connection_data {
 	struct sockaddr_storage addr;
 	socklen_t addr_len;
@@ -114,39 +187,85 @@ typedef struct game {
     char xName[128];
     int xfd;
     char oName[128];
-    int ofd;
+    int ofd; // BOT_FD when O is played by a bot
+    variant_t variant;
+    struct timespec wait_start; // when X started waiting for an opponent
+    uint64_t id;                // journal id, set by start_game on its own copy of the game
+    journal_writer_t* journal;  // journal segment claimed by the game thread (NULL if the game isn't journaled)
+    char winner;                // X, O or D once the game is over, - if it was scrapped, '\0' while it is played
+    replay_t replay;            // moves of a classic game packed for the replay archive
+    char resigner;              // role that resigned, '\0' if nobody did
+    char xToken[SESSION_TOKEN_LEN + 1];  // session tokens, a player resumes the game with their name and token after a restart
+    char oToken[SESSION_TOKEN_LEN + 1];
+    recovered_game_t* resume;   // the journaled game this one picks up after a restart, NULL for a new game
+    journal_position_t begun_at;  // where the game's BEGN and OVER were journaled, for the history index
+    journal_position_t over_at;
+    uint64_t over_ns;           // latency_now when the game's OVER was decided
+    sysacct_t syscalls;         // syscalls of both players' handshakes, then of the game thread on its copy
+    uint64_t trace_id;          // the game's trace id if it was sampled for tracing when its node was made, else 0
+    int moves;                  // moves played, kept by the game thread on its copy
+    // what admin listings show of a game being played, written by its game thread to the node in games_list
+    // published is odd while the thread writes, a reader copies the fields again if it changed under it
+    unsigned published;         // 0 until the game thread starts
+    char turn;
+    char board[ADMIN_BOARD_BYTES + 1];
     struct game *next;
 } game_t;
 
 // handles locking and unlocking for games_list
-pthread_mutex_t games_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+lockprof_mutex_t games_list_mutex = LOCKPROF_MUTEX_INITIALIZER("games_list_mutex");
 
 // linked list that maintains the number of games that are active or waiting for another player.
 game_t* games_list = NULL;
 
-// adds a client to a game or create a new game if all are full (returns 1 to show that a game is full and ready to be started )
-game_t* add_client_to_game(int fd, char *name) {
+// closes a player's connection and counts it for the metrics
+void close_player(int fd) {
+    close(fd);
+    sysacct_count(SYSACCT_CLOSE, 0, 0);
+    metrics_add(METRIC_CONNECTIONS_CLOSED, 1);
+}
+
+// answers a player's first message with INVL and the reason, then closes their connection whether the INVL got through or not
+void turn_away(int fd, message_t* msg, char* reason) {
+    set_message_fields(msg, 7, reason, NULL);
+    send_msg(fd, msg, NULL);
+    close_player(fd);
+}
+
+// adds a client to a game that wants the same variant or create a new game if all are full (returns 1 to show that a game is full and ready to be started )
+game_t* add_client_to_game(int fd, char *name, variant_t* variant) {
     // Lock the mutex before modifying games_list
-    pthread_mutex_lock(&games_list_mutex); 
+    lockprof_lock(&games_list_mutex); 
 
     // check if there is a game with an empty spot for O since all games will have an X
     game_t *curr_game_p = games_list;
     while (curr_game_p != NULL) {
-        if ((curr_game_p->xfd != -1 && curr_game_p->ofd == -1)) {
+        if ((curr_game_p->xfd != -1 && curr_game_p->ofd == -1) && curr_game_p->resume == NULL && variant_equals(&curr_game_p->variant, variant)) {
             strcpy(curr_game_p->oName, name);
             curr_game_p->ofd = fd;
             // Unlock the mutex after modifying games_list
-            pthread_mutex_unlock(&games_list_mutex);
+            lockprof_unlock(&games_list_mutex);
             return curr_game_p;
         }
         curr_game_p = curr_game_p->next;
     }
     // no game with empty spot so create a new game
-    game_t *new_game = malloc(sizeof(game_t));
+    game_t *new_game = memacct_malloc(MEMACCT_GAME, sizeof(game_t));
+    // the node is all a waiting player holds until an opponent comes
+    memacct_record_footprint(MEMACCT_WAITING_PLAYER, memacct_size(new_game));
     strcpy(new_game->xName, name);
     new_game->xfd = fd;
     strcpy(new_game->oName, "");
     new_game->ofd = -1;
+    new_game->variant = *variant;
+    clock_gettime(CLOCK_MONOTONIC, &new_game->wait_start);
+    new_game->id = 0;
+    new_game->journal = NULL;
+    new_game->winner = '\0';
+    new_game->resume = NULL;
+    new_game->published = 0;
+    memset(&new_game->syscalls, 0, sizeof(sysacct_t));
+    new_game->trace_id = trace_sample();
     new_game->next = NULL;
 
     // add game to games_list (if non empty add to front)
@@ -158,14 +277,66 @@ game_t* add_client_to_game(int fd, char *name) {
         games_list = new_game;
     }
     // Unlock the mutex after modifying games_list
-    pthread_mutex_unlock(&games_list_mutex);
+    lockprof_unlock(&games_list_mutex);
     return new_game;
 }
 
+// seats a reconnecting player in their recovered game, creating it on the first of its players to come back
+// a bot's seat is filled right away (returns NULL if someone connected already holds the seat)
+game_t* add_client_to_resumed_game(int fd, recovered_game_t* recovered, char role) {
+    // Lock the mutex before modifying games_list
+    lockprof_lock(&games_list_mutex);
+    game_t *game_p = games_list;
+    while (game_p != NULL && game_p->resume != recovered) {
+        game_p = game_p->next;
+    }
+    if (game_p == NULL) {
+        game_p = memacct_malloc(MEMACCT_GAME, sizeof(game_t));
+        strcpy(game_p->xName, recovered->xName);
+        strcpy(game_p->oName, recovered->oName);
+        strcpy(game_p->xToken, recovered->xToken);
+        strcpy(game_p->oToken, recovered->oToken);
+        game_p->xfd = -1;
+        game_p->ofd = strcmp(recovered->oToken, SESSION_TOKEN_NONE) == 0 ? BOT_FD : -1;
+        variant_parse(recovered->spec, &game_p->variant);
+        clock_gettime(CLOCK_MONOTONIC, &game_p->wait_start);
+        game_p->id = recovered->id;
+        game_p->journal = NULL;
+        game_p->winner = '\0';
+        game_p->resume = recovered;
+        game_p->published = 0;
+        memset(&game_p->syscalls, 0, sizeof(sysacct_t));
+        game_p->trace_id = trace_sample();
+        game_p->next = games_list;
+        games_list = game_p;
+    }
+    // Unlock the mutex after modifying games_list
+    lockprof_unlock(&games_list_mutex);
+    // only this thread changes a resumed game's seats until its thread starts, so like a waiting game's they are checked
+    // without the lock and no game thread waits behind the recv
+    int* seat = (role == 'X') ? &game_p->xfd : &game_p->ofd;
+    int old_fd = *seat;
+    if (old_fd >= 0 && is_socket_connected(old_fd)) {
+        return NULL;
+    }
+    // Lock the mutex before modifying games_list
+    lockprof_lock(&games_list_mutex);
+    *seat = fd;
+    // Unlock the mutex after modifying games_list
+    lockprof_unlock(&games_list_mutex);
+    // the player reconnected again before their opponent came back, drop the old connection
+    if (old_fd >= 0) {
+        close_player(old_fd);
+    }
+    return game_p;
+}
+
 // removes game from games_list and closes connections
 void scrap_game(game_t* game_to_delete) {
+    // closing the sockets ends the game however it ended
+    sysacct_set_phase(SYSACCT_OVER);
     // Lock the mutex before modifying games_list
-    pthread_mutex_lock(&games_list_mutex); 
+    lockprof_lock(&games_list_mutex); 
     game_t *current = games_list;
     game_t *previous = NULL;
 
@@ -180,167 +351,236 @@ void scrap_game(game_t* game_to_delete) {
             }
             printf("[SERVER SCRAPPED GAME between %d: %s and %d: %s]", current->xfd, current->xName, current->ofd, current->oName);
             fflush(stdout);
-            // close the sockets associated with the clients and free the memory of the node
-            close(current->xfd);
-            close(current->ofd);
-            free(current);
+            // close the sockets associated with the clients and free the memory of the node (bots don't have one)
+            if (current->xfd >= 0) {
+                close_player(current->xfd);
+            }
+            if (current->ofd >= 0) {
+                close_player(current->ofd);
+            }
+            memacct_free(MEMACCT_GAME, current);
             break;
         }
         previous = current;
         current = current->next;
     }
     // Unlock the mutex after modifying games_list
-    pthread_mutex_unlock(&games_list_mutex);
+    lockprof_unlock(&games_list_mutex);
 }
 
 // checks if a name already exists in the list (1 if it is, else 0)
 int is_name_in_use(char *name) {
     // Lock the mutex before modifying games_list
-    pthread_mutex_lock(&games_list_mutex); 
+    lockprof_lock(&games_list_mutex); 
     game_t *curr_game_p = games_list;
     while (curr_game_p != NULL) {
         if ((strcmp(curr_game_p->xName, name) == 0) || (strcmp(curr_game_p->oName, name) == 0)) {
             // Unlock the mutex after modifying games_list
-            pthread_mutex_unlock(&games_list_mutex);
+            lockprof_unlock(&games_list_mutex);
             return 1;
         }
         curr_game_p = curr_game_p->next;
     }
     // Unlock the mutex after modifying games_list
-    pthread_mutex_unlock(&games_list_mutex);
-    return 0;
+    lockprof_unlock(&games_list_mutex);
+    // players of a recovered game keep their names until they come back for it
+    return recovery_is_reserved(name);
 }
 
-// checks if a move is valid (1 if yes, else 0)
-int check_if_valid_move(char board[3][3], int row, int col) {
-    // Check if the row and column are within the bounds of the board
-    if (row < 1 || row > 3 || col < 1 || col > 3) {
-        return 0;
+// sends a message to a player, bots play inside the game thread so messages to them are dropped (returns 1 on success, -1 if error)
+int send_player_msg(int fd, message_t* msg, const char* board_str) {
+    if (fd == BOT_FD) {
+        return 1;
     }
-    // Check if the spot on the board is already taken
-    if (board[row - 1][col - 1] != '.') {
-        return 0;
+    return send_msg(fd, msg, board_str);
+}
+
+// appends a BEGN, MOVD or OVER record for a game to its journal segment, the payload is formatted like printf
+void journal_event(game_t* game, MessageCode code, const char* format, ...) {
+    char payload[JOURNAL_MAX_PAYLOAD];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(payload, sizeof(payload), format, args);
+    va_end(args);
+    if (length >= (int) sizeof(payload)) {
+        length = sizeof(payload) - 1;
+    }
+    // the first field of an OVER is the winner
+    if (code == OVER) {
+        game->winner = payload[0];
+        game->over_ns = latency_now();
+        sysacct_set_phase(SYSACCT_OVER);
+    }
+    if (game->journal == NULL) {
+        return;
+    }
+    if (journal_append(game->journal, code, game->id, payload, length) == -1) {
+        fprintf(stderr, "[JOURNAL] could not append to the journal of game %llu\n", (unsigned long long) game->id);
+    }
+    else if (code == BEGN) {
+        journal_last_position(game->journal, &game->begun_at);
+    }
+    else if (code == OVER) {
+        journal_last_position(game->journal, &game->over_at);
     }
-    return 1;
 }
 
-// checks if a player has won the game (1 if yes, else 0)
-int check_win(char board[3][3], char player_role) {
-    for (int i = 0; i < 3; i++) {
-        // check rows
-        if (board[i][0] == player_role && board[i][1] == player_role && board[i][2] == player_role) {
-            return 1;
+// adds a move to the packed replay of a classic game, other variants aren't archived
+void record_replay_move(game_t* game, int row, int col) {
+    if (game->variant.type == VARIANT_CLASSIC) {
+        game->replay = replay_add_move(game->replay, (row - 1) * 3 + (col - 1));
+    }
+}
+
+// shows admin listings a game's id, board and whose turn it is, only the game's own thread calls it and it never waits
+void publish_game(game_t* original_game_p, const game_t* curr_game_p, const game_board_t* board, char turn) {
+    unsigned published = original_game_p->published;
+    __atomic_store_n(&original_game_p->published, published + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    original_game_p->id = curr_game_p->id;
+    original_game_p->turn = turn;
+    original_game_p->moves = curr_game_p->moves;
+    snprintf(original_game_p->board, sizeof(original_game_p->board), "%s", game_board_str(board));
+    __atomic_store_n(&original_game_p->published, published + 2, __ATOMIC_RELEASE);
+}
+
+// sends OVER to both players if the move role just made on (row, col) ended the game (returns 1 if the game is over and was scrapped, else 0)
+int finish_if_over(game_t* original_game_p, game_t* curr_game_p, game_board_t* board, int row, int col, char* role, messageBuffer_t* m_msgBuffer_p, message_t * m_msg_p, messageBuffer_t* w_msgBuffer_p, message_t * w_msg_p) {
+    // check if the move causes a win or a tie
+    if (game_board_check_win(board, row, col, *role) == 1) {
+        journal_event(curr_game_p, OVER, "%c|%s has completed a line and won.", *role, (*role == 'X') ? curr_game_p->xName : curr_game_p->oName);
+        // game is over send W to m and L to w
+        set_message_fields(m_msg_p, 8, "W", "you have won.");
+        send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+
+        char fullmsg[BUFFER_SIZE];
+        memset(fullmsg, '\0', BUFFER_SIZE);
+        if (*role == 'X') {
+            strcat(fullmsg, curr_game_p->xName);
         }
-        // check columns
-        if (board[0][i] == player_role && board[1][i] == player_role && board[2][i] == player_role) {
-            return 1;
+        else {
+            strcat(fullmsg, curr_game_p->oName);
         }
+        strcat(fullmsg, " has completed a line and won.");
+        set_message_fields(w_msg_p, 8, "L", fullmsg);
+        send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+        scrap_game(original_game_p);
+        return 1;
     }
-    // check diagonals
-    if (board[0][0] == player_role && board[1][1] == player_role && board[2][2] == player_role) {
+    if (game_board_check_tie(board) == 1) {
+        journal_event(curr_game_p, OVER, "D|the grid is full.");
+        // game is over due to tie send D to m and w
+        set_message_fields(m_msg_p, 8, "D", "the grid is full.");
+        send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+
+        set_message_fields(w_msg_p, 8, "D", "the grid is full.");
+        send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+        scrap_game(original_game_p);
         return 1;
     }
-    if (board[0][2] == player_role && board[1][1] == player_role && board[2][0] == player_role) {
+    // the perfect play table knows when no line can be completed anymore, end the game there instead of playing it out
+    if (game_board_is_dead_draw(board) == 1) {
+        journal_event(curr_game_p, OVER, "D|no line can be completed.");
+        set_message_fields(m_msg_p, 8, "D", "no line can be completed.");
+        send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+
+        set_message_fields(w_msg_p, 8, "D", "no line can be completed.");
+        send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+        scrap_game(original_game_p);
         return 1;
     }
     return 0;
 }
 
-// checks if there is a tie (1 if yes, else 0)
-int check_tie(char board[3][3]) {
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            if (board[i][j] == '.')
-                return 0;
-        }
+// makes move for the bot playing role, m is the bot and w is its human opponent (returns 1 if move is done, -1 if game is to be scrapped)
+int make_bot_move(game_t* original_game_p, game_t* curr_game_p, game_board_t* board, char* role, bot_t* bot, messageBuffer_t* m_msgBuffer_p, message_t * m_msg_p, messageBuffer_t* w_msgBuffer_p, message_t * w_msg_p) {
+    // handles connection lost error, the human may have left while the bot was thinking
+    if (!is_socket_connected(w_msgBuffer_p->fd)) {
+        scrap_game(original_game_p);
+        return -1;
     }
-    return 1;
-}
-
-// converts the board into the string version for when we send it to client
-void format_board(char board[3][3], char* board_str) {
-    int index = 0;
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            board_str[index++] = board[i][j];
-        }
+    int row = 0;
+    int col = 0;
+    if (!bot_choose_move(bot, board, *role, &row, &col)) {
+        scrap_game(original_game_p);
+        return -1;
+    }
+    if (bot->last_search.playouts > 0) {
+        printf("[BOT SEARCH for %d]: %ld playouts in %.3f s on %d threads (%.0f playouts/s per core)\n", w_msgBuffer_p->fd, bot->last_search.playouts, bot->last_search.seconds, bot->last_search.threads, bot->last_search.playouts / bot->last_search.seconds / bot->last_search.threads);
+    }
+    game_board_place(board, row, col, *role);
+    char position[16];
+    game_board_format_move(board, row, col, position);
+    journal_event(curr_game_p, MOVD, "%c|%s", *role, position);
+    record_replay_move(curr_game_p, row, col);
+    // send MOVD message to the human with the board
+    set_message_fields(w_msg_p, 6, role, position);
+    if (send_player_msg(w_msgBuffer_p->fd, w_msg_p, game_board_str(board)) == -1) {
+        // couldn't write message, scrap the game
+        scrap_game(original_game_p);
+        return -1;
+    }
+    if (finish_if_over(original_game_p, curr_game_p, board, row, col, role, m_msgBuffer_p, m_msg_p, w_msgBuffer_p, w_msg_p)) {
+        // the move that ended the game was still played
+        curr_game_p->moves++;
+        return -1;
     }
-    board_str[index] = '\0';
+    return 1;
 }
 
-// makes move for the moving player (returns 1 if move is done, 0 if move must be redone, -1 if game is to be scrapped)
-int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], char* board_str, char* role, messageBuffer_t* m_msgBuffer_p, message_t * m_msg_p, messageBuffer_t* w_msgBuffer_p, message_t * w_msg_p) {
-    // handles connection lost error
+// makes move for the moving player, bot is the opponent's bot or NULL if w is a human (returns 1 if move is done, 0 if move must be redone, -1 if game is to be scrapped)
+int make_move(game_t* original_game_p, game_t* curr_game_p, game_board_t* board, char* role, bot_t* bot, messageBuffer_t* m_msgBuffer_p, message_t * m_msg_p, messageBuffer_t* w_msgBuffer_p, message_t * w_msg_p) {
+    // handles connection lost error, a player who left never moves again so the game is scrapped instead of waiting on them forever
     if (!is_socket_connected(m_msgBuffer_p->fd)) {
-        // handle error caused by client socket not being connected anymore
-        return 0;
+        scrap_game(original_game_p);
+        return -1;
     }
     // read message from moving player and check if its malformed
     if (recieve_msg(m_msgBuffer_p, m_msg_p) == -1) {
         // message recieved is malformed, as stated by prof we must send invalid and scrap the game
         set_message_fields(m_msg_p, 7, "malformed message or connection lost", NULL);
         set_message_fields(w_msg_p, 7, "malformed message or connection lost", NULL);
-        send_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
-        send_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+        send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+        send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
         scrap_game(original_game_p);
         return -1;
     }
+    uint64_t received_ns = latency_now();
     // check if MOVE msg
     if (m_msg_p->code == 1) {
         // check if the MOVE msg is for role
         if (strcmp(m_msg_p->thirdField, role) == 0) {
-            // get the location of the move (we can use index 0 and 2 of the fourthField safely since protocol ensures that in a move message, the fourth field is formatted to be location,location)
-            int row = m_msg_p->fourthField[0] - '0';
-            int col = m_msg_p->fourthField[2] - '0';
-            // check if the move is valid
-            if (check_if_valid_move(board, row, col) == 1) {
-                board[row - 1][col - 1] = *role;
-                format_board(board, board_str);
+            // get the location of the move (protocol ensures that in a move message, the fourth field is formatted to be location,location or location)
+            int row = 0;
+            int col = 0;
+            // check if the move is valid, a column alone is only a move in a gravity game
+            if (game_board_parse_move(board, m_msg_p->fourthField, &row, &col) && game_board_is_valid_move(board, row, col) == 1) {
+                // the board string is kept up to date by game_board_place so there is no need to rebuild it
+                game_board_place(board, row, col, *role);
                 char position[BUFFER_SIZE];
                 strcpy(position, m_msg_p->fourthField);
+                journal_event(curr_game_p, MOVD, "%c|%s", *role, position);
+                record_replay_move(curr_game_p, row, col);
                 // send MOVD message to both client m and client w with the board
                 set_message_fields(m_msg_p, 6, role, position);
                 set_message_fields(w_msg_p, 6, role, position);
-                if ((send_msg(m_msgBuffer_p->fd, m_msg_p, board_str) == -1) || (send_msg(w_msgBuffer_p->fd, w_msg_p, board_str) == -1)) {
+                if ((send_player_msg(m_msgBuffer_p->fd, m_msg_p, game_board_str(board)) == -1) || (send_player_msg(w_msgBuffer_p->fd, w_msg_p, game_board_str(board)) == -1)) {
                     // couldn't write message, scrap the game
                     scrap_game(original_game_p);
                     return -1;
                 }
-                // check if the move causes a win or a tie
-                if (check_win(board, *role) == 1) {
-                    // game is over send W to m and L to w
-                    set_message_fields(m_msg_p, 8, "W", "you have won.");
-                    send_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
-
-                    char fullmsg[BUFFER_SIZE];
-                    memset(fullmsg, '\0', BUFFER_SIZE);
-                    if (*role == 'X') {
-                        strcat(fullmsg, curr_game_p->xName);
-                    }
-                    else {
-                        strcat(fullmsg, curr_game_p->oName);
-                    }
-                    strcat(fullmsg, " has completed a line and won.");
-                    set_message_fields(w_msg_p, 8, "L", fullmsg);
-                    send_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
-                    scrap_game(original_game_p);
-                    return -1;
-                }
-                if (check_tie(board) == 1) {
-                    // game is over due to tie send D to m and w
-                    set_message_fields(m_msg_p, 8, "D", "the grid is full.");
-                    send_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
-
-                    set_message_fields(w_msg_p, 8, "D", "the grid is full.");
-                    send_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
-                    scrap_game(original_game_p);
+                latency_since(LATENCY_MOVE, received_ns);
+                // check if the move ended the game
+                if (finish_if_over(original_game_p, curr_game_p, board, row, col, role, m_msgBuffer_p, m_msg_p, w_msgBuffer_p, w_msg_p)) {
+                    // the move that ended the game was still played
+                    curr_game_p->moves++;
                     return -1;
                 }
             }
             // move is invalid
             else {
                 set_message_fields(m_msg_p, 7, "invalid move", NULL);
-                if ((send_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
+                if ((send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
                     // couldn't write message, scrap the game
                     scrap_game(original_game_p);
                     return -1;
@@ -352,7 +592,7 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
         // move message is for role w which is invalid
         else {
             set_message_fields(m_msg_p, 7, "invalid role", NULL);
-            if ((send_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
+            if ((send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
                 // couldn't write message, scrap the game
                 scrap_game(original_game_p);
                 return -1;
@@ -363,9 +603,11 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
     }
     // check if RSGN msg 
     else if (m_msg_p->code == 2) {
+        curr_game_p->resigner = *role;
+        journal_event(curr_game_p, OVER, "%c|%s has resigned.", (*role == 'X') ? 'O' : 'X', (*role == 'X') ? curr_game_p->xName : curr_game_p->oName);
         // reply with OVER
         set_message_fields(m_msg_p, 8, "L", "you have resigned.");
-        send_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+        send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
 
         char fullmsg[BUFFER_SIZE];
         memset(fullmsg, '\0', BUFFER_SIZE);
@@ -377,7 +619,7 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
         }
         strcat(fullmsg, " has resigned.");
         set_message_fields(w_msg_p, 8, "W", fullmsg);
-        send_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+        send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
         scrap_game(original_game_p);
         return -1;
     }
@@ -385,11 +627,15 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
     else if (m_msg_p->code == 3) {
         // check if client m wants to suggest a draw
         if (strcmp(m_msg_p->thirdField, "S") == 0) {
+            // a bot answers right away since it has no socket to ask through
+            if (bot != NULL) {
+                set_message_fields(w_msg_p, 3, bot_accepts_draw(bot, board, (*role == 'X') ? 'O' : 'X') ? "A" : "R", NULL);
+            }
             // get accept or decline message from client w, looping incase they send something else since we would need to re-ask
-            while (1) {
+            while (bot == NULL) {
                 // send draw s to client w
                 set_message_fields(w_msg_p, 3, "S", NULL);
-                if (send_msg(w_msgBuffer_p->fd, w_msg_p, NULL) == -1) {
+                if (send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL) == -1) {
                     // couldn't write message, scrap the game
                     scrap_game(original_game_p);
                     return -1;
@@ -397,15 +643,16 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
                 // get message from client w
                 // handles connection lost error
                 if (!is_socket_connected(w_msgBuffer_p->fd)) {
-                    // handle error caused by client socket not being connected anymore
-                    return 0;
+                    // handle error caused by client socket not being connected anymore, same as a player who left on their turn
+                    scrap_game(original_game_p);
+                    return -1;
                 }
                 if (recieve_msg(w_msgBuffer_p, w_msg_p) == -1) {
                     // message recieved is malformed, as stated by prof we must send invalid and scrap the game
                     set_message_fields(m_msg_p, 7, "malformed message or connection lost", NULL);
                     set_message_fields(w_msg_p, 7, "malformed message or connection lost", NULL);
-                    send_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
-                    send_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+                    send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+                    send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
                     scrap_game(original_game_p);
                     return -1;
                 }
@@ -417,11 +664,12 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
             }
             // we now have an accept or decline message from client w so check if draw was accepted
             if (strcmp(w_msg_p->thirdField,"A") == 0) {
+                journal_event(curr_game_p, OVER, "D|both players agreed to a draw");
                 // send over to both players with outcome as draw
                 set_message_fields(m_msg_p, 8, "D", "both players agreed to a draw");
                 set_message_fields(w_msg_p, 8, "D", "both players agreed to a draw");
-                send_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
-                send_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
+                send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL);
+                send_player_msg(w_msgBuffer_p->fd, w_msg_p, NULL);
                 scrap_game(original_game_p);
                 return -1;
             }
@@ -429,7 +677,7 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
             else {
                 // redo the turn for m since client w reject their draw proposal
                 set_message_fields(m_msg_p, 3, "R", NULL);
-                if ((send_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
+                if ((send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
                     // couldn't write message, scrap the game
                     scrap_game(original_game_p);
                     return -1;
@@ -441,7 +689,7 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
         // client m sent a draw message without an "S" which is invalid.
         else {
             set_message_fields(m_msg_p, 7, "invalid field", NULL);
-            if ((send_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
+            if ((send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
                 // couldn't write message, scrap the game
                 scrap_game(original_game_p);
                 return -1;
@@ -454,7 +702,7 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
     else {
         // send invalid and redo turn, takes care of if client sends PLAY or any of the server msg codes
         set_message_fields(m_msg_p, 7, "invalid command", NULL);
-        if ((send_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
+        if ((send_player_msg(m_msgBuffer_p->fd, m_msg_p, NULL) == -1)) {
             // couldn't write message, scrap the game
             scrap_game(original_game_p);
             return -1;
@@ -465,62 +713,206 @@ int make_move(game_t* original_game_p, game_t* curr_game_p, char board[3][3], ch
     return 1;
 }
 
+// rebuilds the board of a recovered game and shows it to its players, then gives the recovered game back (returns 1 if the last move had already ended the game, else 0)
+int resume_game(game_t* original_game_p, game_t* curr_game_p, game_board_t* board, messageBuffer_t* x_msgBuffer_p, message_t* x_msg_p, messageBuffer_t* o_msgBuffer_p, message_t* o_msg_p, int* is_x_turn) {
+    recovered_game_t* resume = curr_game_p->resume;
+    int played = 0;
+    int row = 0;
+    int col = 0;
+    char role[2] = "X";
+    for (int move = 0; move < resume->moves; move++) {
+        role[0] = (move % 2 == 0) ? 'X' : 'O';
+        // every journaled move was valid when it was made, stop at anything that isn't
+        if (!game_board_parse_move(board, resume->positions[move], &row, &col) || game_board_is_valid_move(board, row, col) != 1) {
+            break;
+        }
+        game_board_place(board, row, col, role[0]);
+        record_replay_move(curr_game_p, row, col);
+        played++;
+    }
+    *is_x_turn = (played % 2 == 0);
+    curr_game_p->moves = played;
+
+    int gameover = 0;
+    if (played > 0) {
+        // the last move again with the board, so the players see where the game stands
+        set_message_fields(x_msg_p, 6, role, resume->positions[played - 1]);
+        set_message_fields(o_msg_p, 6, role, resume->positions[played - 1]);
+        if ((send_player_msg(x_msgBuffer_p->fd, x_msg_p, game_board_str(board)) == -1) || (send_player_msg(o_msgBuffer_p->fd, o_msg_p, game_board_str(board)) == -1)) {
+            scrap_game(original_game_p);
+            gameover = 1;
+        }
+        // the server may have stopped between the last move and its OVER
+        else if (role[0] == 'X') {
+            gameover = finish_if_over(original_game_p, curr_game_p, board, row, col, role, x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p);
+        }
+        else {
+            gameover = finish_if_over(original_game_p, curr_game_p, board, row, col, role, o_msgBuffer_p, o_msg_p, x_msgBuffer_p, x_msg_p);
+        }
+    }
+    printf("[SERVER RESUMED GAME between %s and %s after %d moves]\n", curr_game_p->xName, curr_game_p->oName, played);
+    fflush(stdout);
+
+    // the players' names are free again once the game is back on a thread
+    if (!gameover) {
+        // Lock the mutex before modifying games_list
+        lockprof_lock(&games_list_mutex);
+        original_game_p->resume = NULL;
+        // Unlock the mutex after modifying games_list
+        lockprof_unlock(&games_list_mutex);
+    }
+    curr_game_p->resume = NULL;
+    recovery_finish(resume);
+    return gameover;
+}
+
+// frees what a game thread allocated for its game
+void free_game_copy(game_t* curr_game_p, messageBuffer_t* x_msgBuffer_p, message_t* x_msg_p, messageBuffer_t* o_msgBuffer_p, message_t* o_msg_p) {
+    memacct_free(MEMACCT_GAME, curr_game_p);
+    memacct_free(MEMACCT_CONNECTION, x_msgBuffer_p);
+    memacct_free(MEMACCT_MESSAGE, x_msg_p);
+    memacct_free(MEMACCT_CONNECTION, o_msgBuffer_p);
+    memacct_free(MEMACCT_MESSAGE, o_msg_p);
+}
+
 // starts a game between two connected players
 void* start_game(void* game_to_start) {
+    uint64_t started_ns = latency_now();
     // copy the game so that any changes to original object don't affect the game
-    game_t* curr_game_p = malloc(sizeof(game_t));
+    game_t* curr_game_p = memacct_malloc(MEMACCT_GAME, sizeof(game_t));
     memcpy(curr_game_p, (game_t*) game_to_start, sizeof(game_t));
+    // the node stays in games_list until the game is scrapped, it is part of what the game holds
+    size_t node_bytes = memacct_size(game_to_start);
+    // the handshakes came with the copy, the thread's own syscalls are added to them
+    sysacct_attach(&curr_game_p->syscalls, SYSACCT_BEGIN);
+    trace_set(curr_game_p->trace_id);
+    curr_game_p->replay = replay_empty();
+    curr_game_p->resigner = '\0';
+    memset(&curr_game_p->begun_at, 0, sizeof(journal_position_t));
+    memset(&curr_game_p->over_at, 0, sizeof(journal_position_t));
+    curr_game_p->moves = 0;
+    metrics_add(METRIC_GAMES_STARTED, 1);
+    metrics_add(METRIC_GAMES_ACTIVE, 1);
+    // how long X waited for someone to play, a resumed game's wait is its players coming back
+    if (curr_game_p->resume == NULL) {
+        metrics_add(METRIC_WAITING, -1);
+        uint64_t wait_ns = (uint64_t) curr_game_p->wait_start.tv_sec * 1000000000ull + curr_game_p->wait_start.tv_nsec;
+        latency_record(LATENCY_PAIRING, started_ns - wait_ns);
+        trace_span("game", "pairing", wait_ns, started_ns);
+    }
 
     printf("TIME TO PLAY! X: %s vs O: %s\n", curr_game_p->xName, curr_game_p->oName);
     fflush(stdout);
 
     // create objects that will buffer messages and store them for client x
-    messageBuffer_t *x_msgBuffer_p = malloc(sizeof(messageBuffer_t));
+    messageBuffer_t *x_msgBuffer_p = memacct_malloc(MEMACCT_CONNECTION, sizeof(messageBuffer_t));
     x_msgBuffer_p->fd = curr_game_p->xfd;
     x_msgBuffer_p->buflen = 0;
     memset(x_msgBuffer_p->buffer, '\0', BUFFER_SIZE);
-    message_t *x_msg_p = malloc(sizeof(message_t));
+    message_t *x_msg_p = memacct_malloc(MEMACCT_MESSAGE, sizeof(message_t));
 
     // create objects that will buffer messages and store them for client o
-    messageBuffer_t *o_msgBuffer_p = malloc(sizeof(messageBuffer_t));
+    messageBuffer_t *o_msgBuffer_p = memacct_malloc(MEMACCT_CONNECTION, sizeof(messageBuffer_t));
     o_msgBuffer_p->fd = curr_game_p->ofd;
     o_msgBuffer_p->buflen = 0;
     memset(o_msgBuffer_p->buffer, '\0', BUFFER_SIZE);
-    message_t *o_msg_p = malloc(sizeof(message_t));
+    message_t *o_msg_p = memacct_malloc(MEMACCT_MESSAGE, sizeof(message_t));
 
     // set a timeout value for both sockets when we are trying to read
     struct timeval timeout;
-    timeout.tv_sec = 10; // 10 seconds
+    timeout.tv_sec = TURN_TIMEOUT_SECONDS;
     timeout.tv_usec = 0;
-    if ((setsockopt(curr_game_p->xfd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0) || (setsockopt(curr_game_p->ofd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0)) {
+    if ((setsockopt(curr_game_p->xfd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0) || (curr_game_p->ofd != BOT_FD && setsockopt(curr_game_p->ofd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0)) {
         perror("setsockopt failed");
     }
+    sysacct_count(SYSACCT_SETSOCKOPT, 0, 0);
+    if (curr_game_p->ofd != BOT_FD) {
+        sysacct_count(SYSACCT_SETSOCKOPT, 0, 0);
+    }
+
+    // a resumed game keeps the id and tokens it was journaled with
+    if (curr_game_p->resume == NULL) {
+        curr_game_p->id = journal_next_game_id();
+        session_token(curr_game_p->xToken);
+        if (curr_game_p->ofd == BOT_FD) {
+            strcpy(curr_game_p->oToken, SESSION_TOKEN_NONE);
+        }
+        else {
+            session_token(curr_game_p->oToken);
+        }
+    }
 
-    // send the begin message to x and o
+    // send the begin message to x and o, the session token goes after the opponent's name
     set_message_fields(x_msg_p, 5, "X", curr_game_p->oName);
     set_message_fields(o_msg_p, 5, "O", curr_game_p->xName);
-    if ((send_msg(curr_game_p->xfd, x_msg_p, NULL) == -1) || (send_msg(curr_game_p->ofd, o_msg_p, NULL) == -1)) {
+    if ((send_player_msg(curr_game_p->xfd, x_msg_p, curr_game_p->xToken) == -1) || (send_player_msg(curr_game_p->ofd, o_msg_p, curr_game_p->oToken) == -1)) {
         // couldn't write message, scrap the game
         scrap_game(game_to_start);
+        metrics_add(METRIC_GAMES_SCRAPPED, 1);
+        metrics_add(METRIC_GAMES_ACTIVE, -1);
+        sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+        trace_set(0);
+        free_game_copy(curr_game_p, x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p);
         return NULL;
     }
+    latency_since(LATENCY_BEGIN, started_ns);
+    trace_span("game", "begin", started_ns, latency_now());
     
-    // create empty TicTacToe board and board string
-    char board[3][3];
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            board[i][j] = '.';
-        }
+    // every event of the game goes to a journal segment, shared with other games only once every segment has one
+    // a resumed game's BEGN was journaled again at startup
+    curr_game_p->journal = journal_claim();
+    if (curr_game_p->journal == NULL && journal_on) {
+        fprintf(stderr, "[JOURNAL] no journal segment for game %llu, it won't be recovered or indexed\n", (unsigned long long) curr_game_p->id);
+        metrics_add(METRIC_GAMES_UNJOURNALED, 1);
+    }
+    if (curr_game_p->resume == NULL) {
+        char spec[24];
+        variant_format(&curr_game_p->variant, spec);
+        journal_event(curr_game_p, BEGN, "%s|%s|%s|%s|%s", curr_game_p->xName, curr_game_p->oName, spec, curr_game_p->xToken, curr_game_p->oToken);
+    }
+    else {
+        curr_game_p->begun_at = curr_game_p->resume->begun_at;
+    }
+
+    // create empty board for the variant the players asked for (the board string is part of it)
+    game_board_t board;
+    if (!game_board_init(&board, &curr_game_p->variant)) {
+        perror("game_board_init");
+        scrap_game(game_to_start);
+        metrics_add(METRIC_GAMES_SCRAPPED, 1);
+        metrics_add(METRIC_GAMES_ACTIVE, -1);
+        journal_release(curr_game_p->journal);
+        sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+        trace_set(0);
+        free_game_copy(curr_game_p, x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p);
+        return NULL;
+    }
+    // an m,n,k board's cells are allocated by mnk.c, the other boards live in the game_board_t on this stack
+    memacct_track(MEMACCT_GAME, board.mnk.str);
+    
+    // a waiting player paired by backfill_waiting_games plays O against a bot that lives on this thread's stack
+    bot_t bot;
+    bot_t* o_bot = NULL;
+    if (curr_game_p->ofd == BOT_FD) {
+        bot_init(&bot, bot_strength, (uint32_t) time(NULL) ^ (uint32_t) curr_game_p->xfd);
+        o_bot = &bot;
     }
-    char board_str[10];
-    format_board(board, board_str);
     
     int gameover = 0;
     int is_x_turn = 1;
+    if (curr_game_p->resume != NULL) {
+        gameover = resume_game(game_to_start, curr_game_p, &board, x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p, &is_x_turn);
+    }
+    if (!gameover) {
+        publish_game(game_to_start, curr_game_p, &board, is_x_turn ? 'X' : 'O');
+    }
+    sysacct_set_phase(SYSACCT_PLAY);
     while (!gameover) {
         // check if it's player X's turn
         if (is_x_turn) {
-            int move_result = make_move(game_to_start, curr_game_p, board, board_str, "X", x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p);
+            uint64_t span = trace_begin();
+            int move_result = make_move(game_to_start, curr_game_p, &board, "X", o_bot, x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p);
+            trace_end("game", "make_move X", span);
             if (move_result == -1) {
                 // game is over or scrapped
                 break;
@@ -528,6 +920,8 @@ void* start_game(void* game_to_start) {
             else if (move_result == 1) {
                 // move completed switch
                 is_x_turn = 0;
+                curr_game_p->moves++;
+                publish_game(game_to_start, curr_game_p, &board, 'O');
             }
             else {
                 // redo move
@@ -536,7 +930,16 @@ void* start_game(void* game_to_start) {
         }
         else {
             // player O's turn
-            int move_result = make_move(game_to_start, curr_game_p, board, board_str, "O", o_msgBuffer_p, o_msg_p, x_msgBuffer_p, x_msg_p);
+            int move_result;
+            uint64_t span = trace_begin();
+            if (o_bot != NULL) {
+                move_result = make_bot_move(game_to_start, curr_game_p, &board, "O", o_bot, o_msgBuffer_p, o_msg_p, x_msgBuffer_p, x_msg_p);
+                trace_end("game", "make_bot_move O", span);
+            }
+            else {
+                move_result = make_move(game_to_start, curr_game_p, &board, "O", NULL, o_msgBuffer_p, o_msg_p, x_msgBuffer_p, x_msg_p);
+                trace_end("game", "make_move O", span);
+            }
             if (move_result == -1) {
                 // game is over or scrapped
                 break;
@@ -544,6 +947,8 @@ void* start_game(void* game_to_start) {
             else if (move_result == 1) {
                 // move completed switch
                 is_x_turn = 1;
+                curr_game_p->moves++;
+                publish_game(game_to_start, curr_game_p, &board, 'X');
             }
             else {
                 // redo move
@@ -552,42 +957,617 @@ void* start_game(void* game_to_start) {
         }
     }
 
+    // the OVER was sent and scrap_game closed the sockets by the time the loop ends
+    if (curr_game_p->winner != '\0') {
+        latency_since(LATENCY_OVER, curr_game_p->over_ns);
+    }
+    // a game that ends any other way was scrapped, recovery must not bring it back
+    if (curr_game_p->winner == '\0') {
+        journal_event(curr_game_p, OVER, "-|the game was scrapped.");
+    }
+    // both players' records get the result, a game that never ended counts for neither
+    if (curr_game_p->winner != '-' && players.map != NULL) {
+        if (players_record_game(&players, curr_game_p->xName, curr_game_p->oName, curr_game_p->winner, curr_game_p->resigner, time(NULL))) {
+            // moves both players on the leaderboard without waiting for anyone reading it
+            leaderboard_post(&leaderboard, curr_game_p->xName);
+            leaderboard_post(&leaderboard, curr_game_p->oName);
+        }
+        else {
+            fprintf(stderr, "[PLAYERS] could not record the game of %s and %s\n", curr_game_p->xName, curr_game_p->oName);
+        }
+    }
+    // both players' histories point at the game's BEGN and OVER, a game missing from the journal can't be looked up
+    if (curr_game_p->winner != '-' && curr_game_p->begun_at.run != 0 && curr_game_p->over_at.run != 0
+        && history_add_game(&history, curr_game_p->id, curr_game_p->xName, curr_game_p->oName, &curr_game_p->begun_at, &curr_game_p->over_at) == -1) {
+        fprintf(stderr, "[HISTORY] could not index the game of %s and %s\n", curr_game_p->xName, curr_game_p->oName);
+    }
+    // finished classic games go to the replay archive, scrapped ones have no result to scan for
+    if (curr_game_p->variant.type == VARIANT_CLASSIC && curr_game_p->winner != '-') {
+        replay_archive_append(&replay_archive, replay_set_result(curr_game_p->replay, replay_result_from_winner(curr_game_p->winner)));
+    }
+
+    metrics_add(curr_game_p->winner == '-' ? METRIC_GAMES_SCRAPPED : METRIC_GAMES_FINISHED, 1);
+    metrics_add(METRIC_GAMES_ACTIVE, -1);
+    // what the game cost in syscalls from both handshakes to its sockets closed
+    sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+    trace_span("game", "game", started_ns, latency_now());
+    trace_set(0);
+    metrics_game_syscalls(&curr_game_p->syscalls, curr_game_p->moves);
+    printf("[SERVER SYSCALLS game %llu]: ", (unsigned long long) curr_game_p->id);
+    sysacct_print(stdout, &curr_game_p->syscalls, curr_game_p->moves);
+    printf("\n");
+
+    // nothing is freed before the game ends, so this is the most it held
+    memacct_record_footprint(MEMACCT_ACTIVE_GAME, node_bytes + memacct_size(curr_game_p) + memacct_size(x_msgBuffer_p) + memacct_size(x_msg_p)
+        + memacct_size(o_msgBuffer_p) + memacct_size(o_msg_p) + memacct_size(board.mnk.str));
+
     // clean up malloced memory
-    free(curr_game_p);
-    free(x_msgBuffer_p);
-    free(x_msg_p);
-    free(o_msgBuffer_p);
-    free(o_msg_p);
+    memacct_untrack(MEMACCT_GAME, board.mnk.str);
+    game_board_free(&board);
+    journal_release(curr_game_p->journal);
+    free_game_copy(curr_game_p, x_msgBuffer_p, x_msg_p, o_msgBuffer_p, o_msg_p);
 
     return NULL;
 }
 
+// gets the milliseconds from now until a waiting game reaches the bot deadline or the recovered games expire
+// (-1 if nobody is waiting or bots are off, and no recovered game is left)
+int next_backfill_timeout() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long timeout = -1;
+    if (resumes_pending) {
+        long left = (resume_deadline.tv_sec - now.tv_sec) * 1000 + (resume_deadline.tv_nsec - now.tv_nsec) / 1000000;
+        timeout = left < 0 ? 0 : left;
+    }
+    if (bot_wait_seconds < 0) {
+        return (int) timeout;
+    }
+    // Lock the mutex before reading games_list
+    lockprof_lock(&games_list_mutex);
+    for (game_t *curr_game_p = games_list; curr_game_p != NULL; curr_game_p = curr_game_p->next) {
+        if (curr_game_p->xfd != -1 && curr_game_p->ofd == -1 && curr_game_p->resume == NULL) {
+            long waited = (now.tv_sec - curr_game_p->wait_start.tv_sec) * 1000 + (now.tv_nsec - curr_game_p->wait_start.tv_nsec) / 1000000;
+            long left = bot_wait_seconds * 1000L - waited;
+            if (left < 0) {
+                left = 0;
+            }
+            if (timeout == -1 || left < timeout) {
+                timeout = left;
+            }
+        }
+    }
+    // Unlock the mutex after reading games_list
+    lockprof_unlock(&games_list_mutex);
+    return (int) timeout;
+}
+
+// pairs every player that has waited past bot_wait_seconds with a bot and starts their games
+void backfill_waiting_games() {
+    if (bot_wait_seconds < 0) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while (1) {
+        game_t* game_p = NULL;
+        // Lock the mutex before modifying games_list
+        lockprof_lock(&games_list_mutex);
+        for (game_t *curr_game_p = games_list; curr_game_p != NULL; curr_game_p = curr_game_p->next) {
+            long waited = (now.tv_sec - curr_game_p->wait_start.tv_sec) * 1000 + (now.tv_nsec - curr_game_p->wait_start.tv_nsec) / 1000000;
+            if (curr_game_p->xfd != -1 && curr_game_p->ofd == -1 && curr_game_p->resume == NULL && waited >= bot_wait_seconds * 1000L) {
+                // taking the O spot here means no human can join this game anymore
+                strcpy(curr_game_p->oName, BOT_NAME);
+                curr_game_p->ofd = BOT_FD;
+                game_p = curr_game_p;
+                break;
+            }
+        }
+        // Unlock the mutex after modifying games_list
+        lockprof_unlock(&games_list_mutex);
+        if (game_p == NULL) {
+            return;
+        }
+
+        // the waiting player may have left already
+        if (!is_socket_connected(game_p->xfd)) {
+            scrap_game(game_p);
+            metrics_add(METRIC_WAITING, -1);
+            continue;
+        }
+        metrics_add(METRIC_WAIT_TIMEOUTS, 1);
+        printf("[SERVER PAIRED %d: %s WITH A BOT]\n", game_p->xfd, game_p->xName);
+        fflush(stdout);
+        // the game still needs a thread for the human, the bot itself runs inside it
+        pthread_t tid;
+        int ret = pthread_create(&tid, NULL, start_game, game_p);
+        if (ret != 0) {
+            // thread couldn't be created, scrap the game and the connection
+            fprintf(stderr, "pthread_create: %s\n", strerror(ret));
+            scrap_game(game_p);
+            metrics_add(METRIC_WAITING, -1);
+            continue;
+        }
+        // automatically clean up child threads once they terminate
+        pthread_detach(tid);
+    }
+}
+
+// rebuilds the games that were live when the server last stopped and journals them again into this run, so the next recovery can start here
+void recover_games() {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long games = recovery_load(JOURNAL_DIR, journal_read_checkpoint(JOURNAL_DIR));
+    if (games < 0) {
+        return;
+    }
+    journal_writer_t* writer = journal_claim();
+    long relogged = recovery_relog(writer);
+    journal_release(writer);
+    journal_flush();
+    // older runs can only be skipped once every live game is in this run's segments
+    if (relogged != games || !journal_write_checkpoint(JOURNAL_DIR, journal_current_run())) {
+        fprintf(stderr, "[JOURNAL] could not checkpoint the recovered games, the next recovery reads the older runs again\n");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Recovered %ld live games from the journal in %.3f s\n", games, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    if (games > 0) {
+        resume_deadline = end;
+        resume_deadline.tv_sec += RECOVERY_RESUME_SECONDS;
+        resumes_pending = 1;
+    }
+}
+
+// starts a resumed game once both of its players are back (a bot is always there)
+void start_resumed_game_if_ready(game_t* game_p) {
+    pthread_t tid;
+    int* seats[2] = {&game_p->xfd, &game_p->ofd};
+    int left[2] = {-1, -1};
+    int ready = 1;
+    // whoever came back first may have left again while waiting, checked without the lock like in add_client_to_resumed_game
+    for (int i = 0; i < 2; i++) {
+        if (*seats[i] >= 0 && !is_socket_connected(*seats[i])) {
+            left[i] = *seats[i];
+        }
+        if (*seats[i] == -1 || left[i] >= 0) {
+            ready = 0;
+        }
+    }
+    if (left[0] >= 0 || left[1] >= 0) {
+        // Lock the mutex before modifying games_list
+        lockprof_lock(&games_list_mutex);
+        for (int i = 0; i < 2; i++) {
+            if (left[i] >= 0) {
+                *seats[i] = -1;
+            }
+        }
+        // Unlock the mutex after modifying games_list
+        lockprof_unlock(&games_list_mutex);
+        for (int i = 0; i < 2; i++) {
+            if (left[i] >= 0) {
+                close_player(left[i]);
+            }
+        }
+    }
+    if (!ready) {
+        printf("MUST WAIT FOR THE OPPONENT TO RESUME!\n");
+        fflush(stdout);
+        return;
+    }
+    // from here on only the game thread may free the recovered game, so no RSUM may seat anyone in it
+    recovered_game_t* recovered = game_p->resume;
+    recovery_set_started(recovered, 1);
+    int ret = pthread_create(&tid, NULL, start_game, game_p);
+    if (ret != 0) {
+        // thread couldn't be created, scrap the game and the connections, its players can still come back until the deadline
+        fprintf(stderr, "pthread_create: %s\n", strerror(ret));
+        recovery_set_started(recovered, 0);
+        scrap_game(game_p);
+        return;
+    }
+    // automatically clean up child threads once they terminate
+    pthread_detach(tid);
+}
+
+// checks if the players of recovered games have run out of time to come back (1 if they have, else 0)
+int resume_deadline_passed() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > resume_deadline.tv_sec || (now.tv_sec == resume_deadline.tv_sec && now.tv_nsec >= resume_deadline.tv_nsec);
+}
+
+// scraps the recovered games whose players didn't all come back by the deadline, the ones somebody came back for
+// are in games_list waiting for the others (only this thread starts resumed games, so none starts meanwhile)
+void expire_resumed_games() {
+    while (1) {
+        game_t* game_p = NULL;
+        // Lock the mutex before reading games_list
+        lockprof_lock(&games_list_mutex);
+        for (game_t *curr_game_p = games_list; curr_game_p != NULL && game_p == NULL; curr_game_p = curr_game_p->next) {
+            if (curr_game_p->resume != NULL && !curr_game_p->resume->started) {
+                game_p = curr_game_p;
+            }
+        }
+        // Unlock the mutex after reading games_list
+        lockprof_unlock(&games_list_mutex);
+        if (game_p == NULL) {
+            break;
+        }
+        scrap_game(game_p);
+        printf("\n");
+    }
+    journal_writer_t* writer = journal_claim();
+    long expired = recovery_expire(writer);
+    journal_release(writer);
+    printf("[SERVER EXPIRED %ld recovered games not resumed within %d s]\n", expired, RECOVERY_RESUME_SECONDS);
+    fflush(stdout);
+}
+
+// admin GAMES: copies every game with the list locked, then prints the copy with it unlocked
+int admin_list_games(const char* args, FILE* out) {
+    // only the admin thread lists, so its buffers are kept for the next listing
+    static admin_snapshot_t snapshot;
+    admin_snapshot_clear(&snapshot);
+    uint64_t start_ns = latency_now();
+    // Lock the mutex before reading games_list
+    lockprof_lock(&games_list_mutex);
+    uint64_t locked_ns = latency_now();
+    for (game_t* game_p = games_list; game_p != NULL; game_p = game_p->next) {
+        admin_game_t game;
+        char spec[24];
+        char board[ADMIN_BOARD_BYTES + 1];
+        game.xfd = game_p->xfd;
+        game.ofd = game_p->ofd;
+        variant_format(&game_p->variant, spec);
+        unsigned published;
+        do {
+            published = __atomic_load_n(&game_p->published, __ATOMIC_ACQUIRE);
+            game.id = game_p->id;
+            game.turn = game_p->turn;
+            game.moves = game_p->moves;
+            memcpy(board, game_p->board, sizeof(board));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while ((published & 1) || published != __atomic_load_n(&game_p->published, __ATOMIC_RELAXED));
+        if (published == 0) {
+            game.state = (game_p->resume != NULL) ? 'R' : 'W';
+            game.turn = '-';
+            game.moves = 0;
+            board[0] = '\0';
+        }
+        else {
+            game.state = 'P';
+            board[ADMIN_BOARD_BYTES] = '\0';
+        }
+        admin_snapshot_add(&snapshot, &game, game_p->xName, game_p->oName, spec[0] != '\0' ? spec : "classic", board);
+    }
+    // Unlock the mutex after reading games_list
+    lockprof_unlock(&games_list_mutex);
+    uint64_t end_ns = latency_now();
+    fprintf(out, "id state turn moves xfd x ofd o variant board\n");
+    admin_snapshot_write(&snapshot, out);
+    fprintf(out, "OK %zu games%s, list locked for %.3f ms (waited %.3f ms for it)\n", snapshot.count, snapshot.failed ? " (out of memory, some are missing)" : "",
+        (end_ns - locked_ns) / 1e6, (locked_ns - start_ns) / 1e6);
+    return 1;
+}
+
+// admin KICK <name>: shuts the player's socket down, their game thread sees the connection lost on its next read or write and scraps the game
+int admin_kick_player(const char* args, FILE* out) {
+    int fd = -1;
+    // Lock the mutex before reading games_list, fds are only closed with it held so fd is still the player's
+    lockprof_lock(&games_list_mutex);
+    for (game_t* game_p = games_list; game_p != NULL && fd < 0; game_p = game_p->next) {
+        if (strcmp(game_p->xName, args) == 0) {
+            fd = game_p->xfd;
+        }
+        else if (strcmp(game_p->oName, args) == 0 && game_p->ofd != BOT_FD) {
+            fd = game_p->ofd;
+        }
+    }
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+    }
+    // Unlock the mutex after reading games_list
+    lockprof_unlock(&games_list_mutex);
+    if (fd < 0) {
+        fprintf(out, "ERR no connected player named %s\n", args);
+        return 1;
+    }
+    fprintf(out, "OK kicked %s (fd %d)\n", args, fd);
+    return 1;
+}
+
+// admin DRAIN [on|off]: turns new players away (or lets them in again), games being played and resumed go on
+int admin_drain(const char* args, FILE* out) {
+    if (strcasecmp(args, "off") == 0) {
+        draining = 0;
+        fprintf(out, "OK matchmaking is open\n");
+        return 1;
+    }
+    if (args[0] != '\0' && strcasecmp(args, "on") != 0) {
+        fprintf(out, "ERR use DRAIN on or DRAIN off\n");
+        return 1;
+    }
+    draining = 1;
+    fprintf(out, "OK draining, %lld games still being played and %lld players waiting\n", (long long) metrics_sum(METRIC_GAMES_ACTIVE), (long long) metrics_sum(METRIC_WAITING));
+    return 1;
+}
+
+// admin LOCKS [on|off|reset]: turns lock profiling on or off, or starts its counts over, then prints the lock report
+int admin_locks(const char* args, FILE* out) {
+    if (strcasecmp(args, "on") == 0 || strcasecmp(args, "off") == 0) {
+        lockprof_enable(strcasecmp(args, "on") == 0);
+    }
+    else if (strcasecmp(args, "reset") == 0) {
+        lockprof_reset();
+    }
+    else if (args[0] != '\0') {
+        fprintf(out, "ERR use LOCKS, LOCKS on, LOCKS off or LOCKS reset\n");
+        return 1;
+    }
+    lockprof_report(out);
+    fprintf(out, "OK lock profiling is %s\n", lockprof_enabled ? "on" : "off");
+    return 1;
+}
+
+// admin TRACE [<n>|off]: traces 1 in n of the games made from now on (or none), then tells where the spans go
+int admin_trace(const char* args, FILE* out) {
+    if (strcasecmp(args, "off") == 0) {
+        trace_sample_every(0);
+    }
+    else if (args[0] != '\0') {
+        int every = atoi(args);
+        if (every < 1) {
+            fprintf(out, "ERR use TRACE <n> to trace 1 in n games, or TRACE off\n");
+            return 1;
+        }
+        trace_sample_every(every);
+    }
+    int every = trace_sampling();
+    if (every > 0) {
+        fprintf(out, "OK tracing 1 in %d games to %s, %llu spans written, %llu dropped\n", every, trace_path, (unsigned long long) trace_written(), (unsigned long long) trace_dropped());
+    }
+    else {
+        fprintf(out, "OK tracing is off, %llu spans written to %s, %llu dropped\n", (unsigned long long) trace_written(), trace_path, (unsigned long long) trace_dropped());
+    }
+    return 1;
+}
+
+// admin MEMORY: prints the heap held by each subsystem, what a waiting player and a game hold, and what the ones there now add up to
+int admin_memory(const char* args, FILE* out) {
+    if (args[0] != '\0') {
+        fprintf(out, "ERR use MEMORY\n");
+        return 1;
+    }
+    memacct_report(out);
+    memacct_sizes_t waiting_sizes;
+    memacct_sizes_t game_sizes;
+    memacct_read_footprint(MEMACCT_WAITING_PLAYER, &waiting_sizes);
+    memacct_read_footprint(MEMACCT_ACTIVE_GAME, &game_sizes);
+    long long waiting = (long long) metrics_sum(METRIC_WAITING);
+    long long games = (long long) metrics_sum(METRIC_GAMES_ACTIVE);
+    double waiting_bytes = waiting_sizes.count ? (double) waiting_sizes.bytes / waiting_sizes.count : 0.0;
+    double game_bytes = game_sizes.count ? (double) game_sizes.bytes / game_sizes.count : 0.0;
+    // a game thread also has its stack, reserved but mostly never touched
+    size_t stack_bytes = 0;
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) == 0) {
+        pthread_attr_getstacksize(&attr, &stack_bytes);
+        pthread_attr_destroy(&attr);
+    }
+    fprintf(out, "OK %lld waiting players and %lld games hold about %.0f bytes, each game thread also reserves a %zu KiB stack\n", waiting, games,
+        waiting * waiting_bytes + games * game_bytes, stack_bytes / 1024);
+    return 1;
+}
+
+// stops the CPU profiler and writes its folded stacks (returns 1 on success, 0 if it wasn't running or error)
+int stop_profile(FILE* out) {
+    if (!prof_stop()) {
+        fprintf(out, "ERR the profiler isn't running, start it with PROFILE start [hz]\n");
+        return 0;
+    }
+    int stacks = prof_write(prof_path);
+    if (stacks < 0) {
+        fprintf(out, "ERR the profile couldn't be written to %s\n", prof_path);
+        return 0;
+    }
+    fprintf(out, "OK wrote %d stacks of %llu samples to %s, %llu dropped\n", stacks, (unsigned long long) (prof_samples() - prof_dropped()), prof_path,
+        (unsigned long long) prof_dropped());
+    return 1;
+}
+
+// admin PROFILE [start [hz]|stop]: starts the CPU profiler, or stops it and writes the folded stacks, then tells what it is doing
+int admin_profile(const char* args, FILE* out) {
+    if (strncasecmp(args, "start", 5) == 0 && (args[5] == '\0' || args[5] == ' ')) {
+        int hz = args[5] == ' ' ? atoi(args + 6) : PROF_DEFAULT_HZ;
+        if (hz < 1 || hz > PROF_MAX_HZ) {
+            fprintf(out, "ERR the rate is 1 to %d samples a second\n", PROF_MAX_HZ);
+            return 1;
+        }
+        if (!prof_start(hz)) {
+            fprintf(out, "ERR the profiler is already running or can't start\n");
+            return 1;
+        }
+    }
+    else if (strcasecmp(args, "stop") == 0) {
+        stop_profile(out);
+        return 1;
+    }
+    else if (args[0] != '\0') {
+        fprintf(out, "ERR use PROFILE, PROFILE start [hz] or PROFILE stop\n");
+        return 1;
+    }
+    if (prof_running()) {
+        fprintf(out, "OK profiling at %d Hz, %llu samples so far\n", prof_hz(), (unsigned long long) prof_samples());
+    }
+    else {
+        fprintf(out, "OK the profiler is stopped, PROFILE stop writes the folded stacks to %s\n", prof_path);
+    }
+    return 1;
+}
+
 int main(int argc, char **argv) {
     signal(SIGPIPE, SIG_IGN);
     sigset_t mask;
-    connection_data_t *con;
+    connection_data_t con;
     int error;
     pthread_t tid;
 
-    char* portNumber = argc == 2 ? argv[1] : "15000";
+    char* portNumber = argc >= 2 ? argv[1] : "15000";
+    // optional bot settings: ./ttts <port> <seconds before a waiting player gets a bot, -1 for never> <bot strength 0-100>
+    if (argc >= 3) {
+        bot_wait_seconds = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        bot_strength = atoi(argv[3]);
+    }
+    // optional journal sync policy: ./ttts <port> <bot wait> <bot strength> <none, group or always>
+    if (argc >= 5 && !journal_parse_sync(argv[4], &journal_sync)) {
+        fprintf(stderr, "unknown journal sync policy %s, use none, group or always\n", argv[4]);
+        exit(EXIT_FAILURE);
+    }
+    // optional metrics port: ./ttts <port> <bot wait> <bot strength> <journal sync> <metrics port on 127.0.0.1, -1 for none>
+    char* metrics_port = argc >= 6 ? argv[5] : METRICS_PORT;
 
 	install_handlers(&mask);
+    if (!prof_init()) {
+        fprintf(stderr, "the profiler is off\n");
+    }
+
+    // bots still work without the cache, they just repeat searches other games already did
+    if (!poscache_init(&position_cache, POSITION_CACHE_ENTRIES)) {
+        perror("poscache_init");
+    }
+    // games still run if the journal can't be set up, they just aren't recorded
+    if (!journal_init(JOURNAL_DIR, journal_sync)) {
+        fprintf(stderr, "journal is off\n");
+    }
+    // without the journal there is nothing to recover from or to index
+    else {
+        journal_on = 1;
+        recover_games();
+        if (!history_open(&history, HISTORY_DIR)) {
+            fprintf(stderr, "game history is off\n");
+        }
+    }
+    // without the player table games are played but nobody's record changes
+    if (!players_open(&players, PLAYERS_PATH, PLAYERS_CAPACITY)) {
+        fprintf(stderr, "player records are off\n");
+    }
+    // the leaderboard is built from the records once, then kept up to date by every game that ends
+    else if (leaderboard_init(&leaderboard, &players)) {
+        leaderboard_entry_t top[LEADERBOARD_TOP];
+        int count = leaderboard_top(&leaderboard, LEADERBOARD_RATING, LEADERBOARD_TOP, top);
+        printf("Leaderboard: %llu ranked players\n", (unsigned long long) leaderboard.lists[LEADERBOARD_RATING].length);
+        for (int i = 0; i < count; i++) {
+            printf("    %llu. %s %.2f\n", (unsigned long long) top[i].rank, top[i].name, top[i].score / 100.0);
+        }
+    }
+    // games are still played and journaled if the archive can't be opened
+    if (!replay_archive_open(&replay_archive, REPLAY_PATH)) {
+        fprintf(stderr, "replay archive is off\n");
+    }
+    // the 4x4 tablebase is optional, without it bots search 4,4,4 games like any other m,n,k board
+    if (tablebase_open(&tablebase4, TABLEBASE_PATH)) {
+        printf("Mapped %u 4x4 tablebase positions from %s\n", tablebase4.positions, TABLEBASE_PATH);
+    }
 	
     int listener = open_listener(portNumber, QUEUE_SIZE);
     if (listener < 0) exit(EXIT_FAILURE);
     
     printf("Listening for incoming connections on %s\n", portNumber);
 
+    // the scrape thread must not get the signals meant for this thread either
+    if (strcmp(metrics_port, "-1") != 0) {
+        pthread_sigmask(SIG_BLOCK, &mask, NULL);
+        if (metrics_start(&metrics_server, metrics_port, &active)) {
+            printf("Serving metrics on http://127.0.0.1:%s/metrics\n", metrics_port);
+        }
+        else {
+            fprintf(stderr, "metrics are off\n");
+        }
+        pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+    }
+    char admin_path[64];
+    snprintf(admin_path, sizeof(admin_path), ADMIN_PATH_FORMAT, portNumber);
+    admin_register(&admin_server, "GAMES", "lists every game: id, state (W waiting, R resuming, P playing), turn, moves, fds, names, variant, board", admin_list_games);
+    admin_register(&admin_server, "KICK", "<name> disconnects a player, their game is scrapped", admin_kick_player);
+    admin_register(&admin_server, "DRAIN", "[on|off] turns new players away while running games finish", admin_drain);
+    admin_register(&admin_server, "LOCKS", "[on|off|reset] profiles the server's locks, prints how often each waited and who held it longest", admin_locks);
+    admin_register(&admin_server, "TRACE", "[<n>|off] traces 1 in n new games to the trace file, off stops tracing new ones", admin_trace);
+    admin_register(&admin_server, "MEMORY", "prints the heap each subsystem holds and what a waiting player and a game cost", admin_memory);
+    admin_register(&admin_server, "PROFILE", "[start [hz]|stop] samples every thread's stack, stop writes them as folded stacks for a flame graph", admin_profile);
+    snprintf(prof_path, sizeof(prof_path), PROF_PATH_FORMAT, portNumber);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    if (admin_start(&admin_server, admin_path, &active)) {
+        printf("Taking admin commands on %s\n", admin_path);
+    }
+    else {
+        fprintf(stderr, "admin socket is off\n");
+    }
+    // the spans of traced games are written by a thread of their own, so tracing never makes a game wait on the file
+    snprintf(trace_path, sizeof(trace_path), TRACE_PATH_FORMAT, portNumber);
+    if (!trace_start(trace_path, &active)) {
+        fprintf(stderr, "tracing is off\n");
+    }
+    pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+
     while (active) {
-    	con = (connection_data_t *) malloc(sizeof(connection_data_t));
-    	con->addr_len = sizeof(struct sockaddr_storage);
-        con->fd = accept(listener, (struct sockaddr *)&con->addr, &con->addr_len);
-        if (con->fd < 0) {
+        // wait for a connection, but wake up in time to give a bot to anyone who has waited too long
+        struct pollfd listener_poll;
+        listener_poll.fd = listener;
+        listener_poll.events = POLLIN;
+        int ready = poll(&listener_poll, 1, next_backfill_timeout());
+        if (ready <= 0 || !(listener_poll.revents & POLLIN)) {
+            if (ready < 0 && errno != EINTR) {
+                perror("poll");
+            }
+            if (lock_report_wanted) {
+                lock_report_wanted = 0;
+                lockprof_report(stdout);
+                fflush(stdout);
+            }
+            if (profile_toggle_wanted) {
+                profile_toggle_wanted = 0;
+                if (prof_running()) {
+                    stop_profile(stdout);
+                }
+                else if (prof_start(PROF_DEFAULT_HZ)) {
+                    printf("Profiling at %d Hz until the next SIGUSR2\n", PROF_DEFAULT_HZ);
+                }
+                fflush(stdout);
+            }
+            // game threads must not get the signals meant for this thread
+            error = pthread_sigmask(SIG_BLOCK, &mask, NULL);
+            if (error != 0) {
+                fprintf(stderr, "sigmask: %s\n", strerror(error));
+                exit(EXIT_FAILURE);
+            }
+            backfill_waiting_games();
+            if (resumes_pending && resume_deadline_passed()) {
+                resumes_pending = 0;
+                expire_resumed_games();
+            }
+            error = pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+            if (error != 0) {
+                fprintf(stderr, "sigmask: %s\n", strerror(error));
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+    	con.addr_len = sizeof(struct sockaddr_storage);
+        con.fd = accept(listener, (struct sockaddr *)&con.addr, &con.addr_len);
+        uint64_t accepted_ns = latency_now();
+        if (con.fd < 0) {
             perror("accept");
-            free(con);
             // TODO check for specific error conditions
             continue;
         }
+        metrics_add(METRIC_CONNECTIONS_OPENED, 1);
+        // the connection's syscalls until it waits for a game go to the game it waits in
+        sysacct_t handshake;
+        memset(&handshake, 0, sizeof(handshake));
+        sysacct_attach(&handshake, SYSACCT_HANDSHAKE);
         
         // temporarily disable signals
         // (the worker thread will inherit this mask, ensuring that SIGINT is
@@ -600,7 +1580,7 @@ int main(int argc, char **argv) {
 
         char host[HOSTSIZE], port[PORTSIZE];
 
-        int error = getnameinfo((struct sockaddr *)&con->addr, con->addr_len, host, HOSTSIZE, port, PORTSIZE, NI_NUMERICSERV);
+        int error = getnameinfo((struct sockaddr *)&con.addr, con.addr_len, host, HOSTSIZE, port, PORTSIZE, NI_NUMERICSERV);
         
         if (error) {
             fprintf(stderr, "getnameinfo: %s\n", gai_strerror(error));
@@ -611,53 +1591,89 @@ int main(int argc, char **argv) {
         printf("Connection from %s:%s\n", host, port);
         
         messageBuffer_t myMessageBuffer;
-        myMessageBuffer.fd = con->fd;
+        myMessageBuffer.fd = con.fd;
         myMessageBuffer.buflen = 0;
         message_t myMessage;
         
         // we dont have to worry about a timeout or anything because professor mentioned in a dicussion post (https://rutgers.instructure.com/courses/210688/discussion_topics/2885093) 
         // "Yes. There is no reason for a client to delay sending PLAY after establishing a connection."
         // handles connection lost error
-        if (!is_socket_connected(con->fd)) {
+        // a connection that is closed or turned away here is done with, nothing below may use its fd again
+        int turned_away = 0;
+        if (!is_socket_connected(con.fd)) {
             // handle error caused by client socket not being connected anymore
-            close(con->fd);
+            close_player(con.fd);
+            turned_away = 1;
         }
-        if (recieve_msg(&myMessageBuffer, &myMessage) == -1) {
-            set_message_fields(&myMessage, 7, "malformed message or connection lost", NULL);
-            if (send_msg(con->fd, &myMessage, NULL) == -1) {
-                // couldn't write message, close the socket with the client
-                close(con->fd);
-            }
+        else if (recieve_msg(&myMessageBuffer, &myMessage) == -1) {
+            turn_away(con.fd, &myMessage, "malformed message or connection lost");
+            turned_away = 1;
+        }
+        else {
+            latency_since(LATENCY_HANDSHAKE, accepted_ns);
+        }
+        uint64_t parsed_ns = latency_now();
+        if (turned_away) {
+            // the connection is closed, there is nobody to answer
         }
         // check if the first message is a play message
-        if (myMessage.code == 0) {
-            char* name = strdup(myMessage.thirdField);
+        else if (myMessage.code == 0) {
+            char* name = memacct_strdup(MEMACCT_NAME, myMessage.thirdField);
+            // the optional fourth field picks the board (rows,cols,k), no fourth field means classic 3x3
+            variant_t variant;
             // check if name is too long or too short
-            if (strlen(name) > 128 || strlen(name) < 1) {
-                set_message_fields(&myMessage, 7, "name is invalid", NULL);
-                if (send_msg(con->fd, &myMessage, NULL) == -1) {
-                    // couldn't write message, close the socket with the client
-                    close(con->fd);
-                }
+            // xName and oName hold 127 characters and the '\0'
+            if (strlen(name) > 127 || strlen(name) < 1) {
+                turn_away(con.fd, &myMessage, "name is invalid");
+            }
+            // check if the variant is one we can play
+            else if (!variant_parse(myMessage.fourthField, &variant)) {
+                turn_away(con.fd, &myMessage, "variant is invalid");
+            }
+            // the server is being drained, nobody new gets a game
+            else if (draining) {
+                turn_away(con.fd, &myMessage, "server is draining");
             }
             // check if name is already in use
             else if (is_name_in_use(name) == 1) {
-                set_message_fields(&myMessage, 7, "name is in use", NULL);
-                if (send_msg(con->fd, &myMessage, NULL) == -1) {
-                    // couldn't write message, close the socket with the client
-                    close(con->fd);
-                }
+                turn_away(con.fd, &myMessage, "name is in use");
             }
             // the client's name is acceptable
             else {
+                // the player's record is found (or made) before they wait, so it is there when their game ends
+                player_record_t* record = players_seen(&players, name, time(NULL));
+                if (record != NULL) {
+                    player_stats_t stats;
+                    players_read(record, &stats);
+                    printf("[PLAYER %s]: rating %.0f, %llu games (%llu won, %llu lost, %llu drawn)\n", name, stats.rating, (unsigned long long) stats.games, (unsigned long long) stats.wins, (unsigned long long) stats.losses, (unsigned long long) stats.draws);
+                    uint64_t rank;
+                    uint64_t ranked;
+                    if (leaderboard_rank(&leaderboard, LEADERBOARD_RATING, name, &rank, &ranked)) {
+                        printf("[PLAYER %s]: ranked %llu of %llu by rating\n", name, (unsigned long long) rank, (unsigned long long) ranked);
+                    }
+                }
                 // send a wait and check if there is another client waiting so we can start a game
                 set_message_fields(&myMessage, 4, NULL, NULL);
-                if (send_msg(con->fd, &myMessage, NULL) == -1) {
+                if (send_msg(con.fd, &myMessage, NULL) == -1) {
                     // couldn't write message, close the socket with the client
-                    close(con->fd);
+                    close_player(con.fd);
+                }
+                else {
+                    latency_since(LATENCY_PLAY_WAIT, parsed_ns);
                 }
                 // add client to a game if another client is already waiting or create a game if no other client is waiting
-                game_t* game_p = add_client_to_game(con->fd, name);
+                game_t* game_p = add_client_to_game(con.fd, name, &variant);
+                // only this thread starts game threads, so nothing else touches the node's syscalls yet
+                // checking on the waiting player below isn't either connection's handshake
+                sysacct_add(&game_p->syscalls, &handshake);
+                sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+                // the rest of this connection is traced if its game is, the handshake was over before the game was known
+                trace_set(game_p->trace_id);
+                trace_span("connection", "handshake", accepted_ns, latency_now());
+                // a player that takes the X spot waits, the one waiting already stops waiting when their game thread starts
+                if (game_p->ofd == -1) {
+                    metrics_add(METRIC_WAITING, 1);
+                }
                 if (game_p->xfd != -1 && game_p->ofd != -1) {
                     // x and o are both connected we can start a game
                     if (is_socket_connected(game_p->xfd) && is_socket_connected(game_p->ofd)) {
@@ -667,6 +1683,7 @@ int main(int argc, char **argv) {
                             // thread couldn't be created, scrap the game and the connections
                             perror("pthread_create");
                             scrap_game(game_p);
+                            metrics_add(METRIC_WAITING, -1);
                         }
                         // automatically clean up child threads once they terminate
                         pthread_detach(tid);
@@ -674,26 +1691,29 @@ int main(int argc, char **argv) {
                     // x is not connected, make o the x client and wait for a different client to become the o
                     else if (!is_socket_connected(game_p->xfd)) {
                         // Lock the mutex before modifying games_list
-                        pthread_mutex_lock(&games_list_mutex); 
+                        lockprof_lock(&games_list_mutex); 
                         strcpy(game_p->xName, game_p->oName);
                         game_p->xfd = game_p->ofd;
                         strcpy(game_p->oName, "");
                         game_p->ofd = -1;
+                        // the new x only just started waiting
+                        clock_gettime(CLOCK_MONOTONIC, &game_p->wait_start);
                         // Unlock the mutex after modifying games_list
-                        pthread_mutex_unlock(&games_list_mutex);
+                        lockprof_unlock(&games_list_mutex);
                     }
                     // o is not connected, wait for a different client to become the o
                     else if (!is_socket_connected(game_p->ofd)) {
                         // Lock the mutex before modifying games_list
-                        pthread_mutex_lock(&games_list_mutex); 
+                        lockprof_lock(&games_list_mutex); 
                         strcpy(game_p->oName, "");
                         game_p->ofd = -1;
                         // Unlock the mutex after modifying games_list
-                        pthread_mutex_unlock(&games_list_mutex);
+                        lockprof_unlock(&games_list_mutex);
                     }
                     // both o and x are not connected, scrap game 
                     else {
                         scrap_game(game_p);
+                        metrics_add(METRIC_WAITING, -1);
                     }
                 }
                 // do nothing as we must wait for a game to be filled to start it
@@ -702,15 +1722,35 @@ int main(int argc, char **argv) {
                     fflush(stdout);
                 }
             }
+            // the node has its own copy of the name
+            memacct_free(MEMACCT_NAME, name);
+        }
+        // a player getting back into the game they were in when the server stopped: RSUM|len|name|session token|
+        else if (myMessage.code == RSUM) {
+            char role = 'X';
+            recovered_game_t* recovered = recovery_find(myMessage.thirdField, myMessage.fourthField, &role);
+            game_t* game_p = (recovered == NULL) ? NULL : add_client_to_resumed_game(con.fd, recovered, role);
+            if (game_p == NULL) {
+                turn_away(con.fd, &myMessage, "no game to resume");
+            }
+            else {
+                // the player waits like after a PLAY until the game can go on
+                set_message_fields(&myMessage, 4, NULL, NULL);
+                send_msg(con.fd, &myMessage, NULL);
+                sysacct_add(&game_p->syscalls, &handshake);
+                sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+                trace_set(game_p->trace_id);
+                trace_span("connection", "handshake", accepted_ns, latency_now());
+                start_resumed_game_if_ready(game_p);
+            }
         }
         // first message is not play message so it is invalid
         else {
-            set_message_fields(&myMessage, 7, "invalid message", NULL);
-            if (send_msg(con->fd, &myMessage, NULL) == -1) {
-                // couldn't write message, close the socket with the client
-                close(con->fd);
-            }
+            turn_away(con.fd, &myMessage, "invalid message");
         }
+        // a connection turned away counts for no game
+        sysacct_attach(NULL, SYSACCT_HANDSHAKE);
+        trace_set(0);
         
         // unblock handled signals
         error = pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
@@ -719,8 +1759,20 @@ int main(int argc, char **argv) {
         	exit(EXIT_FAILURE);
         }
     }
-    free(con);
     puts("Shutting down");
+    printf("Position cache: %lld hits, %lld misses\n", (long long) metrics_sum(METRIC_POSCACHE_HITS), (long long) metrics_sum(METRIC_POSCACHE_MISSES));
+    latency_report(stdout);
+    memacct_report(stdout);
+    if (lockprof_enabled) {
+        lockprof_report(stdout);
+    }
+    // a profile still running when the server stops is written like PROFILE stop would
+    if (prof_running()) {
+        stop_profile(stdout);
+    }
+    trace_stop();
+    journal_shutdown();
+    history_close(&history);
     close(listener);
     
     // returning from main() (or calling exit()) immediately terminates all
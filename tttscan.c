@@ -0,0 +1,243 @@
+// NOTE: must use option -pthread when compiling!
+// filters and aggregates a replay archive of 3x3 games, one worker thread per slice of the mapped archive
+// usage: ./tttscan [-t threads] [-r x, o or d] [-m row,col] <archive>
+//        ./tttscan -g <games> <archive>   writes random self-play games from sim.c to a new archive
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "replay.h"
+#include "sim.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+// records written per fwrite while generating
+#define GENERATE_CHUNK SIM_BATCH
+
+// totals of one worker, nibble indexed arrays have 16 entries so an unplayed move needs no check
+typedef struct stats {
+    uint64_t games;
+    uint64_t moves;
+    uint64_t results[4];
+    uint64_t lengths[16];
+    uint64_t by_first[16][4];      // results of the games opened on each cell
+    uint64_t openings[16][16];     // first move and reply
+} stats_t;
+
+typedef struct worker {
+    pthread_t tid;
+    const replay_t* records;
+    size_t start;
+    size_t end;
+    stats_t* stats;
+} worker_t;
+
+// filter every worker applies
+unsigned result_mask = 0xF;   // bit per result that is kept
+int first_cell = -1;          // cell the game must open on, -1 for any
+
+void* scan_worker(void* arg) {
+    worker_t* worker = arg;
+    stats_t* stats = worker->stats;
+    const replay_t* records = worker->records;
+    for (size_t i = worker->start; i < worker->end; i++) {
+        replay_t replay = records[i];
+        int first = replay_cell(replay, 0);
+        int result = replay_result(replay);
+        if (!((result_mask >> result) & 1) || (first_cell >= 0 && first != first_cell)) {
+            continue;
+        }
+        int length = replay_length(replay);
+        stats->games++;
+        stats->moves += length;
+        stats->results[result]++;
+        stats->lengths[length]++;
+        stats->by_first[first][result]++;
+        stats->openings[first][replay_cell(replay, 1)]++;
+    }
+    return NULL;
+}
+
+// writes games random self-play games to a new archive (returns 1 on success, 0 if error)
+int generate(const char* path, long games) {
+    FILE* out = fopen(path, "wb");
+    if (out == NULL) {
+        perror("fopen");
+        return 0;
+    }
+    replay_header_t header = {REPLAY_MAGIC, REPLAY_VERSION, 0};
+    sim_batch_t* batch = malloc(sizeof(sim_batch_t));
+    replay_t* chunk = malloc(GENERATE_CHUNK * sizeof(replay_t));
+    if (batch == NULL || chunk == NULL || fwrite(&header, sizeof(header), 1, out) != 1) {
+        perror("generate");
+        fclose(out);
+        return 0;
+    }
+    sim_batch_seed(batch, 1);
+    for (long done = 0; done < games; done += SIM_BATCH) {
+        sim_batch_play(batch);
+        int lanes = (games - done < SIM_BATCH) ? games - done : SIM_BATCH;
+        for (int i = 0; i < lanes; i++) {
+            replay_t replay = replay_empty();
+            for (int ply = 0; ply < batch->length[i]; ply++) {
+                replay = replay_add_move(replay, batch->cells[ply][i]);
+            }
+            chunk[i] = replay_set_result(replay, batch->result[i]);
+        }
+        if (fwrite(chunk, sizeof(replay_t), lanes, out) != (size_t) lanes) {
+            perror("fwrite");
+            fclose(out);
+            return 0;
+        }
+    }
+    free(batch);
+    free(chunk);
+    if (fclose(out) != 0) {
+        perror("fclose");
+        return 0;
+    }
+    return 1;
+}
+
+// prints a percent of a total (0 if the total is 0)
+double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+void print_stats(const stats_t* stats) {
+    uint64_t games = stats->games;
+    printf("games: %llu, X won %.2f%%, O won %.2f%%, drawn %.2f%%, unfinished %.2f%%\n", (unsigned long long) games, percent(stats->results[REPLAY_X_WON], games), percent(stats->results[REPLAY_O_WON], games), percent(stats->results[REPLAY_DRAW], games), percent(stats->results[REPLAY_UNFINISHED], games));
+    printf("average length: %.3f moves\n", games ? (double) stats->moves / games : 0.0);
+    printf("length:");
+    for (int length = 0; length <= REPLAY_MAX_MOVES; length++) {
+        if (stats->lengths[length] > 0) {
+            printf(" %d: %.2f%%", length, percent(stats->lengths[length], games));
+        }
+    }
+    printf("\n");
+
+    printf("opening frequencies (first move):\n");
+    for (int row = 0; row < 3; row++) {
+        printf("   ");
+        for (int col = 0; col < 3; col++) {
+            uint64_t opened = 0;
+            for (int result = 0; result < 4; result++) {
+                opened += stats->by_first[row * 3 + col][result];
+            }
+            printf(" %6.2f%%", percent(opened, games));
+        }
+        printf("\n");
+    }
+
+    printf("win rate by first move:\n");
+    for (int cell = 0; cell < REPLAY_MAX_MOVES; cell++) {
+        const uint64_t* by = stats->by_first[cell];
+        uint64_t opened = by[0] + by[1] + by[2] + by[3];
+        if (opened == 0) {
+            continue;
+        }
+        // the most common reply to this opening
+        int reply = 0;
+        for (int next = 1; next < REPLAY_MAX_MOVES; next++) {
+            if (stats->openings[cell][next] > stats->openings[cell][reply]) {
+                reply = next;
+            }
+        }
+        printf("    %d,%d: X %.2f%%, O %.2f%%, draw %.2f%% of %llu games, most common reply %d,%d\n", cell / 3 + 1, cell % 3 + 1, percent(by[REPLAY_X_WON], opened), percent(by[REPLAY_O_WON], opened), percent(by[REPLAY_DRAW], opened), (unsigned long long) opened, reply / 3 + 1, reply % 3 + 1);
+    }
+}
+
+int main(int argc, char **argv) {
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long generate_games = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:m:g:")) != -1) {
+        if (opt == 't') {
+            threads = atoi(optarg);
+        }
+        else if (opt == 'r') {
+            // the results to keep, e.g. -r xo skips draws
+            result_mask = 0;
+            for (const char* p = optarg; *p != '\0'; p++) {
+                result_mask |= (*p == 'x') ? 1 << REPLAY_X_WON : (*p == 'o') ? 1 << REPLAY_O_WON : (*p == 'd') ? 1 << REPLAY_DRAW : 0;
+            }
+        }
+        else if (opt == 'm') {
+            int row = 0;
+            int col = 0;
+            if (sscanf(optarg, "%d,%d", &row, &col) != 2 || row < 1 || row > 3 || col < 1 || col > 3) {
+                fprintf(stderr, "-m takes the first move as row,col\n");
+                return EXIT_FAILURE;
+            }
+            first_cell = (row - 1) * 3 + (col - 1);
+        }
+        else if (opt == 'g') {
+            generate_games = atol(optarg);
+        }
+        else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1) {
+        printf("Usage: ./tttscan [-t threads] [-r x, o or d] [-m row,col] <archive>\n       ./tttscan -g <games> <archive>\n");
+        return EXIT_FAILURE;
+    }
+    const char* path = argv[optind];
+    threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+
+    if (generate_games >= 0) {
+        double start = now_seconds();
+        if (!generate(path, generate_games)) {
+            return EXIT_FAILURE;
+        }
+        printf("tttscan: wrote %ld games to %s in %.2f s\n", generate_games, path, now_seconds() - start);
+        return EXIT_SUCCESS;
+    }
+
+    replay_map_t map;
+    if (!replay_map_open(&map, path)) {
+        return EXIT_FAILURE;
+    }
+    posix_madvise(map.map, map.map_size, POSIX_MADV_SEQUENTIAL);
+    double start = now_seconds();
+    worker_t workers[MAX_THREADS];
+    size_t share = (map.count + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        workers[t].records = map.records;
+        workers[t].start = t * share < map.count ? t * share : map.count;
+        workers[t].end = (t + 1) * share < map.count ? (t + 1) * share : map.count;
+        // each worker counts into its own allocation, a few KB apart, so no two workers write the same cache line
+        workers[t].stats = calloc(1, sizeof(stats_t));
+        if (workers[t].stats == NULL) {
+            perror("calloc");
+            return EXIT_FAILURE;
+        }
+        if (pthread_create(&workers[t].tid, NULL, scan_worker, &workers[t]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].tid, NULL);
+        const uint64_t* from = (const uint64_t*) workers[t].stats;
+        uint64_t* to = (uint64_t*) &total;
+        for (size_t i = 0; i < sizeof(stats_t) / sizeof(uint64_t); i++) {
+            to[i] += from[i];
+        }
+        free(workers[t].stats);
+    }
+    double seconds = now_seconds() - start;
+
+    double bytes = (double) map.count * sizeof(replay_t);
+    printf("tttscan: scanned %zu games (%.1f MB) in %.3f s on %d threads, %.0f games/s, %.2f GB/s\n", map.count, bytes / 1e6, seconds, threads, map.count / seconds, bytes / seconds / 1e9);
+    print_stats(&total);
+    replay_map_close(&map);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+// NOTE: must use option -pthread when compiling!
+// runs random 3x3 self-play games in process with the batch engine in sim.c, one worker thread per core
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+// every VERIFY_STRIDE-th game is replayed with board.c (the first batch of each thread is replayed in full)
+#define VERIFY_STRIDE 64
+
+// data to be sent to worker threads
+typedef struct worker {
+    pthread_t tid;
+    int id;
+    long batches;
+    sim_totals_t totals;
+    long verified;
+    long mismatches;
+} worker_t;
+
+void* run_worker(void* arg) {
+    worker_t* worker = arg;
+    sim_batch_t* batch = malloc(sizeof(sim_batch_t));
+    if (batch == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    sim_batch_seed(batch, (uint32_t) worker->id + 1);
+    for (long b = 0; b < worker->batches; b++) {
+        sim_batch_play(batch);
+        sim_batch_tally(batch, &worker->totals);
+        int stride = (b == 0) ? 1 : VERIFY_STRIDE;
+        worker->mismatches += sim_batch_verify(batch, stride);
+        worker->verified += (SIM_BATCH + stride - 1) / stride;
+    }
+    free(batch);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    long games = argc >= 2 ? atol(argv[1]) : 100000000;
+    long threads = argc >= 3 ? atol(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (games < 1 || threads < 1) {
+        printf("Usage: ./tttsim [number of games] [number of threads]\n");
+        return EXIT_FAILURE;
+    }
+
+    long batches = (games + SIM_BATCH - 1) / SIM_BATCH;
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    double start = now_seconds();
+    for (long i = 0; i < threads; i++) {
+        workers[i].id = i;
+        // spread the batches as evenly as possible over the threads
+        workers[i].batches = batches / threads + (i < batches % threads ? 1 : 0);
+        int ret = pthread_create(&workers[i].tid, NULL, run_worker, &workers[i]);
+        if (ret != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(ret));
+            return EXIT_FAILURE;
+        }
+    }
+
+    sim_totals_t totals;
+    memset(&totals, 0, sizeof(totals));
+    long verified = 0;
+    long mismatches = 0;
+    for (long i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        totals.games += workers[i].totals.games;
+        totals.x_wins += workers[i].totals.x_wins;
+        totals.o_wins += workers[i].totals.o_wins;
+        totals.draws += workers[i].totals.draws;
+        totals.moves += workers[i].totals.moves;
+        verified += workers[i].verified;
+        mismatches += workers[i].mismatches;
+    }
+    double elapsed = now_seconds() - start;
+    free(workers);
+
+    printf("games: %ld on %ld threads in %.3f s\n", totals.games, threads, elapsed);
+    printf("X won: %.2f%% O won: %.2f%% draw: %.2f%% average length: %.2f\n", 100.0 * totals.x_wins / totals.games, 100.0 * totals.o_wins / totals.games, 100.0 * totals.draws / totals.games, (double) totals.moves / totals.games);
+    printf("rate: %.1f million games/s, %.1f million games/min, %.1f million games/min per thread\n", totals.games / elapsed / 1e6, totals.games / elapsed * 60 / 1e6, totals.games / elapsed * 60 / 1e6 / threads);
+    printf("checked against board.c: %ld games, %ld mismatches\n", verified, mismatches);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,93 @@
+#include "ultimate.h"
+#include <string.h>
+
+void ultimate_init(ultimate_board_t* board) {
+    memset(board->x, 0, sizeof(board->x));
+    memset(board->o, 0, sizeof(board->o));
+    board->won_x = 0;
+    board->won_o = 0;
+    board->closed = 0;
+    board->active = ULTIMATE_ANY;
+    memset(board->str, '.', ULTIMATE_CELLS);
+    board->str[ULTIMATE_CELLS] = '\0';
+}
+
+// fills moves[sub] with the free cells of every sub-board the player to move may use (returns the number of legal moves)
+// a sub-board is allowed if it is the active one, or any open one when the last move sent the player to a closed board
+int ultimate_legal_moves(const ultimate_board_t* board, uint16_t moves[BOARD_CELLS]) {
+    uint16_t allowed = (board->active == ULTIMATE_ANY) ? (~board->closed & BOARD_FULL) : (uint16_t) (1 << board->active);
+    int count = 0;
+    for (int sub = 0; sub < BOARD_CELLS; sub++) {
+        // all ones when the sub-board is allowed, else zero
+        uint16_t keep = -(uint16_t) ((allowed >> sub) & 1);
+        moves[sub] = ~(board->x[sub] | board->o[sub]) & BOARD_FULL & keep;
+        count += __builtin_popcount(moves[sub]);
+    }
+    return count;
+}
+
+// checks if a move is valid (1 if yes, else 0), row and col are 1-based in the 9x9 grid like in a MOVE message
+int ultimate_is_valid_move(const ultimate_board_t* board, int row, int col) {
+    if (row < 1 || row > ULTIMATE_SIDE || col < 1 || col > ULTIMATE_SIDE) {
+        return 0;
+    }
+    int sub = ((row - 1) / 3) * 3 + (col - 1) / 3;
+    uint16_t bit = 1 << (((row - 1) % 3) * 3 + (col - 1) % 3);
+    if ((board->closed >> sub) & 1) {
+        return 0;
+    }
+    if (board->active != ULTIMATE_ANY && board->active != sub) {
+        return 0;
+    }
+    return ((board->x[sub] | board->o[sub]) & bit) == 0;
+}
+
+// places role on a cell and updates the won and closed sub-boards and the next active one
+// the caller must have checked the move with ultimate_is_valid_move
+void ultimate_place(ultimate_board_t* board, int row, int col, char role) {
+    int sub = ((row - 1) / 3) * 3 + (col - 1) / 3;
+    int cell = ((row - 1) % 3) * 3 + (col - 1) % 3;
+    uint16_t* mine = (role == 'X') ? &board->x[sub] : &board->o[sub];
+    *mine |= 1 << cell;
+    board->str[(row - 1) * ULTIMATE_SIDE + (col - 1)] = role;
+
+    // only the sub-board that was played in can change
+    if (board_mask_is_win(*mine)) {
+        if (role == 'X') {
+            board->won_x |= 1 << sub;
+        }
+        else {
+            board->won_o |= 1 << sub;
+        }
+        board->closed |= 1 << sub;
+    }
+    else if ((board->x[sub] | board->o[sub]) == BOARD_FULL) {
+        board->closed |= 1 << sub;
+    }
+    // the cell played picks the opponent's sub-board, unless that one is closed
+    board->active = ((board->closed >> cell) & 1) ? ULTIMATE_ANY : cell;
+}
+
+// checks if role has won three sub-boards in a line of the meta-board (1 if yes, else 0)
+int ultimate_check_win(const ultimate_board_t* board, char role) {
+    return board_mask_is_win(role == 'X' ? board->won_x : board->won_o);
+}
+
+// checks if every sub-board is closed, the caller checks for a win first (1 if yes, else 0)
+int ultimate_check_tie(const ultimate_board_t* board) {
+    return board->closed == BOARD_FULL;
+}
+
+// checks if no meta-board line can be won by either player anymore (1 if yes, else 0)
+// a line is lost to a player once it holds a sub-board won by the other player or one that filled up without a winner
+int ultimate_is_dead_draw(const ultimate_board_t* board) {
+    uint16_t drawn = board->closed & ~(board->won_x | board->won_o);
+    uint16_t blocks_x = board->won_o | drawn;
+    uint16_t blocks_o = board->won_x | drawn;
+    for (int line = 0; line < BOARD_LINES; line++) {
+        if (!(board_win_masks[line] & blocks_x) || !(board_win_masks[line] & blocks_o)) {
+            return 0;
+        }
+    }
+    return 1;
+}
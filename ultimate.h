@@ -0,0 +1,32 @@
+#ifndef ULTIMATE_H
+#define ULTIMATE_H
+
+#include <stdint.h>
+#include "board.h"
+
+// ultimate tic-tac-toe is a 3x3 meta-board of 3x3 sub-boards, so 9x9 cells
+#define ULTIMATE_SIDE 9
+#define ULTIMATE_CELLS (ULTIMATE_SIDE * ULTIMATE_SIDE)
+// active value when the next move may go in any open sub-board
+#define ULTIMATE_ANY -1
+
+// sub-boards are numbered like the cells of a 3x3 board, so every mask here uses the board.c layout and win masks
+typedef struct ultimate_board {
+    uint16_t x[BOARD_CELLS];        // X's cells of each sub-board
+    uint16_t o[BOARD_CELLS];        // O's cells of each sub-board
+    uint16_t won_x;                 // sub-boards won by X
+    uint16_t won_o;                 // sub-boards won by O
+    uint16_t closed;                // sub-boards that are won or full, no more moves go there
+    int active;                     // sub-board the next move has to go in, or ULTIMATE_ANY
+    char str[ULTIMATE_CELLS + 1];   // board string sent in MOVD (9 rows of 9 cells), updated one cell per move
+} ultimate_board_t;
+
+void ultimate_init(ultimate_board_t* board);
+int ultimate_legal_moves(const ultimate_board_t* board, uint16_t moves[BOARD_CELLS]);
+int ultimate_is_valid_move(const ultimate_board_t* board, int row, int col);
+void ultimate_place(ultimate_board_t* board, int row, int col, char role);
+int ultimate_check_win(const ultimate_board_t* board, char role);
+int ultimate_check_tie(const ultimate_board_t* board);
+int ultimate_is_dead_draw(const ultimate_board_t* board);
+
+#endif
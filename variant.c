@@ -0,0 +1,239 @@
+#include "variant.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// reads a positive number of at most 2 digits and moves *p past it (returns the number, or -1 if there isn't one)
+static int parse_small_number(const char** p) {
+    const char* s = *p;
+    if (!isdigit((unsigned char) s[0])) {
+        return -1;
+    }
+    int value = s[0] - '0';
+    s++;
+    if (isdigit((unsigned char) s[0])) {
+        value = value * 10 + (s[0] - '0');
+        s++;
+    }
+    *p = s;
+    return value;
+}
+
+// parses rows,cols,k into the size of a variant (returns 1 on success, 0 if malformed or not allowed)
+static int parse_size(const char* spec, variant_t* variant) {
+    const char* p = spec;
+    int rows = parse_small_number(&p);
+    if (rows < 0 || *p++ != ',') {
+        return 0;
+    }
+    int cols = parse_small_number(&p);
+    if (cols < 0 || *p++ != ',') {
+        return 0;
+    }
+    int k = parse_small_number(&p);
+    if (k < 0 || *p != '\0') {
+        return 0;
+    }
+    if (rows < 1 || rows > MNK_MAX_SIDE || cols < 1 || cols > MNK_MAX_SIDE || k < 1 || (k > rows && k > cols)) {
+        return 0;
+    }
+    variant->rows = rows;
+    variant->cols = cols;
+    variant->k = k;
+    return 1;
+}
+
+// parses the variant field of a PLAY message (returns 1 on success, 0 if malformed or not allowed)
+// an empty or missing field is the classic 3x3 game, ultimate is ultimate tic-tac-toe, gravity is connect four,
+// otherwise it is rows,cols,k (e.g. 15,15,5 for five in a row)
+int variant_parse(const char* spec, variant_t* variant) {
+    variant->type = VARIANT_CLASSIC;
+    variant->rows = 3;
+    variant->cols = 3;
+    variant->k = 3;
+    if (spec == NULL || spec[0] == '\0') {
+        return 1;
+    }
+    // gravity is connect four (6 rows, 7 columns, 4 in a row), gravity,rows,cols,k picks another size
+    if (strncmp(spec, "gravity", 7) == 0) {
+        variant->type = VARIANT_GRAVITY;
+        variant->rows = 6;
+        variant->cols = 7;
+        variant->k = 4;
+        if (spec[7] == '\0') {
+            return 1;
+        }
+        if (spec[7] != ',' || !parse_size(spec + 8, variant)) {
+            return 0;
+        }
+        // every column needs rows + 1 bits of the 64 bit masks
+        return variant->cols <= GRAVITY_MAX_COLS && (variant->rows + 1) * variant->cols <= GRAVITY_MAX_BITS;
+    }
+    if (strcmp(spec, "ultimate") == 0) {
+        variant->type = VARIANT_ULTIMATE;
+        variant->rows = ULTIMATE_SIDE;
+        variant->cols = ULTIMATE_SIDE;
+        return 1;
+    }
+    variant_t size;
+    if (!parse_size(spec, &size)) {
+        return 0;
+    }
+    // 3,3,3 is the classic game so it gets the bitboard
+    if (size.rows == 3 && size.cols == 3 && size.k == 3) {
+        return 1;
+    }
+    variant->type = VARIANT_MNK;
+    variant->rows = size.rows;
+    variant->cols = size.cols;
+    variant->k = size.k;
+    return 1;
+}
+
+// writes the variant field a PLAY message would use to ask for this variant ("" for classic), spec needs 24 bytes
+void variant_format(const variant_t* variant, char* spec) {
+    if (variant->type == VARIANT_CLASSIC) {
+        spec[0] = '\0';
+    }
+    else if (variant->type == VARIANT_ULTIMATE) {
+        strcpy(spec, "ultimate");
+    }
+    else if (variant->type == VARIANT_GRAVITY) {
+        sprintf(spec, "gravity,%d,%d,%d", variant->rows, variant->cols, variant->k);
+    }
+    else {
+        sprintf(spec, "%d,%d,%d", variant->rows, variant->cols, variant->k);
+    }
+}
+
+// checks if two players asked for the same game (1 if yes, else 0)
+int variant_equals(const variant_t* a, const variant_t* b) {
+    return a->type == b->type && a->rows == b->rows && a->cols == b->cols && a->k == b->k;
+}
+
+// sets up an empty board for a variant (returns 1 on success, 0 if memory ran out)
+int game_board_init(game_board_t* board, const variant_t* variant) {
+    board->variant = *variant;
+    board->mnk.str = NULL;
+    board_init(&board->classic);
+    if (variant->type == VARIANT_ULTIMATE) {
+        ultimate_init(&board->ultimate);
+    }
+    if (variant->type == VARIANT_GRAVITY) {
+        return gravity_init(&board->gravity, variant->rows, variant->cols, variant->k);
+    }
+    if (variant->type == VARIANT_MNK) {
+        canon_hash_init(&board->hash, variant->rows, variant->cols, variant->k);
+        return mnk_init(&board->mnk, variant->rows, variant->cols, variant->k);
+    }
+    return 1;
+}
+
+void game_board_free(game_board_t* board) {
+    if (board->variant.type == VARIANT_MNK) {
+        mnk_free(&board->mnk);
+    }
+}
+
+// parses the position field of a MOVE message into 1-based row and col (returns 1 on success, else 0)
+// protocol.c already made sure it looks like digits,digits or digits so this only has to read the numbers
+// a gravity move is only a column, the row is wherever the piece falls (0 if the column is full)
+int game_board_parse_move(const game_board_t* board, const char* position, int* row, int* col) {
+    const char* p = position;
+    if (board->variant.type == VARIANT_GRAVITY) {
+        *col = parse_small_number(&p);
+        if (*col < 0 || *p != '\0') {
+            return 0;
+        }
+        *row = gravity_drop_row(&board->gravity, *col);
+        return 1;
+    }
+    *row = parse_small_number(&p);
+    if (*row < 0 || *p++ != ',') {
+        return 0;
+    }
+    *col = parse_small_number(&p);
+    return *col >= 0 && *p == '\0';
+}
+
+// writes a move the way a MOVE message names it (row,col, or just col for gravity) for the MOVD of a bot move
+void game_board_format_move(const game_board_t* board, int row, int col, char* position) {
+    if (board->variant.type == VARIANT_GRAVITY) {
+        sprintf(position, "%d", col);
+        return;
+    }
+    sprintf(position, "%d,%d", row, col);
+}
+
+// the game_board_other_* functions are the slow paths of the inline game_board_* functions in variant.h, for every variant but classic
+
+// checks if a move is valid (1 if yes, else 0)
+int game_board_other_is_valid_move(const game_board_t* board, int row, int col) {
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        return ultimate_is_valid_move(&board->ultimate, row, col);
+    }
+    if (board->variant.type == VARIANT_GRAVITY) {
+        return gravity_is_valid_move(&board->gravity, row, col);
+    }
+    return mnk_is_valid_move(&board->mnk, row, col);
+}
+
+// places role on a cell, the caller must have checked the move with game_board_is_valid_move
+void game_board_other_place(game_board_t* board, int row, int col, char role) {
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        ultimate_place(&board->ultimate, row, col, role);
+        return;
+    }
+    if (board->variant.type == VARIANT_GRAVITY) {
+        gravity_place(&board->gravity, row, col, role);
+        return;
+    }
+    mnk_place(&board->mnk, row, col, role);
+    canon_hash_place(&board->hash, row, col, role);
+}
+
+// checks if the move role just made on (row, col) won the game (1 if yes, else 0)
+int game_board_other_check_win(const game_board_t* board, int row, int col, char role) {
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        return ultimate_check_win(&board->ultimate, role);
+    }
+    if (board->variant.type == VARIANT_GRAVITY) {
+        return gravity_check_win(&board->gravity, role);
+    }
+    return mnk_check_win_at(&board->mnk, row, col);
+}
+
+// checks if there is a tie (1 if yes, else 0)
+int game_board_other_check_tie(const game_board_t* board) {
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        return ultimate_check_tie(&board->ultimate);
+    }
+    if (board->variant.type == VARIANT_GRAVITY) {
+        return gravity_check_tie(&board->gravity);
+    }
+    return mnk_check_tie(&board->mnk);
+}
+
+// checks if neither player can complete a line anymore so the game can be ended early (1 if yes, else 0)
+// ultimate checks the meta-board lines, gravity and m,n,k boards are played out
+int game_board_other_is_dead_draw(const game_board_t* board) {
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        return ultimate_is_dead_draw(&board->ultimate);
+    }
+    return 0;
+}
+
+// gets the board string sent in MOVD
+const char* game_board_str(const game_board_t* board) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        return board->classic.str;
+    }
+    if (board->variant.type == VARIANT_ULTIMATE) {
+        return board->ultimate.str;
+    }
+    if (board->variant.type == VARIANT_GRAVITY) {
+        return board->gravity.str;
+    }
+    return board->mnk.str;
+}
@@ -0,0 +1,97 @@
+#ifndef VARIANT_H
+#define VARIANT_H
+
+#include "board.h"
+#include "perfect.h"
+#include "mnk.h"
+#include "canon.h"
+#include "ultimate.h"
+#include "gravity.h"
+
+typedef enum {
+    VARIANT_CLASSIC, // 0 - 3x3 bitboard from board.c
+    VARIANT_MNK,     // 1 - any other rows,cols,k board from mnk.c
+    VARIANT_ULTIMATE, // 2 - 9x9 ultimate tic-tac-toe from ultimate.c
+    VARIANT_GRAVITY   // 3 - connect four style rows,cols,k board from gravity.c, a MOVE names only the column
+} VariantType;
+
+// the game a player asked for in the fourth field of PLAY, players are only paired with the same variant
+typedef struct variant {
+    VariantType type;
+    int rows;
+    int cols;
+    int k;
+} variant_t;
+
+// the board of a running game, only the member that matches variant.type is used
+typedef struct game_board {
+    variant_t variant;
+    board_t classic;
+    mnk_board_t mnk;
+    ultimate_board_t ultimate;
+    gravity_board_t gravity;
+    canon_hash_t hash; // symmetry hashes of the m,n,k board, keys the shared position cache
+} game_board_t;
+
+int variant_parse(const char* spec, variant_t* variant);
+int variant_equals(const variant_t* a, const variant_t* b);
+void variant_format(const variant_t* variant, char* spec);
+
+int game_board_init(game_board_t* board, const variant_t* variant);
+void game_board_free(game_board_t* board);
+int game_board_parse_move(const game_board_t* board, const char* position, int* row, int* col);
+void game_board_format_move(const game_board_t* board, int row, int col, char* position);
+const char* game_board_str(const game_board_t* board);
+
+int game_board_other_is_valid_move(const game_board_t* board, int row, int col);
+void game_board_other_place(game_board_t* board, int row, int col, char role);
+int game_board_other_check_win(const game_board_t* board, int row, int col, char role);
+int game_board_other_check_tie(const game_board_t* board);
+int game_board_other_is_dead_draw(const game_board_t* board);
+
+// the per-move functions are inline so a classic game goes straight to board.c with one compare and no extra call,
+// every other variant goes through the game_board_other_* functions in variant.c
+
+// checks if a move is valid (1 if yes, else 0)
+static inline int game_board_is_valid_move(const game_board_t* board, int row, int col) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        return board_is_valid_move(&board->classic, row, col);
+    }
+    return game_board_other_is_valid_move(board, row, col);
+}
+
+// places role on a cell, the caller must have checked the move with game_board_is_valid_move
+static inline void game_board_place(game_board_t* board, int row, int col, char role) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        board_place(&board->classic, row, col, role);
+        return;
+    }
+    game_board_other_place(board, row, col, role);
+}
+
+// checks if the move role just made on (row, col) won the game (1 if yes, else 0)
+static inline int game_board_check_win(const game_board_t* board, int row, int col, char role) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        return board_check_win(&board->classic, role);
+    }
+    return game_board_other_check_win(board, row, col, role);
+}
+
+// checks if there is a tie (1 if yes, else 0)
+static inline int game_board_check_tie(const game_board_t* board) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        return board_check_tie(&board->classic);
+    }
+    return game_board_other_check_tie(board);
+}
+
+// checks if neither player can complete a line anymore so the game can be ended early (1 if yes, else 0)
+// the classic board asks the perfect play table
+static inline int game_board_is_dead_draw(const game_board_t* board) {
+    if (board->variant.type == VARIANT_CLASSIC) {
+        return perfect_is_dead_draw(&board->classic);
+    }
+    return game_board_other_is_dead_draw(board);
+}
+
+#endif